@@ -0,0 +1,78 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_BENCHMARK_H
+#define DOSBOX_BENCHMARK_H
+
+/* Benchmark mode (-benchmark <seconds>): runs the emulator headless and
+ * unthrottled with a fixed cycle count for the given emulated time, then
+ * prints the emulation speed and where the host time went. */
+
+#include "dosbox.h"
+
+#include <chrono>
+
+enum BenchmarkPart {
+	BENCH_OTHER=0,			// main loop and everything not listed below
+	BENCH_CPU,				// CPU core
+	BENCH_CALLBACKS,		// BIOS and DOS callbacks
+	BENCH_EVENTS,			// PIC events (video timing, sound card DMA, ...)
+	BENCH_TICKS,			// 1ms timer tick handlers (mixer, ...)
+	BENCH_GUI,				// host input and window events
+	BENCH_PARTS
+};
+
+struct BenchmarkState {
+	bool active;
+	bool started;
+	BenchmarkPart part;		// where the host time goes right now
+	std::chrono::steady_clock::time_point last;
+
+	uint64_t cycles;		// emulated cycles executed by the CPU core, without HLT and I/O delays
+	uint64_t pic_events;
+	uint64_t frames;		// frames rendered by the video emulation
+	double host[BENCH_PARTS];	// host seconds spent in each part
+};
+
+extern BenchmarkState benchmark;
+
+void BENCHMARK_Start(void);
+void BENCHMARK_Report(void);
+
+static inline BenchmarkPart BENCHMARK_Switch(const BenchmarkPart part) {
+	const auto now = std::chrono::steady_clock::now();
+	const BenchmarkPart prev = benchmark.part;
+	benchmark.host[prev] += std::chrono::duration<double>(now - benchmark.last).count();
+	benchmark.last = now;
+	benchmark.part = part;
+	return prev;
+}
+
+/* charges the host time of its scope to one part, nested scopes (a callback
+ * that runs the CPU) are not counted twice */
+class BenchmarkScope {
+public:
+	BenchmarkScope(const BenchmarkPart part) {
+		if (GCC_UNLIKELY(benchmark.active)) prev = BENCHMARK_Switch(part);
+	}
+	~BenchmarkScope() {
+		if (GCC_UNLIKELY(benchmark.active)) BENCHMARK_Switch(prev);
+	}
+private:
+	BenchmarkPart prev = BENCH_OTHER;
+};
+
+#endif
@@ -19,6 +19,11 @@
 #ifndef DOSBOX_BIOS_DISK_H
 #define DOSBOX_BIOS_DISK_H
 
+#include <functional>
+#include <list>
+#include <map>
+#include <vector>
+
 #include "dos_inc.h"
 #include "logging.h"
 #include "../src/dos/cdrom.h"
@@ -91,6 +96,92 @@ enum class Int13Status : uint8_t {
     SenseFailed         = 0xFF,
 };
 
+/* Write-back cache of an image file, shared by the disk image formats that do
+ * their own file I/O (raw, VHD, QCOW2, CHD deltas). The file is kept in 32KB
+ * chunks with a valid and a dirty bit per 512 bytes. A read that continues the
+ * previous one fetches the rest of the chunk ahead of it. Dirty data goes back
+ * to the file in runs of adjacent sectors when a chunk is evicted, on Flush()
+ * and about once a second from the timer. */
+class imageDiskCache {
+	public:
+		imageDiskCache(FILE *file,uint64_t max_bytes);
+		~imageDiskCache();
+
+		/* NULL if "disk image cache" is 0 */
+		static imageDiskCache *Create(FILE *file);
+		static void FlushAll(void);
+
+		bool Read(uint64_t offset,void *data,size_t len);
+		bool Write(uint64_t offset,const void *data,size_t len);
+		/* write back everything dirty and fflush() the file */
+		bool Flush(void);
+		/* the file length including data not yet written back */
+		uint64_t Length(void) const { return length; }
+		void LogStats(const char *name) const;
+
+		/* called by FlushAll() before the cache is written back, for owners
+		 * that keep metadata of their own to write through it (QCOW2 refcounts) */
+		std::function<bool(void)> sync;
+
+		uint64_t hits = 0,misses = 0,readahead = 0;
+		uint64_t writeback_runs = 0,writeback_sectors = 0;
+
+	private:
+		static constexpr unsigned int unit_shift = 9;
+		static constexpr unsigned int chunk_shift = 15;
+		static constexpr uint64_t chunk_size = (uint64_t)1u << chunk_shift;
+		static constexpr uint64_t unit_size = (uint64_t)1u << unit_shift;
+
+		struct Chunk {
+			uint8_t data[chunk_size];
+			uint64_t valid = 0,dirty = 0;
+			std::list<uint64_t>::iterator lru;
+		};
+
+		Chunk &GetChunk(uint64_t index);
+		bool Fill(uint64_t index,Chunk &c,uint64_t need);
+		bool WriteBack(std::map<uint64_t,Chunk>::iterator first,std::map<uint64_t,Chunk>::iterator last);
+
+		FILE *file;
+		size_t max_chunks;
+		uint64_t length = 0;       /* logical, includes pending writes */
+		uint64_t file_length = 0;  /* what is actually in the file */
+		uint64_t next_read = ~0ull;
+		size_t dirty_chunks = 0;
+		int writable = -1;         /* unknown until the first write */
+		std::map<uint64_t,Chunk> chunks;
+		std::list<uint64_t> lru;   /* most recently used first */
+		std::vector<uint8_t> iobuf;
+};
+
+/* A raw image file mapped into memory, for "memory map disk images". Sectors
+ * are copied straight out of and into the mapping and the host writes the
+ * dirty pages back, Flush() forces that. Images that don't fit the address
+ * space, or hosts without mmap, use the cache instead. */
+class imageDiskMapping {
+	public:
+		~imageDiskMapping();
+
+		/* NULL if disabled, unsupported or the file can't be mapped */
+		static imageDiskMapping *Create(FILE *file);
+
+		/* false if out of range (or a write to a read-only mapping) */
+		bool Read(uint64_t offset,void *data,size_t len) const;
+		bool Write(uint64_t offset,const void *data,size_t len);
+		bool Flush(void);
+		/* the mapped bytes themselves, NULL if out of range */
+		const uint8_t *Pointer(uint64_t offset,size_t len) const;
+
+	private:
+		imageDiskMapping() = default;
+
+		uint8_t *base = NULL;
+		uint64_t length = 0;
+		bool writable = false;
+		uint64_t dirty_start = 0,dirty_end = 0; /* written since the last Flush() */
+		void *map_handle = NULL;                 /* Windows file mapping object */
+};
+
 class imageDisk {
 	public:
 		enum IMAGE_TYPE {
@@ -104,13 +195,24 @@ class imageDisk {
 			ID_EMPTY_DRIVE,
 			ID_INT13,
 			ID_MSDOSBLOCKDEV,
-			ID_TELEDISK
+			ID_TELEDISK,
+			ID_CHD
 		};
 
 		virtual Int13Status Read_Sector(uint32_t head,uint32_t cylinder,uint32_t sector,void * data,unsigned int req_sector_size=0);
 		virtual Int13Status Write_Sector(uint32_t head,uint32_t cylinder,uint32_t sector,const void * data,unsigned int req_sector_size=0);
 		virtual Int13Status Read_AbsoluteSector(uint32_t sectnum, void * data);
 		virtual Int13Status Write_AbsoluteSector(uint32_t sectnum, const void * data);
+		/* 'count' consecutive sectors. the default calls the single sector functions for each one,
+		 * formats that can do a run of sectors at once (QCOW2) override these */
+		virtual Int13Status Read_AbsoluteSectors(uint32_t sectnum, uint32_t count, void * data);
+		virtual Int13Status Write_AbsoluteSectors(uint32_t sectnum, uint32_t count, const void * data);
+		/* Where the image is memory mapped, a pointer to 'count' sectors of it that stays valid
+		 * while the disk is, to read from without a copy. NULL means use Read_AbsoluteSector(). */
+		const uint8_t *Map_AbsoluteSector(uint32_t sectnum, uint32_t count = 1);
+		/* let the raw sector code memory map diskimg, see imageDiskMapping. Only for the
+		 * open paths of plain raw images, whose sectors are in disk order from image_base */
+		void EnableMapping(void) { mapping_enabled = true; }
 
 		virtual void UpdateFloppyType(void);
 		virtual void Set_Reserved_Cylinders(Bitu resCyl);
@@ -148,6 +250,18 @@ class imageDisk {
 		imageDisk(IMAGE_TYPE class_id);
 		uint8_t floppytype = 0;
 
+		/* file I/O on diskimg, through the cache unless it is disabled */
+		bool ReadImage(uint64_t offset,void *data,size_t len);
+		bool WriteImage(uint64_t offset,const void *data,size_t len);
+		bool FlushImage(void);
+		imageDiskCache *cache = NULL;
+		/* memory mapping of diskimg for the raw sector code, created on first access
+		 * once EnableMapping() was called */
+		void MapImage(void);
+		imageDiskMapping *mapping = NULL;
+		bool mapping_enabled = false;
+		bool mapping_tried = false;
+
 	public:
 		uint32_t reserved_cylinders = 0;
 		uint64_t image_base = 0;
@@ -365,6 +479,58 @@ private:
     //uint64_t image_length = 0;
 };
 
+/* imageDiskCHD reads MAME CHD hard disk images through libchdr. Hunks are
+ * decompressed into a cache sized by "dos disk image cache". The CHD itself is
+ * never written: changed hunks go to "<image>.delta", created on the first
+ * write, which holds a header, an index of one 32-bit slot number per hunk and
+ * the hunks themselves in the order they were first written. */
+class imageDiskCHD : public imageDisk {
+public:
+	enum ErrorCodes : int
+	{
+		OPEN_SUCCESS = 0,
+		ERROR_OPENING = 1,
+		INVALID_DATA = 2,
+		UNSUPPORTED_TYPE = 3,
+		ERROR_OPENING_DELTA = 4,
+		DELTA_INVALID_MATCH = 5
+	};
+	Int13Status Read_AbsoluteSector(uint32_t sectnum, void * data) override;
+	Int13Status Write_AbsoluteSector(uint32_t sectnum, const void * data) override;
+	Int13Status Read_AbsoluteSectors(uint32_t sectnum, uint32_t count, void * data) override;
+	Int13Status Write_AbsoluteSectors(uint32_t sectnum, uint32_t count, const void * data) override;
+	static ErrorCodes Open(const char* fileName, const bool readOnly, imageDisk** disk);
+	virtual ~imageDiskCHD();
+
+private:
+	struct Hunk {
+		std::vector<uint8_t> data;
+		std::list<uint32_t>::iterator lru;
+	};
+
+	imageDiskCHD() : imageDisk(ID_CHD) { }
+	ErrorCodes OpenDelta(void);
+	bool CreateDelta(void);
+	Hunk* GetHunk(uint32_t hunknum);
+	bool InRange(uint32_t sectnum, uint32_t count) const;
+	Int13Status ReadSectors(uint32_t sectnum, uint32_t count, uint8_t* data);
+	Int13Status WriteSectors(uint32_t sectnum, uint32_t count, const uint8_t* data);
+
+	struct _chd_file* chd = NULL;
+	uint32_t hunkbytes = 0;
+	uint32_t totalhunks = 0;
+	uint8_t sha1[20] = {};
+	bool readOnly = false;
+	std::string deltaname;
+	std::vector<uint32_t> deltaIndex;  /* 0 = hunk is not in the delta */
+	uint32_t deltaSlots = 0;
+	uint64_t deltaDataOffset = 0;
+	size_t maxHunks = 0;
+	std::map<uint32_t,Hunk> hunks;
+	std::list<uint32_t> lru;           /* most recently used first */
+	uint64_t hits = 0, misses = 0;
+};
+
 /* PC-98 IPL1 partition table entry.
  * Taken from GNU Parted source code.
  * Maximum 16 entries. */
@@ -65,12 +65,14 @@ public:
     void ClearExtraData() { Section_prop *sec_prop; Section_line *sec_line; for (const_it tel = sectionlist.begin(); tel != sectionlist.end(); ++tel) {sec_prop = dynamic_cast<Section_prop *>(*tel); sec_line = dynamic_cast<Section_line *>(*tel); if (sec_prop) sec_prop->data = ""; else if (sec_line) sec_line->data = "";} }
 public:
     std::string opt_editconf,opt_opensaves,opt_opencaptures,opt_lang="",opt_machine="";
+    std::string opt_hostprof_trace;
     std::vector<std::string> config_file_list;
     std::vector<std::string> opt_o;
     std::vector<std::string> opt_c;
     std::vector<std::string> opt_set;
 
     double opt_time_limit = -1;
+    double opt_benchmark = -1;
     signed char opt_promptfolder = -1;
     bool opt_disable_dpi_awareness = false;
     bool opt_disable_numlock_check = false;
@@ -0,0 +1,112 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_HOSTPROF_H
+#define DOSBOX_HOSTPROF_H
+
+/* Host time profiler, compiled in with --enable-host-profiler.
+ *
+ * HOSTPROF_SCOPE() times the rest of the enclosing block and charges it to a
+ * zone. Scopes nest: the time of an inner scope is not charged to the outer
+ * one, so the shares shown in the video debug overlay add up to 100%. With
+ * -hostprof-trace <file> every scope is also recorded and written on exit as
+ * Chrome trace events (open in chrome://tracing or ui.perfetto.dev), where
+ * PIC events are named after their handler. Without the configure option the
+ * macros compile to nothing. */
+
+#include "dosbox.h"
+
+enum HostProfZone {
+	HOSTPROF_OTHER=0,		// main loop and everything not listed below
+	HOSTPROF_CPU,			// CPU core
+	HOSTPROF_PIC,			// PIC event handlers
+	HOSTPROF_MIXER,			// MIXER_MixData()
+	HOSTPROF_VGA_LINE,		// VGA_DrawSingleLine() and friends
+	HOSTPROF_RENDER_LINE,	// RENDER_DrawLine(), the scalers
+	HOSTPROF_GFX,			// GFX_EndUpdate(), output to the host
+	HOSTPROF_ZONES
+};
+
+#if C_HOST_PROFILER
+
+#include <chrono>
+
+typedef uint64_t hostprof_time_t;	// nanoseconds
+
+struct HostProfState {
+	bool active;
+	HostProfZone zone;				// innermost open scope
+	hostprof_time_t last;			// when the time of the innermost scope was last charged
+	hostprof_time_t self[HOSTPROF_ZONES];	// since the overlay was last updated
+	hostprof_time_t total[HOSTPROF_ZONES];
+	std::chrono::steady_clock::time_point epoch;
+};
+
+extern HostProfState hostprof;
+
+void HOSTPROF_Init(void);
+void HOSTPROF_Record(HostProfZone zone,const void *id,hostprof_time_t start,hostprof_time_t end);
+void HOSTPROF_OverlayText(char *buf,size_t len);
+
+static inline hostprof_time_t HOSTPROF_Now(void) {
+	return (hostprof_time_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - hostprof.epoch).count();
+}
+
+static inline void HOSTPROF_Charge(const hostprof_time_t now) {
+	hostprof.self[hostprof.zone] += now - hostprof.last;
+	hostprof.last = now;
+}
+
+class HostProfScope {
+public:
+	HostProfScope(const HostProfZone z,const void *i=NULL) : zone(z), id(i) {
+		if (GCC_UNLIKELY(hostprof.active)) {
+			timed = true;
+			start = HOSTPROF_Now();
+			HOSTPROF_Charge(start);
+			prev = hostprof.zone;
+			hostprof.zone = zone;
+		}
+	}
+	~HostProfScope() {
+		if (GCC_UNLIKELY(timed)) {
+			const hostprof_time_t end = HOSTPROF_Now();
+			HOSTPROF_Charge(end);
+			hostprof.zone = prev;
+			HOSTPROF_Record(zone,id,start,end);
+		}
+	}
+private:
+	const HostProfZone zone;
+	const void * const id;			// PIC event handler, names the trace event
+	HostProfZone prev = HOSTPROF_OTHER;
+	hostprof_time_t start = 0;
+	bool timed = false;
+};
+
+#define HOSTPROF_CONCAT2(a,b) a##b
+#define HOSTPROF_CONCAT(a,b) HOSTPROF_CONCAT2(a,b)
+#define HOSTPROF_SCOPE(zone) HostProfScope HOSTPROF_CONCAT(hostprof_scope_,__LINE__)(zone)
+#define HOSTPROF_SCOPE_ID(zone,id) HostProfScope HOSTPROF_CONCAT(hostprof_scope_,__LINE__)(zone,(const void*)(id))
+
+#else
+
+#define HOSTPROF_SCOPE(zone) do {} while (0)
+#define HOSTPROF_SCOPE_ID(zone,id) do {} while (0)
+
+#endif
+
+#endif
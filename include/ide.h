@@ -26,5 +26,6 @@ bool IDE_controller_occupied(signed char index, bool slave);
 void DOS_EnableDriveIDEMenu(unsigned int idx,unsigned char ms);
 bool IDE_is_CDROM(signed char index,bool slave);
 bool IDE_is_CDROM(const std::string &opts);
+void IDE_BusMaster_SetBase(unsigned int base);
 
 #endif
@@ -37,6 +37,15 @@ class IO_CalloutObject;
 typedef Bitu IO_ReadHandler(Bitu port,Bitu iolen);
 typedef void IO_WriteHandler(Bitu port,Bitu val,Bitu iolen);
 
+/* Optional bulk handlers for the data port of a device, used by REP INS/OUTS.
+ * They move up to 'count' items of 'iolen' bytes between the port and 'buf'
+ * (little endian, in guest memory order) and return how many were moved. That
+ * may be fewer than asked for, even none, the string op then goes on through
+ * the regular handler. Each item must have the same effect as one call to the
+ * regular handler the block handler was registered with. */
+typedef Bitu IO_ReadBlockHandler(Bitu port,uint8_t *buf,Bitu iolen,Bitu count);
+typedef Bitu IO_WriteBlockHandler(Bitu port,const uint8_t *buf,Bitu iolen,Bitu count);
+
 typedef IO_ReadHandler* (IO_ReadCalloutHandler)(IO_CalloutObject &co,Bitu port,Bitu iolen);
 typedef IO_WriteHandler* (IO_WriteCalloutHandler)(IO_CalloutObject &co,Bitu port,Bitu iolen);
 
@@ -51,6 +60,20 @@ void IO_FreeWriteHandler(Bitu port,Bitu mask,Bitu range=1);
 
 void IO_InvalidateCachedHandler(Bitu port,Bitu range=1);
 
+/* the block handler is only used while 'handler' is the one installed on the port.
+ * IO_FreeReadHandler/IO_FreeWriteHandler remove it again. */
+void IO_RegisterReadBlockHandler(Bitu port,IO_ReadHandler * handler,IO_ReadBlockHandler * block,Bitu range=1);
+void IO_RegisterWriteBlockHandler(Bitu port,IO_WriteHandler * handler,IO_WriteBlockHandler * block,Bitu range=1);
+bool IO_HasBlockHandler(Bitu port,bool write);
+
+/* REP INS/OUTS: move what is left of the page at base+index through the block
+ * handler of the port, if it has one. Only valid right after an item went through
+ * IO_Read*()/IO_Write*() and SaveM*()/LoadM*() at base+index-iolen, so that the
+ * page is known to be mapped. Takes the I/O delay off CPU_Cycles, the caller the
+ * one cycle per item. Advances index and returns the number of items. */
+Bitu IO_StringIn(Bitu port,uint32_t base,uint32_t &index,uint32_t mask,Bitu iolen,Bitu count);
+Bitu IO_StringOut(Bitu port,uint32_t base,uint32_t &index,uint32_t mask,Bitu iolen,Bitu count);
+
 void IO_WriteB(Bitu port,uint8_t val);
 void IO_WriteW(Bitu port,uint16_t val);
 void IO_WriteD(Bitu port,uint32_t val);
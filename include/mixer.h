@@ -46,6 +46,10 @@ extern uint8_t MixTemp[MIXER_BUFSIZE];
 
 #define LOWPASS_ORDER 8
 
+#define MIXER_RESAMPLE_MAXTAPS 32
+
+struct MixerResampleBank;
+
 class MixerChannel {
 public:
 	void SetVolume(float _left,float _right);
@@ -60,8 +64,8 @@ public:
 	void EndFrame(Bitu samples);
 
 	void lowpassUpdate();
-	int32_t lowpassStep(int32_t in,const unsigned int iteration,const unsigned int channel);
-	void lowpassProc(int32_t ch[2]);
+	float lowpassStep(float in,const unsigned int iteration,const unsigned int channel);
+	void lowpassProc(float ch[2]);
 
 	template<class Type,bool stereo,bool signeddata,bool nativeorder,bool lowpass>
 	void loadCurrentSample(Bitu &len, const Type* &data);
@@ -71,6 +75,13 @@ public:
 	double timeSinceLastSample(void);
 
 	bool runSampleInterpolation(const Bitu upto);
+	bool runSampleResample(const Bitu upto);
+
+	bool SetResampler(const char *profile); // "linear" (the default) or a windowed-sinc profile, false if there is no such profile
+	const char *GetResampler(void) const;
+	const float *GetResamplerCoef(unsigned int &taps,unsigned int &phases) const; // phases rows of taps coefficients, oldest input first, NULL for linear interpolation
+	void resamplerUpdate(void);
+	void resamplerPush(void);
 
 	void updateSlew(void);
 	void padFillSampleInterpolation(const Bitu upto);
@@ -100,9 +111,9 @@ public:
 	MIXER_Handler handler;
 	float volmain[2];
 	float scale[2];
-	int32_t volmul[2];
-	int32_t lowpass[LOWPASS_ORDER][2];	// lowpass filter
-	int32_t lowpass_alpha;			// "alpha" multiplier for lowpass (16.16 fixed point)
+	float volmul[2];
+	float lowpass[LOWPASS_ORDER][2];	// lowpass filter
+	float lowpass_alpha;			// "alpha" multiplier for lowpass
 	Bitu lowpass_freq;
 	unsigned int lowpass_order;
 	bool lowpass_on_load;			// apply lowpass on sample load (if source rate > mixer rate)
@@ -114,10 +125,14 @@ public:
 	unsigned int freq_n,freq_d,freq_d_orig;
 	bool current_loaded;
 	int32_t current[2],last[2],delta[2],max_change;
-	int32_t msbuffer[2048][2];		// more than enough for 1ms of audio, at mixer sample rate
+	float msbuffer[2048][2];		// more than enough for 1ms of audio, at mixer sample rate (float32 mixer bus, 16-bit sample units)
 	Bits last_sample_write;
 	Bitu msbuffer_o;
 	Bitu msbuffer_i;
+	unsigned int resample_profile;		// 0 = linear interpolation
+	const MixerResampleBank *resample;	// filter bank for the current rate ratio, NULL for linear interpolation
+	unsigned int resample_pos;		// oldest input sample in resample_hist
+	float resample_hist[2][MIXER_RESAMPLE_MAXTAPS*2];	// input history, written twice so the newest taps are always contiguous
 	const char * name;
 	bool enabled;
 	MixerChannel * next;
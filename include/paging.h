@@ -195,6 +195,16 @@ void PAGING_SetDirBase(Bitu cr3);
 void PAGING_InitTLB(void);
 void PAGING_ClearTLB(void);
 
+/* Counters of the software TLB behind the flat tables */
+struct PagingTLBStats {
+	uint64_t walks;			// page table walks to fill the flat tables
+	uint64_t stlb_hits;		// flat table fills served by the software TLB
+	uint64_t flushes;		// TLB flushes (CR3 writes, INVLPG, ...)
+	uint64_t unlinks;		// flat table flushes, including the above
+	uint64_t unlinked_pages;
+};
+const PagingTLBStats &PAGING_GetTLBStats(void);
+
 void PAGING_LinkPage(PageNum lin_page,PageNum phys_page);
 void PAGING_UnlinkPages(PageNum lin_page,PageNum pages);
 /* This maps the page directly, only use when paging is disabled */
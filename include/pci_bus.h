@@ -102,6 +102,9 @@ void PCI_RemoveSVGADOSBoxIG_Device(void);
 void PCI_AddSST_Device(Bitu type);
 void PCI_RemoveSST_Device(void);
 
+void PCI_AddIDEBusMaster_Device(void);
+void PCI_RemoveIDEBusMaster_Device(void);
+
 RealPt PCI_GetPModeInterface(void);
 bool has_pcibus_enable(void);
 
@@ -22,6 +22,8 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <map>
+#include <vector>
 
 #include "bios_disk.h"
 
@@ -56,11 +58,34 @@ public:
 	uint8_t read_sector(uint32_t sectnum, uint8_t* data);
 
 	uint8_t write_sector(uint32_t sectnum, const uint8_t* data);
+
+	uint8_t read_sectors(uint32_t sectnum, uint32_t count, uint8_t* data);
+
+	uint8_t write_sectors(uint32_t sectnum, uint32_t count, const uint8_t* data);
+
+	//Write pending refcount updates to the image file.
+	uint8_t sync();
 	
 private:
 
+	//A cached L2 table or refcount block, entries in host byte order.
+	template <typename T> struct CachedTable {
+		std::vector<T> entries;
+		uint64_t last_use = 0;
+		size_t dirty_first = 0;
+		size_t dirty_last = 0; /* dirty_first == dirty_last when clean */
+	};
+
 	FILE* file;
+	imageDiskCache* cache;
 	QCow2Header header;
+	std::vector<uint64_t> l1_table;
+	std::vector<uint64_t> refcount_table;
+	std::map<uint64_t, CachedTable<uint64_t> > l2_tables;
+	std::map<uint64_t, CachedTable<uint16_t> > refcount_blocks;
+	size_t max_cached_tables;
+	uint64_t table_use_count;
+	std::vector<uint8_t> cluster_buffer;
 	static const uint64_t copy_flag;
 	static const uint64_t empty_mask;
 	static const uint64_t table_entry_mask;
@@ -85,23 +110,27 @@ private:
 	
 	uint8_t pad_file(uint64_t& new_file_length);
 
-	uint8_t read_allocated_data(uint64_t file_offset, uint8_t* data, uint64_t data_size);
+	uint8_t allocate_cluster(const uint8_t* data, uint64_t& cluster_offset);
 
-	uint8_t read_cluster(uint64_t data_cluster_number, uint8_t* data);
+	uint8_t read_allocated_data(uint64_t file_offset, uint8_t* data, uint64_t data_size);
 
 	uint8_t read_l1_table(uint64_t address, uint64_t& l2_table_offset);
 
 	uint8_t read_l2_table(uint64_t l2_table_offset, uint64_t address, uint64_t& data_cluster_offset);
 
-	uint8_t read_refcount_table(uint64_t data_cluster_offset, uint64_t& refcount_cluster_offset);
+	uint8_t read_data_cluster_offset(uint64_t address, uint64_t& data_cluster_offset);
+
+	uint8_t read_unallocated_data(uint64_t address, uint8_t* data, uint64_t data_size);
+
+	uint8_t read_whole_table(uint64_t table_offset, uint64_t table_size, std::vector<uint64_t>& table);
 
-	uint8_t read_table(uint64_t entry_offset, uint64_t entry_mask, uint64_t& entry_value);
+	CachedTable<uint64_t>* get_l2_table(uint64_t l2_table_offset);
 
-	uint8_t read_unallocated_cluster(uint64_t data_cluster_number, uint8_t* data);
+	CachedTable<uint16_t>* get_refcount_block(uint64_t refcount_cluster_offset);
 
-	uint8_t read_unallocated_sector(uint32_t sectnum, uint8_t* data);
+	template <typename T> void evict_tables(std::map<uint64_t, CachedTable<T> >& tables);
 
-	uint8_t update_reference_count(uint64_t cluster_offset, uint8_t* cluster_buffer);
+	uint8_t update_reference_count(uint64_t cluster_offset);
 
 	uint8_t write_data(uint64_t file_offset, const uint8_t* data, uint64_t data_size);
 
@@ -109,7 +138,7 @@ private:
 
 	uint8_t write_l2_table_entry(uint64_t l2_table_offset, uint64_t address, uint64_t data_cluster_offset);
 
-	uint8_t write_refcount(uint64_t cluster_offset, uint64_t refcount_cluster_offset, uint16_t refcount);
+	uint8_t write_refcount_block(uint64_t refcount_cluster_offset, CachedTable<uint16_t>& block);
 
 	uint8_t write_refcount_table_entry(uint64_t cluster_offset, uint64_t refcount_cluster_offset);
 
@@ -128,6 +157,10 @@ public:
 
 	Int13Status Write_AbsoluteSector(uint32_t sectnum, const void* data) override;
 
+	Int13Status Read_AbsoluteSectors(uint32_t sectnum, uint32_t count, void* data) override;
+
+	Int13Status Write_AbsoluteSectors(uint32_t sectnum, uint32_t count, const void* data) override;
+
 private:
 
 	QCow2Image qcowImage;
@@ -191,6 +191,8 @@ bool RENDER_StartUpdate(void);
 void RENDER_EndUpdate(bool abort);
 void RENDER_SetPal(uint8_t entry,uint8_t red,uint8_t green,uint8_t blue);
 bool RENDER_GetForceUpdate(void);
+bool RENDER_CanSkipLine(void);
+bool RENDER_LineCached(void);
 void RENDER_SetForceUpdate(bool);
 
 bool TempLineAlloc(unsigned int w);
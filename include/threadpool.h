@@ -0,0 +1,105 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_THREADPOOL_H
+#define DOSBOX_THREADPOOL_H
+
+/* A fixed pool of worker threads for splitting one job into items, used by
+ * the scaler threads of the renderer and by the ZMBV encoder. Run() hands out
+ * the items to the pool and the calling thread and returns when all are done,
+ * one job at a time. Only standard headers, zmbv.cpp is built on its own too. */
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+	ThreadPool(int threads) {
+		for (int i=0;i<threads;i++)
+			pool.emplace_back(&ThreadPool::Worker, this);
+	}
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lk(lock);
+			quit = true;
+			wake.notify_all();
+		}
+		for (auto &t : pool) t.join();
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/* calls fn(0..items-1) on the pool and the calling thread, returns when all are done */
+	void Run(int items,const std::function<void(int)> &fn) {
+		if (pool.empty() || items <= 1) {
+			for (int i=0;i<items;i++) fn(i);
+			return;
+		}
+
+		std::unique_lock<std::mutex> lk(lock);
+		job = fn;
+		next = 0;
+		count = items;
+		finished = 0;
+		generation++;
+		wake.notify_all();
+
+		while (next < count) {
+			const int i = next++;
+			lk.unlock();
+			fn(i);
+			lk.lock();
+			finished++;
+		}
+		done.wait(lk, [this] { return finished == count; });
+		job = nullptr;
+	}
+
+private:
+	void Worker(void) {
+		std::unique_lock<std::mutex> lk(lock);
+		unsigned int seen = generation;
+
+		for (;;) {
+			wake.wait(lk, [this,&seen] { return quit || generation != seen; });
+			if (quit) break;
+			seen = generation;
+
+			while (next < count) {
+				const int i = next++;
+				lk.unlock();
+				job(i);
+				lk.lock();
+				if (++finished == count) done.notify_all();
+			}
+		}
+	}
+
+	std::mutex lock;
+	std::condition_variable wake, done;
+	std::vector<std::thread> pool;
+	std::function<void(int)> job;
+	int next = 0, count = 0, finished = 0;
+	unsigned int generation = 0;
+	bool quit = false;
+};
+
+#endif
@@ -665,6 +665,43 @@ typedef struct VGA_Complexity_t {
 	}
 } VGA_Complexity;
 
+/* Dirty tracking of video memory. The CPU write handlers stamp each block of vga.mem.linear
+ * they modify with the current scanline serial, so that a scanline whose memory, start address
+ * and palette did not change since it was last drawn can be passed to the renderer as unchanged
+ * instead of being drawn again and compared. */
+#define VGA_DIRTY_SHIFT		8u	// 256 bytes of video memory per stamp
+
+typedef struct VGA_Dirty_t {
+	uint32_t*	stamp = NULL;		// serial of the last write, per block of video memory
+	uint32_t	serial = 2;		// advanced for every scanline drawn
+	uint32_t	invalid = 1;		// scanlines drawn at or before this serial must be drawn again
+	bool		tracking = false;	// every CPU write to video memory goes through a handler that stamps it
+
+	INLINE void mark(const uint32_t linear_addr) {
+		stamp[linear_addr >> VGA_DIRTY_SHIFT] = serial;
+	}
+	INLINE void invalidate(void) {
+		invalid = serial;
+	}
+	/* true if any of the len bytes from offset start of the window at base, which
+	 * wraps around at mask+1, was written at or after serial since */
+	bool written_since(const Bitu base,Bitu start,Bitu len,const Bitu mask,const uint32_t since) const {
+		while (len != 0) {
+			const Bitu chunk = (len < mask + 1u - start) ? len : (mask + 1u - start);
+			const Bitu first = (base + start) >> VGA_DIRTY_SHIFT;
+			const Bitu last = (base + start + chunk - 1u) >> VGA_DIRTY_SHIFT;
+
+			for (Bitu b=first;b <= last;b++) {
+				if (stamp[b] >= since) return true;
+			}
+
+			len -= chunk;
+			start = 0;
+		}
+		return false;
+	}
+} VGA_Dirty;
+
 typedef struct VGA_Override_t {
 	bool			enable = false;
 	bool			start_sum = false;
@@ -734,6 +771,7 @@ typedef struct VGA_Type_t {
     VGA_Memory mem;
     VGA_LFB lfb = {};
     VGA_Complexity complexity = {};
+    VGA_Dirty dirty = {};
     VGA_Override overopts = {};
     VGA_DOSBoxIG dosboxig = {};
     unsigned int max_svga_width = 0,max_svga_height = 0;
@@ -44,7 +44,9 @@
 #define CACHE_MAXSIZE	(4096*8)
 #define CACHE_TOTAL		(1024*1024*8)
 #define CACHE_PAGES		(512)
+#define CACHE_PAGES_GROW	(64)
 #define CACHE_BLOCKS	(64*1024)
+#define CACHE_BLOCKS_GROW	(8*1024)
 #define CACHE_ALIGN		(16)
 #define DYN_HASH_SHIFT	(4)
 #define DYN_PAGE_HASH	(4096>>DYN_HASH_SHIFT)
@@ -374,6 +376,7 @@ Bits CPU_Core_Dyn_X86_Run(void) {
 		};
 	};
 	auto_dh_fpu fpu_saver;
+	dynprof_tick();
 
     /* Determine the linear address of CS:EIP */
 restart_core:
@@ -397,6 +400,9 @@ restart_core:
 	CacheBlock * block=chandler->FindCacheBlock(ip_point&4095);
 	if (!block) {
 		if (!chandler->invalidation_map || (chandler->invalidation_map[ip_point&4095]<4)) {
+			cache_stats.misses++;
+			if (chandler->invalidation_map && chandler->invalidation_map[ip_point&4095])
+				cache_stats.recompiles++;
 			decoder_pagefault.had_pagefault = false;
 			int cache_size = dynamic_core_cache_block_size;
 			block = CreateCacheBlock(chandler,ip_point,cache_size);
@@ -425,6 +431,9 @@ restart_core:
 			}
 			return nc_retcode; 
 		}
+	} else {
+		cache_stats.hits++;
+		cache_touchpage(chandler);
 	}
 run_block:
 	cache.block.running=nullptr;
@@ -500,6 +509,7 @@ run_block:
 			if (temp_handler->flags & (cpu.code.big ? PFLAG_HASCODE32:PFLAG_HASCODE16)) {
 				block=temp_handler->FindCacheBlock(temp_ip & 4095);
 				if (!block) goto restart_core;
+				cache_stats.hits++;
 				cache.block.running->LinkTo(ret==BR_Link2,block);
 				goto run_block;
 			}
@@ -620,6 +630,7 @@ void CPU_Core_Dyn_X86_Cache_Init(bool enable_cache) {
 }
 
 void CPU_Core_Dyn_X86_Cache_Close(void) {
+	dynprof_write_file("Dynamic x86 core");
 	cache_close();
 }
 
@@ -627,6 +638,32 @@ void CPU_Core_Dyn_X86_Cache_Reset(void) {
 	cache_reset();
 }
 
+#if C_DEBUG
+void DEBUG_PrintDynX86Cache(void) { //debugger "DYNCACHE" command
+	if (!cache_initialized) {
+		LOG_MSG("Dynamic x86 core: code cache not in use");
+		return;
+	}
+	LOG_MSG("Dynamic x86 core: code cache %luKB, %lu/%lu code pages, %lu cache blocks",
+			(unsigned long)(cache_total_size/1024u),
+			(unsigned long)cache_pages_total,
+			(unsigned long)cache_pages_max,
+			(unsigned long)(CACHE_BLOCKS+cache_block_chunks.size()*CACHE_BLOCKS_GROW));
+	LOG_MSG("hits=%llu misses=%llu recompiles=%llu invalidations=%llu block evictions=%llu page evictions=%llu",
+			(unsigned long long)cache_stats.hits,
+			(unsigned long long)cache_stats.misses,
+			(unsigned long long)cache_stats.recompiles,
+			(unsigned long long)cache_stats.invalidations,
+			(unsigned long long)cache_stats.block_evictions,
+			(unsigned long long)cache_stats.page_evictions);
+}
+
+void DEBUG_DynX86Profile(bool clear) { //debugger "DYNPROF" command
+	if (clear) dynprof_clear();
+	else if (dynprof_entries.size()>1) dynprof_report("Dynamic x86 core",NULL,20);
+}
+#endif
+
 void CPU_Core_Dyn_X86_SetFPUMode(bool dh_fpu) {
 #if defined(X86_DYNFPU_DH_ENABLED)
 	dyn_dh_fpu.dh_fpu_enabled=dh_fpu;
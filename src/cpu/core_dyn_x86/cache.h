@@ -18,6 +18,10 @@
 
 #include <assert.h>
 
+#include <vector>
+
+#include "cpu/dynamic_profile_common.h"
+
 class CacheBlock {
 public:
 	void Clear(void);
@@ -50,6 +54,7 @@ public:
 		CacheBlock * from;
 	} link[2];
 	CacheBlock * crossblock;
+	uint32_t profile;		// profiler slot, 0 if the block is not profiled
 };
 
 static struct {
@@ -65,6 +70,22 @@ static struct {
 	CodePageHandler * last_page;
 } cache;
 
+/* Code cache counters, shown by the debugger DYNCACHE command */
+static struct {
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t recompiles;
+	uint64_t invalidations;
+	uint64_t block_evictions;
+	uint64_t page_evictions;
+} cache_stats;
+
+/* Size of the code cache, taken from "dynamic core cache size" before allocation */
+static Bitu cache_total_size=CACHE_TOTAL;
+/* The number of code page handlers grows on demand up to cache_pages_max */
+static Bitu cache_pages_total=0;
+static Bitu cache_pages_max=CACHE_PAGES;
+
 static CacheBlock link_blocks[2];
 
 class CodePageHandler : public PageHandler {
@@ -99,8 +120,11 @@ public:
 			while (block) {
 				CacheBlock * nextblock=block->hash.next;
 				if (start<=block->page.end && end>=block->page.start) {
-					if (ip_point<=block->page.end && ip_point>=block->page.start) is_current_block=true;
+					const bool running=(ip_point<=block->page.end && ip_point>=block->page.start);
+					if (running) is_current_block=true;
+					dynprof_invalidate(block->profile,dynprof_writereason(end-start+1),running);
 					block->Clear();
+					cache_stats.invalidations++;
 				}
 				block=nextblock;
 			}
@@ -305,6 +329,7 @@ public:
 			while (block) {
 				CacheBlock * nextblock=block->hash.next;
 				block->page.handler=nullptr;			//No need, full clear
+				dynprof_invalidate(block->profile,DYNPROF_INV_PAGE);
 				block->Clear();
 				block=nextblock;
 			}
@@ -345,7 +370,57 @@ static INLINE void cache_addunsedblock(CacheBlock * block) {
 	cache.block.free=block;
 }
 
+static CacheBlock * cache_blocks=NULL;
+static std::vector<CacheBlock *> cache_block_chunks;
+
+/* Move a code page to the end of the used list, the head is the least recently used page */
+static INLINE void cache_touchpage(CodePageHandler * cpage) {
+	if (cache.last_page==cpage) return;
+	if (cpage->prev) cpage->prev->next=cpage->next;
+	else cache.used_pages=cpage->next;
+	cpage->next->prev=cpage->prev;
+	cpage->prev=cache.last_page;
+	cpage->next=nullptr;
+	cache.last_page->next=cpage;
+	cache.last_page=cpage;
+}
+
+static bool cache_growpages(Bitu count) {
+	if (cache_pages_total>=cache_pages_max) return false;
+	if (count>cache_pages_max-cache_pages_total) count=cache_pages_max-cache_pages_total;
+	for (Bitu i=0;i<count;i++) {
+		CodePageHandler * newpage=new CodePageHandler();
+		newpage->next=cache.free_pages;
+		cache.free_pages=newpage;
+	}
+	cache_pages_total+=count;
+	return true;
+}
+
+static void cache_freepages(void) {
+	while (cache.free_pages) {
+		CodePageHandler * npage=cache.free_pages->next;
+		delete cache.free_pages;
+		cache.free_pages=npage;
+	}
+	cache_pages_total=0;
+}
+
+static void cache_growblocks(void) {
+	CacheBlock * chunk=(CacheBlock*)malloc(CACHE_BLOCKS_GROW*sizeof(CacheBlock));
+	if (!chunk) E_Exit("Ran out of CacheBlocks");
+	memset(chunk,0,sizeof(CacheBlock)*CACHE_BLOCKS_GROW);
+	for (Bitu i=0;i<CACHE_BLOCKS_GROW;i++) {
+		chunk[i].link[0].to=(CacheBlock *)1;
+		chunk[i].link[1].to=(CacheBlock *)1;
+		chunk[i].cache.next=(i<CACHE_BLOCKS_GROW-1)?&chunk[i+1]:cache.block.free;
+	}
+	cache.block.free=&chunk[0];
+	cache_block_chunks.push_back(chunk);
+}
+
 static CacheBlock * cache_getblock(void) {
+	if (!cache.block.free) cache_growblocks();
 	CacheBlock * ret=cache.block.free;
 	if (!ret) E_Exit("Ran out of CacheBlocks" );
 	cache.block.free=ret->cache.next;
@@ -354,6 +429,7 @@ static CacheBlock * cache_getblock(void) {
 }
 
 void CacheBlock::Clear(void) {
+	profile=0;
 	Bitu ind;
 	/* Check if this is not a cross page block */
 	if (hash.index) for (ind=0;ind<2;ind++) {
@@ -399,15 +475,21 @@ static CacheBlock * cache_openblock(void) {
 	/* check for enough space in this block */
 	Bitu size=block->cache.size;
 	CacheBlock * nextblock=block->cache.next;
-	if (block->page.handler) 
+	if (block->page.handler) {
+		cache_stats.block_evictions++;
+		dynprof_invalidate(block->profile,DYNPROF_INV_EVICT);
 		block->Clear();
+	}
 	while (size<CACHE_MAXSIZE) {
 		if (!nextblock) 
 			goto skipresize;
 		size+=nextblock->cache.size;
 		CacheBlock * tempblock=nextblock->cache.next;
-		if (nextblock->page.handler) 
+		if (nextblock->page.handler) {
+			cache_stats.block_evictions++;
+			dynprof_invalidate(nextblock->profile,DYNPROF_INV_EVICT);
 			nextblock->Clear();
+		}
 		cache_addunsedblock(nextblock);
 		nextblock=tempblock;
 	}
@@ -500,15 +582,24 @@ static void gen_return(BlockReturnDynX86 retcode);
 static uint8_t * cache_code_start_ptr=NULL;
 static uint8_t * cache_code=NULL;
 static uint8_t * cache_code_link_blocks=NULL;
-static CacheBlock * cache_blocks=NULL;
 
 static bool cache_initialized = false;
 
 #include "cpu/dynamic_alloc_common.h"
 
+extern int dynamic_core_cache_size;
+extern int dynamic_core_cache_pages;
+
 static void cache_ensure_allocation(void) {
 	if (cache_code_start_ptr==NULL) {
-        cache_dynamic_common_alloc(CACHE_TOTAL+CACHE_MAXSIZE); /* sets cache_code_start_ptr/cache_code */
+		/* The size is fixed once the cache memory exists, the page limit scales with it unless it is set */
+		cache_total_size=(Bitu)dynamic_core_cache_size*1024*1024;
+		if (cache_total_size<CACHE_TOTAL/8) cache_total_size=CACHE_TOTAL/8;
+		if (dynamic_core_cache_pages>0) cache_pages_max=(Bitu)dynamic_core_cache_pages;
+		else cache_pages_max=CACHE_PAGES*4*cache_total_size/CACHE_TOTAL;
+		if (cache_pages_max<CACHE_PAGES) cache_pages_max=CACHE_PAGES;
+
+        cache_dynamic_common_alloc(cache_total_size+CACHE_MAXSIZE); /* sets cache_code_start_ptr/cache_code */
  
 		cache_code_link_blocks=cache_code;
 		cache_code+=PAGESIZE_TEMP;
@@ -539,7 +630,7 @@ static void cache_init(bool enable) {
 			cache.block.active=block;
 			block->cache.start=&cache_code[0];
 			block->cache.xstart=(uint8_t*)cache_rwtox(block->cache.start);
-			block->cache.size=CACHE_TOTAL;
+			block->cache.size=cache_total_size;
 			block->cache.next=nullptr;								//Last block in the list
 		}
 		/* Setup the default blocks for block linkage returns */
@@ -554,12 +645,9 @@ static void cache_init(bool enable) {
 		cache.free_pages=nullptr;
 		cache.last_page=nullptr;
 		cache.used_pages=nullptr;
+		cache_pages_total=0;
 		/* Setup the code pages */
-		for (i=0;i<CACHE_PAGES;i++) {
-			CodePageHandler * newpage=new CodePageHandler();
-			newpage->next=cache.free_pages;
-			cache.free_pages=newpage;
-		}
+		cache_growpages(CACHE_PAGES);
 	}
 }
 
@@ -590,15 +678,13 @@ static void cache_close(void) {
 
 static void cache_reset(void) {
 	if (cache_initialized) {
-		for (;;) {
-			if (cache.used_pages) {
-				CodePageHandler * cpage=cache.used_pages;
-				CodePageHandler * npage=cache.used_pages->next;
-				cpage->ClearRelease();
-				delete cpage;
-				cache.used_pages=npage;
-			} else break;
-		}
+		// releasing a page moves it to the free list, which is deleted below
+		while (cache.used_pages) cache.used_pages->ClearRelease();
+		cache_freepages();
+
+		/* Drop the blocks that were added on demand, all blocks are unused now */
+		for (size_t i=0;i<cache_block_chunks.size();i++) free(cache_block_chunks[i]);
+		cache_block_chunks.clear();
 
 		if (cache_blocks == NULL) {
 			cache_blocks=(CacheBlock*)malloc(CACHE_BLOCKS*sizeof(CacheBlock));
@@ -619,7 +705,7 @@ static void cache_reset(void) {
 		cache.block.active=block;
 		block->cache.start=&cache_code[0];
 		block->cache.xstart=(uint8_t*)cache_rwtox(block->cache.start);
-		block->cache.size=CACHE_TOTAL;
+		block->cache.size=cache_total_size;
 		block->cache.next=nullptr;								//Last block in the list
 
 		/* Setup the default blocks for block linkage returns */
@@ -631,14 +717,9 @@ static void cache_reset(void) {
 		link_blocks[1].cache.start=cache.pos;
 		link_blocks[1].cache.xstart=(uint8_t*)cache_rwtox(link_blocks[1].cache.start);
 		gen_return(BR_Link2);
-		cache.free_pages=nullptr;
 		cache.last_page=nullptr;
 		cache.used_pages=nullptr;
 		/* Setup the code pages */
-		for (Bitu i=0;i<CACHE_PAGES;i++) {
-			CodePageHandler * newpage=new CodePageHandler();
-			newpage->next=cache.free_pages;
-			cache.free_pages=newpage;
-		}
+		cache_growpages(CACHE_PAGES);
 	}
 }
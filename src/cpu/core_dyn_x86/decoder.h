@@ -109,8 +109,9 @@ static bool MakeCodePage(LinearPt lin_addr,CodePageHandler * &cph) {
 		LOG_MSG("DYNX86:Can't find physpage");
 		cph=nullptr;		return false;
 	}
-	/* Find a free CodePage */
-	if (!cache.free_pages) {
+	/* Find a free CodePage, release the least recently used one if no more can be added */
+	if (!cache.free_pages && !cache_growpages(CACHE_PAGES_GROW)) {
+		cache_stats.page_evictions++;
 		if (cache.used_pages!=decode.page.code) cache.used_pages->ClearRelease();
 		else {
 			if ((cache.used_pages->next) && (cache.used_pages->next!=decode.page.code))
@@ -2185,6 +2186,7 @@ static void dyn_segprefix(SegNames seg) {
 
 static void dyn_closeblock(void) {
 	//Shouldn't create empty block normally but let's do it like this
+	gen_deadflags(false);
 	gen_protectflags();
 	dyn_fill_blocks();
 	cache_closeblock();
@@ -2484,8 +2486,136 @@ static void dyn_larlsl(bool islar) {
 #define dyn_mmx_check() if ((dyn_dh_fpu.dh_fpu_enabled) && (!fpu_used)) {dh_fpu_startup();}
 #endif
 
+// flags liveness
+// look at the instructions from the current one on, without decoding them into
+// the block yet. Returns true if the flags in the host flags register are all
+// overwritten before anything reads them, then they don't have to be saved when
+// a function is called in between. Only the instructions listed here are known,
+// anything else is assumed to read the flags. An instruction that can raise an
+// exception (a memory operand, push and pop) counts as a reader too, since the
+// exception path stores the saved flags for the guest. The instructions that
+// are looked at all belong to the block, so writes to them invalidate it.
+#define DYN_FLAGS_LOOKAHEAD 6
+
+static bool dyn_flags_dead(Bitu max_opcodes) {
+	PhysPt code=decode.code;
+	Bitu index=decode.page.index;
+	Bitu live=FMASK_TEST;
+	if (max_opcodes>=DYN_FLAGS_LOOKAHEAD) max_opcodes=DYN_FLAGS_LOOKAHEAD-1;
+	for (Bitu count=0;count<=max_opcodes;count++) {
+		bool big_op=cpu.code.big;
+		bool big_addr=cpu.code.big;
+		Bitu len=0;			// bytes after the opcode besides the modrm
+		Bitu modrm=0x100;	// no modrm
+		Bitu op;
+		for (;;) {
+			if (index>=4096) return false;
+			if (decode.page.invmap && decode.page.invmap[index]>=4) return false;
+			op=mem_readb(code);
+			code++;index++;
+			if (op==0x66) big_op=!big_op;
+			else if (op==0x67) big_addr=!big_addr;
+			else if (op!=0x26 && op!=0x2e && op!=0x36 && op!=0x3e && op!=0x64 && op!=0x65) break;
+		}
+		Bitu kills=0;		// flags that are overwritten
+		if (op<0x40 && (op&7)<6) {
+			// add/or/adc/sbb/and/sub/xor/cmp
+			if ((op>>3)==2 || (op>>3)==3) return false;
+			kills=FMASK_TEST;
+			if ((op&7)<4) modrm=0;
+			else len=((op&7)==4) ? 1 : (big_op ? 4 : 2);
+		} else if (op>=0x40 && op<=0x4f) {
+			kills=FMASK_TEST&~FLAG_CF;
+		} else if (op>=0x50 && op<=0x5f) {
+			return false;	// stack access, can fault
+		} else if (op>=0x80 && op<=0x8b) {
+			modrm=0;
+			if (op<=0x83) {
+				len=(op==0x81) ? (big_op ? 4 : 2) : 1;
+				kills=FMASK_TEST;	// checked against adc/sbb below
+			} else if (op<=0x85) kills=FMASK_TEST;
+		} else if (op==0x8d) {
+			modrm=0;
+		} else if ((op>=0x90 && op<=0x99) || (op>=0xb0 && op<=0xbf)) {
+			if (op>=0xb8) len=big_op ? 4 : 2;
+			else if (op>=0xb0) len=1;
+		} else if (op==0xa8 || op==0xa9) {
+			kills=FMASK_TEST;
+			len=(op==0xa8) ? 1 : (big_op ? 4 : 2);
+		} else if (op==0xc6 || op==0xc7 || op==0xd0 || op==0xd1 || op==0xf6 || op==0xf7 || op==0xfe || op==0xff) {
+			modrm=0;
+			if (op==0xc6) len=1;
+			else if (op==0xc7) len=big_op ? 4 : 2;
+		} else if (op==0x0f) {
+			if (index>=4096) return false;
+			op=0x100|mem_readb(code);
+			code++;index++;
+			if (op!=0x1b6 && op!=0x1b7 && op!=0x1be && op!=0x1bf) return false;
+			modrm=0;
+		} else return false;
+
+		if (!modrm) {
+			if (index>=4096) return false;
+			modrm=mem_readb(code);
+			code++;index++;
+			const Bitu mod=modrm>>6,rm=modrm&7,reg=(modrm>>3)&7;
+			switch (op) {
+			case 0x80:case 0x81:case 0x82:case 0x83:
+				if (reg==2 || reg==3) return false;
+				break;
+			case 0x8d:
+				if (mod==3) return false;
+				break;
+			case 0xc6:case 0xc7:
+				if (reg) return false;
+				break;
+			case 0xd0:case 0xd1:
+				// shifts by one change all flags, rotates only cf and of
+				if (reg==2 || reg==3) return false;
+				kills=(reg<2) ? (FLAG_CF|FLAG_OF) : FMASK_TEST;
+				break;
+			case 0xf6:case 0xf7:
+				// test and neg
+				if (reg==0) len=(op==0xf6) ? 1 : (big_op ? 4 : 2);
+				else if (reg!=3) return false;
+				kills=FMASK_TEST;
+				break;
+			case 0xfe:case 0xff:
+				// inc and dec
+				if (reg>1) return false;
+				kills=FMASK_TEST&~FLAG_CF;
+				break;
+			}
+			// memory operands can fault, lea only computes the address
+			if (mod!=3 && op!=0x8d) return false;
+			if (mod!=3) {
+				if (big_addr) {
+					if (rm==4) {
+						if (index>=4096) return false;
+						if (mod==0 && (mem_readb(code)&7)==5) len+=4;
+						len++;
+					}
+					if (mod==0 && rm==5) len+=4;
+					else if (mod==1) len+=1;
+					else if (mod==2) len+=4;
+				} else {
+					if (mod==0 && rm==6) len+=2;
+					else if (mod==1) len+=1;
+					else if (mod==2) len+=2;
+				}
+			}
+		}
+		live&=~kills;
+		if (!live) return true;
+		code+=(PhysPt)len;
+		index+=len;
+	}
+	return false;
+}
+
 static CacheBlock * CreateCacheBlock(CodePageHandler * codepage,PhysPt start,Bitu max_opcodes) {
 	Bits i;
+	Bitu instructions=0;
 
 	cache_remap_rw();
 
@@ -2501,6 +2631,7 @@ static CacheBlock * CreateCacheBlock(CodePageHandler * codepage,PhysPt start,Bit
 	decode.active_block=decode.block=cache_openblock();
 	decode.block->page.start=(uint16_t)decode.page.index;
 	codepage->AddCacheBlock(decode.block);
+	decode.block->profile=dynprof_openblock(start);
 
 	for (i=0;i<G_MAX;i++) {
 		DynRegs[i].flags&=~(DYNFLG_ACTIVE|DYNFLG_CHANGED);
@@ -2510,6 +2641,7 @@ static CacheBlock * CreateCacheBlock(CodePageHandler * codepage,PhysPt start,Bit
 	gen_save_host_direct(&cache.block.running,(uintptr_t)decode.block);
 	/* Start with the cycles check */
 	gen_protectflags();
+	if (decode.block->profile) gen_inc_host_direct(&dynprof_counts[decode.block->profile]);
 	gen_dop_word(DOP_TEST,true,DREG(CYCLES),DREG(CYCLES));
 	save_info[used_save_info].branch_pos=gen_create_branch_long(BR_LE);
 	save_info[used_save_info].type=cycle_check;
@@ -2527,8 +2659,10 @@ static CacheBlock * CreateCacheBlock(CodePageHandler * codepage,PhysPt start,Bit
 		decode.segprefix=nullptr;
 		decode.rep=REP_NONE;
 		decode.cycles++;
+		instructions++;
 		decode.op_start=decode.code;
 		decode.pf_restore.dword=0;
+		gen_deadflags(dyn_flags_dead(max_opcodes));
 #ifdef DYN_DEBUG_PAGEFAULT
 		decode.debug_message = "";
 #endif
@@ -3288,6 +3422,7 @@ finish_block:
 	/* Setup the correct end-address */
 	decode.active_block->page.end=(uint16_t)--decode.page.index;
 //	LOG_MSG("Created block size %d start %d end %d",decode.block->cache.size,decode.block->page.start,decode.block->page.end);
+	dynprof_closeblock(decode.block->profile,(Bitu)(decode.code-decode.code_start),instructions,(Bitu)(cache.pos-decode.block->cache.start));
 	cache_remap_rx();
 	return decode.block;
 }
@@ -70,6 +70,8 @@ static const int reg_args[4] = {X64_REG_RDI, X64_REG_RSI, X64_REG_RDX, X64_REG_R
 
 static struct {
 	bool flagsactive;
+	bool flagsdead;		// the flags in the host register will not be read
+	bool savedead;		// the saved flags are not valid, they were dead
 	Bitu last_used;
 	GenReg * regs[X64_REGS];
 } x64gen;
@@ -446,35 +448,61 @@ static void gen_synchreg(DynReg * dnew,DynReg * dsynch) {
 	}
 }
 
+static void gen_discardflags(void) {
+	if (!x64gen.flagsactive) {
+		x64gen.flagsactive=true;
+		opcode(0).set64().setrm(4).setimm(CALLSTACK+8,1).Emit8(0x83); // add rsp,16/48
+	}
+	x64gen.flagsdead=x64gen.savedead=false;
+}
+
 static void gen_needflags(void) {
+	if (x64gen.savedead) {
+		// nothing valid to restore, the flags are overwritten before use
+		gen_discardflags();
+		return;
+	}
 	if (!x64gen.flagsactive) {
 		x64gen.flagsactive=true;
 		opcode(0).set64().setrm(4).setimm(CALLSTACK,1).Emit8(0x83); // add rsp,8/40
 		cache_addb(0x9d);		//POPFQ
 	}
+	x64gen.flagsdead=false;
 }
 
 static void gen_protectflags(void) {
 	if (x64gen.flagsactive) {
 		x64gen.flagsactive=false;
-		cache_addb(0x9c);		//PUSHFQ
-		opcode(4).set64().setea(4,-1,0,-(CALLSTACK)).Emit8(0x8D); // lea rsp, [rsp-8/40]
-	}
-}
-
-static void gen_discardflags(void) {
-	if (!x64gen.flagsactive) {
-		x64gen.flagsactive=true;
-		opcode(0).set64().setrm(4).setimm(CALLSTACK+8,1).Emit8(0x83); // add rsp,16/48
+		if (x64gen.flagsdead) {
+			// keep the stack layout but do not bother to save the flags
+			x64gen.savedead=true;
+			opcode(4).set64().setea(4,-1,0,-(CALLSTACK+8)).Emit8(0x8D); // lea rsp, [rsp-16/48]
+		} else {
+			cache_addb(0x9c);		//PUSHFQ
+			opcode(4).set64().setea(4,-1,0,-(CALLSTACK)).Emit8(0x8D); // lea rsp, [rsp-8/40]
+		}
 	}
 }
 
 static void gen_needcarry(void) {
+	if (x64gen.savedead) {
+		gen_discardflags();
+		return;
+	}
 	if (!x64gen.flagsactive) {
 		x64gen.flagsactive=true;
 		opcode(4).setea(4,-1,0,CALLSTACK).setimm(0,1).Emit16(0xBA0F);  // bt [rsp+8/40], 0
 		opcode(4).set64().setea(4,-1,0,CALLSTACK+8).Emit8(0x8D);       // lea rsp, [rsp+16/48]
 	}
+	x64gen.flagsdead=false;
+}
+
+// the flags in the host register are overwritten before they are read and
+// nothing before that can raise an exception (see dyn_flags_dead), so
+// gen_protectflags does not need to save them. The exception paths restore
+// the flags from the saved slot, which then holds garbage.
+static void gen_deadflags(bool dead) {
+	x64gen.flagsdead=dead;
 }
 
 /* UNUSED
@@ -499,6 +527,7 @@ static void set_skipflags(bool state) {
 static void gen_reinit(void) {
 	x64gen.last_used=0;
 	x64gen.flagsactive=false;
+	x64gen.flagsdead=x64gen.savedead=false;
 	for (Bitu i=0;i<X64_REGS;i++) {
 		x64gen.regs[i]->dynreg=nullptr;
 	}
@@ -1253,11 +1282,16 @@ static void gen_save_host_direct(void *data,Bitu imm) {
 		opcode(0).set64().setimm(imm,4).setabsaddr(data).Emit8(0xC7); // mov qword[], int32_t
 }
 
+static void gen_inc_host_direct(void *data) {
+	opcode(0).setabsaddr(data).Emit8(0xFF); // inc dword[]
+}
+
 static void gen_test_host_byte(void * data, uint8_t imm) {
 	opcode(0).setimm(imm,1).setabsaddr(data).Emit8(0xF6); // test byte[], uint8_t
 }
 
 static void gen_return(BlockReturnDynX86 retcode) {
+	x64gen.flagsdead=false;
 	gen_protectflags();
 	opcode(1).setea(4,-1,0,CALLSTACK).Emit8(0x8B); // mov ecx, [rsp+8/40]
 	opcode(0).set64().setrm(4).setimm(CALLSTACK+8,1).Emit8(0x83); // add rsp,16/48
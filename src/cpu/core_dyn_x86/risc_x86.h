@@ -237,35 +237,59 @@ static void gen_synchreg(DynReg * dnew,DynReg * dsynch) {
 	}
 }
 
+static void gen_discardflags(void) {
+	if (!x86gen.flagsactive) {
+		x86gen.flagsactive=true;
+		cache_addw(0xc483);		//ADD ESP,4
+		cache_addb(0x4);
+	}
+	x86gen.flagsdead=x86gen.savedead=false;
+}
+
 static void gen_needflags(void) {
+	if (x86gen.savedead) {
+		// nothing valid to restore, the flags are overwritten before use
+		gen_discardflags();
+		return;
+	}
 	if (!x86gen.flagsactive) {
 		x86gen.flagsactive=true;
 		cache_addb(0x9d);		//POPFD
 	}
+	x86gen.flagsdead=false;
 }
 
 static void gen_protectflags(void) {
 	if (x86gen.flagsactive) {
 		x86gen.flagsactive=false;
-		cache_addb(0x9c);		//PUSHFD
-	}
-}
-
-static void gen_discardflags(void) {
-	if (!x86gen.flagsactive) {
-		x86gen.flagsactive=true;
-		cache_addw(0xc483);		//ADD ESP,4
-		cache_addb(0x4);
+		if (x86gen.flagsdead) {
+			// keep the stack layout but do not bother to save the flags
+			x86gen.savedead=true;
+			cache_addb(0x50);		//PUSH EAX
+		} else cache_addb(0x9c);		//PUSHFD
 	}
 }
 
 static void gen_needcarry(void) {
+	if (x86gen.savedead) {
+		gen_discardflags();
+		return;
+	}
 	if (!x86gen.flagsactive) {
 		x86gen.flagsactive=true;
 		cache_addw(0x2cd1);			//SHR DWORD [ESP],1
 		cache_addb(0x24);
 		cache_addd(0x0424648d);		//LEA ESP,[ESP+4]
 	}
+	x86gen.flagsdead=false;
+}
+
+// the flags in the host register are overwritten before they are read and
+// nothing before that can raise an exception (see dyn_flags_dead), so
+// gen_protectflags does not need to save them. The exception paths restore
+// the flags from the saved slot, which then holds garbage.
+static void gen_deadflags(bool dead) {
+	x86gen.flagsdead=dead;
 }
 
 static void gen_setzeroflag(void) {
@@ -290,6 +314,7 @@ static void set_skipflags(bool state) {
 static void gen_reinit(void) {
 	x86gen.last_used=0;
 	x86gen.flagsactive=false;
+	x86gen.flagsdead=x86gen.savedead=false;
 	for (Bitu i=0;i<X86_REGS;i++) {
 		x86gen.regs[i]->dynreg=0;
 	}
@@ -1087,6 +1112,11 @@ static void gen_save_host_direct(void * data,Bits imm) {
 	cache_addd(imm);
 }
 
+static void gen_inc_host_direct(void * data) {
+	cache_addw(0x05ff);		//INC DWORD []
+	cache_addd((uintptr_t)data);
+}
+
 static void gen_test_host_byte(void * data, uint8_t imm) {
 	cache_addw(0x05f6); // test [],byte
 	cache_addd((uintptr_t)data);
@@ -1094,6 +1124,7 @@ static void gen_test_host_byte(void * data, uint8_t imm) {
 }
 
 static void gen_return(BlockReturnDynX86 retcode) {
+	x86gen.flagsdead=false;
 	gen_protectflags();
 	cache_addb(0x59);			//POP ECX, the flags
 	if (retcode==0) cache_addw(0xc033);		//MOV EAX, 0
@@ -50,7 +50,9 @@ extern bool do_lds_wraparound;
 #define CACHE_MAXSIZE	(4096*2)
 #define CACHE_TOTAL		(1024*1024*8)
 #define CACHE_PAGES		(512)
+#define CACHE_PAGES_GROW	(64)
 #define CACHE_BLOCKS	(128*1024)
+#define CACHE_BLOCKS_GROW	(16*1024)
 #define CACHE_ALIGN		(16)
 #define DYN_HASH_SHIFT	(4)
 #define DYN_PAGE_HASH	(4096>>DYN_HASH_SHIFT)
@@ -203,6 +205,7 @@ CacheBlockDynRec * LinkBlocks(BlockReturnDynRec ret) {
 		// see if the target is an already translated block
 		block=temp_handler->FindCacheBlock(temp_ip & 4095);
 		if (!block) return NULL;
+		cache_stats.hits++;
 
 		// found it, link the current block to
 		cache.block.running->LinkTo(ret==BR_Link2,block);
@@ -260,6 +263,8 @@ Bits CPU_Core_Dynrec_Run(void) {
         return CPU_Core_Normal_Run();
     }
 
+	dynprof_tick();
+
 	for (;;) {
 		dosbox_allow_nonrecursive_page_fault = false;
 		// Determine the linear address of CS:EIP
@@ -288,6 +293,9 @@ Bits CPU_Core_Dynrec_Run(void) {
 			// no block found, thus translate the instruction stream
 			// unless the instruction is known to be modified
 			if (!chandler->invalidation_map || (chandler->invalidation_map[ip_point&4095]<4)) {
+				cache_stats.misses++;
+				if (chandler->invalidation_map && chandler->invalidation_map[ip_point&4095])
+					cache_stats.recompiles++;
 				// translate up to 32 instructions
 				block=CreateCacheBlock(chandler,ip_point,32);
 			} else {
@@ -304,6 +312,17 @@ Bits CPU_Core_Dynrec_Run(void) {
 				}
 				return nc_retcode;
 			}
+		} else {
+			cache_stats.hits++;
+			cache_touchpage(chandler);
+			// a hot block whose closing jump mostly goes one way is translated
+			// again as a superblock, unless the page has modified code
+			if (GCC_UNLIKELY(block->trace_branch!=nullptr) && !block->traced && !chandler->invalidation_map &&
+				dyn_trace_predict(block->trace_branch,DYN_TRACE_HOT)>=0) {
+				block->Clear();
+				cache_stats.superblocks++;
+				block=CreateCacheBlock(chandler,ip_point,32,true);
+			}
 		}
 
 run_block:
@@ -436,10 +455,41 @@ void CPU_Core_Dynrec_Cache_Init(bool enable_cache) {
 }
 
 void CPU_Core_Dynrec_Cache_Close(void) {
+	dynprof_write_file("Dynrec core");
 	cache_close();
 }
 
 void CPU_Core_Dynrec_Cache_Reset(void) {
 	cache_reset();
 }
+
+#if C_DEBUG
+void DEBUG_PrintDynrecCache(void) { //debugger "DYNCACHE" command
+	if (!cache_initialized) {
+		LOG_MSG("Dynrec core: code cache not in use");
+		return;
+	}
+	LOG_MSG("Dynrec core: code cache %luKB, %lu/%lu code pages, %lu cache blocks",
+			(unsigned long)(cache_total_size/1024u),
+			(unsigned long)cache_pages_total,
+			(unsigned long)cache_pages_max,
+			(unsigned long)(CACHE_BLOCKS+cache_block_chunks.size()*CACHE_BLOCKS_GROW));
+	LOG_MSG("hits=%llu misses=%llu recompiles=%llu invalidations=%llu block evictions=%llu page evictions=%llu superblocks=%llu",
+			(unsigned long long)cache_stats.hits,
+			(unsigned long long)cache_stats.misses,
+			(unsigned long long)cache_stats.recompiles,
+			(unsigned long long)cache_stats.invalidations,
+			(unsigned long long)cache_stats.block_evictions,
+			(unsigned long long)cache_stats.page_evictions,
+			(unsigned long long)cache_stats.superblocks);
+	LOG_MSG("flag generating instructions=%llu, without live flags=%llu",
+			(unsigned long long)cache_stats.flag_defs,
+			(unsigned long long)cache_stats.dead_flags);
+}
+
+void DEBUG_DynrecProfile(bool clear) { //debugger "DYNPROF" command
+	if (clear) dynprof_clear();
+	else if (dynprof_entries.size()>1) dynprof_report("Dynrec core",NULL,20);
+}
+#endif
 #endif
@@ -18,10 +18,22 @@
 
 #include <assert.h>
 
+#include <unordered_map>
+#include <vector>
+
 #include "logging.h"
+#include "cpu/dynamic_profile_common.h"
 
 class CodePageHandlerDynRec;	// forward
 
+// how often a conditional jump went either way, used to form superblocks
+struct DynTraceBranch {
+	uint32_t taken;
+	uint32_t not_taken;
+};
+
+extern bool dynamic_core_superblocks;
+
 // basic cache block representation
 class CacheBlockDynRec {
 public:
@@ -59,6 +71,9 @@ public:
 		CacheBlockDynRec * from;	// the from-block can transfer control to this block
 	} link[2];	// maximum two links (conditional jumps)
 	CacheBlockDynRec * crossblock;
+	DynTraceBranch * trace_branch;	// counters of the conditional jump that ends this block
+	bool traced;				// translated as a superblock, don't try again
+	uint32_t profile;		// profiler slot, 0 if the block is not profiled
 };
 
 static struct {
@@ -74,6 +89,29 @@ static struct {
 	CodePageHandlerDynRec * last_page;		// the last used page
 } cache;
 
+// code cache counters, shown by the debugger DYNCACHE command
+static struct {
+	uint64_t hits;				// dispatches to an already translated block
+	uint64_t misses;			// blocks that had to be translated
+	uint64_t recompiles;		// translations of code that was modified before
+	uint64_t invalidations;		// blocks cleared by writes to their code
+	uint64_t block_evictions;	// blocks overwritten to make room in the code cache
+	uint64_t page_evictions;	// code pages released to make room for new ones
+	uint64_t superblocks;		// blocks retranslated along their hot path
+	uint64_t flag_defs;			// translated instructions that generate condition flags
+	uint64_t dead_flags;		// of these, the ones whose flags are never read
+} cache_stats;
+
+// conditional jump counters keyed by physical address and code size. The
+// translated code increments the entries directly, so they must not move.
+static std::unordered_map<uint64_t,DynTraceBranch> cache_trace_branches;
+
+// size of the code cache, taken from "dynamic core cache size" before allocation
+static Bitu cache_total_size=CACHE_TOTAL;
+// the number of code page handlers grows on demand up to cache_pages_max
+static Bitu cache_pages_total=0;
+static Bitu cache_pages_max=CACHE_PAGES;
+
 
 // cache memory pointers, to be malloc'd later
 static uint8_t * cache_code_start_ptr=NULL;
@@ -81,6 +119,7 @@ static uint8_t * cache_code=NULL;
 static uint8_t * cache_code_link_blocks=NULL;
 
 static CacheBlockDynRec * cache_blocks=NULL;
+static std::vector<CacheBlockDynRec *> cache_block_chunks;	// blocks added when cache_blocks ran out
 static CacheBlockDynRec link_blocks[2];		// default linking (specially marked)
 
 
@@ -132,8 +171,11 @@ public:
 				CacheBlockDynRec * nextblock=block->hash.next;
 				// test if this block is in the range
 				if (start<=block->page.end && end>=block->page.start) {
-					if (ip_point<=block->page.end && ip_point>=block->page.start) is_current_block=true;
+					const bool running=(ip_point<=block->page.end && ip_point>=block->page.start);
+					if (running) is_current_block=true;
+					dynprof_invalidate(block->profile,dynprof_writereason(end-start+1),running);
 					block->Clear();		// clear the block, decrements the write_map accordingly
+					cache_stats.invalidations++;
 				}
 				block=nextblock;
 			}
@@ -385,6 +427,7 @@ public:
 				block=*++map;
 			CacheBlockDynRec * nextblock=block->hash.next;
 			block->page.handler=nullptr;			// no need, full clear
+			dynprof_invalidate(block->profile,DYNPROF_INV_PAGE);
 			block->Clear();
 			block=nextblock;
 		}
@@ -433,8 +476,58 @@ static INLINE void cache_addunusedblock(CacheBlockDynRec * block) {
 	cache.block.free=block;
 }
 
+// move a code page to the end of the used list, so the head of the list
+// is always the least recently used page and gets released first
+static INLINE void cache_touchpage(CodePageHandlerDynRec * cpage) {
+	if (cache.last_page==cpage) return;
+	if (cpage->prev) cpage->prev->next=cpage->next;
+	else cache.used_pages=cpage->next;
+	cpage->next->prev=cpage->prev;
+	cpage->prev=cache.last_page;
+	cpage->next=nullptr;
+	cache.last_page->next=cpage;
+	cache.last_page=cpage;
+}
+
+// add up to count code page handlers to the free list, false if at the limit
+static bool cache_growpages(Bitu count) {
+	if (cache_pages_total>=cache_pages_max) return false;
+	if (count>cache_pages_max-cache_pages_total) count=cache_pages_max-cache_pages_total;
+	for (Bitu i=0;i<count;i++) {
+		CodePageHandlerDynRec * newpage=new CodePageHandlerDynRec();
+		newpage->next=cache.free_pages;
+		cache.free_pages=newpage;
+	}
+	cache_pages_total+=count;
+	return true;
+}
+
+static void cache_freepages(void) {
+	while (cache.free_pages) {
+		CodePageHandlerDynRec * npage=cache.free_pages->next;
+		delete cache.free_pages;
+		cache.free_pages=npage;
+	}
+	cache_pages_total=0;
+}
+
+// the initial block pool ran out, add another chunk of blocks to the free list
+static void cache_growblocks(void) {
+	CacheBlockDynRec * chunk=(CacheBlockDynRec*)malloc(CACHE_BLOCKS_GROW*sizeof(CacheBlockDynRec));
+	if (!chunk) E_Exit("Ran out of CacheBlocks");
+	memset(chunk,0,sizeof(CacheBlockDynRec)*CACHE_BLOCKS_GROW);
+	for (Bitu i=0;i<CACHE_BLOCKS_GROW;i++) {
+		chunk[i].link[0].to=(CacheBlockDynRec *)1;
+		chunk[i].link[1].to=(CacheBlockDynRec *)1;
+		chunk[i].cache.next=(i<CACHE_BLOCKS_GROW-1)?&chunk[i+1]:cache.block.free;
+	}
+	cache.block.free=&chunk[0];
+	cache_block_chunks.push_back(chunk);
+}
+
 static CacheBlockDynRec * cache_getblock(void) {
 	// get a free cache block and advance the free pointer
+	if (!cache.block.free) cache_growblocks();
 	CacheBlockDynRec * ret=cache.block.free;
     if (!ret)
         E_Exit("Ran out of CacheBlocks");
@@ -446,6 +539,9 @@ static CacheBlockDynRec * cache_getblock(void) {
 }
 
 void CacheBlockDynRec::Clear(void) {
+	profile=0;
+	trace_branch=nullptr;
+	traced=false;
 	// check if this is not a cross page block
 	if (hash.index) for (Bitu ind=0;ind<2;ind++) {
 		CacheBlockDynRec * fromlink=link[ind].from;
@@ -497,8 +593,11 @@ static CacheBlockDynRec * cache_openblock(void) {
 	// check for enough space in this block
 	Bitu size=block->cache.size;
 	CacheBlockDynRec * nextblock=block->cache.next;
-	if (block->page.handler) 
+	if (block->page.handler) {
+		cache_stats.block_evictions++;
+		dynprof_invalidate(block->profile,DYNPROF_INV_EVICT);
 		block->Clear();
+	}
 	// block size must be at least CACHE_MAXSIZE
 	while (size<CACHE_MAXSIZE) {
 		if (!nextblock)
@@ -506,8 +605,11 @@ static CacheBlockDynRec * cache_openblock(void) {
 		// merge blocks
 		size+=nextblock->cache.size;
 		CacheBlockDynRec * tempblock=nextblock->cache.next;
-		if (nextblock->page.handler) 
+		if (nextblock->page.handler) {
+			cache_stats.block_evictions++;
+			dynprof_invalidate(nextblock->profile,DYNPROF_INV_EVICT);
 			nextblock->Clear();
+		}
 		// block is free now
 		cache_addunusedblock(nextblock);
 		nextblock=tempblock;
@@ -551,7 +653,7 @@ static void cache_closeblock(void) {
 		}
 	}
 	// advance the active block pointer
-	if (!block->cache.next || (block->cache.next->cache.start>(cache_code_start_ptr + CACHE_TOTAL - CACHE_MAXSIZE))) {
+	if (!block->cache.next || (block->cache.next->cache.start>(cache_code_start_ptr + cache_total_size - CACHE_MAXSIZE))) {
 //		LOG_MSG("Cache full restarting");
 		cache.block.active=cache.block.first;
 	} else {
@@ -608,9 +710,19 @@ static bool cache_initialized = false;
 
 #include "cpu/dynamic_alloc_common.h"
 
+extern int dynamic_core_cache_size;
+extern int dynamic_core_cache_pages;
+
 static void cache_ensure_allocation(void) {
 	if (cache_code_start_ptr==NULL) {
-        cache_dynamic_common_alloc(CACHE_TOTAL+CACHE_MAXSIZE); /* sets cache_code_start_ptr/cache_code */
+		// the size is fixed once the cache memory exists, the page limit scales with it unless it is set
+		cache_total_size=(Bitu)dynamic_core_cache_size*1024*1024;
+		if (cache_total_size<CACHE_TOTAL/8) cache_total_size=CACHE_TOTAL/8;
+		if (dynamic_core_cache_pages>0) cache_pages_max=(Bitu)dynamic_core_cache_pages;
+		else cache_pages_max=CACHE_PAGES*4*cache_total_size/CACHE_TOTAL;
+		if (cache_pages_max<CACHE_PAGES) cache_pages_max=CACHE_PAGES;
+
+        cache_dynamic_common_alloc(cache_total_size+CACHE_MAXSIZE); /* sets cache_code_start_ptr/cache_code */
  
 		cache_code_link_blocks=cache_code;
 		cache_code+=PAGESIZE_TEMP;
@@ -619,15 +731,16 @@ static void cache_ensure_allocation(void) {
 
 static void cache_reset(void) {
 	if (cache_initialized) {
-		for (;;) {
-			if (cache.used_pages) {
-				CodePageHandlerDynRec * cpage=cache.used_pages;
-				CodePageHandlerDynRec * npage=cache.used_pages->next;
-				cpage->ClearRelease();
-				delete cpage;
-				cache.used_pages=npage;
-			} else break;
-		}
+		// releasing a page moves it to the free list, which is deleted below
+		while (cache.used_pages) cache.used_pages->ClearRelease();
+		cache_freepages();
+
+		// drop the blocks that were added on demand, all blocks are unused now
+		for (size_t i=0;i<cache_block_chunks.size();i++) free(cache_block_chunks[i]);
+		cache_block_chunks.clear();
+
+		// all code that referenced the jump counters is gone
+		cache_trace_branches.clear();
 
 		if (cache_blocks == NULL) {
 			cache_blocks=(CacheBlockDynRec*)malloc(CACHE_BLOCKS*sizeof(CacheBlockDynRec));
@@ -650,7 +763,7 @@ static void cache_reset(void) {
 		cache.block.active=block;
 		block->cache.start=&cache_code[0];
 		block->cache.xstart=(uint8_t*)cache_rwtox(block->cache.start);
-		block->cache.size=CACHE_TOTAL;
+		block->cache.size=cache_total_size;
 		block->cache.next=nullptr;								//Last block in the list
 
 		/* Setup the default blocks for block linkage returns */
@@ -662,15 +775,10 @@ static void cache_reset(void) {
 		link_blocks[1].cache.start=cache.pos;
 		link_blocks[1].cache.xstart=(uint8_t*)cache_rwtox(link_blocks[1].cache.start);
 		dyn_return(BR_Link2,false);
-		cache.free_pages=nullptr;
 		cache.last_page=nullptr;
 		cache.used_pages=nullptr;
 		/* Setup the code pages */
-		for (Bitu i=0;i<CACHE_PAGES;i++) {
-			CodePageHandlerDynRec * newpage=new CodePageHandlerDynRec();
-			newpage->next=cache.free_pages;
-			cache.free_pages=newpage;
-		}
+		cache_growpages(CACHE_PAGES);
 
 		cache_remap_rx();
 	}
@@ -709,7 +817,7 @@ static void cache_init(bool enable) {
 			cache.block.active=block;
 			block->cache.start=&cache_code[0];
 			block->cache.xstart=(uint8_t*)cache_rwtox(block->cache.start);
-			block->cache.size=CACHE_TOTAL;
+			block->cache.size=cache_total_size;
 			block->cache.next=nullptr;						// last block in the list
 		}
 		// setup the default blocks for block linkage returns
@@ -732,12 +840,9 @@ static void cache_init(bool enable) {
 		cache.free_pages=nullptr;
 		cache.last_page=nullptr;
 		cache.used_pages=nullptr;
+		cache_pages_total=0;
 		// setup the code pages
-		for (i=0;i<CACHE_PAGES;i++) {
-			CodePageHandlerDynRec * newpage=new CodePageHandlerDynRec();
-			newpage->next=cache.free_pages;
-			cache.free_pages=newpage;
-		}
+		cache_growpages(CACHE_PAGES);
 	}
 }
 
@@ -32,7 +32,8 @@
 	instruction is encountered.
 */
 
-static CacheBlockDynRec * CreateCacheBlock(CodePageHandlerDynRec * codepage,PhysPt start,Bitu max_opcodes) {
+static CacheBlockDynRec * CreateCacheBlock(CodePageHandlerDynRec * codepage,PhysPt start,Bitu max_opcodes,bool superblock=false) {
+	Bitu instructions=0;
 	cache_remap_rw();
 
 	// initialize a load of variables
@@ -46,6 +47,12 @@ static CacheBlockDynRec * CreateCacheBlock(CodePageHandlerDynRec * codepage,Phys
 	decode.active_block=decode.block=cache_openblock();
 	decode.block->page.start=(uint16_t)decode.page.index;
 	codepage->AddCacheBlock(decode.block);
+	decode.block->profile=dynprof_openblock(start);
+	decode.block->trace_branch=nullptr;
+	decode.block->traced=superblock;
+	decode.trace.active=superblock;
+	decode.trace.branches=0;
+	decode.trace.loop_end=0;
 
 	InitFlagsOptimization();
 
@@ -53,6 +60,9 @@ static CacheBlockDynRec * CreateCacheBlock(CodePageHandlerDynRec * codepage,Phys
 	// so the block linking knows the last executed block
 	gen_mov_direct_ptr(&cache.block.running,(DRC_PTR_SIZE_IM)decode.block);
 
+	// count the executions of this block for the profiler
+	if (decode.block->profile) gen_add_direct_word(&dynprof_counts[decode.block->profile],1,true);
+
 	// start with the cycles check
 	gen_mov_word_to_reg(FC_RETOP,&CPU_Cycles,true);
 	save_info_dynrec[used_save_info_dynrec].branch_pos=gen_create_branch_long_leqzero(FC_RETOP);
@@ -68,6 +78,7 @@ static CacheBlockDynRec * CreateCacheBlock(CodePageHandlerDynRec * codepage,Phys
 		decode.seg_prefix_used=false;
 		decode.rep=REP_NONE;
 		decode.cycles++;
+		instructions++;
 		decode.op_start=decode.code;
 restart_prefix:
 		Bitu opcode;
@@ -201,9 +212,9 @@ restart_prefix:
 				// short conditional jumps
 				case 0x80:case 0x81:case 0x82:case 0x83:case 0x84:case 0x85:case 0x86:case 0x87:	
 				case 0x88:case 0x89:case 0x8a:case 0x8b:case 0x8c:case 0x8d:case 0x8e:case 0x8f:	
-					dyn_branched_exit((BranchTypes)(dual_code&0xf),
-						decode.big_op ? (int32_t)decode_fetchd() : (int16_t)decode_fetchw());
-					goto finish_block;
+					if (dyn_branched_exit((BranchTypes)(dual_code&0xf),
+						decode.big_op ? (int32_t)decode_fetchd() : (int16_t)decode_fetchw())) goto finish_block;
+					break;
 
 				// conditional byte set instructions
 /*				case 0x90:case 0x91:case 0x92:case 0x93:case 0x94:case 0x95:case 0x96:case 0x97:	
@@ -304,8 +315,8 @@ restart_prefix:
 		// short conditional jumps
 		case 0x70:case 0x71:case 0x72:case 0x73:case 0x74:case 0x75:case 0x76:case 0x77:	
 		case 0x78:case 0x79:case 0x7a:case 0x7b:case 0x7c:case 0x7d:case 0x7e:case 0x7f:	
-			dyn_branched_exit((BranchTypes)(opcode&0xf),(int8_t)decode_fetchb());	
-			goto finish_block;
+			if (dyn_branched_exit((BranchTypes)(opcode&0xf),(int8_t)decode_fetchb())) goto finish_block;
+			break;
 
 		// 'op []/reg8,imm8'
 		case 0x80:
@@ -552,9 +563,11 @@ restart_prefix:
 			break;
 		case 0xf8:		//CLC
 			gen_call_function_raw(dynrec_clc);
+			KillFlags(FLAG_CF);
 			break;
 		case 0xf9:		//STC
 			gen_call_function_raw(dynrec_stc);
+			KillFlags(FLAG_CF);
 			break;
 
 		case 0xf6:dyn_grp3_eb();break;
@@ -623,7 +636,15 @@ finish_block:
 	// setup the correct end-address
 	decode.page.index--;
 	decode.active_block->page.end=(uint16_t)decode.page.index;
+	if (decode.trace.loop_end) {
+		// an unrolled loop covers everything up to its back-edge, and
+		// the bytes decoded more than once count once in the write map
+		const Bitu start=decode.block->page.start;
+		decode.block->page.end=(uint16_t)(decode.trace.loop_end-1);
+		memcpy(&decode.page.wmap[start],&dyn_trace_wmap[start],decode.trace.loop_end-start);
+	}
 //	LOG_MSG("Created block size %d start %d end %d",decode.block->cache.size,decode.block->page.start,decode.block->page.end);
+	dynprof_closeblock(decode.block->profile,(Bitu)(decode.code-decode.code_start),instructions,(Bitu)(cache.pos-decode.block->cache.start));
 
 	cache_remap_rx();
 
@@ -118,6 +118,14 @@ static struct DynDecodeDynRec {
 		Bitu first;		// page number 
 	} page;
 
+	// superblock translation, conditional jumps that mostly go one
+	// way are followed and the other way becomes a side exit
+	struct {
+		bool active;
+		Bitu branches;		// conditional jumps followed so far
+		Bitu loop_end;		// page index after the first back-edge that was followed, 0 if none
+	} trace;
+
 	// modrm state of the current instruction (if used)
 	struct {
 //		Bitu val;
@@ -161,8 +169,9 @@ static bool MakeCodePage(Bitu lin_addr,CodePageHandlerDynRec * &cph) {
 		cph=nullptr;
 		return false;
 	}
-	// find a free CodePage
-	if (!cache.free_pages) {
+	// find a free CodePage, release the least recently used one if no more can be added
+	if (!cache.free_pages && !cache_growpages(CACHE_PAGES_GROW)) {
+		cache_stats.page_evictions++;
 		if (cache.used_pages!=decode.page.code) cache.used_pages->ClearRelease();
 		else {
 			// try another page to avoid clearing our source-crosspage
@@ -614,7 +623,7 @@ template <typename T> static DRC_PTR_SIZE_IM INLINE gen_call_function_mm(const T
 
 
 
-enum save_info_type_dynrec {db_exception, cycle_check, string_break, trap};
+enum save_info_type_dynrec {db_exception, cycle_check, string_break, trap, side_exit};
 
 
 // function that is called on exceptions
@@ -681,6 +690,13 @@ static void dyn_fill_blocks(void) {
 				gen_add_direct_word(&reg_eip,save_info_dynrec[sct].eip_change,decode.big_op);
 				dyn_return(BR_Trap);
 				break;
+			case side_exit:
+				// a followed conditional jump went the unlikely way, leave the superblock
+				decode.cycles=save_info_dynrec[sct].cycles;
+				dyn_reduce_cycles();
+				gen_add_direct_word(&reg_eip,save_info_dynrec[sct].eip_change,cpu.code.big);
+				dyn_return(BR_Normal);
+				break;
 		}
 	}
 	used_save_info_dynrec=0;
@@ -1208,55 +1224,87 @@ static void gen_restore_reg(HostReg reg,HostReg dest_reg) {
 
 // flags optimization functions
 // they try to find out if a function can be replaced by another
-// one that does not generate any flags at all
+// one that does not generate any flags at all.
+// Each queued function keeps the mask of the condition flags it
+// writes that may still be read. Instructions that overwrite flags
+// clear them from the masks of the earlier functions, a function
+// whose mask becomes empty is dead and replaced by its simple variant.
+
+#define MF_FUNCTIONS_MAX 64
 
 static Bitu mf_functions_num=0;
 static struct {
 	uint8_t* pos;
 	void* fct_ptr;
 	Bitu ftype;
-} mf_functions[64];
+	Bitu flags;		// written flags that may still be read
+} mf_functions[MF_FUNCTIONS_MAX];
 
 static void InitFlagsOptimization(void) {
 	mf_functions_num=0;
 }
 
-// replace all queued functions with their simpler variants
-// because the current instruction destroys all condition flags and
-// the flags are not required before
-static void InvalidateFlags(void) {
+// the current instruction overwrites the condition flags in flags_mask,
+// replace the queued functions that have no live flags left
+static void KillFlags(Bitu flags_mask) {
 #ifdef DRC_FLAGS_INVALIDATION
+	Bitu keep=0;
 	for (Bitu ct=0; ct<mf_functions_num; ct++) {
-		gen_fill_function_ptr(mf_functions[ct].pos,mf_functions[ct].fct_ptr,mf_functions[ct].ftype);
+		mf_functions[ct].flags&=~flags_mask;
+		if (!mf_functions[ct].flags) {
+			gen_fill_function_ptr(mf_functions[ct].pos,mf_functions[ct].fct_ptr,mf_functions[ct].ftype);
+			cache_stats.dead_flags++;
+		} else mf_functions[keep++]=mf_functions[ct];
 	}
-	mf_functions_num=0;
+	mf_functions_num=keep;
+#else
+	(void)flags_mask;
 #endif
 }
 
+#ifdef DRC_FLAGS_INVALIDATION
+static void QueueFlagsFunction(uint8_t* pos,void* fct_ptr,Bitu flags_type,Bitu written) {
+	cache_stats.flag_defs++;
+	if (mf_functions_num>=MF_FUNCTIONS_MAX) {
+		// the oldest function keeps generating its flags
+		for (Bitu ct=1; ct<mf_functions_num; ct++) mf_functions[ct-1]=mf_functions[ct];
+		mf_functions_num--;
+	}
+	mf_functions[mf_functions_num].pos=pos;
+	mf_functions[mf_functions_num].fct_ptr=fct_ptr;
+	mf_functions[mf_functions_num].ftype=flags_type;
+	mf_functions[mf_functions_num].flags=written;
+	mf_functions_num++;
+}
+#endif
+
+// replace all queued functions with their simpler variants
+// because the current instruction destroys all condition flags and
+// the flags are not required before
+static void InvalidateFlags(void) {
+	KillFlags(FMASK_TEST);
+}
+
 // replace all queued functions with their simpler variants
 // because the current instruction destroys all condition flags and
 // the flags are not required before
 template <typename T> static void InvalidateFlags(const T current_simple_function,Bitu flags_type) {
 #ifdef DRC_FLAGS_INVALIDATION
-	for (Bitu ct=0; ct<mf_functions_num; ct++) {
-		gen_fill_function_ptr(mf_functions[ct].pos,mf_functions[ct].fct_ptr,mf_functions[ct].ftype);
-	}
-	mf_functions_num=1;
-	mf_functions[0].pos=cache.pos;
-	mf_functions[0].fct_ptr=reinterpret_cast<void*>((uintptr_t)current_simple_function);
-	mf_functions[0].ftype=flags_type;
+	KillFlags(FMASK_TEST);
+	QueueFlagsFunction(cache.pos,reinterpret_cast<void*>((uintptr_t)current_simple_function),flags_type,FMASK_TEST);
 #endif
 }
 
-// enqueue this instruction, if later an instruction is encountered that
-// destroys all condition flags and the flags weren't needed in-between
-// this function can be replaced by a simpler one as well
-template <typename T> static void InvalidateFlagsPartially(const T current_simple_function,Bitu flags_type) {
+// the current instruction overwrites the flags in defined and may change
+// the flags in written. Enqueue it, if later instructions overwrite all
+// of its flags before they are read it can be replaced by a simpler one
+template <typename T> static void InvalidateFlagsPartially(const T current_simple_function,Bitu flags_type,Bitu defined,Bitu written) {
 #ifdef DRC_FLAGS_INVALIDATION
-	mf_functions[mf_functions_num].pos=cache.pos;
-	mf_functions[mf_functions_num].fct_ptr=reinterpret_cast<void*>((uintptr_t)current_simple_function);
-	mf_functions[mf_functions_num].ftype=flags_type;
-	mf_functions_num++;
+	KillFlags(defined);
+	QueueFlagsFunction(cache.pos,reinterpret_cast<void*>((uintptr_t)current_simple_function),flags_type,written);
+#else
+	(void)defined;
+	(void)written;
 #endif
 }
 
@@ -1265,18 +1313,63 @@ template <typename T> static void InvalidateFlagsPartially(const T current_simpl
 // this function can be replaced by a simpler one as well
 template <typename T> static void InvalidateFlagsPartially(const T current_simple_function,DRC_PTR_SIZE_IM cpos,Bitu flags_type) {
 #ifdef DRC_FLAGS_INVALIDATION
-	mf_functions[mf_functions_num].pos=(uint8_t*)cpos;
-	mf_functions[mf_functions_num].fct_ptr=reinterpret_cast<void*>((uintptr_t)current_simple_function);
-	mf_functions[mf_functions_num].ftype=flags_type;
-	mf_functions_num++;
+	QueueFlagsFunction((uint8_t*)cpos,reinterpret_cast<void*>((uintptr_t)current_simple_function),flags_type,FMASK_TEST);
 #endif
 }
 
-// the current function needs the condition flags thus reset the queue
+// the current function needs the condition flags in flags_mask, the
+// functions that generate them have to stay
 static void AcquireFlags(Bitu flags_mask) {
-	(void)flags_mask;
-
 #ifdef DRC_FLAGS_INVALIDATION
-	mf_functions_num=0;
+	Bitu keep=0;
+	for (Bitu ct=0; ct<mf_functions_num; ct++) {
+		if (!(mf_functions[ct].flags & flags_mask)) mf_functions[keep++]=mf_functions[ct];
+	}
+	mf_functions_num=keep;
+#else
+	(void)flags_mask;
 #endif
 }
+
+
+
+// superblock formation
+// blocks that end with a conditional jump count which way the jump goes,
+// once a block is hot and its jump mostly goes one way it is translated
+// again and continues along that path (see dyn_branched_exit), a jump back
+// to a loop start earlier in the block unrolls the loop within its page
+
+#define DYN_TRACE_HOT		256			// jump executions before a block is retranslated
+#define DYN_TRACE_FOLLOW	32			// jump executions needed to follow it further
+#define DYN_TRACE_BRANCHES	4			// conditional jumps followed in one superblock
+#define DYN_TRACE_MAX		(64*1024)	// number of jump counters
+
+// write map of the block's page when the first back-edge was followed, the
+// bytes of an unrolled loop are counted only once (see finish_block)
+static uint8_t dyn_trace_wmap[4096];
+
+// counters of the conditional jump that starts at decode.op_start,
+// NULL if superblocks are disabled or there are no counters left
+static DynTraceBranch * dyn_trace_branch(void) {
+	if (!dynamic_core_superblocks) return nullptr;
+	const uint64_t key=(uint64_t)((PAGING_GetPhysicalPage(decode.op_start)&~(PhysPt)4095)|(decode.op_start&4095))|
+		(cpu.code.big?(1ull<<32):0);
+	auto it=cache_trace_branches.find(key);
+	if (it!=cache_trace_branches.end()) return &it->second;
+	if (cache_trace_branches.size()>=DYN_TRACE_MAX) return nullptr;
+	DynTraceBranch &branch=cache_trace_branches[key];
+	branch.taken=0;
+	branch.not_taken=0;
+	return &branch;
+}
+
+// 1 if the jump is mostly taken, 0 if it mostly falls through,
+// -1 if it did not run often enough or goes both ways
+static int dyn_trace_predict(const DynTraceBranch * branch,uint64_t min_count) {
+	if (!branch) return -1;
+	const uint64_t total=(uint64_t)branch->taken+branch->not_taken;
+	if (total<min_count) return -1;
+	if (branch->taken>=total-total/16) return 1;
+	if (branch->not_taken>=total-total/16) return 0;
+	return -1;
+}
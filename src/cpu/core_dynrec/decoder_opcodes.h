@@ -635,20 +635,20 @@ static void dyn_grp2_eb(grp2_types type) {
 	switch (type) {
 	case grp2_1:
 		gen_mov_byte_to_reg_low_imm_canuseword(FC_OP2,1);
-		dyn_shift_byte_gencall((ShiftOps)decode.modrm.reg);
+		dyn_shift_byte_gencall((ShiftOps)decode.modrm.reg,true);
 		break;
 	case grp2_imm: {
 		uint8_t imm=decode_fetchb();
 		if (imm) {
 			gen_mov_byte_to_reg_low_imm_canuseword(FC_OP2,imm&0x1f);
-			dyn_shift_byte_gencall((ShiftOps)decode.modrm.reg);
+			dyn_shift_byte_gencall((ShiftOps)decode.modrm.reg,(imm&0x1f)!=0);
 		} else return;
 		}
 		break;
 	case grp2_cl:
 		MOV_REG_BYTE_TO_HOST_REG_LOW_CANUSEWORD(FC_OP2,DRC_REG_ECX,0);
 		gen_and_imm(FC_OP2,0x1f);
-		dyn_shift_byte_gencall((ShiftOps)decode.modrm.reg);
+		dyn_shift_byte_gencall((ShiftOps)decode.modrm.reg,false);
 		break;
 	}
 	if (decode.modrm.mod<3) {
@@ -671,27 +671,27 @@ static void dyn_grp2_ev(grp2_types type) {
 	switch (type) {
 	case grp2_1:
 		gen_mov_byte_to_reg_low_imm_canuseword(FC_OP2,1);
-		dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op);
+		dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op,true);
 		break;
 	case grp2_imm: {
 		Bitu val;
 		if (decode_fetchb_imm(val)) {
 			gen_mov_byte_to_reg_low_canuseword(FC_OP2,(void*)val);
 			gen_and_imm(FC_OP2,0x1f);
-			dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op);
+			dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op,false);
 			break;
 		}
 		uint8_t imm=(uint8_t)val;
 		if (imm) {
 			gen_mov_byte_to_reg_low_imm_canuseword(FC_OP2,imm&0x1f);
-			dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op);
+			dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op,(imm&0x1f)!=0);
 		} else return;
 		}
 		break;
 	case grp2_cl:
 		MOV_REG_BYTE_TO_HOST_REG_LOW_CANUSEWORD(FC_OP2,DRC_REG_ECX,0);
 		gen_and_imm(FC_OP2,0x1f);
-		dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op);
+		dyn_shift_word_gencall((ShiftOps)decode.modrm.reg,decode.big_op,false);
 		break;
 	}
 	if (decode.modrm.mod<3) {
@@ -1093,7 +1093,8 @@ static void dyn_cwd(void) {
 static void dyn_sahf(void) {
 	MOV_REG_WORD16_TO_HOST_REG(FC_OP1,DRC_REG_EAX);
 	gen_call_function_raw(dynrec_sahf);
-	InvalidateFlags();
+	// the overflow flag is kept
+	KillFlags(FMASK_TEST&~FLAG_OF);
 }
 
 
@@ -1105,22 +1106,86 @@ static void dyn_exit_link(int32_t eip_change) {
 }
 
 
-static void dyn_branched_exit(BranchTypes btype,int32_t eip_add) {
+// see if a superblock can continue along the likely way of a conditional jump,
+// returns 1 to follow the jump, 0 to fall through and -1 to end the block
+static int dyn_trace_follow(const DynTraceBranch * branch,int32_t eip_add) {
+	if (!decode.trace.active || decode.trace.branches>=DYN_TRACE_BRANCHES) return -1;
+	if (decode.big_op!=cpu.code.big) return -1;
+	switch (dyn_trace_predict(branch,DYN_TRACE_FOLLOW)) {
+	case 0:
+		return 0;
+	case 1:
+		if (eip_add<0) {
+			// a back-edge to a loop start inside this block, the loop body is
+			// translated again; not once the block went on to the next page
+			if (decode.active_block!=decode.block) return -1;
+			if ((Bits)decode.page.index+eip_add<(Bits)decode.block->page.start) return -1;
+			return 1;
+		}
+		// only short forward jumps inside the current page, the bytes in
+		// between become part of the block so that writes to them are seen
+		if (eip_add==0 || decode.page.index+(Bitu)eip_add>=4096) return -1;
+		if (!cpu.code.big && reg_eip+(decode.code-decode.code_start)+(uint32_t)eip_add>0xffff) return -1;
+		return 1;
+	default:
+		return -1;
+	}
+}
+
+// returns true if the block was closed, false if a superblock continues
+// on the likely way of the jump
+static bool dyn_branched_exit(BranchTypes btype,int32_t eip_add) {
 	uint32_t eip_base=decode.code-decode.code_start;
+	DynTraceBranch * branch=dyn_trace_branch();
+
+	const int follow=dyn_trace_follow(branch,eip_add);
+	if (follow>=0) {
+		// the other way is a side exit placed at the end of the block
+		dyn_branchflag_to_reg(follow ? (BranchTypes)(btype^1) : btype);
+		save_info_dynrec[used_save_info_dynrec].branch_pos=gen_create_branch_long_nonzero(FC_RETOP,true);
+		save_info_dynrec[used_save_info_dynrec].eip_change=follow ? eip_base : eip_base+eip_add;
+		save_info_dynrec[used_save_info_dynrec].cycles=decode.cycles;
+		save_info_dynrec[used_save_info_dynrec].type=side_exit;
+		used_save_info_dynrec++;
+		// the flags have to be valid if the side exit is taken
+		AcquireFlags(FMASK_TEST);
+		if (follow) {
+			if (eip_add<0) {
+				// the loop body is decoded again along the same path, up to
+				// this jump at most, remember how the write map looked before
+				if (!decode.trace.loop_end) {
+					const Bitu start=decode.block->page.start;
+					decode.trace.loop_end=decode.page.index;
+					memcpy(&dyn_trace_wmap[start],&decode.page.wmap[start],decode.page.index-start);
+				}
+			} else {
+				for (int32_t i=0;i<eip_add;i++) decode.page.wmap[decode.page.index+i]++;
+			}
+			decode.page.index+=(Bitu)eip_add;
+			decode.code+=(PhysPt)eip_add;
+		}
+		decode.trace.branches++;
+		return false;
+	}
+
 	dyn_reduce_cycles();
 
 	dyn_branchflag_to_reg(btype);
 	DRC_PTR_SIZE_IM data=gen_create_branch_on_nonzero(FC_RETOP,true);
 
  	// Branch not taken
+	if (branch) gen_add_direct_word(&branch->not_taken,1,true);
 	gen_add_direct_word(&reg_eip,eip_base,decode.big_op);
  	gen_jmp_ptr(&decode.block->link[0].to,offsetof(CacheBlockDynRec,cache.xstart));
  	gen_fill_branch(data);
 
  	// Branch taken
+	if (branch) gen_add_direct_word(&branch->taken,1,true);
 	gen_add_direct_word(&reg_eip,eip_base+eip_add,decode.big_op);
  	gen_jmp_ptr(&decode.block->link[1].to,offsetof(CacheBlockDynRec,cache.xstart));
+	decode.block->trace_branch=branch;
  	dyn_closeblock();
+	return true;
 }
 
 /*
@@ -411,7 +411,7 @@ static void dyn_dop_byte_gencall(DualOps op) {
 			break;
 		case DOP_ADC:
 			AcquireFlags(FLAG_CF);
-			InvalidateFlagsPartially(dynrec_adc_byte_simple,t_ADCb);
+			InvalidateFlags(dynrec_adc_byte_simple,t_ADCb);
 			gen_call_function_raw(dynrec_adc_byte);
 			break;
 		case DOP_SUB:
@@ -420,7 +420,7 @@ static void dyn_dop_byte_gencall(DualOps op) {
 			break;
 		case DOP_SBB:
 			AcquireFlags(FLAG_CF);
-			InvalidateFlagsPartially(dynrec_sbb_byte_simple,t_SBBb);
+			InvalidateFlags(dynrec_sbb_byte_simple,t_SBBb);
 			gen_call_function_raw(dynrec_sbb_byte);
 			break;
 		case DOP_CMP:
@@ -456,7 +456,7 @@ static void dyn_dop_word_gencall(DualOps op,bool dword) {
 				break;
 			case DOP_ADC:
 				AcquireFlags(FLAG_CF);
-				InvalidateFlagsPartially(dynrec_adc_dword_simple,t_ADCd);
+				InvalidateFlags(dynrec_adc_dword_simple,t_ADCd);
 				gen_call_function_raw(dynrec_adc_dword);
 				break;
 			case DOP_SUB:
@@ -465,7 +465,7 @@ static void dyn_dop_word_gencall(DualOps op,bool dword) {
 				break;
 			case DOP_SBB:
 				AcquireFlags(FLAG_CF);
-				InvalidateFlagsPartially(dynrec_sbb_dword_simple,t_SBBd);
+				InvalidateFlags(dynrec_sbb_dword_simple,t_SBBd);
 				gen_call_function_raw(dynrec_sbb_dword);
 				break;
 			case DOP_CMP:
@@ -498,7 +498,7 @@ static void dyn_dop_word_gencall(DualOps op,bool dword) {
 				break;
 			case DOP_ADC:
 				AcquireFlags(FLAG_CF);
-				InvalidateFlagsPartially(dynrec_adc_word_simple,t_ADCw);
+				InvalidateFlags(dynrec_adc_word_simple,t_ADCw);
 				gen_call_function_raw(dynrec_adc_word);
 				break;
 			case DOP_SUB:
@@ -507,7 +507,7 @@ static void dyn_dop_word_gencall(DualOps op,bool dword) {
 				break;
 			case DOP_SBB:
 				AcquireFlags(FLAG_CF);
-				InvalidateFlagsPartially(dynrec_sbb_word_simple,t_SBBw);
+				InvalidateFlags(dynrec_sbb_word_simple,t_SBBw);
 				gen_call_function_raw(dynrec_sbb_word);
 				break;
 			case DOP_CMP:
@@ -678,11 +678,11 @@ static uint32_t DRC_CALL_CONV dynrec_neg_dword_simple(uint32_t op) {
 static void dyn_sop_byte_gencall(SingleOps op) {
 	switch (op) {
 		case SOP_INC:
-			InvalidateFlagsPartially(dynrec_inc_byte_simple,t_INCb);
+			InvalidateFlagsPartially(dynrec_inc_byte_simple,t_INCb,FMASK_TEST&~FLAG_CF,FMASK_TEST&~FLAG_CF);
 			gen_call_function_raw(dynrec_inc_byte);
 			break;
 		case SOP_DEC:
-			InvalidateFlagsPartially(dynrec_dec_byte_simple,t_DECb);
+			InvalidateFlagsPartially(dynrec_dec_byte_simple,t_DECb,FMASK_TEST&~FLAG_CF,FMASK_TEST&~FLAG_CF);
 			gen_call_function_raw(dynrec_dec_byte);
 			break;
 		case SOP_NOT:
@@ -700,11 +700,11 @@ static void dyn_sop_word_gencall(SingleOps op,bool dword) {
 	if (dword) {
 		switch (op) {
 			case SOP_INC:
-				InvalidateFlagsPartially(dynrec_inc_dword_simple,t_INCd);
+				InvalidateFlagsPartially(dynrec_inc_dword_simple,t_INCd,FMASK_TEST&~FLAG_CF,FMASK_TEST&~FLAG_CF);
 				gen_call_function_raw(dynrec_inc_dword);
 				break;
 			case SOP_DEC:
-				InvalidateFlagsPartially(dynrec_dec_dword_simple,t_DECd);
+				InvalidateFlagsPartially(dynrec_dec_dword_simple,t_DECd,FMASK_TEST&~FLAG_CF,FMASK_TEST&~FLAG_CF);
 				gen_call_function_raw(dynrec_dec_dword);
 				break;
 			case SOP_NOT:
@@ -719,11 +719,11 @@ static void dyn_sop_word_gencall(SingleOps op,bool dword) {
 	} else {
 		switch (op) {
 			case SOP_INC:
-				InvalidateFlagsPartially(dynrec_inc_word_simple,t_INCw);
+				InvalidateFlagsPartially(dynrec_inc_word_simple,t_INCw,FMASK_TEST&~FLAG_CF,FMASK_TEST&~FLAG_CF);
 				gen_call_function_raw(dynrec_inc_word);
 				break;
 			case SOP_DEC:
-				InvalidateFlagsPartially(dynrec_dec_word_simple,t_DECw);
+				InvalidateFlagsPartially(dynrec_dec_word_simple,t_DECw,FMASK_TEST&~FLAG_CF,FMASK_TEST&~FLAG_CF);
 				gen_call_function_raw(dynrec_dec_word);
 				break;
 			case SOP_NOT:
@@ -1123,14 +1123,15 @@ static uint32_t DRC_CALL_CONV dynrec_sar_dword_simple(uint32_t op1,uint8_t op2)
 	else return op1 >> op2;
 }
 
-static void dyn_shift_byte_gencall(ShiftOps op) {
+// nonzero_count: the shift count is known to be nonzero, thus the flags are always changed
+static void dyn_shift_byte_gencall(ShiftOps op,bool nonzero_count) {
 	switch (op) {
 		case SHIFT_ROL:
-			InvalidateFlagsPartially(dynrec_rol_byte_simple,t_ROLb);
+			InvalidateFlagsPartially(dynrec_rol_byte_simple,t_ROLb,nonzero_count?(FLAG_CF|FLAG_OF):0,FLAG_CF|FLAG_OF);
 			gen_call_function_raw(dynrec_rol_byte);
 			break;
 		case SHIFT_ROR:
-			InvalidateFlagsPartially(dynrec_ror_byte_simple,t_RORb);
+			InvalidateFlagsPartially(dynrec_ror_byte_simple,t_RORb,nonzero_count?(FLAG_CF|FLAG_OF):0,FLAG_CF|FLAG_OF);
 			gen_call_function_raw(dynrec_ror_byte);
 			break;
 		case SHIFT_RCL:
@@ -1143,30 +1144,30 @@ static void dyn_shift_byte_gencall(ShiftOps op) {
 			break;
 		case SHIFT_SHL:
 		case SHIFT_SAL:
-			InvalidateFlagsPartially(dynrec_shl_byte_simple,t_SHLb);
+			InvalidateFlagsPartially(dynrec_shl_byte_simple,t_SHLb,nonzero_count?FMASK_TEST:0,FMASK_TEST);
 			gen_call_function_raw(dynrec_shl_byte);
 			break;
 		case SHIFT_SHR:
-			InvalidateFlagsPartially(dynrec_shr_byte_simple,t_SHRb);
+			InvalidateFlagsPartially(dynrec_shr_byte_simple,t_SHRb,nonzero_count?FMASK_TEST:0,FMASK_TEST);
 			gen_call_function_raw(dynrec_shr_byte);
 			break;
 		case SHIFT_SAR:
-			InvalidateFlagsPartially(dynrec_sar_byte_simple,t_SARb);
+			InvalidateFlagsPartially(dynrec_sar_byte_simple,t_SARb,nonzero_count?FMASK_TEST:0,FMASK_TEST);
 			gen_call_function_raw(dynrec_sar_byte);
 			break;
 		default: IllegalOptionDynrec("dyn_shift_byte_gencall");
 	}
 }
 
-static void dyn_shift_word_gencall(ShiftOps op,bool dword) {
+static void dyn_shift_word_gencall(ShiftOps op,bool dword,bool nonzero_count) {
 	if (dword) {
 		switch (op) {
 			case SHIFT_ROL:
-				InvalidateFlagsPartially(dynrec_rol_dword_simple,t_ROLd);
+				InvalidateFlagsPartially(dynrec_rol_dword_simple,t_ROLd,nonzero_count?(FLAG_CF|FLAG_OF):0,FLAG_CF|FLAG_OF);
 				gen_call_function_raw(dynrec_rol_dword);
 				break;
 			case SHIFT_ROR:
-				InvalidateFlagsPartially(dynrec_ror_dword_simple,t_RORd);
+				InvalidateFlagsPartially(dynrec_ror_dword_simple,t_RORd,nonzero_count?(FLAG_CF|FLAG_OF):0,FLAG_CF|FLAG_OF);
 				gen_call_function_raw(dynrec_ror_dword);
 				break;
 			case SHIFT_RCL:
@@ -1179,15 +1180,15 @@ static void dyn_shift_word_gencall(ShiftOps op,bool dword) {
 				break;
 			case SHIFT_SHL:
 			case SHIFT_SAL:
-				InvalidateFlagsPartially(dynrec_shl_dword_simple,t_SHLd);
+				InvalidateFlagsPartially(dynrec_shl_dword_simple,t_SHLd,nonzero_count?FMASK_TEST:0,FMASK_TEST);
 				gen_call_function_raw(dynrec_shl_dword);
 				break;
 			case SHIFT_SHR:
-				InvalidateFlagsPartially(dynrec_shr_dword_simple,t_SHRd);
+				InvalidateFlagsPartially(dynrec_shr_dword_simple,t_SHRd,nonzero_count?FMASK_TEST:0,FMASK_TEST);
 				gen_call_function_raw(dynrec_shr_dword);
 				break;
 			case SHIFT_SAR:
-				InvalidateFlagsPartially(dynrec_sar_dword_simple,t_SARd);
+				InvalidateFlagsPartially(dynrec_sar_dword_simple,t_SARd,nonzero_count?FMASK_TEST:0,FMASK_TEST);
 				gen_call_function_raw(dynrec_sar_dword);
 				break;
 			default: IllegalOptionDynrec("dyn_shift_dword_gencall");
@@ -1195,11 +1196,11 @@ static void dyn_shift_word_gencall(ShiftOps op,bool dword) {
 	} else {
 		switch (op) {
 			case SHIFT_ROL:
-				InvalidateFlagsPartially(dynrec_rol_word_simple,t_ROLw);
+				InvalidateFlagsPartially(dynrec_rol_word_simple,t_ROLw,nonzero_count?(FLAG_CF|FLAG_OF):0,FLAG_CF|FLAG_OF);
 				gen_call_function_raw(dynrec_rol_word);
 				break;
 			case SHIFT_ROR:
-				InvalidateFlagsPartially(dynrec_ror_word_simple,t_RORw);
+				InvalidateFlagsPartially(dynrec_ror_word_simple,t_RORw,nonzero_count?(FLAG_CF|FLAG_OF):0,FLAG_CF|FLAG_OF);
 				gen_call_function_raw(dynrec_ror_word);
 				break;
 			case SHIFT_RCL:
@@ -1212,15 +1213,15 @@ static void dyn_shift_word_gencall(ShiftOps op,bool dword) {
 				break;
 			case SHIFT_SHL:
 			case SHIFT_SAL:
-				InvalidateFlagsPartially(dynrec_shl_word_simple,t_SHLw);
+				InvalidateFlagsPartially(dynrec_shl_word_simple,t_SHLw,nonzero_count?FMASK_TEST:0,FMASK_TEST);
 				gen_call_function_raw(dynrec_shl_word);
 				break;
 			case SHIFT_SHR:
-				InvalidateFlagsPartially(dynrec_shr_word_simple,t_SHRw);
+				InvalidateFlagsPartially(dynrec_shr_word_simple,t_SHRw,nonzero_count?FMASK_TEST:0,FMASK_TEST);
 				gen_call_function_raw(dynrec_shr_word);
 				break;
 			case SHIFT_SAR:
-				InvalidateFlagsPartially(dynrec_sar_word_simple,t_SARw);
+				InvalidateFlagsPartially(dynrec_sar_word_simple,t_SARw,nonzero_count?FMASK_TEST:0,FMASK_TEST);
 				gen_call_function_raw(dynrec_sar_word);
 				break;
 			default: IllegalOptionDynrec("dyn_shift_word_gencall");
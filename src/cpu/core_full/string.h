@@ -53,7 +53,10 @@
 		 *      using REP OUTSB to the VGA palette suffered from audio quality problems. at this phase of implementation the
 		 *      "interruptible string ops" parameter is now merely a testing parameter that can be used to verify this code
 		 *      breaks and restarts string ops correctly. */
-		if (cpu_rep_max > 0 && count > (unsigned int)cpu_rep_max) {
+		/* REP INS/OUTS on a port with a block handler (disk and network data ports) are left alone,
+		 * they still stop at the end of the time slice but restarting every few items costs too much */
+		if (cpu_rep_max > 0 && count > (unsigned int)cpu_rep_max &&
+			!(inst.code.op <= R_INSD && IO_HasBlockHandler(reg_dx,inst.code.op <= R_OUTSD))) {
 			count_left+=count-(unsigned int)cpu_rep_max;
 			count=(unsigned int)cpu_rep_max;
 		}
@@ -69,6 +72,11 @@
 						count--;
 
 						if ((--CPU_Cycles) <= 0) break;
+						if (add_index > 0 && count != 0) {
+							const Bitu n = IO_StringOut(reg_dx,si_base,si_index,add_mask,1,count);
+							count -= n;
+							if ((CPU_Cycles -= (Bits)n) <= 0) break;
+						}
 					} while (count != 0); break;
 				case R_OUTSW:
 					add_index<<=1;
@@ -78,6 +86,11 @@
 						count--;
 
 						if ((--CPU_Cycles) <= 0) break;
+						if (add_index > 0 && count != 0) {
+							const Bitu n = IO_StringOut(reg_dx,si_base,si_index,add_mask,2,count);
+							count -= n;
+							if ((CPU_Cycles -= (Bits)n) <= 0) break;
+						}
 					} while (count != 0); break;
 				case R_OUTSD:
 					add_index<<=2;
@@ -87,6 +100,11 @@
 						count--;
 
 						if ((--CPU_Cycles) <= 0) break;
+						if (add_index > 0 && count != 0) {
+							const Bitu n = IO_StringOut(reg_dx,si_base,si_index,add_mask,4,count);
+							count -= n;
+							if ((CPU_Cycles -= (Bits)n) <= 0) break;
+						}
 					} while (count != 0); break;
 
 				case R_INSB:
@@ -96,6 +114,11 @@
 						count--;
 
 						if ((--CPU_Cycles) <= 0) break;
+						if (add_index > 0 && count != 0) {
+							const Bitu n = IO_StringIn(reg_dx,di_base,di_index,add_mask,1,count);
+							count -= n;
+							if ((CPU_Cycles -= (Bits)n) <= 0) break;
+						}
 					} while (count != 0); break;
 				case R_INSW:
 					add_index<<=1;
@@ -105,6 +128,11 @@
 						count--;
 
 						if ((--CPU_Cycles) <= 0) break;
+						if (add_index > 0 && count != 0) {
+							const Bitu n = IO_StringIn(reg_dx,di_base,di_index,add_mask,2,count);
+							count -= n;
+							if ((CPU_Cycles -= (Bits)n) <= 0) break;
+						}
 					} while (count != 0); break;
 				case R_INSD:
 					add_index<<=2;
@@ -114,6 +142,11 @@
 						count--;
 
 						if ((--CPU_Cycles) <= 0) break;
+						if (add_index > 0 && count != 0) {
+							const Bitu n = IO_StringIn(reg_dx,di_base,di_index,add_mask,4,count);
+							count -= n;
+							if ((CPU_Cycles -= (Bits)n) <= 0) break;
+						}
 					} while (count != 0); break;
 
 				case R_STOSB:
@@ -3478,6 +3478,11 @@ void CPU_Disable_SkipAutoAdjust(void) {
 extern int32_t ticksDone;
 extern uint32_t ticksScheduled;
 extern int dynamic_core_cache_block_size;
+extern int dynamic_core_cache_size;
+extern int dynamic_core_cache_pages;
+extern bool dynamic_core_profile;
+extern bool dynamic_core_superblocks;
+extern std::string dynamic_core_profile_file;
 
 void CPU_Reset_AutoAdjust(void) {
 	CPU_IODelayRemoved = 0;
@@ -3776,6 +3781,16 @@ public:
 		dynamic_core_cache_block_size = section->Get_int("dynamic core cache block size");
 		if (dynamic_core_cache_block_size < 1 || dynamic_core_cache_block_size > 65536) dynamic_core_cache_block_size = 32;
 
+		dynamic_core_cache_size = section->Get_int("dynamic core cache size");
+		if (dynamic_core_cache_size < 1 || dynamic_core_cache_size > 256) dynamic_core_cache_size = 8;
+
+		dynamic_core_cache_pages = section->Get_int("dynamic core cache pages");
+		if (dynamic_core_cache_pages < 0 || dynamic_core_cache_pages > 65536) dynamic_core_cache_pages = 0;
+
+		dynamic_core_profile_file = section->Get_string("dynamic core profile");
+		dynamic_core_profile = !dynamic_core_profile_file.empty();
+		dynamic_core_superblocks = section->Get_bool("dynamic core superblocks");
+
 		Prop_multival* p = section->Get_multival("cycles");
 		std::string type = p->GetSection()->Get_string("type");
 		std::string str ;
@@ -0,0 +1,238 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Block profiler shared by the dynamic cores. Each core includes this from
+ * its cache.h and gets its own copy of the tables.
+ *
+ * While profiling is on, every translated block gets a slot, keyed by the
+ * physical address and code size of its first instruction. The block code
+ * increments the 32-bit slot counter on entry. Those counters are folded
+ * into the 64-bit totals now and then. A slot is never reused, so blocks
+ * translated before a DYNPROF CLEAR keep counting into the right entry. */
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <stdio.h>
+
+#define DYNPROF_SLOTS		(64*1024)	// slot 0 means "not profiled"
+#define DYNPROF_FOLD_CYCLES	0x80000000ull	// cycles granted between folds of the counters
+
+enum {
+	DYNPROF_INV_WRITEB=0,	// byte write into the code
+	DYNPROF_INV_WRITEW,		// word write into the code
+	DYNPROF_INV_WRITED,		// dword write into the code
+	DYNPROF_INV_PAGE,		// code page released (page eviction or cache reset)
+	DYNPROF_INV_EVICT,		// code cache space reused for another block
+	DYNPROF_INV_MAX
+};
+
+struct DynProfileEntry {
+	uint32_t phys;				// physical address of the first instruction
+	uint32_t linear;			// linear address and CS:EIP at the last translation
+	uint16_t cs;
+	uint32_t eip;
+	bool big;					// 32-bit code segment
+	uint32_t guest_bytes;		// length of the guest code at the last translation
+	uint32_t instructions;		// guest instructions at the last translation
+	uint64_t executions;		// folded from dynprof_counts
+	uint64_t compiles;
+	uint64_t host_bytes;		// host code emitted over all translations
+	uint64_t invalidations[DYNPROF_INV_MAX];
+	uint64_t running_smc;		// writes that hit the block while it was executing
+};
+
+extern std::string dynamic_core_profile_file;
+extern bool dynamic_core_profile;
+
+// incremented by the generated code, static so that it can be addressed
+// relative to the instruction pointer by the x86-64 code generators
+static uint32_t dynprof_counts[DYNPROF_SLOTS];
+static std::vector<DynProfileEntry> dynprof_entries(1);
+static std::unordered_map<uint64_t,uint32_t> dynprof_index;
+static uint64_t dynprof_cycles=0;	// cycles granted to the core since the last fold
+
+static struct {
+	uint64_t blocks;			// blocks translated while profiling
+	uint64_t guest_bytes;
+	uint64_t host_bytes;
+	uint64_t untracked;			// blocks translated after all slots were taken
+	uint64_t invalidations[DYNPROF_INV_MAX];
+} dynprof_totals;
+
+static void dynprof_fold(void) {
+	for (size_t i=1;i<dynprof_entries.size();i++) {
+		dynprof_entries[i].executions+=dynprof_counts[i];
+		dynprof_counts[i]=0;
+	}
+	dynprof_cycles=0;
+}
+
+// called each time the core is entered. Every block takes at least one
+// cycle, so a core run enters blocks at most CPU_Cycles times (plus the one
+// that finds the cycles used up). Folding before the cycles granted since
+// the last fold pass 2^31 keeps the 32-bit counters from wrapping whatever
+// the cycles setting or the length of the hot run.
+static INLINE void dynprof_tick(void) {
+	if (GCC_UNLIKELY(dynprof_entries.size()>1)) {
+		const uint64_t cycles=(CPU_Cycles>0)?(uint64_t)CPU_Cycles+1u:1u;
+		if (dynprof_cycles+cycles>DYNPROF_FOLD_CYCLES) dynprof_fold();
+		dynprof_cycles+=cycles;
+	}
+}
+
+// find or create the slot for a block that starts at linear address start,
+// returns 0 if profiling is off or there are no free slots
+static uint32_t dynprof_openblock(PhysPt start) {
+	if (!dynamic_core_profile) return 0;
+	const uint32_t phys=(uint32_t)((PAGING_GetPhysicalPage(start)&~(PhysPt)4095)|(start&4095));
+	const uint64_t key=(uint64_t)phys|(cpu.code.big?(1ull<<32):0);
+	uint32_t slot;
+	auto it=dynprof_index.find(key);
+	if (it!=dynprof_index.end()) slot=it->second;
+	else if (dynprof_entries.size()<DYNPROF_SLOTS) {
+		slot=(uint32_t)dynprof_entries.size();
+		DynProfileEntry entry={};
+		entry.phys=phys;
+		entry.big=cpu.code.big;
+		dynprof_entries.push_back(entry);
+		dynprof_index[key]=slot;
+	} else {
+		dynprof_totals.untracked++;
+		return 0;
+	}
+	DynProfileEntry &entry=dynprof_entries[slot];
+	entry.linear=(uint32_t)start;
+	entry.cs=(uint16_t)SegValue(cs);
+	entry.eip=(uint32_t)reg_eip;
+	return slot;
+}
+
+static void dynprof_closeblock(uint32_t slot,Bitu guest_bytes,Bitu instructions,Bitu host_bytes) {
+	if (!slot) return;
+	DynProfileEntry &entry=dynprof_entries[slot];
+	entry.guest_bytes=(uint32_t)guest_bytes;
+	entry.instructions=(uint32_t)instructions;
+	entry.compiles++;
+	entry.host_bytes+=host_bytes;
+	dynprof_totals.blocks++;
+	dynprof_totals.guest_bytes+=guest_bytes;
+	dynprof_totals.host_bytes+=host_bytes;
+}
+
+static INLINE void dynprof_invalidate(uint32_t slot,unsigned int reason,bool running=false) {
+	if (!slot) return;
+	dynprof_entries[slot].invalidations[reason]++;
+	if (running) dynprof_entries[slot].running_smc++;
+	dynprof_totals.invalidations[reason]++;
+}
+
+// reason for a write of len bytes into translated code
+static INLINE unsigned int dynprof_writereason(Bitu len) {
+	return (len>=4)?DYNPROF_INV_WRITED:((len==2)?DYNPROF_INV_WRITEW:DYNPROF_INV_WRITEB);
+}
+
+#if C_DEBUG
+// only the debugger resets the counts
+static void dynprof_clear(void) {
+	// keep the slot assignments, translated blocks still point at them
+	for (size_t i=1;i<dynprof_entries.size();i++) {
+		DynProfileEntry &entry=dynprof_entries[i];
+		dynprof_counts[i]=0;
+		entry.executions=0;
+		entry.compiles=0;
+		entry.host_bytes=0;
+		for (unsigned int r=0;r<DYNPROF_INV_MAX;r++) entry.invalidations[r]=0;
+		entry.running_smc=0;
+	}
+	memset(&dynprof_totals,0,sizeof(dynprof_totals));
+	dynprof_cycles=0;
+}
+#endif
+
+// print the profile sorted by executed guest instructions, to the log if
+// out is NULL. At most max_lines blocks are listed, 0 lists all of them.
+static void dynprof_report(const char *core_name,FILE *out,size_t max_lines) {
+	char line[256];
+	dynprof_fold();
+
+	std::vector<uint32_t> order;
+	uint64_t total_instr=0;
+	for (size_t i=1;i<dynprof_entries.size();i++) {
+		const DynProfileEntry &entry=dynprof_entries[i];
+		if (!entry.executions && !entry.compiles) continue;
+		order.push_back((uint32_t)i);
+		total_instr+=entry.executions*entry.instructions;
+	}
+	std::sort(order.begin(),order.end(),[](uint32_t a,uint32_t b) {
+		const DynProfileEntry &ea=dynprof_entries[a],&eb=dynprof_entries[b];
+		const uint64_t wa=ea.executions*ea.instructions,wb=eb.executions*eb.instructions;
+		if (wa!=wb) return wa>wb;
+		return ea.compiles>eb.compiles;
+	});
+
+#define DYNPROF_OUT(...) do { snprintf(line,sizeof(line),__VA_ARGS__); if (out) fprintf(out,"%s\n",line); else LOG_MSG("%s",line); } while (0)
+	DYNPROF_OUT("%s profile: %llu blocks translated, %llu guest bytes, %llu host bytes emitted, %llu untracked",
+		core_name,
+		(unsigned long long)dynprof_totals.blocks,
+		(unsigned long long)dynprof_totals.guest_bytes,
+		(unsigned long long)dynprof_totals.host_bytes,
+		(unsigned long long)dynprof_totals.untracked);
+	DYNPROF_OUT("invalidations: writeb=%llu writew=%llu writed=%llu page=%llu evict=%llu",
+		(unsigned long long)dynprof_totals.invalidations[DYNPROF_INV_WRITEB],
+		(unsigned long long)dynprof_totals.invalidations[DYNPROF_INV_WRITEW],
+		(unsigned long long)dynprof_totals.invalidations[DYNPROF_INV_WRITED],
+		(unsigned long long)dynprof_totals.invalidations[DYNPROF_INV_PAGE],
+		(unsigned long long)dynprof_totals.invalidations[DYNPROF_INV_EVICT]);
+	DYNPROF_OUT("  CS:EIP         linear   length  phys     instr     executions  %%time compiles hostsz  smc(b/w/d/run)  page evict");
+
+	size_t count=order.size();
+	if (max_lines && count>max_lines) count=max_lines;
+	for (size_t i=0;i<count;i++) {
+		const DynProfileEntry &entry=dynprof_entries[order[i]];
+		const uint64_t weight=entry.executions*entry.instructions;
+		DYNPROF_OUT("  %04X:%08X %08X %6u  %08X %2u%s %14llu %5.1f %8llu %6llu  %llu/%llu/%llu/%llu  %llu %llu",
+			entry.cs,entry.eip,entry.linear,entry.guest_bytes,entry.phys,
+			entry.instructions,entry.big?"d":"w",
+			(unsigned long long)entry.executions,
+			total_instr?(100.0*(double)weight/(double)total_instr):0.0,
+			(unsigned long long)entry.compiles,
+			(unsigned long long)(entry.compiles?entry.host_bytes/entry.compiles:0),
+			(unsigned long long)entry.invalidations[DYNPROF_INV_WRITEB],
+			(unsigned long long)entry.invalidations[DYNPROF_INV_WRITEW],
+			(unsigned long long)entry.invalidations[DYNPROF_INV_WRITED],
+			(unsigned long long)entry.running_smc,
+			(unsigned long long)entry.invalidations[DYNPROF_INV_PAGE],
+			(unsigned long long)entry.invalidations[DYNPROF_INV_EVICT]);
+	}
+	if (count<order.size()) DYNPROF_OUT("  ... %lu more blocks",(unsigned long)(order.size()-count));
+#undef DYNPROF_OUT
+}
+
+// append the full profile to the "dynamic core profile" file
+static void dynprof_write_file(const char *core_name) {
+	if (dynamic_core_profile_file.empty() || dynprof_totals.blocks==0) return;
+	FILE *out=fopen(dynamic_core_profile_file.c_str(),"a");
+	if (!out) {
+		LOG_MSG("%s: unable to write profile to %s",core_name,dynamic_core_profile_file.c_str());
+		return;
+	}
+	dynprof_report(core_name,out,0);
+	fprintf(out,"\n");
+	fclose(out);
+}
@@ -252,6 +252,79 @@ static inline PhysPt GetPageTableEntryAddr(LinearPt lin_addr, const X86PageEntry
 	return PhysPt(dir_entry.dirblock.base << PhysPt(12u)) + PhysPt((lin_addr >> LinearPt(10u)) & 0xffcu); /* equiv: ((lin_addr >> 12) & 0x3ff) * 4 */
 }
 
+// Software TLB behind the flat tables in paging.tlb.
+//
+// The flat tables are emptied on every PAGING_ClearTLB, but also when the
+// link list overflows, after a protection fault and when CR0.WP changes.
+// Only the first is a TLB flush the guest asked for. This small set
+// associative cache remembers the page walks done since the last real
+// flush, so refilling the flat tables after the other cases does not walk
+// the page tables again. A real flush starts a new generation, which
+// invalidates all entries at once, so the software TLB part of a CR3 write
+// is O(1). A hit maps the cached walk without reading the page directory or
+// page table again, like a hardware TLB the guest has to flush after
+// changing them. The flat tables themselves are still emptied by walking
+// the link list, the inline accessors and the dynamic cores read them
+// without any check.
+#define STLB_SETS		64
+#define STLB_WAYS		4
+
+struct PagingSTLBEntry {
+	uint32_t	lin_page;
+	uint32_t	phys_page;
+	uint32_t	gen;		// valid while equal to stlb_gen
+	uint8_t		linkmode;	// ACCESS_* rights from the page walk
+	bool		dirty;
+};
+
+static PagingSTLBEntry stlb[STLB_SETS][STLB_WAYS];
+static uint8_t stlb_victim[STLB_SETS];
+static uint32_t stlb_gen = 1;
+
+static PagingTLBStats paging_tlb_stats;
+
+const PagingTLBStats &PAGING_GetTLBStats(void) {
+	return paging_tlb_stats;
+}
+
+static void PAGING_STLBFlush(void) {
+	if (GCC_UNLIKELY(++stlb_gen == 0)) {
+		// wrapped around, old entries could match again
+		memset(stlb,0,sizeof(stlb));
+		stlb_gen = 1;
+	}
+}
+
+static inline PagingSTLBEntry *PAGING_STLBLookup(const PageNum lin_page) {
+	PagingSTLBEntry * const set = stlb[lin_page & (STLB_SETS-1)];
+	for (unsigned int w=0;w < STLB_WAYS;w++) {
+		if (set[w].gen == stlb_gen && set[w].lin_page == (uint32_t)lin_page)
+			return &set[w];
+	}
+	return nullptr;
+}
+
+static void PAGING_STLBInsert(const PageNum lin_page, const PageNum phys_page, const uint8_t linkmode, const bool dirty) {
+	PagingSTLBEntry *entry = PAGING_STLBLookup(lin_page);
+	if (entry == nullptr) {
+		const unsigned int set = lin_page & (STLB_SETS-1);
+		entry = &stlb[set][stlb_victim[set]];
+		stlb_victim[set] = (stlb_victim[set] + 1u) & (STLB_WAYS-1);
+	}
+	entry->lin_page = (uint32_t)lin_page;
+	entry->phys_page = (uint32_t)phys_page;
+	entry->gen = stlb_gen;
+	entry->linkmode = linkmode;
+	entry->dirty = dirty;
+}
+
+static inline void PAGING_STLBInvalidate(const PageNum lin_page) {
+	PagingSTLBEntry * const entry = PAGING_STLBLookup(lin_page);
+	if (entry != nullptr) entry->gen = 0;
+}
+
+static void PAGING_UnlinkAll(void);
+
 bool use_dynamic_core_with_paging = false; /* allow dynamic core even with paging (AT YOUR OWN RISK!!!!) */
 bool auto_determine_dynamic_core_paging = false; /* enable use_dynamic_core_with_paging when paging is enabled */
 bool dosbox_allow_nonrecursive_page_fault = false;	/* when set, do nonrecursive mode (when executing instruction) */
@@ -334,6 +407,8 @@ private:
 			
 		// set the page dirty in the tlb
 		paging.tlb.phys_page[lin_page] |= PHYSPAGE_DIRTY;
+		PagingSTLBEntry * const cached = PAGING_STLBLookup(lin_page);
+		if (cached != nullptr) cached->dirty = true;
 
 		// mark the page table entry dirty
 		const PhysPt dirEntryAddr = GetPageDirectoryEntryAddr(addr);
@@ -486,8 +561,11 @@ private:
 		} 
 		PAGING_NewPageFault(addr, tableaddr, checked,
 			1u | (writing ? 2u : 0u) | (((cpu.cpl&cpu.mpl) == 3u) ? 4u : 0u));
-		
-		PAGING_ClearTLB(); // TODO got a better idea?
+
+		// like a real CPU, the fault only drops the faulting translation,
+		// the other pages are mapped again from the software TLB
+		PAGING_STLBInvalidate(addr >> 12);
+		PAGING_UnlinkAll(); // TODO got a better idea?
 	}
 
 	uint8_t readb_through(PhysPt addr) {
@@ -785,6 +863,19 @@ initpage_retry:
 			X86PageEntry dir_entry, table_entry;
 			const bool isUser = (((cpu.cpl & cpu.mpl)==3)? true:false);
 
+			// Walked before since the last flush? Faults and writes to clean
+			// pages take the long way, they need the page table entries.
+			const PagingSTLBEntry * const cached = PAGING_STLBLookup(lin_page);
+			if (cached != nullptr && (cached->dirty || !writing)) {
+				const uint8_t ft_index = cached->linkmode | (writing ? 8u : 0u) | (isUser ? 4u : 0u) | (paging.wp ? 16u : 0u);
+				if (!fault_table[ft_index]) {
+					paging_tlb_stats.stlb_hits++;
+					PAGING_LinkPageNew(lin_page, cached->phys_page, cached->linkmode, cached->dirty);
+					return false;
+				}
+			}
+			paging_tlb_stats.walks++;
+
 			// Read the paging stuff, throw not present exceptions if needed
 			// and find out how the page should be mapped
 			const PhysPt dirEntryAddr = GetPageDirectoryEntryAddr(lin_addr);
@@ -829,6 +920,7 @@ initpage_retry:
 					(unsigned int)dir_entry.dirblock4mb.base32); */
 				// finally install the new page
 				PAGING_LinkPageNew(lin_page, dir_entry.dirblock4mb.getBase(lin_page), result, dirty);
+				PAGING_STLBInsert(lin_page, dir_entry.dirblock4mb.getBase(lin_page), result, dirty);
 			}
 			else {
 				const PhysPt tableEntryAddr = GetPageTableEntryAddr(lin_addr, dir_entry);
@@ -896,6 +988,7 @@ initpage_retry:
 				   */
 				// finally install the new page
 				PAGING_LinkPageNew(lin_page, table_entry.block.base, result, dirty);
+				PAGING_STLBInsert(lin_page, table_entry.block.base, result, dirty);
 			}
 
 		} else { // paging off
@@ -985,12 +1078,16 @@ void PAGING_InitTLB(void) {
 	paging.krw_links.used=0;
 	paging.kr_links.used=0;
 	paging.links.used=0;
+	PAGING_STLBFlush();
 }
 
-void PAGING_ClearTLB(void) {
+// empty the flat tables, the software TLB keeps its translations
+static void PAGING_UnlinkAll(void) {
 //	LOG_MSG("CLEAR                          m% 4u, kr% 4u, krw% 4u, ur% 4u",
 //		paging.links.used, paging.kro_links.used, paging.krw_links.used, paging.ure_links.used);
 
+	paging_tlb_stats.unlinks++;
+	paging_tlb_stats.unlinked_pages+=paging.links.used;
 	uint32_t * entries=&paging.links.entries[0];
 	for (;paging.links.used>0;paging.links.used--) {
 		Bitu page=*entries++;
@@ -1005,6 +1102,27 @@ void PAGING_ClearTLB(void) {
 	paging.links.used=0;
 }
 
+void PAGING_ClearTLB(void) {
+	paging_tlb_stats.flushes++;
+	PAGING_UnlinkAll();
+	PAGING_STLBFlush();
+}
+
+#if C_DEBUG
+void DEBUG_PrintTLB(void) { //debugger "TLB" command
+	LOG_MSG("TLB: paging %s, %lu pages linked, software TLB %u sets x %u ways",
+			paging.enabled ? "on" : "off",
+			(unsigned long)paging.links.used,
+			(unsigned int)STLB_SETS,(unsigned int)STLB_WAYS);
+	LOG_MSG("page walks=%llu software TLB hits=%llu flushes=%llu unlinks=%llu unlinked pages=%llu",
+			(unsigned long long)paging_tlb_stats.walks,
+			(unsigned long long)paging_tlb_stats.stlb_hits,
+			(unsigned long long)paging_tlb_stats.flushes,
+			(unsigned long long)paging_tlb_stats.unlinks,
+			(unsigned long long)paging_tlb_stats.unlinked_pages);
+}
+#endif
+
 void PAGING_UnlinkPages(PageNum lin_page,PageNum pages) {
 	for (;pages>0;pages--) {
 		paging.tlb.read[lin_page]=nullptr;
@@ -1044,7 +1162,7 @@ static void PAGING_LinkPageNew(PageNum lin_page, PageNum phys_page, const uint8_
 		E_Exit("Illegal page");
 	if (GCC_UNLIKELY(paging.links.used>=PAGING_LINKS)) {
 		LOG(LOG_PAGING,LOG_NORMAL)("Not enough paging links, resetting cache");
-		PAGING_ClearTLB();
+		PAGING_UnlinkAll();
 	}
 	// re-use some of the unused bits in the phys_page variable
 	// needed in the exception handler and foiler so they can replace themselves appropriately
@@ -1121,7 +1239,7 @@ void PAGING_LinkPage(PageNum lin_page,PageNum phys_page) {
 
 	if (paging.links.used>=PAGING_LINKS) {
 		LOG(LOG_PAGING,LOG_NORMAL)("Not enough paging links, resetting cache");
-		PAGING_ClearTLB();
+		PAGING_UnlinkAll();
 	}
 
 	paging.tlb.phys_page[lin_page]= (uint32_t)phys_page;
@@ -1415,8 +1533,9 @@ void PAGING_SetDirBase(Bitu cr3) {
 
 void PAGING_SetWP(bool wp) {
 	paging.wp = wp;
+	// the mappings depend on WP, the translations do not
 	if (paging.enabled)
-		PAGING_ClearTLB();
+		PAGING_UnlinkAll();
 }
 
 int CPU_IsDynamicCore(void);
@@ -150,6 +150,18 @@ extern bool logBuffSuppressConsoleNeedUpdate;
 
 void DEBUG_PrintGUS();
 void DEBUG_PrintRTC();
+void DEBUG_PrintTLB();
+#if (C_DYNAMIC_X86)
+void DEBUG_PrintDynX86Cache();
+void DEBUG_DynX86Profile(bool clear);
+#endif
+#if (C_DYNREC)
+void DEBUG_PrintDynrecCache();
+void DEBUG_DynrecProfile(bool clear);
+#endif
+#if (C_DYNAMIC_X86) || (C_DYNREC)
+extern bool dynamic_core_profile;
+#endif
 
 // Forwards
 static void DrawCode(void);
@@ -3250,6 +3262,65 @@ bool ParseCommand(char* str) {
         }
     }
 
+    if (command == "TLB") {
+        DEBUG_BeginPagedContent();
+        DEBUG_PrintTLB();
+        DEBUG_EndPagedContent();
+        return true;
+    }
+
+    if (command == "DYNCACHE") {
+        DEBUG_BeginPagedContent();
+#if (C_DYNAMIC_X86)
+        DEBUG_PrintDynX86Cache();
+#endif
+#if (C_DYNREC)
+        DEBUG_PrintDynrecCache();
+#endif
+        DEBUG_EndPagedContent();
+        return true;
+    }
+
+#if (C_DYNAMIC_X86) || (C_DYNREC)
+    if (command == "DYNPROF") {
+        std::string subcommand;
+        {
+            char *start = found;
+            while (*found != 0 && *found != ' ') found++;
+            subcommand = std::string(start,(size_t)(found-start));
+            while (*found == ' ') found++;
+        }
+
+        if (subcommand == "ON" || subcommand == "OFF") {
+            dynamic_core_profile = (subcommand == "ON");
+            DEBUG_ShowMsg("DEBUG: Dynamic core profiling %s for newly translated blocks.\n",dynamic_core_profile ? "enabled" : "disabled");
+            return true;
+        }
+        else if (subcommand == "CLEAR") {
+#if (C_DYNAMIC_X86)
+            DEBUG_DynX86Profile(true);
+#endif
+#if (C_DYNREC)
+            DEBUG_DynrecProfile(true);
+#endif
+            DEBUG_ShowMsg("DEBUG: Dynamic core profile cleared.\n");
+            return true;
+        }
+        else if (subcommand.empty()) {
+            DEBUG_BeginPagedContent();
+            if (!dynamic_core_profile) LOG_MSG("Dynamic core profiling is off, use DYNPROF ON to turn it on");
+#if (C_DYNAMIC_X86)
+            DEBUG_DynX86Profile(false);
+#endif
+#if (C_DYNREC)
+            DEBUG_DynrecProfile(false);
+#endif
+            DEBUG_EndPagedContent();
+            return true;
+        }
+    }
+
+#endif
     if (command == "VRD") {
         VGA_DebugRedraw();
         return true;
@@ -4062,11 +4133,14 @@ bool ParseCommand(char* str) {
 		DEBUG_ShowMsg("SSE [=t] [reg]            - Display SSE register file (t can be B,W,D,Q,X,S,F)\n");
 		DEBUG_ShowMsg("SSE [=t] [reg] SET [val]  - Set SSE register (t can be B,W,D,Q,X,S,F), val is comma-separated\n");
 		DEBUG_ShowMsg("CPU                       - Display CPU status information.\n");
+		DEBUG_ShowMsg("DYNCACHE                  - Display dynamic core code cache counters.\n");
+		DEBUG_ShowMsg("DYNPROF [ON|OFF|CLEAR]    - Show, toggle or clear the dynamic core block profile.\n");
 		DEBUG_ShowMsg("FPU                       - Display FPU status information.\n");
 		DEBUG_ShowMsg("GDT                       - Lists descriptors of the GDT.\n");
 		DEBUG_ShowMsg("LDT                       - Lists descriptors of the LDT.\n");
 		DEBUG_ShowMsg("IDT                       - Lists descriptors of the IDT.\n");
 		DEBUG_ShowMsg("PAGING [page]             - Display content of page table.\n");
+		DEBUG_ShowMsg("TLB                       - Display software TLB counters.\n");
 		DEBUG_ShowMsg("EXTEND                    - Toggle additional info.\n");
 		DEBUG_ShowMsg("TIMERIRQ                  - Run the system timer.\n");
 		DEBUG_ShowMsg("TIME [time]               - Display or change the internal time.\n");
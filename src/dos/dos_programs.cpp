@@ -2659,8 +2659,10 @@ public:
                 newDiskSwap[index] = new imageDiskNFD(usefile, fname, floppysize, false, 0);
             else if(!memcmp(hdr, "T98FDDIMAGE.R1\0\0", 16))
                 newDiskSwap[index] = new imageDiskNFD(usefile, fname, floppysize, false, 1);
-            else
+            else {
                 newDiskSwap[index] = new imageDisk(usefile, fname, rombytesize, rombytesize > 2880 * 1024);
+                newDiskSwap[index]->EnableMapping();
+            }
 
             if(newDiskSwap[index]) {
                 newDiskSwap[index]->Addref();
@@ -6171,7 +6173,7 @@ class IMGMOUNT : public Program {
 							if (!paths.empty()) {
 								const char *ext = strrchr(paths[0].c_str(), '.');
 								if (ext != NULL) {
-									if ((!IS_PC98_ARCH && strcasecmp(ext,".img") && strcasecmp(ext,".ima") && strcasecmp(ext,".vhd") && strcasecmp(ext,".qcow2") && strcasecmp(ext,".td0")) ||
+									if ((!IS_PC98_ARCH && strcasecmp(ext,".img") && strcasecmp(ext,".ima") && strcasecmp(ext,".vhd") && strcasecmp(ext,".qcow2") && strcasecmp(ext,".chd") && strcasecmp(ext,".td0")) ||
 											(IS_PC98_ARCH && strcasecmp(ext,".hdi") && strcasecmp(ext,".nhd") && strcasecmp(ext,".img") && strcasecmp(ext,".ima"))){
 										WriteOut(MSG_Get("PROGRAM_MOUNT_UNSUPPORTED_EXT"), ext);
                                         LOG_MSG("IMGMOUNT: Warning: Unsupported extension '%s' for image file '%s'", ext, paths[0].c_str());
@@ -6890,6 +6892,25 @@ class IMGMOUNT : public Program {
 									default: break;
 								}
 							}
+							else if (!strcasecmp(ext, ".chd")) {
+								ro=wpcolon&&paths[i].length()>1&&paths[i].c_str()[0]==':';
+								//hard disk CHD, the geometry comes from its metadata and can't be detected from the file
+								skipDetectGeometry = true;
+								imageDiskCHD::ErrorCodes ret = imageDiskCHD::Open(ro?paths[i].c_str()+1:paths[i].c_str(), ro||roflag, &vhdImage);
+								switch (ret) {
+									case imageDiskCHD::ERROR_OPENING:
+										errorMessage = MSG_Get("CHD_ERROR_OPENING"); break;
+									case imageDiskCHD::INVALID_DATA:
+										errorMessage = MSG_Get("CHD_INVALID_DATA"); break;
+									case imageDiskCHD::UNSUPPORTED_TYPE:
+										errorMessage = MSG_Get("CHD_UNSUPPORTED_TYPE"); break;
+									case imageDiskCHD::ERROR_OPENING_DELTA:
+										errorMessage = MSG_Get("CHD_ERROR_OPENING_DELTA"); break;
+									case imageDiskCHD::DELTA_INVALID_MATCH:
+										errorMessage = MSG_Get("CHD_DELTA_INVALID_MATCH"); break;
+									default: break;
+								}
+							}
 							else if(!strcasecmp(ext, ".qcow2")) {
 								ro = wpcolon && paths[i].length() > 1 && paths[i].c_str()[0] == ':';
 								const char* fname = ro ? paths[i].c_str() + 1 : paths[i].c_str();
@@ -7651,6 +7672,19 @@ class IMGMOUNT : public Program {
 						//LOG_MSG("LBA=%llu",newImage->LBA);
 						return newImage;
 					}
+					else if (!strcasecmp(ext, ".chd")) {
+						bool ro=wpcolon&&strlen(fileName)>1&&fileName[0]==':';
+						imageDiskCHD::ErrorCodes ret = imageDiskCHD::Open(ro?fileName+1:fileName, ro||roflag, &newImage);
+						switch (ret) {
+							case imageDiskCHD::ERROR_OPENING: WriteOut(MSG_Get("CHD_ERROR_OPENING")); break;
+							case imageDiskCHD::INVALID_DATA: WriteOut(MSG_Get("CHD_INVALID_DATA")); break;
+							case imageDiskCHD::UNSUPPORTED_TYPE: WriteOut(MSG_Get("CHD_UNSUPPORTED_TYPE")); break;
+							case imageDiskCHD::ERROR_OPENING_DELTA: WriteOut(MSG_Get("CHD_ERROR_OPENING_DELTA")); break;
+							case imageDiskCHD::DELTA_INVALID_MATCH: WriteOut(MSG_Get("CHD_DELTA_INVALID_MATCH")); break;
+							default: break;
+						}
+						return newImage;
+					}
 					else if (!strcasecmp(ext, ".hdi")) {
 						assumeHardDisk = true; /* bugfix for HDI images smaller than 2.88MB so that the .hdi file is not mistaken for a floppy disk image */
 					}
@@ -7740,6 +7774,7 @@ class IMGMOUNT : public Program {
 					sectors = imagesize / (uint64_t)sizes[0];
 					setbuf(newDisk, NULL);
 					newImage = new imageDisk(newDisk, fname, imagesize, (imagesize > 2880 * 1024) || assumeHardDisk);
+					newImage->EnableMapping();
 				}
 			}
 
@@ -10751,6 +10786,11 @@ void DOS_SetupPrograms(void) {
     MSG_Add("VHD_PARENT_UNSUPPORTED_TYPE", "The parent of the specified VHD file is of an unsupported type.\n");
     MSG_Add("VHD_PARENT_INVALID_MATCH", "The parent of the specified VHD file does not contain the expected identifier.\n");
     MSG_Add("VHD_PARENT_INVALID_DATE", "The parent of the specified VHD file has been changed and cannot be loaded.\n");
+    MSG_Add("CHD_ERROR_OPENING", "Could not open the specified CHD file.\n");
+    MSG_Add("CHD_INVALID_DATA", "The specified CHD file is corrupt and cannot be opened.\n");
+    MSG_Add("CHD_UNSUPPORTED_TYPE", "The specified CHD file is not a hard disk image, or needs a parent CHD.\n");
+    MSG_Add("CHD_ERROR_OPENING_DELTA", "The delta file of the specified CHD file could not be opened.\n");
+    MSG_Add("CHD_DELTA_INVALID_MATCH", "The delta file of the specified CHD file was made from a different CHD file.\n");
 
     MSG_Add("PROGRAM_IMGMOUNT_SPECIFY_DRIVE","Must specify drive letter to mount image at.\n");
     MSG_Add("PROGRAM_IMGMOUNT_SPECIFY2","Must specify drive number (0 to %d) to mount image at (0,1=fda,fdb;2,3=hda,hdb).\n");
@@ -1578,8 +1578,10 @@ fatDrive::fatDrive(const char* sysFilename, uint32_t bytesector, uint32_t cylsec
 			loadedDisk = new imageDiskNFD(diskfile, fname, (uint32_t)filesize, false, 0);
 		else if (!memcmp(bootcode,"T98FDDIMAGE.R1\0\0",16))
 			loadedDisk = new imageDiskNFD(diskfile, fname, (uint32_t)filesize, false, 1);
-		else
+		else {
 			loadedDisk = new imageDisk(diskfile, fname, rawsize, (is_hdd | (rawsize > 2880 * 1024)));
+			loadedDisk->EnableMapping();
+		}
 	}
 
 	fatDriveInit(sysFilename, bytesector, cylsector, headscyl, cylinders, filesize, options);
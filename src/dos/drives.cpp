@@ -544,6 +544,8 @@ bool drivemanager_init = false;
 bool int13_extensions_enable = true;
 bool int13_disk_change_detect_enable = true;
 bool int13_enable_48bitLBA = true;
+int disk_image_cache_kb = 8192;
+bool disk_image_mmap = true;
 
 void DriveManager::Init(Section* s) {
     const Section_prop* section = static_cast<Section_prop*>(s);
@@ -553,6 +555,8 @@ void DriveManager::Init(Section* s) {
 	int13_extensions_enable = section->Get_bool("int 13 extensions");
 	int13_disk_change_detect_enable = section->Get_bool("int 13 disk change detect");
     int13_enable_48bitLBA = section->Get_bool("int 13 enable 48-bit LBA");
+    disk_image_cache_kb = section->Get_int("disk image cache");
+    disk_image_mmap = section->Get_bool("memory map disk images");
 
 	// setup driveInfos structure
 	currentDrive = 0;
@@ -79,6 +79,8 @@
 #include "parport.h"
 #include "keyboard.h"
 #include "clockdomain.h"
+#include "benchmark.h"
+#include "hostprof.h"
 
 #if __APPLE__ && __MAC_OS_X_VERSION_MIN_REQUIRED < 101200
 /* FIX_ME: A workaround to avoid build error. Change version to 101300 if error occurs for Sierra (10.12) */
@@ -297,6 +299,11 @@ bool                ticksLocked;
 bool                mono_cga=false;
 bool                ignore_opcode_63 = true;
 int                 dynamic_core_cache_block_size = 32;
+int                 dynamic_core_cache_size = 8;
+int                 dynamic_core_cache_pages = 0;
+bool                dynamic_core_profile = false;
+bool                dynamic_core_superblocks = false;
+std::string         dynamic_core_profile_file;
 Bitu                VGA_BIOS_Size_override = 0;
 Bitu                VGA_BIOS_SEG = 0xC000;
 Bitu                VGA_BIOS_SEG_END = 0xC800;
@@ -429,10 +436,55 @@ extern bool DOSBox_Paused(), isDBCSCP(), InitCodePage();
 
 static Uint32 SDL_ticks_last = 0,SDL_ticks_next = 0;
 
+BenchmarkState benchmark;
+static std::clock_t benchmark_cpu_start;
+
+void BENCHMARK_Start(void) {
+    benchmark.started = true;
+    benchmark.part = BENCH_OTHER;
+    benchmark.last = std::chrono::steady_clock::now();
+    benchmark.cycles = benchmark.pic_events = benchmark.frames = 0;
+    for (unsigned int i=0;i < BENCH_PARTS;i++) benchmark.host[i] = 0;
+    benchmark_cpu_start = std::clock();
+    /* the emulated time counts from power on, the BIOS and DOS boot are part of it */
+    LOG_MSG("Benchmark: started at %.3f emulated seconds",(double)PIC_FullIndex() / 1000.0);
+}
+
+void BENCHMARK_Report(void) {
+    static const char * const part_names[BENCH_PARTS] = {"other","cpu","callbacks","pic events","timer ticks","gui"};
+
+    if (!benchmark.started) return;
+    BENCHMARK_Switch(benchmark.part);
+
+    double host_total = 0;
+    for (unsigned int i=0;i < BENCH_PARTS;i++) host_total += benchmark.host[i];
+    if (host_total <= 0) host_total = 1e-9;
+    const double emulated = (double)PIC_FullIndex() / 1000.0;
+    const double host_cpu = (double)(std::clock() - benchmark_cpu_start) / CLOCKS_PER_SEC;
+
+    printf("Benchmark: %.3f emulated seconds in %.3f host seconds (%.1f%% of real time), host CPU time %.3f seconds\n",
+        emulated,host_total,emulated * 100.0 / host_total,host_cpu);
+    printf("Benchmark: executed cycles=%llu (%.0f per second, core %s, cycle limit %ld)\n",
+        (unsigned long long)benchmark.cycles,(double)benchmark.cycles / host_total,
+        core_mode,(long)CPU_CycleMax);
+    printf("Benchmark: PIC events=%llu (%.0f per second), frames=%llu (%.1f per second)\n",
+        (unsigned long long)benchmark.pic_events,(double)benchmark.pic_events / host_total,
+        (unsigned long long)benchmark.frames,(double)benchmark.frames / host_total);
+    for (unsigned int i=0;i < BENCH_PARTS;i++)
+        printf("Benchmark: host time %-12s %9.3f seconds %5.1f%%\n",
+            part_names[i],benchmark.host[i],benchmark.host[i] * 100.0 / host_total);
+    fflush(stdout);
+
+    benchmark.started = false;
+}
+
 static Bitu Normal_Loop(void) {
     bool saved_allow = dosbox_allow_nonrecursive_page_fault;
     Bits ret;
 
+    if (GCC_UNLIKELY(benchmark.active && !benchmark.started))
+        BENCHMARK_Start();
+
     if (!menu.hidecycles || menu.showrt) { /* sdlmain.cpp/render.cpp doesn't even maintain the frames count when hiding cycles! */
         uint32_t ticksNew = GetTicks();
         if (ticksNew >= Ticks) {
@@ -466,13 +518,22 @@ static Bitu Normal_Loop(void) {
 
     try {
         while (1) {
-            if (PIC_RunQueue()) {
+            bool queue_ready;
+            {
+                BenchmarkScope bench(BENCH_EVENTS);
+                queue_ready = PIC_RunQueue();
+            }
+            if (queue_ready) {
                 /* now is the time to check for the NMI (Non-maskable interrupt) */
                 CPU_Check_NMI();
 
                 saved_allow = dosbox_allow_nonrecursive_page_fault;
                 dosbox_allow_nonrecursive_page_fault = true;
-                ret = (*cpudecoder)();
+                {
+                    BenchmarkScope bench(BENCH_CPU);
+                    HOSTPROF_SCOPE(HOSTPROF_CPU);
+                    ret = (*cpudecoder)();
+                }
                 dosbox_allow_nonrecursive_page_fault = saved_allow;
 
                 if (GCC_UNLIKELY(ret<0))
@@ -487,7 +548,11 @@ static Bitu Normal_Loop(void) {
                     last_callback = (unsigned int)ret;
 
                     dosbox_allow_nonrecursive_page_fault = false;
-                    Bitu blah = (*CallBack_Handlers[ret])();
+                    Bitu blah;
+                    {
+                        BenchmarkScope bench(BENCH_CALLBACKS);
+                        blah = (*CallBack_Handlers[ret])();
+                    }
                     dosbox_allow_nonrecursive_page_fault = saved_allow;
 
                     last_callback = p_last_callback;
@@ -512,8 +577,12 @@ static Bitu Normal_Loop(void) {
                     return 0;
 #endif
             } else {
-                GFX_Events();
+                {
+                    BenchmarkScope bench(BENCH_GUI);
+                    GFX_Events();
+                }
                 if (DOSBox_Paused() == false && ticksRemain > 0) {
+                    BenchmarkScope bench(BENCH_TICKS);
                     TIMER_AddTick();
                     ticksRemain--;
                 } else {
@@ -904,6 +973,8 @@ void DOSBOX_InitTickLoop() {
 
     ticksRemain = 0;
     ticksLocked = section->Get_bool("turbo");
+    /* benchmark mode runs unthrottled, which also keeps the cycle count fixed */
+    if (benchmark.active) ticksLocked = true;
     ticksLastRTtime = 0;
     ticksLast = GetTicks();
     ticksLastRTcounter = GetTicks();
@@ -1430,6 +1501,7 @@ void DOSBOX_SetupConfigSections(void) {
     const char* captureformats[] = { "default", "avi-zmbv", "mpegts-h264", nullptr };
     const char* blocksizes[] = {"1024", "2048", "4096", "8192", "512", "256", nullptr };
     const char* capturechromaformats[] = { "auto", "4:4:4", "4:2:2", "4:2:0", nullptr };
+    const char* capturequeuefull[] = { "block", "drop", nullptr };
     const char* controllertypes[] = { "auto", "at", "xt", "pcjr", "pc98", nullptr }; // Future work: Tandy(?) and USB
     const char* auxdevices[] = {"none","2button","3button","intellimouse","intellimouse45",nullptr};
     const char* cputype_values[] = {"auto", "8086", "8086_prefetch", "80186", "80186_prefetch", "286", "286_prefetch", "386", "386_prefetch", "486old", "486old_prefetch", "486", "486_prefetch", "pentium", "pentium_mmx", "ppro_slow", "pentium_ii", "pentium_iii", "experimental", nullptr };
@@ -1823,6 +1895,21 @@ void DOSBOX_SetupConfigSections(void) {
             "mpegts-h264                 Use MPEG transport stream + H.264 + AAC audio. Resolution & refresh rate changes can be contained\n"
             "                            within one file with this choice, however not all software can support mid-stream format changes.");
 
+    Pint = secprop->Add_int("capture queue frames",Property::Changeable::OnlyAtStart,8);
+    Pint->SetMinMax(0,64);
+    Pint->Set_help("Number of frames that can wait for the video encoder, which runs on its own thread while capturing video.\n"
+            "Set to 0 to encode on the emulation thread as soon as each frame is done.");
+
+    Pstring = secprop->Add_string("capture queue full", Property::Changeable::OnlyAtStart,"block");
+    Pstring->Set_values(capturequeuefull);
+    Pstring->Set_help("What to do with a new frame when the video encoder falls behind and the capture queue is full.\n"
+            "block       Wait for the encoder. The capture is complete, but emulation slows down to the speed of the encoder.\n"
+            "drop        Record the frame as a repeat of the previous one. Emulation runs at full speed and the audio stays in sync.");
+
+    Pstring = secprop->Add_string("capture threads", Property::Changeable::OnlyAtStart,"auto");
+    Pstring->Set_help("Number of extra threads the ZMBV encoder uses to search and compress large frames, from 0 to 16.\n"
+            "'auto' uses the processor cores that emulation and the capture thread leave free, up to 4. The H.264 encoder picks its own.");
+
     Pint = secprop->Add_int("shell environment size",Property::Changeable::OnlyAtStart,0);
     Pint->SetMinMax(0,65280);
     Pint->Set_help("Size of the initial DOSBox-X shell environment block, in bytes. Setting to 0 implies a default size of 720 bytes as in DOSBox.\n"
@@ -2298,6 +2385,12 @@ void DOSBOX_SetupConfigSections(void) {
     Pstring = Pmulti->GetSection()->Add_string("force",Property::Changeable::Always,"");
     Pstring->Set_values(force);
 
+    Pstring = secprop->Add_string("scaler threads",Property::Changeable::OnlyAtStart,"auto");
+    Pstring->Set_help("Number of extra threads that run the hq2x/hq3x, 2xsai/super2xsai/supereagle and advmame/advinterp scalers, from 0 to 16.\n"
+            "These scalers then scale the lines that changed in bands at the end of each frame instead of line by line.\n"
+            "'auto' uses the processor cores that emulation leaves free, up to 4. Set to 0 to scale on the emulation thread as the lines are drawn.");
+    Pstring->SetBasic(false);
+
     Pstring = secprop->Add_path("glshader",Property::Changeable::Always,"none");
     Pstring->Set_help("Path to GLSL shader source to use with OpenGL output (\"none\" to disable, or \"default\" for default shader).\n"
             "Can be either an absolute path, a file in the \"glshaders\" subdirectory of the DOSBox-X configuration directory, "
@@ -3041,6 +3134,10 @@ void DOSBOX_SetupConfigSections(void) {
                       "Default is auto, which will turn it off for VGA modes and turn it on for SVGA modes.");
     Pstring->SetBasic(true);
 
+    Pbool = secprop->Add_bool("skip unchanged scanlines",Property::Changeable::Always,true);
+    Pbool->Set_help("If set, scanlines whose video memory was not written since they were last drawn are not drawn again.\n"
+                    "This applies to the VGA 256-color and 16-color graphics modes. If the display does not update properly, set this to false.");
+
     secprop=control->AddSection_prop("script",&Null_Init,true);//done
 
     Pstring = secprop->Add_string("startup.js",Property::Changeable::WhenIdle,"");
@@ -3172,6 +3269,28 @@ void DOSBOX_SetupConfigSections(void) {
             "According to forum discussions, setting this to 1 can aid debugging, however doing so also causes\n"
             "problems with 32-bit protected mode DOS games and reduces the performance of the dynamic core.\n");
 
+    Pint = secprop->Add_int("dynamic core cache size",Property::Changeable::OnlyAtStart,8);
+    Pint->SetMinMax(1,256);
+    Pint->Set_help("Size in MB of the translated code cache of the dynamic core (the default value is 8).\n"
+            "When the cache is full the oldest translated code is overwritten. Large protected mode games and\n"
+            "Windows 9x guests may retranslate less often with a larger cache. Use the debugger DYNCACHE command to see the cache counters.");
+
+    Pint = secprop->Add_int("dynamic core cache pages",Property::Changeable::OnlyAtStart,0);
+    Pint->SetMinMax(0,65536);
+    Pint->Set_help("Maximum number of guest code pages the dynamic core keeps translations for at a time.\n"
+            "If 0 the limit scales with the dynamic core cache size, 2048 pages for the default 8MB (older versions were fixed at 512).\n"
+            "Values below 512 are raised to 512. When the limit is reached the least recently run page is released.");
+
+    Pbool = secprop->Add_bool("dynamic core superblocks",Property::Changeable::OnlyAtStart,false);
+    Pbool->Set_help("If set, the dynamic_rec core counts which way the conditional jumps at the end of its blocks go.\n"
+            "Hot blocks whose jump mostly goes one way are translated again as superblocks that continue along that path,\n"
+            "which cuts block dispatch overhead in tight loops. This is experimental.");
+
+    Pstring = secprop->Add_string("dynamic core profile",Property::Changeable::OnlyAtStart,"");
+    Pstring->Set_help("If set, the dynamic core counts how often each translated block runs and why blocks are invalidated,\n"
+            "and appends a report sorted by executed guest instructions to this file on exit. Profiling makes the translated\n"
+            "code slightly slower. The debugger DYNPROF command shows the report and turns profiling on or off at runtime.");
+
     Pstring = secprop->Add_string("cputype",Property::Changeable::Always,"auto");
     Pstring->Set_values(cputype_values);
     Pstring->Set_help("CPU Type used in emulation. \"auto\" emulates a 486 which tolerates Pentium instructions.\n"
@@ -3468,6 +3587,10 @@ void DOSBOX_SetupConfigSections(void) {
                     "Otherwise, the memory size will be the standard 4MB (2MB front buffer + 1x2MB texture unit)");
     Pbool->SetBasic(true);
 
+	Pstring = secprop->Add_string("voodoo_threads",Property::Changeable::OnlyAtStart,"auto");
+	Pstring->Set_help("Number of threads the software Voodoo renderer draws triangles on, in addition to the emulation thread.\n"
+                      "Set to 0 to draw on the emulation thread. The default (auto) uses up to 4 threads, one less than the number of host CPUs.");
+
 	Pbool = secprop->Add_bool("glide",Property::Changeable::WhenIdle,false);
 	Pbool->Set_help("Enable Glide emulation (Glide API passthrough to the host).\n"
                     "Requires a Glide wrapper - glide2x.dll (Windows), libglide2x.so (Linux), or libglide2x.dylib (macOS).");
@@ -3521,6 +3644,12 @@ void DOSBOX_SetupConfigSections(void) {
     Pint->Set_help("How many milliseconds of data to keep on top of the blocksize.");
     Pint->SetBasic(true);
 
+    Pstring = secprop->Add_string("resampler",Property::Changeable::OnlyAtStart,"linear");
+    Pstring->Set_help("How sound channels are converted to the mixer rate. linear is the original linear interpolation.\n"
+            "fast, medium and best use a band-limited windowed-sinc filter, with increasing quality and CPU use, and delay the\n"
+            "channel by up to 15 of its samples. Set channels individually with a list such as \"fm=best sb=medium\", an entry\n"
+            "without a channel name sets the other channels. MIXER /RESAMPLER changes this while running.");
+
     secprop=control->AddSection_prop("midi",&Null_Init,true);//done
 
     Pbool = secprop->Add_bool("roland gs sysex",Property::Changeable::OnlyAtStart,true);
@@ -3942,6 +4071,11 @@ void DOSBOX_SetupConfigSections(void) {
 			Pint->Set_help("Sample rate of OPL music emulation. Use 49716 for highest quality (set the mixer rate accordingly).");
 			Pint->SetBasic(true);
 
+			Pbool = secprop->Add_bool("oplthread",Property::Changeable::WhenIdle,false);
+			Pbool->Set_help("Run the OPL emulation on a separate thread, so that it costs the CPU emulation little more than queueing\n"
+					"the register writes. This delays FM output by another 10ms. Most useful with the CPU-intensive 'nuked' oplemu,\n"
+					"ignored for the hardware OPL boards.");
+
 			Pstring = secprop->Add_string("oplport", Property::Changeable::WhenIdle, "");
 			Pstring->Set_help("Serial port of the OPL2 Audio Board when oplemu=opl2board, opl2mode will become 'opl2' automatically.");
 			Pstring->SetBasic(true);
@@ -5068,6 +5202,16 @@ void DOSBOX_SetupConfigSections(void) {
     Pbool = secprop->Add_bool("int 13 enable 48-bit LBA", Property::Changeable::WhenIdle, true);
     Pbool->Set_help("Enable 48-bit LBA support for INT 13h extensions. Needed for drives larger than 28-bit LBA limit (128GiB).");
 
+    Pint = secprop->Add_int("disk image cache", Property::Changeable::OnlyAtStart, 8192);
+    Pint->SetMinMax(0,1024*1024);
+    Pint->Set_help("Size in KB of the cache kept for each mounted raw, VHD or QCOW2 disk image. Sequential reads are read ahead,\n"
+                   "and writes are written back to the image file about once a second and when the image is unmounted.\n"
+                   "Set to 0 to read and write the image file directly. CHD images keep this much of their data decompressed.");
+
+    Pbool = secprop->Add_bool("memory map disk images", Property::Changeable::OnlyAtStart, true);
+    Pbool->Set_help("Map raw disk images into memory where the host supports it, instead of going through the disk image cache.\n"
+                    "Images too large for the address space of a 32-bit host still use the cache.");
+
     Pbool = secprop->Add_bool("biosps2",Property::Changeable::OnlyAtStart,true);
     Pbool->Set_help("Emulate BIOS INT 15h PS/2 mouse services\n"
         "Note that some OS's like Microsoft Windows neither use INT 33h nor\n"
@@ -5325,6 +5469,14 @@ void DOSBOX_SetupConfigSections(void) {
                 "When running Windows 95 or higher a delay of 4000ms is recommended to ensure that\n"
                 "auto-insert notification triggers properly.\n"
                 "Set to 0 to use controller or CD-ROM drive-specific default.");
+
+        Pbool = secprop->Add_bool("busmaster dma",Property::Changeable::OnlyAtStart,false);
+        if (i == 0) Pbool->Set_help(
+                "If set, and the PCI bus is enabled, the primary and secondary IDE interfaces are also\n"
+                "listed as a PCI bus master IDE controller (Intel PIIX3) and hard disks accept the READ DMA\n"
+                "and WRITE DMA commands. Guest OSes with a bus master IDE driver (Windows 95 OSR2 and later,\n"
+                "Windows NT, Linux) can then transfer whole sectors at once instead of one word per I/O.\n"
+                "Has no effect on the tertiary and higher interfaces or in PC-98 mode.");
     }
 
     /* floppy controller emulation options and setup */
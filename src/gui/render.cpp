@@ -20,8 +20,11 @@
 #include <sys/types.h>
 #include <assert.h>
 #include <math.h>
+#include <algorithm>
 #include <fstream>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 #include "dosbox.h"
 #include "logging.h"
@@ -41,6 +44,9 @@
 #include "pc98_cg.h"
 #include "pc98_gdc.h"
 #include "pc98_gdc_const.h"
+#include "benchmark.h"
+#include "hostprof.h"
+#include "threadpool.h"
 
 #include "render_scalers.h"
 #include "render_glsl.h"
@@ -274,10 +280,6 @@ cacheMiss:
     return false;
 }
 
-#if defined(C_SCALER_FULL_LINE)
-static unsigned int RENDER_scaler_countdown = 0;
-static const unsigned int RENDER_scaler_countdown_init = 12;
-
 static INLINE void cn_ScalerAddLines( Bitu changed, Bitu count ) {
     if ((Scaler_ChangedLineIndex & 1) == changed ) {
         Scaler_ChangedLines[Scaler_ChangedLineIndex] += count;
@@ -287,6 +289,10 @@ static INLINE void cn_ScalerAddLines( Bitu changed, Bitu count ) {
     render.scale.outWrite += render.scale.outPitch * count;
 }
 
+#if defined(C_SCALER_FULL_LINE)
+static unsigned int RENDER_scaler_countdown = 0;
+static const unsigned int RENDER_scaler_countdown_init = 12;
+
 static void RENDER_DrawLine_countdown(const void * s);
 
 static void RENDER_DrawLine_countdown_wait(const void * s) {
@@ -394,6 +400,123 @@ static void RENDER_ClearCacheHandler(const void * src) {
     render.scale.lineHandler( src );
 }
 
+/* True if the next scanline may be passed as NULL, meaning it is the same as the
+ * last time it was drawn. Only while the frame is compared against the cache. */
+bool RENDER_CanSkipLine(void) {
+    return Scaler_NullInput && render.updating && !render.fullFrame && !render.disablerender &&
+        RENDER_DrawLine != RENDER_EmptyLineHandler && RENDER_DrawLine != RENDER_ClearCacheHandler;
+}
+
+/* True if the scanline just drawn is now in the cache. Not after RENDER_ClearCacheHandler,
+ * the cache is being rebuilt then. */
+bool RENDER_LineCached(void) {
+    return render.updating && !render.disablerender &&
+        RENDER_DrawLine != RENDER_EmptyLineHandler && RENDER_DrawLine != RENDER_ClearCacheHandler;
+}
+
+#if RENDER_USE_ADVANCED_SCALERS>1
+/* Scaler threads. With "scaler threads" > 0 the complex scalers only collect the
+ * frame into the frame and change caches while it is drawn. RENDER_ComplexFrame()
+ * then scales the lines that changed in bands of render_complex_band lines, on the
+ * pool and the emulation thread, before the frame goes to GFX_EndUpdate(). */
+static const Bitu render_complex_band = 8;
+static int render_scaler_threads = 0;
+static ThreadPool *render_threads = NULL;
+static ScalerComplexLineHandler_t render_complex_line = nullptr;
+static Bitu render_complex_yscale = 0;				// output lines the scaler writes per line
+static bool render_complex_linear = false;			// the L versions, which ignore Scaler_Aspect
+static unsigned int render_complex_wcpitch = 0;
+static bool render_complex_pending = false;
+static Bitu render_complex_first = 0;				// first line of the frame cache to scale
+static uint8_t *render_complex_outWrite = nullptr;	// and where it goes
+static std::vector<uint8_t*> render_complex_out;	// per line, NULL if it did not change
+static std::vector< std::vector<uint8_t> > render_complex_wcache;	// per band, for the L versions
+
+static void RENDER_ShutDownThreads(Section *sec) {
+	(void)sec;//UNUSED
+	delete render_threads;
+	render_threads = NULL;
+	render_complex_line = nullptr;
+}
+
+/* Stands in for the complex scaler while the frame is drawn. The scaler lags one
+ * line behind the input to see the line below, like the line by line version. */
+static void RENDER_DeferComplexHandler(void) {
+	if (!render_complex_pending) {
+		render_complex_pending = true;
+		render_complex_first = render.scale.outLine ? render.scale.outLine : 1;
+		render_complex_outWrite = render.scale.outWrite;
+	}
+	render.scale.outLine = render.scale.inLine;
+}
+
+static void RENDER_ComplexFrame(void) {
+	HOSTPROF_SCOPE(HOSTPROF_RENDER_LINE);
+
+	render_complex_pending = false;
+	/* the last line is scaled once the whole frame is in, see render_loops.h */
+	const Bitu first = render_complex_first;
+	const Bitu end = (render.scale.inLine >= render.scale.inHeight) ? render.scale.inHeight + 1 : render.scale.inLine;
+	if (first >= end) return;
+
+	/* the output positions and changed lines are worked out up front, in order */
+	if (render_complex_out.size() < end) render_complex_out.resize(end);
+	render.scale.outWrite = render_complex_outWrite;
+	Bitu firstchanged = end;
+	bool overlap = false;
+	for (Bitu line=first;line < end;line++) {
+		const Bitu changed = scalerChangeCache[(unsigned int)line][0] ? 1 : 0;
+		const Bitu lines = render_complex_linear ? render_complex_yscale : Scaler_Aspect[line];
+		render_complex_out[line] = changed ? render.scale.outWrite : nullptr;
+		if (changed && firstchanged == end) firstchanged = line;
+		/* an aspect corrected frame shorter than the scaler output overwrites the
+		 * bottom of each line with the next one, which only works in order */
+		if (changed && lines < render_complex_yscale) overlap = true;
+		cn_ScalerAddLines(changed, lines);
+	}
+	render.scale.outLine = end;
+	if (firstchanged == end) return;
+
+	const int bands = (int)((end - first + render_complex_band - 1) / render_complex_band);
+	if (render_complex_wcpitch != 0 && render_complex_wcache.size() < (size_t)bands) {
+		render_complex_wcache.resize((size_t)bands);
+		for (auto &wc : render_complex_wcache) wc.resize((size_t)render_complex_wcpitch * 5u);
+	}
+
+	const ScalerComplexLineHandler_t scale = render_complex_line;
+	const auto bandwcache = [](int band,uint8_t **wcache) {
+		for (unsigned int i=0;i < 5u;i++)
+			wcache[i] = render_complex_wcpitch != 0 ? render_complex_wcache[(size_t)band].data() + (size_t)render_complex_wcpitch * i : NULL;
+	};
+
+	/* The hq scalers set up their tables the first time they run. Scale the first
+	 * line here so that this never happens on the pool. */
+	{
+		uint8_t *wcache[5];
+		bandwcache((int)((firstchanged - first) / render_complex_band),wcache);
+		scale(firstchanged, render_complex_out[firstchanged], wcache);
+		render_complex_out[firstchanged] = nullptr;
+	}
+
+	const auto scaleband = [first,end,scale,bandwcache](int band) {
+		uint8_t *wcache[5];
+		bandwcache(band,wcache);
+
+		const Bitu stop = std::min(first + (Bitu)(band + 1) * render_complex_band, end);
+		for (Bitu line=first + (Bitu)band * render_complex_band;line < stop;line++) {
+			if (render_complex_out[line] != nullptr)
+				scale(line, render_complex_out[line], wcache);
+		}
+	};
+
+	/* the pool is gone once the exit functions ran */
+	if (render_threads != NULL && !overlap)
+		render_threads->Run(bands, scaleband);
+	else
+		for (int band=0;band < bands;band++) scaleband(band);
+}
+#endif
+
 extern void GFX_SetTitle(int32_t cycles, int frameskip, Bits timing, bool paused);
 
 bool RENDER_StartUpdate(void) {
@@ -421,6 +544,9 @@ bool RENDER_StartUpdate(void) {
     render.scale.outPitch = 0;
     Scaler_ChangedLines[0] = 0;
     Scaler_ChangedLineIndex = 0;
+#if RENDER_USE_ADVANCED_SCALERS>1
+    render_complex_pending = false;
+#endif
     if (GCC_UNLIKELY( render.scale.clearCache) ) {
 //      LOG_MSG("Clearing cache");
         //Will always have to update the screen with this one anyway, so let's update already
@@ -480,9 +606,16 @@ void RENDER_EndUpdate( bool abort ) {
     if (video_debug_overlay && !abort && render.active && render.scale.outLine != 0)
         VGA_DebugOverlay();
 
+#if RENDER_USE_ADVANCED_SCALERS>1
+    if (render_complex_pending && !abort && !render.disablerender)
+        RENDER_ComplexFrame();
+#endif
+
     if (!abort && render.active && RENDER_DrawLine == RENDER_ClearCacheHandler)
         render.scale.clearCache = false;
 
+    if (!abort) benchmark.frames++;
+
     RENDER_DrawLine = RENDER_EmptyLineHandler;
     if (render.disablerender) {
         GFX_EndUpdate(nullptr);
@@ -507,6 +640,7 @@ void RENDER_EndUpdate( bool abort ) {
                 flags, fps, (uint8_t*)scalerSourceCacheBuffer, (uint8_t*)&render.pal.rgb );
         }
         if ( render.scale.outWrite) {
+            HOSTPROF_SCOPE(HOSTPROF_GFX);
             GFX_EndUpdate( abort? NULL : Scaler_ChangedLines );
             render.frameskip.hadSkip[render.frameskip.index] = 0;
         } else {
@@ -1016,6 +1150,20 @@ forcenormal:
 			//E_Exit("RENDER:Wrong source bpp %d", render.src.bpp );
 	}
 
+#if RENDER_USE_ADVANCED_SCALERS>1
+	/* the scaler threads take over from the complex scaler, see RENDER_ComplexFrame() */
+	render_complex_pending = false;
+	render_complex_line = nullptr;
+	render_complex_wcache.clear();
+	if (complexBlock && render.scale.complexHandler && render_threads != NULL) {
+		render_complex_line = use_wcache ? complexBlock->LinearLine[ render.scale.outMode ] : complexBlock->RandomLine[ render.scale.outMode ];
+		render_complex_yscale = complexBlock->yscale;
+		render_complex_linear = use_wcache;
+		render_complex_wcpitch = use_wcache ? wcpitch : 0;
+		if (render_complex_line) render.scale.complexHandler = RENDER_DeferComplexHandler;
+	}
+#endif
+
 	scalerSourceCacheBufferAlloc(render.scale.cachePitch,render.src.height);
 
 	/* only allocate frame cache if using a complex scaler.
@@ -1194,6 +1342,9 @@ void RENDER_SetSize(Bitu width,Bitu height,Bitu bpp,float fps,double scrn_ratio)
 	else {
 		height += 8*2;
 	}
+#if C_HOST_PROFILER
+	height += 8; /* host profiler */
+#endif
 	height += 4;
     }
 
@@ -1642,6 +1793,20 @@ void RENDER_Init() {
 
     render.frameskip.max=(Bitu)section->Get_int("frameskip");
 
+#if RENDER_USE_ADVANCED_SCALERS>1
+    /* leave one core to the emulation thread, which scales a band too */
+    std::string scalerthreads = section->Get_string("scaler threads");
+    if (scalerthreads == "auto")
+        render_scaler_threads = std::min(std::max((int)std::thread::hardware_concurrency() - 1,0),4);
+    else
+        render_scaler_threads = std::min(std::max(atoi(scalerthreads.c_str()),0),16);
+    if (render_scaler_threads > 0 && render_threads == NULL) {
+        LOG(LOG_MISC,LOG_DEBUG)("Using %d scaler threads",render_scaler_threads);
+        render_threads = new ThreadPool(render_scaler_threads);
+        AddExitFunction(AddExitFunctionFuncPair(RENDER_ShutDownThreads));
+    }
+#endif
+
     MAPPER_AddHandler(DecreaseFrameSkip,MK_nothing,0,"decfskip","Decrease frameskip");
     MAPPER_AddHandler(IncreaseFrameSkip,MK_nothing,0,"incfskip","Increase frameskip");
 
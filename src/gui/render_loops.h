@@ -16,39 +16,20 @@
  *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
  */
 
+/* Scales one line of the frame cache that changed to outWrite. This is also called
+ * from the scaler threads at the end of the frame (see RENDER_ComplexFrame), so it
+ * must not touch anything but its own line, its output and its own write cache. */
 #if defined (SCALERLINEAR)
-static inline void conc3d(SCALERNAME,SBPP,L)(void) {
-# if !defined(_MSC_VER) /* Microsoft C++ thinks this is a failed attempt at a function call---it's not */
-	(void)conc3d(SCALERNAME,SBPP,L);
-# endif
+static void conc4d(SCALERNAME,SBPP,L,Line)(const Bitu outLine,uint8_t * const outWrite,uint8_t * const * const wcache) {
 #else
-static inline void conc3d(SCALERNAME,SBPP,R)(void) {
-# if !defined(_MSC_VER) /* Microsoft C++ thinks this is a failed attempt at a function call---it's not */
-	(void)conc3d(SCALERNAME,SBPP,R);
-# endif
+static void conc4d(SCALERNAME,SBPP,R,Line)(const Bitu outLine,uint8_t * const outWrite,uint8_t * const * const wcache) {
+	(void)wcache;
 #endif
-//Skip the first one for multiline input scalers
-	if (!render.scale.outLine) {
-		render.scale.outLine++;
-		return;
-	}
-lastagain:
-	if (!CC[render.scale.outLine][0]) {
-#if defined(SCALERLINEAR) 
-		Bitu scaleLines = SCALERHEIGHT;
-#else
-		Bitu scaleLines = Scaler_Aspect[ render.scale.outLine ];
-#endif
-		ScalerAddLines( 0, scaleLines );
-		if (++render.scale.outLine == render.scale.inHeight)
-			goto lastagain;
-		return;
-	}
 	/* Clear the complete line marker */
-	CC[render.scale.outLine][0] = 0;
-	FC_PTRS(const PTYPE,render.scale.outLine);
-	PTYPE * line0=(PTYPE *)(render.scale.outWrite);
-	uint8_t * changed = &CC[render.scale.outLine][1];
+	CC[outLine][0] = 0;
+	FC_PTRS(const PTYPE,outLine);
+	PTYPE * line0=(PTYPE *)(outWrite);
+	uint8_t * changed = &CC[outLine][1];
 	Bitu b;
 	for (b=0;b<render.scale.blocks;b++) {
 #if (SCALERHEIGHT > 1) 
@@ -136,16 +117,16 @@ lastagain:
 		default:
 #if defined(SCALERLINEAR)
 #if (SCALERHEIGHT > 1) 
-			line1 = WC[0];
+			line1 = ((PTYPE *)wcache[0]);
 #endif
 #if (SCALERHEIGHT > 2) 
-			line2 = WC[1];
+			line2 = ((PTYPE *)wcache[1]);
 #endif
 #if (SCALERHEIGHT > 3) 
-			line3 = WC[2];
+			line3 = ((PTYPE *)wcache[2]);
 #endif
 #if (SCALERHEIGHT > 4) 
-			line4 = WC[3];
+			line4 = ((PTYPE *)wcache[3]);
 #endif
 #else
 #if (SCALERHEIGHT > 1) 
@@ -180,30 +161,68 @@ lastagain:
 			}
 #if defined(SCALERLINEAR)
 #if (SCALERHEIGHT > 1) 
-			BituMove((uint8_t*)(&line0[-SCALER_BLOCKSIZE*SCALERWIDTH])+render.scale.outPitch  ,WC[0], SCALER_BLOCKSIZE *SCALERWIDTH*PSIZE);
+			BituMove((uint8_t*)(&line0[-SCALER_BLOCKSIZE*SCALERWIDTH])+render.scale.outPitch  ,((PTYPE *)wcache[0]), SCALER_BLOCKSIZE *SCALERWIDTH*PSIZE);
 #endif
 #if (SCALERHEIGHT > 2) 
-			BituMove((uint8_t*)(&line0[-SCALER_BLOCKSIZE*SCALERWIDTH])+render.scale.outPitch*2,WC[1], SCALER_BLOCKSIZE *SCALERWIDTH*PSIZE);
+			BituMove((uint8_t*)(&line0[-SCALER_BLOCKSIZE*SCALERWIDTH])+render.scale.outPitch*2,((PTYPE *)wcache[1]), SCALER_BLOCKSIZE *SCALERWIDTH*PSIZE);
 #endif
 #if (SCALERHEIGHT > 3) 
-			BituMove((uint8_t*)(&line0[-SCALER_BLOCKSIZE*SCALERWIDTH])+render.scale.outPitch*3,WC[2], SCALER_BLOCKSIZE *SCALERWIDTH*PSIZE);
+			BituMove((uint8_t*)(&line0[-SCALER_BLOCKSIZE*SCALERWIDTH])+render.scale.outPitch*3,((PTYPE *)wcache[2]), SCALER_BLOCKSIZE *SCALERWIDTH*PSIZE);
 #endif
 #if (SCALERHEIGHT > 4) 
-			BituMove((uint8_t*)(&line0[-SCALER_BLOCKSIZE*SCALERWIDTH])+render.scale.outPitch*4,WC[3], SCALER_BLOCKSIZE *SCALERWIDTH*PSIZE);
+			BituMove((uint8_t*)(&line0[-SCALER_BLOCKSIZE*SCALERWIDTH])+render.scale.outPitch*4,((PTYPE *)wcache[3]), SCALER_BLOCKSIZE *SCALERWIDTH*PSIZE);
 #endif
 #endif //defined(SCALERLINEAR)
 			break;
 		}
 	}
+#if !defined(SCALERLINEAR) 
+	Bitu scaleLines = Scaler_Aspect[ outLine ];
+	if ( ((Bits)(scaleLines - SCALERHEIGHT)) > 0 ) {
+		BituMove( outWrite + render.scale.outPitch * SCALERHEIGHT,
+			outWrite + render.scale.outPitch * (SCALERHEIGHT-1),
+			render.src.width * SCALERWIDTH * PSIZE);
+	}
+#endif
+}
+
+#if defined (SCALERLINEAR)
+static inline void conc3d(SCALERNAME,SBPP,L)(void) {
+# if !defined(_MSC_VER) /* Microsoft C++ thinks this is a failed attempt at a function call---it's not */
+	(void)conc3d(SCALERNAME,SBPP,L);
+# endif
+#else
+static inline void conc3d(SCALERNAME,SBPP,R)(void) {
+# if !defined(_MSC_VER) /* Microsoft C++ thinks this is a failed attempt at a function call---it's not */
+	(void)conc3d(SCALERNAME,SBPP,R);
+# endif
+#endif
+//Skip the first one for multiline input scalers
+	if (!render.scale.outLine) {
+		render.scale.outLine++;
+		return;
+	}
+lastagain:
+	if (!CC[render.scale.outLine][0]) {
+#if defined(SCALERLINEAR) 
+		Bitu scaleLines = SCALERHEIGHT;
+#else
+		Bitu scaleLines = Scaler_Aspect[ render.scale.outLine ];
+#endif
+		ScalerAddLines( 0, scaleLines );
+		if (++render.scale.outLine == render.scale.inHeight)
+			goto lastagain;
+		return;
+	}
+#if defined (SCALERLINEAR)
+	conc4d(SCALERNAME,SBPP,L,Line)(render.scale.outLine,render.scale.outWrite,scalerWriteCache.b8);
+#else
+	conc4d(SCALERNAME,SBPP,R,Line)(render.scale.outLine,render.scale.outWrite,scalerWriteCache.b8);
+#endif
 #if defined(SCALERLINEAR) 
 	Bitu scaleLines = SCALERHEIGHT;
 #else
 	Bitu scaleLines = Scaler_Aspect[ render.scale.outLine ];
-	if ( ((Bits)(scaleLines - SCALERHEIGHT)) > 0 ) {
-		BituMove( render.scale.outWrite + render.scale.outPitch * SCALERHEIGHT,
-			render.scale.outWrite + render.scale.outPitch * (SCALERHEIGHT-1),
-			render.src.width * SCALERWIDTH * PSIZE);
-	}
 #endif
 	ScalerAddLines( 1, scaleLines );
 	if (++render.scale.outLine == render.scale.inHeight)
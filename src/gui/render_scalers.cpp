@@ -25,6 +25,14 @@
 #include "render.h"
 #include <string.h>
 
+//The VGA passes scanlines that did not change as 0, see RENDER_CanSkipLine
+#define RENDER_NULL_INPUT
+
+#ifdef RENDER_NULL_INPUT
+bool Scaler_NullInput = true;
+#else
+bool Scaler_NullInput = false;
+#endif
 uint8_t *Scaler_Aspect = NULL;
 uint16_t *Scaler_ChangedLines = NULL;
 Bitu Scaler_ChangedLineIndex;
@@ -758,7 +766,9 @@ ScalerComplexBlock_t ScaleAdvMame2x ={
 	GFX_CAN_8|GFX_CAN_15|GFX_CAN_16|GFX_CAN_32,
 	2,2,
 {	AdvMame2x_8_L,AdvMame2x_15_L,AdvMame2x_16_L,AdvMame2x_32_L},
-{	AdvMame2x_8_R,AdvMame2x_15_R,AdvMame2x_16_R,AdvMame2x_32_R}
+{	AdvMame2x_8_R,AdvMame2x_15_R,AdvMame2x_16_R,AdvMame2x_32_R},
+{	AdvMame2x_8_L_Line,AdvMame2x_15_L_Line,AdvMame2x_16_L_Line,AdvMame2x_32_L_Line},
+{	AdvMame2x_8_R_Line,AdvMame2x_15_R_Line,AdvMame2x_16_R_Line,AdvMame2x_32_R_Line}
 };
 
 ScalerComplexBlock_t ScaleAdvMame3x = {
@@ -766,7 +776,9 @@ ScalerComplexBlock_t ScaleAdvMame3x = {
 	GFX_CAN_8|GFX_CAN_15|GFX_CAN_16|GFX_CAN_32,
 	3,3,
 {	AdvMame3x_8_L,AdvMame3x_15_L,AdvMame3x_16_L,AdvMame3x_32_L},
-{	AdvMame3x_8_R,AdvMame3x_15_R,AdvMame3x_16_R,AdvMame3x_32_R}
+{	AdvMame3x_8_R,AdvMame3x_15_R,AdvMame3x_16_R,AdvMame3x_32_R},
+{	AdvMame3x_8_L_Line,AdvMame3x_15_L_Line,AdvMame3x_16_L_Line,AdvMame3x_32_L_Line},
+{	AdvMame3x_8_R_Line,AdvMame3x_15_R_Line,AdvMame3x_16_R_Line,AdvMame3x_32_R_Line}
 };
 
 /* These need specific 15bpp versions */
@@ -775,7 +787,9 @@ ScalerComplexBlock_t ScaleHQ2x ={
 	GFX_CAN_15|GFX_CAN_16|GFX_CAN_32|GFX_RGBONLY,
 	2,2,
 {	nullptr,HQ2x_15_L,HQ2x_16_L,HQ2x_32_L},
-{	nullptr,HQ2x_15_R,HQ2x_16_R,HQ2x_32_R}
+{	nullptr,HQ2x_15_R,HQ2x_16_R,HQ2x_32_R},
+{	nullptr,HQ2x_15_L_Line,HQ2x_16_L_Line,HQ2x_32_L_Line},
+{	nullptr,HQ2x_15_R_Line,HQ2x_16_R_Line,HQ2x_32_R_Line}
 };
 
 ScalerComplexBlock_t ScaleHQ3x ={
@@ -783,7 +797,9 @@ ScalerComplexBlock_t ScaleHQ3x ={
 	GFX_CAN_15|GFX_CAN_16|GFX_CAN_32|GFX_RGBONLY,
 	3,3,
 {	nullptr,HQ3x_15_L,HQ3x_16_L,HQ3x_32_L},
-{	nullptr,HQ3x_15_R,HQ3x_16_R,HQ3x_32_R}
+{	nullptr,HQ3x_15_R,HQ3x_16_R,HQ3x_32_R},
+{	nullptr,HQ3x_15_L_Line,HQ3x_16_L_Line,HQ3x_32_L_Line},
+{	nullptr,HQ3x_15_R_Line,HQ3x_16_R_Line,HQ3x_32_R_Line}
 };
 
 ScalerComplexBlock_t ScaleSuper2xSaI ={
@@ -791,7 +807,9 @@ ScalerComplexBlock_t ScaleSuper2xSaI ={
 	GFX_CAN_15|GFX_CAN_16|GFX_CAN_32|GFX_RGBONLY,
 	2,2,
 {	nullptr,Super2xSaI_15_L,Super2xSaI_16_L,Super2xSaI_32_L},
-{	nullptr,Super2xSaI_15_R,Super2xSaI_16_R,Super2xSaI_32_R}
+{	nullptr,Super2xSaI_15_R,Super2xSaI_16_R,Super2xSaI_32_R},
+{	nullptr,Super2xSaI_15_L_Line,Super2xSaI_16_L_Line,Super2xSaI_32_L_Line},
+{	nullptr,Super2xSaI_15_R_Line,Super2xSaI_16_R_Line,Super2xSaI_32_R_Line}
 };
 
 ScalerComplexBlock_t Scale2xSaI ={
@@ -799,7 +817,9 @@ ScalerComplexBlock_t Scale2xSaI ={
 	GFX_CAN_15|GFX_CAN_16|GFX_CAN_32|GFX_RGBONLY,
 	2,2,
 {	nullptr,_2xSaI_15_L,_2xSaI_16_L,_2xSaI_32_L},
-{	nullptr,_2xSaI_15_R,_2xSaI_16_R,_2xSaI_32_R}
+{	nullptr,_2xSaI_15_R,_2xSaI_16_R,_2xSaI_32_R},
+{	nullptr,_2xSaI_15_L_Line,_2xSaI_16_L_Line,_2xSaI_32_L_Line},
+{	nullptr,_2xSaI_15_R_Line,_2xSaI_16_R_Line,_2xSaI_32_R_Line}
 };
 
 ScalerComplexBlock_t ScaleSuperEagle ={
@@ -807,7 +827,9 @@ ScalerComplexBlock_t ScaleSuperEagle ={
 	GFX_CAN_15|GFX_CAN_16|GFX_CAN_32|GFX_RGBONLY,
 	2,2,
 {	nullptr,SuperEagle_15_L,SuperEagle_16_L,SuperEagle_32_L},
-{	nullptr,SuperEagle_15_R,SuperEagle_16_R,SuperEagle_32_R}
+{	nullptr,SuperEagle_15_R,SuperEagle_16_R,SuperEagle_32_R},
+{	nullptr,SuperEagle_15_L_Line,SuperEagle_16_L_Line,SuperEagle_32_L_Line},
+{	nullptr,SuperEagle_15_R_Line,SuperEagle_16_R_Line,SuperEagle_32_R_Line}
 };
 
 ScalerComplexBlock_t ScaleAdvInterp2x = {
@@ -815,7 +837,9 @@ ScalerComplexBlock_t ScaleAdvInterp2x = {
 	GFX_CAN_15|GFX_CAN_16|GFX_CAN_32|GFX_RGBONLY,
 	2,2,
 {	nullptr,AdvInterp2x_15_L,AdvInterp2x_16_L,AdvInterp2x_32_L},
-{	nullptr,AdvInterp2x_15_R,AdvInterp2x_16_R,AdvInterp2x_32_R}
+{	nullptr,AdvInterp2x_15_R,AdvInterp2x_16_R,AdvInterp2x_32_R},
+{	nullptr,AdvInterp2x_15_L_Line,AdvInterp2x_16_L_Line,AdvInterp2x_32_L_Line},
+{	nullptr,AdvInterp2x_15_R_Line,AdvInterp2x_16_R_Line,AdvInterp2x_32_R_Line}
 };
 
 ScalerComplexBlock_t ScaleAdvInterp3x = {
@@ -823,7 +847,9 @@ ScalerComplexBlock_t ScaleAdvInterp3x = {
 	GFX_CAN_15|GFX_CAN_16|GFX_CAN_32|GFX_RGBONLY,
 	3,3,
 {	nullptr,AdvInterp3x_15_L,AdvInterp3x_16_L,AdvInterp3x_32_L},
-{	nullptr,AdvInterp3x_15_R,AdvInterp3x_16_R,AdvInterp3x_32_R}
+{	nullptr,AdvInterp3x_15_R,AdvInterp3x_16_R,AdvInterp3x_32_R},
+{	nullptr,AdvInterp3x_15_L_Line,AdvInterp3x_16_L_Line,AdvInterp3x_32_L_Line},
+{	nullptr,AdvInterp3x_15_R_Line,AdvInterp3x_16_R_Line,AdvInterp3x_32_R_Line}
 };
 
 #endif
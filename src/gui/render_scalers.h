@@ -53,8 +53,10 @@ typedef enum scalerOperation {
 
 typedef void (*ScalerLineHandler_t)(const void *src);
 typedef void (*ScalerComplexHandler_t)(void);
+typedef void (*ScalerComplexLineHandler_t)(const Bitu line,uint8_t * const out,uint8_t * const * const wcache);
 
 extern uint8_t diff_table[];
+extern bool Scaler_NullInput;
 extern uint8_t *Scaler_Aspect;
 extern Bitu Scaler_ChangedLineIndex;
 extern uint16_t *Scaler_ChangedLines;
@@ -101,6 +103,8 @@ typedef struct {
 	Bitu xscale,yscale;
 	ScalerComplexHandler_t Linear[4];
 	ScalerComplexHandler_t Random[4];
+	ScalerComplexLineHandler_t LinearLine[4];	// one line of the frame cache, for the scaler threads
+	ScalerComplexLineHandler_t RandomLine[4];
 } ScalerComplexBlock_t;
 
 typedef struct {
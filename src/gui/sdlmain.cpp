@@ -149,6 +149,8 @@ char* revert_escape_newlines(const char* aMessage);
 #include "inout.h"
 #include "jfont.h"
 #include "render.h"
+#include "benchmark.h"
+#include "hostprof.h"
 #include "../dos/cdrom.h"
 #include "../dos/drives.h"
 #include "../ints/int10.h"
@@ -7451,6 +7453,11 @@ bool DOSBOX_parse_argv() {
             fprintf(stderr,"  -set <section property=value>           Set the config option (overriding the config file).\n");
             fprintf(stderr,"                                          Make sure to surround the string in quotes to cover spaces.\n");
             fprintf(stderr,"  -time-limit <n>                         Kill the emulator after 'n' seconds\n");
+            fprintf(stderr,"  -benchmark <n>                          Run headless and unthrottled for 'n' emulated seconds,\n");
+            fprintf(stderr,"                                          then report the emulation speed and exit\n");
+#if C_HOST_PROFILER
+            fprintf(stderr,"  -hostprof-trace <file>                  Write host profiler timings to <file> on exit (Chrome trace format)\n");
+#endif
             fprintf(stderr,"  -fastlaunch                             Fast launch mode (skip the BIOS logo and welcome banner)\n");
 #if C_DEBUG
             fprintf(stderr,"  -helpdebug                              Show debug-related options\n");
@@ -7516,6 +7523,20 @@ bool DOSBOX_parse_argv() {
             if (!control->cmdline->NextOptArgv(tmp)) return false;
             control->opt_time_limit = atof(tmp.c_str());
         }
+#if C_HOST_PROFILER
+        else if (optname == "hostprof-trace") {
+            if (!control->cmdline->NextOptArgv(control->opt_hostprof_trace)) return false;
+        }
+#endif
+        else if (optname == "benchmark") {
+            if (!control->cmdline->NextOptArgv(tmp)) return false;
+            control->opt_benchmark = atof(tmp.c_str());
+            putenv(const_cast<char*>("SDL_AUDIODRIVER=dummy"));
+            putenv(const_cast<char*>("SDL_VIDEODRIVER=dummy"));
+            control->opt_set.push_back("nosound=true");
+            control->opt_nomenu = true;
+            control->opt_fastlaunch = true;
+        }
         else if (optname == "break-start") {
             control->opt_break_start = true;
         }
@@ -8399,6 +8420,11 @@ int main(int argc, char* argv[]) SDL_MAIN_NOEXCEPT {
     if (control->opt_time_limit > 0)
         time_limit_ms = (Bitu)(control->opt_time_limit * 1000);
 
+    if (control->opt_benchmark > 0) {
+        time_limit_ms = (Bitu)(control->opt_benchmark * 1000);
+        benchmark.active = true;
+    }
+
     if (control->opt_console)
         DOSBox_ShowConsole();
 
@@ -9687,6 +9713,9 @@ int main(int argc, char* argv[]) SDL_MAIN_NOEXCEPT {
 
         RENDER_Init();
         CAPTURE_Init();
+#if C_HOST_PROFILER
+        HOSTPROF_Init();
+#endif
         IO_Init();
         HARDWARE_Init();
         CPU_PreInit();
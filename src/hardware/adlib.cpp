@@ -21,6 +21,11 @@
 #include <string.h>
 #include <math.h>
 #include <sys/types.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "adlib.h"
 
 #include "logging.h"
@@ -150,8 +155,13 @@ namespace OPL2 {
 			(void)port;//UNUSED
 			return val;
 		}
+		bool WriteAddrFromMode( uint32_t port, uint8_t val, bool opl3mode, uint32_t &addr ) override {
+			(void)port;(void)opl3mode;//UNUSED
+			addr = val;
+			return true;
+		}
 
-		void Generate( MixerChannel* chan, Bitu samples ) override {
+		void Generate( Adlib::Output* chan, Bitu samples ) override {
 			int16_t buf[1024];
 			while( samples > 0 ) {
 				Bitu todo = samples > 1024 ? 1024 : samples;
@@ -218,7 +228,13 @@ namespace OPL3 {
 			adlib_write_index(port, val);
 			return opl_index;
 		}
-		void Generate( MixerChannel* chan, Bitu samples ) override {
+		bool WriteAddrFromMode( uint32_t port, uint8_t val, bool opl3mode, uint32_t &addr ) override {
+			//Same as adlib_write_index, without keeping opl_index
+			addr = val;
+			if ((port&3)!=0 && (opl3mode || val==5)) addr |= ARC_SECONDSET;
+			return true;
+		}
+		void Generate( Adlib::Output* chan, Bitu samples ) override {
 			int16_t buf[1024*2];
 			while( samples > 0 ) {
 				Bitu todo = samples > 1024 ? 1024 : samples;
@@ -345,7 +361,7 @@ struct Handler : public Adlib::Handler {
 	}
 #endif
 
-	void Generate(MixerChannel *chan, Bitu samples) override {
+	void Generate(Adlib::Output *chan, Bitu samples) override {
 		int16_t buf[1024 * 2];
 
 		while (samples > 0) {
@@ -389,7 +405,15 @@ struct Handler : public Adlib::Handler {
 		return addr;
 	}
 
-	void Generate(MixerChannel *chan, Bitu samples) override {
+	bool WriteAddrFromMode(uint32_t port, uint8_t val, bool opl3mode, uint32_t &addr) override {
+		addr = val;
+		if ((port & 2) && (addr == 0x05 || opl3mode)) {
+			addr |= 0x100;
+		}
+		return true;
+	}
+
+	void Generate(Adlib::Output *chan, Bitu samples) override {
 		int16_t buf[1024 * 2];
 		while (samples > 0) {
 			uint32_t todo = samples > 1024 ? 1024 : (uint32_t)samples;
@@ -432,7 +456,17 @@ namespace NukedCQM {
             return addr;
         }
 
-        void Generate(MixerChannel* chan, Bitu samples) override
+        bool WriteAddrFromMode(uint32_t port, uint8_t val, bool opl3mode, uint32_t& addr) override
+        {
+            addr = val;
+
+            if((port & 2) && (addr == 0x05 || opl3mode))
+                addr |= 0x100;
+
+            return true;
+        }
+
+        void Generate(Adlib::Output* chan, Bitu samples) override
         {
             int16_t buf[1024 * 2];
 
@@ -500,7 +534,11 @@ struct Handler : public Adlib::Handler {
 	uint32_t WriteAddr(uint32_t /*port*/, uint8_t val) override {
 		return val;
 	}
-	void Generate(MixerChannel* chan, Bitu samples) override {
+	bool WriteAddrFromMode(uint32_t /*port*/, uint8_t val, bool /*opl3mode*/, uint32_t &addr) override {
+		addr = val;
+		return true;
+	}
+	void Generate(Adlib::Output* chan, Bitu samples) override {
 		int16_t buf[1024 * 2];
 		while (samples > 0) {
 			Bitu todo = samples > 1024 ? 1024 : samples;
@@ -566,7 +604,11 @@ struct Handler : public Adlib::Handler {
 	uint32_t WriteAddr(uint32_t /*port*/, uint8_t val) override {
 		return val;
 	}
-	void Generate(MixerChannel* chan, Bitu samples) override {
+	bool WriteAddrFromMode(uint32_t /*port*/, uint8_t val, bool /*opl3mode*/, uint32_t &addr) override {
+		addr = val;
+		return true;
+	}
+	void Generate(Adlib::Output* chan, Bitu samples) override {
 		//We generate data for 4 channels, but only the first 2 are connected on a pc
 		int16_t buf[4][1024];
 		int16_t result[1024][2];
@@ -642,7 +684,7 @@ namespace OPL2BOARD {
 			return val;
 		}
 
-		void Generate(MixerChannel* chan, Bitu samples) override {
+		void Generate(Adlib::Output* chan, Bitu samples) override {
 			(void)samples;
 			int16_t buf[1] = { 0 };
 			chan->AddSamples_m16(1, buf);
@@ -677,7 +719,7 @@ namespace OPL3DUOBOARD {
 			return reg;
 		}
 
-		void Generate(MixerChannel* chan, Bitu samples) override {
+		void Generate(Adlib::Output* chan, Bitu samples) override {
 			(void)samples;//UNUSED
 			int16_t buf[1] = { 0 };
 			chan->AddSamples_m16(1, buf);
@@ -734,7 +776,7 @@ namespace Retrowave_OPL3 {
 			return 0;
 		}
 
-		void Generate(MixerChannel* chan, Bitu samples) override {
+		void Generate(Adlib::Output* chan, Bitu samples) override {
 			(void)samples;//UNUSED
 #ifdef RETROWAVE_USE_BUFFER
 			retrowave_flush(&retrowave_global_context);
@@ -1425,7 +1467,7 @@ void Module::Init( Mode m ) {
 static Adlib::Module * module = nullptr;
 
 static void OPL_CallBack(Bitu len) {
-	module->handler->Generate( module->mixerChan, len );
+	module->handler->Generate( &module->mixerOutput, len );
 	//Disable the sound generation after 30 seconds of silence
 	if ((PIC_Ticks - module->lastUsed) > 30000) {
 		Bitu i;
@@ -1576,6 +1618,213 @@ void OPL_SaveRawEvent(bool pressed) {
 
 namespace Adlib {
 
+/* Runs a software OPL handler on a synthesis thread ("oplthread" option).
+
+   Register writes are queued with the sample they land on, which is exact since
+   OPL_Write fills the mixer channel up to the current time first. The thread
+   renders everything up to the last sample the mixer asked for, a batch at a
+   time, while the mixer is handed what was rendered "lookahead" samples before.
+   So the emulation thread only queues writes and copies samples, and waits for
+   the thread only when it falls more than the lookahead behind. */
+class ThreadedHandler : public Handler {
+	struct RegWrite {
+		uint64_t when;
+		uint32_t reg;
+		uint8_t val;
+	};
+
+	//Collects what the handler generates as stereo frames, written only by the thread
+	class Buffer : public Output {
+	public:
+		std::vector<int32_t> frames;
+		uint64_t pos = 0;
+
+		void Put( int32_t l, int32_t r ) {
+			const size_t i = (size_t)(pos++ & (BufferFrames - 1u)) * 2u;
+			frames[i] = l;
+			frames[i+1u] = r;
+		}
+		void AddSamples_m16( Bitu len, const int16_t* data ) override { for ( Bitu i=0;i < len;i++ ) Put( data[i], data[i] ); }
+		void AddSamples_s16( Bitu len, const int16_t* data ) override { for ( Bitu i=0;i < len;i++ ) Put( data[i*2u], data[i*2u+1u] ); }
+		void AddSamples_m32( Bitu len, const int32_t* data ) override { for ( Bitu i=0;i < len;i++ ) Put( data[i], data[i] ); }
+		void AddSamples_s32( Bitu len, const int32_t* data ) override { for ( Bitu i=0;i < len;i++ ) Put( data[i*2u], data[i*2u+1u] ); }
+	};
+
+	static const uint64_t BufferFrames = 16384;	//power of 2, more than the lookahead plus the largest request
+
+	Handler* inner;
+	Buffer buffer;
+	bool opl3mode = false;
+
+	std::thread thread;
+	std::mutex lock;
+	std::condition_variable wake, done;
+	std::deque<RegWrite> writes;
+	uint64_t requested = 0;		//samples the mixer asked for so far
+	uint64_t rendered = 0;		//samples the thread has finished
+	uint64_t needed = 0;		//the mixer is waiting for the thread to get here
+	uint64_t batch = 0, lookahead = 0;
+	unsigned long stalls = 0;
+	bool busy = false;			//the thread is using the handler
+	bool syncing = false;
+	bool quit = false;
+
+	bool HasWork() const {
+		return quit || requested - rendered >= batch || needed > rendered ||
+			( syncing && ( rendered < requested || !writes.empty() ) );
+	}
+
+	void Run() {
+		std::vector<RegWrite> due;
+		std::unique_lock<std::mutex> guard( lock );
+		for (;;) {
+			wake.wait( guard, [this] { return HasWork(); } );
+			if ( quit ) break;
+
+			const uint64_t to = requested;
+			for (;;) {
+				while ( !writes.empty() && writes.front().when <= rendered ) {
+					due.push_back( writes.front() );
+					writes.pop_front();
+				}
+				uint64_t until = to;
+				if ( !writes.empty() && writes.front().when < until )
+					until = writes.front().when;
+				if ( due.empty() && until <= rendered )
+					break;
+
+				busy = true;
+				guard.unlock();
+				for ( const RegWrite &w : due )
+					inner->WriteReg( w.reg, w.val );
+				due.clear();
+				while ( buffer.pos < until ) {
+					//handlers may generate less than asked for
+					const uint64_t before = buffer.pos;
+					inner->Generate( &buffer, (Bitu)( until - buffer.pos ) );
+					if ( buffer.pos == before ) break;
+				}
+				buffer.pos = until;
+				guard.lock();
+				busy = false;
+
+				rendered = until;
+				done.notify_all();
+			}
+		}
+	}
+
+	//Wait for the thread to catch up with every queued write, after which it
+	//leaves the handler alone until the next Generate
+	void Sync() {
+		std::unique_lock<std::mutex> guard( lock );
+		syncing = true;
+		wake.notify_one();
+		done.wait( guard, [this] { return rendered == requested && writes.empty() && !busy; } );
+		syncing = false;
+	}
+
+public:
+	ThreadedHandler( Handler* _inner ) : inner( _inner ) {
+		buffer.frames.resize( BufferFrames * 2u, 0 );
+	}
+
+	uint32_t WriteAddr( uint32_t port, uint8_t val ) override {
+		uint32_t addr;
+		if ( inner->WriteAddrFromMode( port, val, opl3mode, addr ) )
+			return addr;
+		Sync();
+		return inner->WriteAddr( port, val );
+	}
+
+	void WriteReg( uint32_t reg, uint8_t val ) override {
+		if ( reg == 0x105 )
+			opl3mode = ( val & 1 ) != 0;
+		std::lock_guard<std::mutex> guard( lock );
+		writes.push_back( { requested, reg, val } );
+	}
+
+	uint8_t ReadbackReg( uint32_t reg ) override {
+		Sync();
+		return inner->ReadbackReg( reg );
+	}
+
+	void ESFMSetEmulationMode() override {
+		Sync();
+		inner->ESFMSetEmulationMode();
+	}
+
+	void Generate( Output* chan, Bitu samples ) override {
+		int32_t out[512 * 2];
+		while ( samples > 0 ) {
+			const Bitu todo = samples > 512 ? 512 : samples;
+			samples -= todo;
+
+			//hand out [from, to) of what was rendered lookahead samples ago
+			std::unique_lock<std::mutex> guard( lock );
+			const uint64_t from = requested > lookahead ? requested - lookahead : 0;
+			requested += todo;
+			const uint64_t to = requested > lookahead ? requested - lookahead : 0;
+			if ( rendered < to ) {
+				needed = to;
+				stalls++;
+				wake.notify_one();
+				done.wait( guard, [this,to] { return rendered >= to; } );
+				needed = 0;
+			}
+			else if ( requested - rendered >= batch ) {
+				wake.notify_one();
+			}
+			guard.unlock();
+
+			const Bitu silence = todo - (Bitu)( to - from );
+			memset( out, 0, sizeof(int32_t) * 2u * silence );
+			for ( uint64_t p = from;p < to;p++ ) {
+				const size_t i = (size_t)( p & ( BufferFrames - 1u ) ) * 2u;
+				out[( silence + ( p - from ) ) * 2u] = buffer.frames[i];
+				out[( silence + ( p - from ) ) * 2u + 1u] = buffer.frames[i+1u];
+			}
+			chan->AddSamples_s32( todo, out );
+		}
+	}
+
+	void Init( Bitu rate ) override {
+		inner->Init( rate );
+		//render in 5ms batches, 10ms ahead of the mixer
+		batch = std::max<uint64_t>( rate / 200u, 1u );
+		lookahead = batch * 2u;
+		thread = std::thread( &ThreadedHandler::Run, this );
+	}
+
+	void SaveState( std::ostream& stream ) override {
+		Sync();
+		inner->SaveState( stream );
+	}
+
+	void LoadState( std::istream& stream ) override {
+		Sync();
+		inner->LoadState( stream );
+	}
+
+	void CacheRestored( const uint8_t* cache ) override {
+		opl3mode = ( cache[0x105] & 1 ) != 0;
+		inner->CacheRestored( cache );
+	}
+
+	~ThreadedHandler() {
+		if ( thread.joinable() ) {
+			{
+				std::lock_guard<std::mutex> guard( lock );
+				quit = true;
+			}
+			wake.notify_one();
+			thread.join();
+		}
+		LOG(LOG_MISC,LOG_DEBUG)("OPL synthesis thread: %lu stalls",stalls);
+		delete inner;
+	}
+};
+
 static std::string usedoplemu = "none";
 
 Module::Module( Section* configuration ) : Module_base(configuration) {
@@ -1631,6 +1880,7 @@ Module::Module( Section* configuration ) : Module_base(configuration) {
 		LOG_MSG("Adlib: WARN: an ESFM-capable oplemu was chosen, but the chosen sbtype (or oplmode) is not ESFM-capable. ESFM native mode features will not work!");
 	}
 
+	bool software = true;
 	if (oplemu == "compat") {
 		if (oplmode == OPL_opl2) {
 			handler = new OPL2::Handler();
@@ -1646,14 +1896,17 @@ Module::Module( Section* configuration ) : Module_base(configuration) {
         handler = new NukedCQM::Handler();
     }
 	else if (oplemu == "opl2board") {
+		software = false;
 		oplmode = OPL_opl2;
 		handler = new OPL2BOARD::Handler(oplport.c_str());
 	}
 	else if (oplemu == "opl3duoboard") {
+		software = false;
 		oplmode = OPL_opl3;
 		handler = new OPL3DUOBOARD::Handler(oplport.c_str());
 	}
 	else if (oplemu == "retrowave_opl3") {
+		software = false;
 		handler = new Retrowave_OPL3::Handler(retrowave_bus, retrowave_port, retrowave_spi_cs);
 	}
 	else if (oplemu == "mame") {
@@ -1675,7 +1928,11 @@ Module::Module( Section* configuration ) : Module_base(configuration) {
 		handler = new DBOPL::Handler( opl3Mode );
 	}
 
+	if (section->Get_bool("oplthread") && software)
+		handler = new ThreadedHandler( handler );
+
 	mixerChan = mixerObject.Install(OPL_CallBack,rate,"FM");
+	mixerOutput.chan = mixerChan;
 	//Used to be 2.0, which was measured to be too high. Exact value depends on card/clone.
 	mixerChan->SetScale( 1.5f );
 
@@ -1824,6 +2081,8 @@ void Adlib::Module::LoadState( std::istream& stream )
 
 	READ_POD( &cache, cache );
 	READ_POD( &chip, chip );
+
+	handler->CacheRestored(cache);
 }
 
 void POD_Save_Adlib(std::ostream& stream)
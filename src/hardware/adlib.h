@@ -145,10 +145,38 @@ typedef enum {
 	MODE_ESFM
 } Mode;
 
+//Where a handler sends the samples it generates: the mixer channel, or the buffer
+//of the synthesis thread
+class Output {
+public:
+	virtual void AddSamples_m16( Bitu len, const int16_t* data ) = 0;
+	virtual void AddSamples_s16( Bitu len, const int16_t* data ) = 0;
+	virtual void AddSamples_m32( Bitu len, const int32_t* data ) = 0;
+	virtual void AddSamples_s32( Bitu len, const int32_t* data ) = 0;
+	virtual ~Output() {
+	}
+};
+
+class ChannelOutput : public Output {
+public:
+	MixerChannel* chan = NULL;
+	void AddSamples_m16( Bitu len, const int16_t* data ) override { chan->AddSamples_m16( len, data ); }
+	void AddSamples_s16( Bitu len, const int16_t* data ) override { chan->AddSamples_s16( len, data ); }
+	void AddSamples_m32( Bitu len, const int32_t* data ) override { chan->AddSamples_m32( len, data ); }
+	void AddSamples_s32( Bitu len, const int32_t* data ) override { chan->AddSamples_s32( len, data ); }
+};
+
 class Handler {
 public:
 	//Write an address to a chip, returns the address the chip sets
 	virtual uint32_t WriteAddr( uint32_t port, uint8_t val ) = 0;
+	//Same as WriteAddr, but from the OPL3 mode bit last written to register 0x105 instead of the
+	//chip, so it can be answered while the synthesis thread owns the chip. Returns false if the
+	//handler needs the chip for that.
+	virtual bool WriteAddrFromMode( uint32_t port, uint8_t val, bool opl3mode, uint32_t &addr ) {
+		(void)port; (void)val; (void)opl3mode; (void)addr;
+		return false;
+	}
 	//Write to a specific register in the chip
 	virtual void WriteReg( uint32_t addr, uint8_t val ) = 0;
 	//Read back a specific register in the chip (ESFM-specific)
@@ -156,11 +184,13 @@ public:
 	//Sets the card back to emulation mode if it was in native mode (ESFM-specific)
 	virtual void ESFMSetEmulationMode() {};
 	//Generate a certain amount of samples
-	virtual void Generate( MixerChannel* chan, Bitu samples ) = 0;
+	virtual void Generate( Output* chan, Bitu samples ) = 0;
 	//Initialize at a specific sample rate and mode
 	virtual void Init( Bitu rate ) = 0;
 	virtual void SaveState( std::ostream& stream ) { (void)stream; }
 	virtual void LoadState( std::istream& stream ) { (void)stream; }
+	//The register cache was restored by a LoadState, for state the handler derives from it
+	virtual void CacheRestored( const uint8_t* cache ) { (void)cache; }
 
 	virtual ~Handler() {
 	}
@@ -198,6 +228,7 @@ class Module: public Module_base {
 public:
 	static OPL_Mode oplmode;
 	MixerChannel* mixerChan = NULL;
+	ChannelOutput mixerOutput;
 	uint32_t lastUsed = 0;				//Ticks when adlib was last used to turn of mixing after a few second
 	bool esfm_nativemode = false;			// When using MODE_ESFM, whether the synth is in native mode or not - affects port mapping
 
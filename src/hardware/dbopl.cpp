@@ -1510,11 +1510,26 @@ uint32_t Handler::WriteAddr( uint32_t port, uint8_t val ) {
 	return chip.WriteAddr( port, val );
 
 }
+bool Handler::WriteAddrFromMode( uint32_t port, uint8_t val, bool opl3mode, uint32_t &addr ) {
+	//Same as Chip::WriteAddr, opl3Active follows register 0x105
+	switch ( port & 3 ) {
+	case 0:
+		addr = val;
+		break;
+	case 2:
+		addr = ( opl3mode || (val == 0x05u) ) ? ( 0x100u | val ) : val;
+		break;
+	default:
+		addr = 0u;
+		break;
+	}
+	return true;
+}
 void Handler::WriteReg( uint32_t addr, uint8_t val ) {
 	chip.WriteReg( addr, val );
 }
 
-void Handler::Generate( MixerChannel* chan, Bitu samples ) {
+void Handler::Generate( Adlib::Output* chan, Bitu samples ) {
 	int32_t buffer[ 512 * 2 ];
 	if ( GCC_UNLIKELY(samples > 512) )
 		samples = 512;
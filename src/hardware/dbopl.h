@@ -251,8 +251,9 @@ struct Chip {
 struct Handler : public Adlib::Handler {
 	DBOPL::Chip chip;
 	uint32_t WriteAddr( uint32_t port, uint8_t val ) override;
+	bool WriteAddrFromMode( uint32_t port, uint8_t val, bool opl3mode, uint32_t &addr ) override;
 	void WriteReg( uint32_t addr, uint8_t val ) override;
-	void Generate( MixerChannel* chan, Bitu samples ) override;
+	void Generate( Adlib::Output* chan, Bitu samples ) override;
 	void Init( Bitu rate ) override;
 	void SaveState( std::ostream& stream ) override;
 	void LoadState( std::istream& stream ) override;
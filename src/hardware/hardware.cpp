@@ -21,6 +21,11 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <limits.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include "bitmapinfoheader.h"
@@ -654,6 +659,10 @@ void ttf_switch_on(bool ss=true), ttf_switch_off(bool ss=true);
 #endif
 
 #if (C_SSHOT)
+static bool CAPTURE_VideoDrain(void);
+static void CAPTURE_VideoThreadStop(void);
+static void CAPTURE_VideoQueueReport(void);
+
 void CAPTURE_VideoEvent(bool pressed) {
 	if (!pressed)
 		return;
@@ -661,6 +670,8 @@ void CAPTURE_VideoEvent(bool pressed) {
 		/* Close the video */
 		CaptureState &= ~((unsigned int)CAPTURE_VIDEO);
 		LOG_MSG("Stopped capturing video.");	
+		CAPTURE_VideoDrain();
+		CAPTURE_VideoQueueReport();
 
 #if defined(USE_TTF)
 		if (!(CaptureState & CAPTURE_IMAGE) && !(CaptureState & CAPTURE_VIDEO))
@@ -806,6 +817,388 @@ static inline unsigned long math_gcd_png_uint_32(const png_uint_32 a,const png_u
 }
 #endif
 
+#if (C_SSHOT)
+/* Video capture encodes on its own thread. CAPTURE_AddImage() only copies the
+ * frame and the audio recorded since the previous one into a job, the thread
+ * runs the ZMBV or FFMPEG encoder on it and writes the file. Whatever opens,
+ * closes or reconfigures the encoder waits for the queue to drain first. With
+ * "capture queue frames" set to 0 the jobs are encoded right away instead. */
+struct CaptureVideoJob {
+	Bitu		width, height, bpp, flags;	// width and height are after doubling
+	Bitu		pitch;
+	zmbv_format_t	format;
+	bool		has_pixels;			// false: dropped or unchanged, repeat the previous frame
+	std::vector<uint8_t>	pixels;			// the rows before doubling
+	uint8_t		pal[256*4];
+	uint32_t	pal32[256];
+	std::vector<int16_t>	audio;			// stereo samples
+};
+
+struct CaptureVideoQueue {
+	std::mutex			lock;
+	std::condition_variable		wake;		// a job was queued, or quit
+	std::condition_variable		done;		// a job was encoded
+	std::deque<CaptureVideoJob*>	jobs;
+	std::vector<CaptureVideoJob*>	spare;
+	unsigned int			frames = 0;	// jobs with pixels, queued or being encoded
+	bool				busy = false;
+	bool				failed = false;
+	bool				quit = false;
+	std::thread			thread;
+};
+
+/* allocated on first use and only deleted by CAPTURE_VideoThreadStop(), the
+ * exit time destructors must not run while the thread waits on it */
+static CaptureVideoQueue *capture_queue = NULL;
+static CaptureVideoJob capture_sync_job;
+static unsigned int capture_queue_frames = 8;
+static bool capture_queue_drop = false;
+static int capture_zmbv_threads = 0;		// helpers of the ZMBV encoder, besides the capture thread
+
+static struct {
+	uint32_t	queued;		// frames given to the encoder thread
+	uint32_t	dropped;	// frames recorded as a repeat because the queue was full
+	uint32_t	peak;		// most frames waiting at once
+} capture_queue_stats = {};
+
+static bool CAPTURE_EncodeVideo(CaptureVideoJob &job) {
+	const Bitu width = job.width, height = job.height, bpp = job.bpp, flags = job.flags, pitch = job.pitch;
+	const Bitu countWidth = (flags & CAPTURE_FLAG_DBLW) ? (width >> 1) : width;
+	uint8_t * const data = job.pixels.data();
+	Bitu i;
+
+	if (native_zmbv) {
+		int codecFlags;
+
+		if (capture.video.frames % 300 == 0)
+			codecFlags = 1;
+		else
+			codecFlags = 0;
+
+		if (!job.has_pixels) {
+			/* advance unless at keyframe */
+			if (codecFlags == 0) capture.video.frames++;
+
+			/* write null non-keyframe */
+			CAPTURE_AddAviChunk( "00dc", (uint32_t)0, capture.video.buf, (uint32_t)(0x0), 0u);
+		}
+		else {
+			std::vector<uint8_t> doubleRowBuf((width + 32) * 4);
+			uint8_t *doubleRow = doubleRowBuf.data();
+
+			if (!capture.video.codec->PrepareCompressFrame( codecFlags, job.format, (char *)job.pal, capture.video.buf, capture.video.bufSize))
+				return false;
+
+			for (i=0;i<height;i++) {
+				void * rowPointer;
+				void *srcLine;
+				Bitu x;
+				if (flags & CAPTURE_FLAG_DBLH)
+					srcLine=(data+(i >> 1)*pitch);
+				else
+					srcLine=(data+(i >> 0)*pitch);
+				if (flags & CAPTURE_FLAG_DBLW) {
+					switch ( bpp) {
+						case 8:
+							for (x=0;x<countWidth;x++)
+								((uint8_t *)doubleRow)[x*2+0] =
+									((uint8_t *)doubleRow)[x*2+1] = ((uint8_t *)srcLine)[x];
+							break;
+						case 15:
+						case 16:
+							for (x=0;x<countWidth;x++)
+								((uint16_t *)doubleRow)[x*2+0] =
+									((uint16_t *)doubleRow)[x*2+1] = ((uint16_t *)srcLine)[x];
+							break;
+						case 32:
+							for (x=0;x<countWidth;x++)
+								((uint32_t *)doubleRow)[x*2+0] =
+									((uint32_t *)doubleRow)[x*2+1] = ((uint32_t *)srcLine)[x];
+							break;
+					}
+					rowPointer=doubleRow;
+				} else {
+					rowPointer=srcLine;
+				}
+				capture.video.codec->CompressLines( 1, &rowPointer );
+			}
+
+			int written = capture.video.codec->FinishCompressFrame();
+			if (written < 0)
+				return false;
+
+			CAPTURE_AddAviChunk( "00dc", (uint32_t)written, capture.video.buf, (uint32_t)(codecFlags & 1 ? 0x10 : 0x0), 0u);
+			capture.video.frames++;
+		}
+
+		if (!job.audio.empty())
+			CAPTURE_AddAviChunk( "01wb", (uint32_t)(job.audio.size() * 2u), job.audio.data(), /*keyframe*/0x10u, 1u);
+	}
+#if (C_AVCODEC)
+	else if (export_ffmpeg && ffmpeg_fmt_ctx != NULL) {
+		/* a frame that was not queued leaves a gap in the timestamps, the player holds the previous one */
+		if (job.has_pixels) {
+			signed long long saved_dts;
+			AVPacket* pkt = av_packet_alloc();
+			unsigned char *srcline,*dstline;
+			Bitu x;
+			int r;
+
+			if (!pkt) E_Exit("Error: Unable to alloc packet");
+
+			// copy from source to vidrgb frame
+			if (bpp == 8 && ffmpeg_vidrgb_frame->format != AV_PIX_FMT_PAL8) {
+				for (i=0;i<height;i++) {
+					dstline = ffmpeg_vidrgb_frame->data[0] + ((unsigned int)i * (unsigned int)ffmpeg_vidrgb_frame->linesize[0]);
+
+					if (flags & CAPTURE_FLAG_DBLH)
+						srcline=(data+(i >> 1)*pitch);
+					else
+						srcline=(data+(i >> 0)*pitch);
+
+					if (flags & CAPTURE_FLAG_DBLW) {
+						for (x=0;x < countWidth;x++)
+							((uint32_t *)dstline)[(x*2)+0] =
+								((uint32_t *)dstline)[(x*2)+1] = job.pal32[srcline[x]];
+					}
+					else {
+						for (x=0;x < width;x++)
+							((uint32_t *)dstline)[x] = job.pal32[srcline[x]];
+					}
+				}
+			}
+			else {
+				for (i=0;i<height;i++) {
+					dstline = ffmpeg_vidrgb_frame->data[0] + ((unsigned int)i * (unsigned int)ffmpeg_vidrgb_frame->linesize[0]);
+
+					if (flags & CAPTURE_FLAG_DBLH)
+						srcline=(data+(i >> 1)*pitch);
+					else
+						srcline=(data+(i >> 0)*pitch);
+
+					if (flags & CAPTURE_FLAG_DBLW) {
+						switch (bpp) {
+							case 8:
+								for (x=0;x<countWidth;x++)
+									((uint8_t *)dstline)[x*2+0] =
+										((uint8_t *)dstline)[x*2+1] = ((uint8_t *)srcline)[x];
+								break;
+							case 15:
+							case 16:
+								for (x=0;x<countWidth;x++)
+									((uint16_t *)dstline)[x*2+0] =
+										((uint16_t *)dstline)[x*2+1] = ((uint16_t *)srcline)[x];
+								break;
+							case 32:
+								for (x=0;x<countWidth;x++)
+									((uint32_t *)dstline)[x*2+0] =
+										((uint32_t *)dstline)[x*2+1] = ((uint32_t *)srcline)[x];
+								break;
+						}
+					} else {
+						memcpy(dstline,srcline,width*((bpp+7)/8));
+					}
+				}
+			}
+
+			// convert colorspace
+			if (sws_scale(ffmpeg_sws_ctx,
+				// source
+				ffmpeg_vidrgb_frame->data,
+				ffmpeg_vidrgb_frame->linesize,
+				0,ffmpeg_vidrgb_frame->height,
+				// dest
+				ffmpeg_vid_frame->data,
+				ffmpeg_vid_frame->linesize) <= 0)
+				LOG_MSG("WARNING: sws_scale() failed");
+
+			// encode it
+			ffmpeg_vid_frame->pts = (int64_t)capture.video.frames; // or else libx264 complains about non-monotonic timestamps
+			av_opt_set_int(ffmpeg_vid_ctx->priv_data, "g", 15, 0); // GOP size 15
+
+			r=avcodec_send_frame(ffmpeg_vid_ctx,ffmpeg_vid_frame);
+			if (r < 0 && r != AVERROR(EAGAIN))
+				LOG_MSG("WARNING: avcodec_send_frame() video failed to encode (err=%d)",r);
+
+			while ((r=avcodec_receive_packet(ffmpeg_vid_ctx,pkt)) >= 0) {
+				saved_dts = pkt->dts;
+				pkt->stream_index = ffmpeg_vid_stream->index;
+				av_packet_rescale_ts(pkt,ffmpeg_vid_ctx->time_base,ffmpeg_vid_stream->time_base);
+				pkt->pts += (int64_t)ffmpeg_video_frame_time_offset;
+				pkt->dts += (int64_t)ffmpeg_video_frame_time_offset;
+
+				if (av_interleaved_write_frame(ffmpeg_fmt_ctx,pkt) < 0)
+					LOG_MSG("WARNING: av_interleaved_write_frame failed");
+
+				pkt->pts = (int64_t)saved_dts + (int64_t)1;
+				pkt->dts = (int64_t)saved_dts + (int64_t)1;
+				av_packet_rescale_ts(pkt,ffmpeg_vid_ctx->time_base,ffmpeg_vid_stream->time_base);
+				ffmpeg_video_frame_last_time = (uint64_t)pkt->pts;
+			}
+
+			if (r != AVERROR(EAGAIN))
+				LOG_MSG("WARNING: avcodec_receive_packet() video failed to encode (err=%d)",r);
+
+			av_packet_free(&pkt);
+		}
+		capture.video.frames++;
+
+		if (!job.audio.empty())
+			ffmpeg_take_audio(job.audio.data(),(unsigned int)(job.audio.size() / 2u));
+	}
+#endif
+
+	return true;
+}
+
+static void CAPTURE_VideoThread(CaptureVideoQueue *q) {
+	std::unique_lock<std::mutex> lk(q->lock);
+
+	for (;;) {
+		q->wake.wait(lk,[q] { return q->quit || !q->jobs.empty(); });
+		if (q->jobs.empty()) break;
+
+		CaptureVideoJob *job = q->jobs.front();
+		q->jobs.pop_front();
+		q->busy = true;
+
+		/* after a failure the jobs are only thrown away until CAPTURE_AddImage() notices */
+		const bool skip = q->failed;
+		lk.unlock();
+		const bool ok = skip || CAPTURE_EncodeVideo(*job);
+		lk.lock();
+
+		if (!ok) q->failed = true;
+		if (job->has_pixels) q->frames--;
+		q->spare.push_back(job);
+		q->busy = false;
+		q->done.notify_all();
+	}
+}
+
+/* waits for the encoder to finish every queued frame, false if it failed on one */
+static bool CAPTURE_VideoDrain(void) {
+	if (capture_queue == NULL) return true;
+
+	std::unique_lock<std::mutex> lk(capture_queue->lock);
+	capture_queue->done.wait(lk,[] { return capture_queue->jobs.empty() && !capture_queue->busy; });
+
+	const bool ok = !capture_queue->failed;
+	capture_queue->failed = false;
+	return ok;
+}
+
+static void CAPTURE_VideoThreadStop(void) {
+	if (capture_queue == NULL) return;
+
+	{
+		std::lock_guard<std::mutex> lk(capture_queue->lock);
+		capture_queue->quit = true;
+		capture_queue->wake.notify_all();
+	}
+	capture_queue->thread.join();
+
+	for (auto *job : capture_queue->spare) delete job;
+	for (auto *job : capture_queue->jobs) delete job;
+	delete capture_queue;
+	capture_queue = NULL;
+}
+
+/* a free job, after waiting for the encoder if the queue is full and the policy is to block */
+static CaptureVideoJob *CAPTURE_VideoGetJob(bool pixels,bool &failed) {
+	if (capture_queue == NULL) {
+		capture_queue = new CaptureVideoQueue;
+		capture_queue->thread = std::thread(CAPTURE_VideoThread,capture_queue);
+	}
+
+	std::unique_lock<std::mutex> lk(capture_queue->lock);
+	if (pixels && capture_queue->frames >= capture_queue_frames) {
+		if (capture_queue_drop) {
+			capture_queue_stats.dropped++;
+			pixels = false;
+		}
+		else {
+			capture_queue->done.wait(lk,[] { return capture_queue->frames < capture_queue_frames; });
+		}
+	}
+
+	failed = capture_queue->failed;
+
+	CaptureVideoJob *job;
+	if (!capture_queue->spare.empty()) {
+		job = capture_queue->spare.back();
+		capture_queue->spare.pop_back();
+	}
+	else {
+		job = new CaptureVideoJob;
+	}
+
+	job->has_pixels = pixels;
+	if (pixels) {
+		capture_queue->frames++;
+		capture_queue_stats.queued++;
+		if (capture_queue_stats.peak < capture_queue->frames) capture_queue_stats.peak = capture_queue->frames;
+	}
+	return job;
+}
+
+static void CAPTURE_VideoPutJob(CaptureVideoJob *job) {
+	std::lock_guard<std::mutex> lk(capture_queue->lock);
+	capture_queue->jobs.push_back(job);
+	capture_queue->wake.notify_one();
+}
+
+/* copies a frame and the audio that came with it for the encoder, false if the encoder failed */
+static bool CAPTURE_VideoFrame(Bitu width, Bitu height, Bitu bpp, Bitu pitch, Bitu flags, zmbv_format_t format, const uint8_t *data, const uint8_t *pal) {
+	const bool pixels = !(native_zmbv && (flags & CAPTURE_FLAG_NOCHANGE) && skip_encoding_unchanged_frames);
+	bool failed = false;
+	CaptureVideoJob *job;
+
+	if (capture_queue_frames == 0) {
+		job = &capture_sync_job;
+		job->has_pixels = pixels;
+	}
+	else {
+		job = CAPTURE_VideoGetJob(pixels,failed);
+	}
+
+	job->width = width;
+	job->height = height;
+	job->bpp = bpp;
+	job->flags = flags;
+	job->format = format;
+	if (job->has_pixels) {
+		const Bitu rows = (flags & CAPTURE_FLAG_DBLH) ? (height >> 1) : height;
+		const Bitu rowlen = ((flags & CAPTURE_FLAG_DBLW) ? (width >> 1) : width) * ((bpp + 7) / 8);
+
+		job->pitch = rowlen;
+		job->pixels.resize(rows * rowlen);
+		for (Bitu i=0;i < rows;i++)
+			memcpy(job->pixels.data() + i * rowlen,data + i * pitch,rowlen);
+
+		if (bpp == 8) {
+			if (pal != NULL) memcpy(job->pal,pal,sizeof(job->pal));
+			memcpy(job->pal32,GFX_palette32bpp,sizeof(job->pal32));
+		}
+	}
+	const int16_t *audio = (const int16_t *)capture.video.audiobuf;
+	job->audio.assign(audio,audio + capture.video.audioused * 2u);
+
+	if (capture_queue_frames == 0)
+		return CAPTURE_EncodeVideo(*job);
+
+	CAPTURE_VideoPutJob(job);
+	return !failed;
+}
+
+static void CAPTURE_VideoQueueReport(void) {
+	if (capture_queue_frames != 0 && capture_queue_stats.queued != 0)
+		LOG_MSG("Video capture: %u frames encoded on the capture thread, %u dropped, at most %u waiting",
+			(unsigned int)capture_queue_stats.queued,(unsigned int)capture_queue_stats.dropped,(unsigned int)capture_queue_stats.peak);
+	capture_queue_stats.queued = capture_queue_stats.dropped = capture_queue_stats.peak = 0;
+}
+#endif
+
 void CAPTURE_AddImage(Bitu width, Bitu height, Bitu bpp, Bitu pitch, Bitu flags, float fps, uint8_t * data, uint8_t * pal) {
 #if (C_SSHOT)
 	Bitu i;
@@ -1003,6 +1396,8 @@ skip_shot:
 				CAPTURE_VideoEvent(true);
 #if (C_AVCODEC)
 			else if (export_ffmpeg && ffmpeg_fmt_ctx != NULL) {
+				if (!CAPTURE_VideoDrain())
+					goto skip_video;
 				ffmpeg_flush_video();
 				ffmpeg_video_frame_time_offset += ffmpeg_video_frame_last_time;
 				ffmpeg_video_frame_last_time = 0;
@@ -1049,7 +1444,7 @@ skip_shot:
 			capture.video.codec = new VideoCodec();
 			if (!capture.video.codec)
 				goto skip_video;
-			if (!capture.video.codec->SetupCompress( (int)width, (int)height)) 
+			if (!capture.video.codec->SetupCompress( (int)width, (int)height, capture_zmbv_threads)) 
 				goto skip_video;
 			capture.video.bufSize = capture.video.codec->NeededSize((int)width, (int)height, format);
 			capture.video.buf = malloc( (size_t)capture.video.bufSize );
@@ -1403,200 +1798,15 @@ skip_shot:
 		}
 #endif
 
-		if (native_zmbv) {
-			int codecFlags;
-
-			if (capture.video.frames % 300 == 0)
-				codecFlags = 1;
-			else
-				codecFlags = 0;
-
-            if ((flags & CAPTURE_FLAG_NOCHANGE) && skip_encoding_unchanged_frames) {
-                /* advance unless at keyframe */
-                if (codecFlags == 0) capture.video.frames++;
-
-                /* write null non-keyframe */
-                CAPTURE_AddAviChunk( "00dc", (uint32_t)0, capture.video.buf, (uint32_t)(0x0), 0u);
-            }
-            else {
-                if (!capture.video.codec->PrepareCompressFrame( codecFlags, format, (char *)pal, capture.video.buf, capture.video.bufSize))
-                    goto skip_video;
-
-                for (i=0;i<height;i++) {
-                    void * rowPointer;
-                    if (flags & CAPTURE_FLAG_DBLW) {
-                        void *srcLine;
-                        Bitu x;
-                        Bitu countWidth = width >> 1;
-                        if (flags & CAPTURE_FLAG_DBLH)
-                            srcLine=(data+(i >> 1)*pitch);
-                        else
-                            srcLine=(data+(i >> 0)*pitch);
-                        switch ( bpp) {
-                            case 8:
-                                for (x=0;x<countWidth;x++)
-                                    ((uint8_t *)doubleRow)[x*2+0] =
-                                        ((uint8_t *)doubleRow)[x*2+1] = ((uint8_t *)srcLine)[x];
-                                break;
-                            case 15:
-                            case 16:
-                                for (x=0;x<countWidth;x++)
-                                    ((uint16_t *)doubleRow)[x*2+0] =
-                                        ((uint16_t *)doubleRow)[x*2+1] = ((uint16_t *)srcLine)[x];
-                                break;
-                            case 32:
-                                for (x=0;x<countWidth;x++)
-                                    ((uint32_t *)doubleRow)[x*2+0] =
-                                        ((uint32_t *)doubleRow)[x*2+1] = ((uint32_t *)srcLine)[x];
-                                break;
-                        }
-                        rowPointer=doubleRow;
-                    } else {
-                        if (flags & CAPTURE_FLAG_DBLH)
-                            rowPointer=(data+(i >> 1)*pitch);
-                        else
-                            rowPointer=(data+(i >> 0)*pitch);
-                    }
-                    capture.video.codec->CompressLines( 1, &rowPointer );
-                }
-
-                int written = capture.video.codec->FinishCompressFrame();
-                if (written < 0)
-                    goto skip_video;
-
-                CAPTURE_AddAviChunk( "00dc", (uint32_t)written, capture.video.buf, (uint32_t)(codecFlags & 1 ? 0x10 : 0x0), 0u);
-                capture.video.frames++;
-            }
-
-			if ( capture.video.audioused ) {
-				CAPTURE_AddAviChunk( "01wb", (uint32_t)(capture.video.audioused * 4u), capture.video.audiobuf, /*keyframe*/0x10u, 1u);
-				capture.video.audiowritten = capture.video.audioused*4;
-				capture.video.audioused = 0;
-			}
-		}
+		bool encode = native_zmbv;
 #if (C_AVCODEC)
-		else if (export_ffmpeg && ffmpeg_fmt_ctx != NULL) {
-			signed long long saved_dts;
-			AVPacket* pkt = av_packet_alloc();
-			int r;
-
-			if (!pkt) E_Exit("Error: Unable to alloc packet");
-			{
-				unsigned char *srcline,*dstline;
-				Bitu x;
-
-				// copy from source to vidrgb frame
-				if (bpp == 8 && ffmpeg_vidrgb_frame->format != AV_PIX_FMT_PAL8) {
-					for (i=0;i<height;i++) {
-						dstline = ffmpeg_vidrgb_frame->data[0] + ((unsigned int)i * (unsigned int)ffmpeg_vidrgb_frame->linesize[0]);
-
-						if (flags & CAPTURE_FLAG_DBLH)
-							srcline=(data+(i >> 1)*pitch);
-						else
-							srcline=(data+(i >> 0)*pitch);
-
-						if (flags & CAPTURE_FLAG_DBLW) {
-							for (x=0;x < width;x++)
-								((uint32_t *)dstline)[(x*2)+0] =
-									((uint32_t *)dstline)[(x*2)+1] = GFX_palette32bpp[srcline[x]];
-						}
-						else {
-							for (x=0;x < width;x++)
-								((uint32_t *)dstline)[x] = GFX_palette32bpp[srcline[x]];
-						}
-					}
-				}
-				else {
-					for (i=0;i<height;i++) {
-						dstline = ffmpeg_vidrgb_frame->data[0] + ((unsigned int)i * (unsigned int)ffmpeg_vidrgb_frame->linesize[0]);
-
-						if (flags & CAPTURE_FLAG_DBLW) {
-							if (flags & CAPTURE_FLAG_DBLH)
-								srcline=(data+(i >> 1)*pitch);
-							else
-								srcline=(data+(i >> 0)*pitch);
-
-							switch (bpp) {
-								case 8:
-									for (x=0;x<countWidth;x++)
-										((uint8_t *)dstline)[x*2+0] =
-											((uint8_t *)dstline)[x*2+1] = ((uint8_t *)srcline)[x];
-									break;
-								case 15:
-								case 16:
-									for (x=0;x<countWidth;x++)
-										((uint16_t *)dstline)[x*2+0] =
-											((uint16_t *)dstline)[x*2+1] = ((uint16_t *)srcline)[x];
-									break;
-								case 32:
-									for (x=0;x<countWidth;x++)
-										((uint32_t *)dstline)[x*2+0] =
-											((uint32_t *)dstline)[x*2+1] = ((uint32_t *)srcline)[x];
-									break;
-							}
-						} else {
-							if (flags & CAPTURE_FLAG_DBLH)
-								srcline=(data+(i >> 1)*pitch);
-							else
-								srcline=(data+(i >> 0)*pitch);
-
-							memcpy(dstline,srcline,width*((bpp+7)/8));
-						}
-					}
-				}
-
-				// convert colorspace
-				if (sws_scale(ffmpeg_sws_ctx,
-					// source
-					ffmpeg_vidrgb_frame->data,
-					ffmpeg_vidrgb_frame->linesize,
-					0,ffmpeg_vidrgb_frame->height,
-					// dest
-					ffmpeg_vid_frame->data,
-					ffmpeg_vid_frame->linesize) <= 0)
-					LOG_MSG("WARNING: sws_scale() failed");
-
-				// encode it
-				ffmpeg_vid_frame->pts = (int64_t)capture.video.frames; // or else libx264 complains about non-monotonic timestamps
-                av_opt_set_int(ffmpeg_vid_ctx->priv_data, "g", 15, 0); // GOP size 15
-
-				r=avcodec_send_frame(ffmpeg_vid_ctx,ffmpeg_vid_frame);
-				if (r < 0 && r != AVERROR(EAGAIN))
-					LOG_MSG("WARNING: avcodec_send_frame() video failed to encode (err=%d)",r);
-
-				while ((r=avcodec_receive_packet(ffmpeg_vid_ctx,pkt)) >= 0) {
-					saved_dts = pkt->dts;
-					pkt->stream_index = ffmpeg_vid_stream->index;
-					av_packet_rescale_ts(pkt,ffmpeg_vid_ctx->time_base,ffmpeg_vid_stream->time_base);
-					pkt->pts += (int64_t)ffmpeg_video_frame_time_offset;
-					pkt->dts += (int64_t)ffmpeg_video_frame_time_offset;
-
-					if (av_interleaved_write_frame(ffmpeg_fmt_ctx,pkt) < 0)
-						LOG_MSG("WARNING: av_interleaved_write_frame failed");
-
-					pkt->pts = (int64_t)saved_dts + (int64_t)1;
-					pkt->dts = (int64_t)saved_dts + (int64_t)1;
-					av_packet_rescale_ts(pkt,ffmpeg_vid_ctx->time_base,ffmpeg_vid_stream->time_base);
-					ffmpeg_video_frame_last_time = (uint64_t)pkt->pts;
-				}
-
-				if (r != AVERROR(EAGAIN))
-					LOG_MSG("WARNING: avcodec_receive_packet() video failed to encode (err=%d)",r);
-			}
-			av_packet_free(&pkt);
-			capture.video.frames++;
-
-			if ( capture.video.audioused ) {
-				ffmpeg_take_audio((int16_t*)capture.video.audiobuf/*NTS: Ewwwwww.... what if the compiler pads the 2-dimensional array?*/,capture.video.audioused);
-				capture.video.audiowritten = capture.video.audioused*4;
-				capture.video.audioused = 0;
-			}
-		}
+		if (export_ffmpeg && ffmpeg_fmt_ctx != NULL) encode = true;
 #endif
-		else {
-			capture.video.audiowritten = capture.video.audioused*4;
-			capture.video.audioused = 0;
-		}
+		if (encode && !CAPTURE_VideoFrame(width, height, bpp, pitch, flags, format, data, pal))
+			goto skip_video;
+
+		capture.video.audiowritten = capture.video.audioused*4;
+		capture.video.audioused = 0;
 
 		/* Everything went okay, set flag again for next frame */
 		CaptureState |= CAPTURE_VIDEO;
@@ -1610,6 +1820,7 @@ skip_shot:
 #endif
     return;
 skip_video:
+	CAPTURE_VideoDrain();
 	capture.video.writer = avi_writer_destroy(capture.video.writer);
 # if (C_AVCODEC)
 	ffmpeg_flushout();
@@ -2108,6 +2319,7 @@ void CAPTURE_Destroy(Section *sec) {
 	// if capture is active, fake mapper event to "toggle" it off for each capture case.
 #if (C_SSHOT)
 	if (capture.video.writer != NULL) CAPTURE_VideoEvent(true);
+	CAPTURE_VideoThreadStop();
 #endif
     if (capture.multitrack_wave.writer) CAPTURE_MTWaveEvent(true);
 	if (capture.wave.writer) CAPTURE_WaveEvent(true);
@@ -2264,6 +2476,18 @@ void CAPTURE_Init() {
 		export_ffmpeg = false;
 	}
 
+#if (C_SSHOT)
+	capture_queue_frames = (unsigned int)section->Get_int("capture queue frames");
+	capture_queue_drop = !strcmp(section->Get_string("capture queue full"),"drop");
+
+	/* the emulation and the capture thread are busy already */
+	std::string capthreads = section->Get_string("capture threads");
+	if (capthreads == "auto")
+		capture_zmbv_threads = std::min(std::max((int)std::thread::hardware_concurrency() - 2,0),4);
+	else
+		capture_zmbv_threads = std::min(std::max(atoi(capthreads.c_str()),0),16);
+#endif
+
 	CaptureState = 0; // make sure capture is off
 
 #if !defined(C_EMSCRIPTEN)
@@ -34,6 +34,7 @@
 #include "control.h"
 #include "callback.h"
 #include "bios_disk.h"
+#include "pci_bus.h"
 #include "../src/dos/cdrom.h"
 #include "bios.h"
 
@@ -118,6 +119,8 @@ static void ide_altio_w(Bitu port,Bitu val,Bitu iolen);
 static Bitu ide_altio_r(Bitu port,Bitu iolen);
 static void ide_baseio_w(Bitu port,Bitu val,Bitu iolen);
 static Bitu ide_baseio_r(Bitu port,Bitu iolen);
+static Bitu ide_baseio_block_w(Bitu port,const uint8_t *buf,Bitu iolen,Bitu count);
+static Bitu ide_baseio_block_r(Bitu port,uint8_t *buf,Bitu iolen,Bitu count);
 bool GetMSCDEXDrive(unsigned char drive_letter,CDROM_Interface **_cdrom);
 bool IDE_CDROM_Eject(int index,bool slave);
 
@@ -135,7 +138,8 @@ enum IDEDeviceState {
     IDE_DEV_DATA_READ,
     IDE_DEV_DATA_WRITE,
     IDE_DEV_ATAPI_PACKET_COMMAND,
-    IDE_DEV_ATAPI_BUSY
+    IDE_DEV_ATAPI_BUSY,
+    IDE_DEV_DMA_WAIT                /* READ/WRITE DMA waiting for the bus master to start */
 };
 
 enum {
@@ -218,6 +222,8 @@ public:
     virtual void writecommand(uint8_t cmd);
     virtual Bitu data_read(Bitu iolen); /* read from 1F0h data port from IDE device */
     virtual void data_write(Bitu v,Bitu iolen);/* write to 1F0h data port to IDE device */
+    virtual Bitu data_read_block(uint8_t *buf,Bitu iolen,Bitu count); /* REP INS from 1F0h, returns items read */
+    virtual Bitu data_write_block(const uint8_t *buf,Bitu iolen,Bitu count); /* REP OUTS to 1F0h, returns items written */
     virtual bool command_interruption_ok(uint8_t cmd);
     virtual void abort_silent();
 };
@@ -236,6 +242,8 @@ public:
     void update_from_biosdisk();
     virtual Bitu data_read(Bitu iolen) override; /* read from 1F0h data port from IDE device */
     virtual void data_write(Bitu v,Bitu iolen) override;/* write to 1F0h data port to IDE device */
+    virtual Bitu data_read_block(uint8_t *buf,Bitu iolen,Bitu count) override;
+    virtual Bitu data_write_block(const uint8_t *buf,Bitu iolen,Bitu count) override;
     virtual void generate_identify_device();
     virtual void prepare_read(Bitu offset,Bitu size);
     virtual void prepare_write(Bitu offset,Bitu size);
@@ -278,6 +286,8 @@ public:
     size_t cdrom_swaplist_pos = 0;
     Bitu data_read(Bitu iolen) override; /* read from 1F0h data port from IDE device */
     void data_write(Bitu v,Bitu iolen) override; /* write to 1F0h data port to IDE device */
+    Bitu data_read_block(uint8_t *buf,Bitu iolen,Bitu count) override;
+    Bitu data_write_block(const uint8_t *buf,Bitu iolen,Bitu count) override;
     virtual void swap_to_next_cd();
     virtual void drop_all_cds();
     virtual void generate_identify_device();
@@ -332,6 +342,7 @@ public:
     bool enable_pio32;      /* enable 32-bit PIO (if disabled, attempts at 32-bit PIO are handled as if two 16-bit I/O) */
     bool ignore_pio32;      /* if 32-bit PIO enabled, but ignored, writes do nothing, reads return 0xFFFFFFFF */
     bool register_pnp;
+    bool busmaster;         /* READ/WRITE DMA through the PCI bus master IDE function (primary and secondary only) */
     unsigned short alt_io;
     unsigned short base_io;
     unsigned char interface_index;
@@ -1944,6 +1955,32 @@ Bitu IDEATAPICDROMDevice::data_read(Bitu iolen) {
     return w;
 }
 
+/* whole items left in the sector buffer, the rest of a partial one goes the regular way */
+static Bitu IDE_BlockItems(uint64_t sector_i,uint64_t sector_total,Bitu iolen,Bitu count) {
+    if (sector_i >= sector_total)
+        return 0;
+
+    const uint64_t n = (sector_total - sector_i) / iolen;
+    return (n < (uint64_t)count) ? (Bitu)n : count;
+}
+
+Bitu IDEATAPICDROMDevice::data_read_block(uint8_t *buf,Bitu iolen,Bitu count) {
+    if (state != IDE_DEV_DATA_READ || !(status & IDE_STATUS_DRQ))
+        return 0;
+
+    const Bitu n = IDE_BlockItems(sector_i,sector_total,iolen,count);
+    if (n == 0)
+        return 0;
+
+    memcpy(buf,sector+sector_i,n*iolen);
+    sector_i += n*iolen;
+
+    if (sector_i >= sector_total)
+        io_completion();
+
+    return n;
+}
+
 static const uint16_t ReadCDTransferSectorSizeTable[5/*SectorType-1*/][0x20/*READ CD byte 9 >> 3*/] = {
         /* Sector type 0: Any
          * Sector type 1: CDDA */
@@ -2409,6 +2446,24 @@ void IDEATAPICDROMDevice::data_write(Bitu v,Bitu iolen) {
     }
 }
 
+/* the ATAPI command packet goes the regular way */
+Bitu IDEATAPICDROMDevice::data_write_block(const uint8_t *buf,Bitu iolen,Bitu count) {
+    if (state != IDE_DEV_DATA_WRITE || !(status & IDE_STATUS_DRQ))
+        return 0;
+
+    const Bitu n = IDE_BlockItems(sector_i,sector_total,iolen,count);
+    if (n == 0)
+        return 0;
+
+    memcpy(sector+sector_i,buf,n*iolen);
+    sector_i += n*iolen;
+
+    if (sector_i >= sector_total)
+        io_completion();
+
+    return n;
+}
+
 Bitu IDEATADevice::data_read(Bitu iolen) {
     Bitu w = ~0u;
 
@@ -2473,6 +2528,40 @@ void IDEATADevice::data_write(Bitu v,Bitu iolen) {
     if (sector_i >= sector_total)
         io_completion();
 }
+
+Bitu IDEATADevice::data_read_block(uint8_t *buf,Bitu iolen,Bitu count) {
+    if (state != IDE_DEV_DATA_READ || !(status & IDE_STATUS_DRQ))
+        return 0;
+
+    const Bitu n = IDE_BlockItems(sector_i,sector_total,iolen,count);
+    if (n == 0)
+        return 0;
+
+    memcpy(buf,sector+sector_i,n*iolen);
+    sector_i += n*iolen;
+
+    if (sector_i >= sector_total)
+        io_completion();
+
+    return n;
+}
+
+Bitu IDEATADevice::data_write_block(const uint8_t *buf,Bitu iolen,Bitu count) {
+    if (state != IDE_DEV_DATA_WRITE || !(status & IDE_STATUS_DRQ))
+        return 0;
+
+    const Bitu n = IDE_BlockItems(sector_i,sector_total,iolen,count);
+    if (n == 0)
+        return 0;
+
+    memcpy(sector+sector_i,buf,n*iolen);
+    sector_i += n*iolen;
+
+    if (sector_i >= sector_total)
+        io_completion();
+
+    return n;
+}
         
 void IDEATAPICDROMDevice::prepare_read(Bitu offset,Bitu size) {
     /* I/O must be WORD ALIGNED */
@@ -2673,11 +2762,12 @@ void IDEATADevice::generate_identify_device() {
         host_writew(sector+(47*2),0x80|multiple_sector_max); /* <- READ/WRITE MULTIPLE MAX SECTORS */
 
     host_writew(sector+(48*2),0x0000);  /* :0  0=we do not support doubleword (32-bit) PIO */
-    host_writew(sector+(49*2),0x0A00);  /* :13 0=Standby timer values managed by device */
+    host_writew(sector+(49*2),controller->busmaster ? 0x0B00 : 0x0A00);
+                        /* :13 0=Standby timer values managed by device */
                         /* :11 1=IORDY supported */
                         /* :10 0=IORDY not disabled */
                         /* :9  1=LBA supported */
-                        /* :8  0=DMA not supported */
+                        /* :8  1=DMA supported (if the controller has a bus master) */
     host_writew(sector+(50*2),0x4000);  /* FIXME: ??? */
     host_writew(sector+(51*2),0x00F0);  /* PIO data transfer cycle timing mode */
     host_writew(sector+(52*2),0x00F0);  /* DMA data transfer cycle timing mode */
@@ -2695,8 +2785,9 @@ void IDEATADevice::generate_identify_device() {
 
     host_writed(sector+(60*2),lba28);  /* total user addressable sectors (LBA) */
     host_writew(sector+(62*2),0x0000);  /* FIXME: ??? */
-    host_writew(sector+(63*2),0x0000);  /* :10 0=Multiword DMA mode 2 not selected */
-                        /* TODO: Basically, we don't do DMA. Fill out this comment */
+    host_writew(sector+(63*2),controller->busmaster ? 0x0407 : 0x0000);
+                        /* :10 1=Multiword DMA mode 2 selected */
+                        /* 2:0 Multiword DMA modes 0-2 supported, if the controller has a bus master */
     host_writew(sector+(64*2),0x0003);  /* 7:0 PIO modes supported (FIXME ???) */
     host_writew(sector+(65*2),0x0000);  /* FIXME: ??? */
     host_writew(sector+(66*2),0x0000);  /* FIXME: ??? */
@@ -3746,6 +3837,244 @@ void IDE_ResetDiskByBIOS(unsigned char disk) {
     }
 }
 
+/* PCI bus master IDE, register compatible with the Intel PIIX/PIIX3 (SFF-8038i).
+ * The PCI function is in pci_bus.cpp, this is the DMA engine behind its BAR4:
+ * 8 I/O ports per channel (command, status, PRD table address) for the primary
+ * and secondary interface. READ DMA and WRITE DMA move all of their sectors
+ * between the disk image and the guest buffers listed in the PRD table at once,
+ * instead of one data port access per word. Like the rest of the IDE emulation
+ * the registers are not part of save states. */
+struct IDEBusMaster {
+    uint8_t command;    /* bit 0: start, bit 3: 1=write to memory (device read) */
+    uint8_t status;     /* bit 0: active, bit 1: error, bit 2: interrupt, bit 5/6: drive 0/1 DMA capable */
+    uint32_t prd;       /* physical address of the PRD table, dword aligned */
+};
+
+enum {
+    IDE_BM_CMD_START=0x01,
+    IDE_BM_CMD_TO_MEMORY=0x08,
+    IDE_BM_STATUS_ACTIVE=0x01,
+    IDE_BM_STATUS_ERROR=0x02,
+    IDE_BM_STATUS_IRQ=0x04,
+    IDE_BM_STATUS_CAPABLE=0x60
+};
+
+static IDEBusMaster ide_busmaster[2];
+static unsigned int ide_busmaster_base = 0;
+static IO_ReadHandleObject ide_busmaster_ReadHandler[16];
+static IO_WriteHandleObject ide_busmaster_WriteHandler[16];
+
+/* Walks the PRD table: each entry is a dword buffer address, a word byte count
+ * (0 means 64KB) and a word with bit 15 set on the last entry. Like ISA DMA
+ * (dma.cpp) the transfer goes straight to system RAM, not through paging. */
+struct IDEBusMasterPRD {
+    PhysPt table;
+    PhysPt addr = 0;
+    uint32_t left = 0;
+    bool eot = false;
+
+    IDEBusMasterPRD(const PhysPt t) : table(t) {
+    }
+
+    /* the next piece of a transfer of bytes: n bytes at at, of which avail are in
+     * RAM. false if the table ends first */
+    bool next(const uint32_t bytes,PhysPt &at,uint32_t &n,uint32_t &avail) {
+        if (left == 0) {
+            if (eot) return false;
+            addr = phys_readd(table) & ~1u;
+            left = phys_readw(table+4u);
+            if (left == 0) left = 0x10000u;
+            eot = (phys_readw(table+6u) & 0x8000u) != 0;
+            table += 8u;
+        }
+
+        at = addr;
+        n = (left < bytes) ? left : bytes;
+        avail = (addr < MemSize) ? (uint32_t)std::min<PhysPt>(MemSize - addr,n) : 0u;
+        addr += n;
+        left -= n;
+        return true;
+    }
+
+    /* device to memory, false if the table ends before all bytes are transferred */
+    bool to_guest(const unsigned char *buf,uint32_t bytes) {
+        PhysPt at;
+        uint32_t n,avail;
+
+        while (bytes != 0) {
+            if (!next(bytes,at,n,avail)) return false;
+            if (avail != 0) memcpy(MemBase + at,buf,avail);
+            buf += n;
+            bytes -= n;
+        }
+
+        return true;
+    }
+
+    /* memory to device, false if the table ends before all bytes are transferred */
+    bool from_guest(unsigned char *buf,uint32_t bytes) {
+        PhysPt at;
+        uint32_t n,avail;
+
+        while (bytes != 0) {
+            if (!next(bytes,at,n,avail)) return false;
+            if (avail != 0) memcpy(buf,MemBase + at,avail);
+            if (avail < n) memset(buf + avail,0xFF,n - avail);
+            buf += n;
+            bytes -= n;
+        }
+
+        return true;
+    }
+};
+
+/* carry out READ DMA or WRITE DMA. the sector buffer is used as bounce buffer,
+ * up to 128 sectors at a time. reads from a memory mapped image copy straight
+ * from the mapping into guest memory instead. */
+static bool IDE_BusMaster_Transfer(IDEBusMaster &bm,IDEATADevice *ata,imageDisk *disk,uint32_t sectorn,unsigned int sectcount,const bool to_memory) {
+    IDEBusMasterPRD prd(bm.prd);
+
+    while (sectcount != 0) {
+        const unsigned int n = std::min(sectcount,(unsigned int)(sizeof(ata->sector) / 512u));
+
+        if (to_memory) {
+            const uint8_t *src = disk->Map_AbsoluteSector(sectorn,n);
+
+            if (src == NULL) {
+                if (disk->Read_AbsoluteSectors(sectorn,n,ata->sector) != Int13Status::NoError) {
+                    LOG_MSG("ATA DMA read failed\n");
+                    bm.status |= IDE_BM_STATUS_ERROR;
+                    return false;
+                }
+                src = ata->sector;
+            }
+            if (!prd.to_guest(src,n*512u)) {
+                LOG_MSG("ATA DMA: PRD table shorter than the transfer\n");
+                bm.status |= IDE_BM_STATUS_ERROR;
+                return false;
+            }
+        }
+        else {
+            if (!prd.from_guest(ata->sector,n*512u)) {
+                LOG_MSG("ATA DMA: PRD table shorter than the transfer\n");
+                bm.status |= IDE_BM_STATUS_ERROR;
+                return false;
+            }
+            if (disk->Write_AbsoluteSectors(sectorn,n,ata->sector) != Int13Status::NoError) {
+                LOG_MSG("ATA DMA write failed\n");
+                bm.status |= IDE_BM_STATUS_ERROR;
+                return false;
+            }
+        }
+
+        sectorn += n;
+        sectcount -= n;
+    }
+
+    /* the engine stays active if the PRD table describes more than was transferred,
+     * until the driver clears the start bit */
+    if (prd.left == 0 && prd.eot)
+        bm.status &= ~IDE_BM_STATUS_ACTIVE;
+
+    return true;
+}
+
+/* start bit set: if the selected drive is waiting on a READ/WRITE DMA, let it go ahead */
+static void IDE_BusMaster_Start(const unsigned int chan) {
+    IDEController *ctrl = GetIDEController(chan);
+    if (ctrl == NULL || !ctrl->busmaster) return;
+
+    IDEDevice *dev = ctrl->device[ctrl->select];
+    if (dev == NULL || dev->state != IDE_DEV_DMA_WAIT) return;
+
+    const unsigned int pk = IDEEventPack(chan,(unsigned int)ctrl->select).get();
+    PIC_RemoveSpecificEvents(IDE_DelayedCommand,pk);
+    PIC_AddEvent(IDE_DelayedCommand,0.00001/*ms*/,pk);
+}
+
+static void ide_busmaster_writeb(const unsigned int reg,const uint8_t val) {
+    const unsigned int chan = (reg >> 3u) & 1u;
+    IDEBusMaster &bm = ide_busmaster[chan];
+
+    switch (reg & 7u) {
+        case 0: /* command */
+            if (val & IDE_BM_CMD_START) {
+                if (!(bm.command & IDE_BM_CMD_START)) {
+                    bm.command = val & (IDE_BM_CMD_START|IDE_BM_CMD_TO_MEMORY);
+                    bm.status |= IDE_BM_STATUS_ACTIVE;
+                    IDE_BusMaster_Start(chan);
+                }
+            }
+            else {
+                /* stopping the engine aborts whatever is left of the transfer */
+                bm.command = val & IDE_BM_CMD_TO_MEMORY;
+                bm.status &= ~IDE_BM_STATUS_ACTIVE;
+            }
+            break;
+        case 2: /* status: error and interrupt are write 1 to clear */
+            bm.status = (uint8_t)((bm.status & ~IDE_BM_STATUS_CAPABLE) | (val & IDE_BM_STATUS_CAPABLE));
+            bm.status &= (uint8_t)~(val & (IDE_BM_STATUS_ERROR|IDE_BM_STATUS_IRQ));
+            break;
+        case 4: case 5: case 6: case 7: { /* PRD table address */
+            const unsigned int shf = (reg & 3u) * 8u;
+            bm.prd = ((bm.prd & ~(0xFFu << shf)) | ((uint32_t)val << shf)) & ~3u;
+            break; }
+        default:
+            break;
+    }
+}
+
+static uint8_t ide_busmaster_readb(const unsigned int reg) {
+    const IDEBusMaster &bm = ide_busmaster[(reg >> 3u) & 1u];
+
+    switch (reg & 7u) {
+        case 0:
+            return bm.command;
+        case 2:
+            return bm.status;
+        case 4: case 5: case 6: case 7:
+            return (uint8_t)(bm.prd >> ((reg & 3u) * 8u));
+        default:
+            break;
+    }
+
+    return 0x00;
+}
+
+static void ide_busmaster_w(Bitu port,Bitu val,Bitu iolen) {
+    for (Bitu i=0;i < iolen;i++)
+        ide_busmaster_writeb((unsigned int)(port + i - ide_busmaster_base) & 0xFu,(uint8_t)(val >> (i * 8u)));
+}
+
+static Bitu ide_busmaster_r(Bitu port,Bitu iolen) {
+    Bitu v = 0;
+
+    for (Bitu i=0;i < iolen;i++)
+        v |= (Bitu)ide_busmaster_readb((unsigned int)(port + i - ide_busmaster_base) & 0xFu) << (i * 8u);
+
+    return v;
+}
+
+/* called by the PCI function when BAR4 or the I/O enable bit changes, 0 to unmap */
+void IDE_BusMaster_SetBase(unsigned int base) {
+    base &= 0xFFF0u;
+    if (base == ide_busmaster_base) return;
+
+    for (unsigned int i=0;i < 16;i++) {
+        ide_busmaster_WriteHandler[i].Uninstall();
+        ide_busmaster_ReadHandler[i].Uninstall();
+    }
+
+    ide_busmaster_base = base;
+    if (base != 0) {
+        LOG(LOG_MISC,LOG_DEBUG)("IDE bus master registers at 0x%x",base);
+        for (unsigned int i=0;i < 16;i++) {
+            ide_busmaster_WriteHandler[i].Install(base+i,ide_busmaster_w,IO_MA);
+            ide_busmaster_ReadHandler[i].Install(base+i,ide_busmaster_r,IO_MA);
+        }
+    }
+}
+
 static void IDE_DelayedCommand(Bitu pk/*which IDE device*/) {
     IDEEventPack ep(pk);
     const unsigned int idx = ep.interface();
@@ -3910,6 +4239,86 @@ static void IDE_DelayedCommand(Bitu pk/*which IDE device*/) {
                 dev->raise_irq();
                 break;
 
+            case 0xC8:/* READ DMA */
+            case 0xC9:/* READ DMA WITHOUT RETRY */
+            case 0xCA:/* WRITE DMA */
+            case 0xCB:/* WRITE DMA WITHOUT RETRY */ {
+                IDEBusMaster &bm = ide_busmaster[idx & 1u];
+                const bool to_memory = (dev->command & 2u) == 0;
+
+                /* the drive has done its seek, now it waits on the host to start the bus master */
+                if (!(bm.status & IDE_BM_STATUS_ACTIVE) || !(bm.command & IDE_BM_CMD_START)) {
+                    ata->state = IDE_DEV_DMA_WAIT;
+                    ata->status = IDE_STATUS_DRQ|IDE_STATUS_DRIVE_READY|IDE_STATUS_DRIVE_SEEK_COMPLETE;
+                    return;
+                }
+
+                disk = ata->getBIOSdisk();
+                if (disk == NULL) {
+                    LOG_MSG("ATA DMA fail, bios disk N/A\n");
+                    bm.status &= ~IDE_BM_STATUS_ACTIVE;
+                    ata->abort_error();
+                    dev->raise_irq();
+                    return;
+                }
+
+                if (!(bm.command & IDE_BM_CMD_TO_MEMORY) != !to_memory) {
+                    LOG_MSG("ATA DMA: bus master direction does not match command %02x\n",dev->command);
+                    bm.status = (uint8_t)((bm.status & ~IDE_BM_STATUS_ACTIVE) | IDE_BM_STATUS_ERROR);
+                    ata->abort_error();
+                    dev->raise_irq();
+                    return;
+                }
+
+                sectcount = ata->count & 0xFF;
+                if (sectcount == 0) sectcount = 256;
+                if (drivehead_is_lba(ata->drivehead)) {
+                    /* LBA */
+                    sectorn = (((unsigned int)ata->drivehead & 0xFu) << 24u) | (unsigned int)ata->lba[0] |
+                        ((unsigned int)ata->lba[1] << 8u) |
+                        ((unsigned int)ata->lba[2] << 16u);
+                }
+                else {
+                    /* C/H/S */
+                    if (ata->lba[0] == 0 ||
+                        (unsigned int)(ata->drivehead & 0xF) >= (unsigned int)ata->heads ||
+                        (unsigned int)ata->lba[0] > (unsigned int)ata->sects ||
+                        (unsigned int)(ata->lba[1] | ((unsigned int)ata->lba[2] << 8u)) >= (unsigned int)ata->cyls) {
+                        LOG_MSG("ATA DMA C/H/S %u/%u/%u out of bounds %u/%u/%u\n",
+                            (unsigned int)(ata->lba[1] | ((unsigned int)ata->lba[2] << 8u)),
+                            (unsigned int)(ata->drivehead&0xF),
+                            (unsigned int)ata->lba[0],
+                            (unsigned int)ata->cyls,
+                            (unsigned int)ata->heads,
+                            (unsigned int)ata->sects);
+                        bm.status &= ~IDE_BM_STATUS_ACTIVE;
+                        ata->abort_error();
+                        dev->raise_irq();
+                        return;
+                    }
+
+                    sectorn = (((unsigned int)ata->drivehead & 0xFu) * ata->sects) +
+                        (((unsigned int)ata->lba[1] | ((unsigned int)ata->lba[2] << 8u)) * ata->sects * ata->heads) +
+                        ((unsigned int)ata->lba[0] - 1u);
+                }
+
+                if (!IDE_BusMaster_Transfer(bm,ata,disk,sectorn,sectcount,to_memory)) {
+                    bm.status &= ~IDE_BM_STATUS_ACTIVE;
+                    ata->abort_error();
+                    dev->raise_irq();
+                    return;
+                }
+
+                /* like the PIO commands, the registers end up on the last sector transferred */
+                if (sectcount > 1) ata->increment_current_address(sectcount - 1u);
+                ata->progress_count = sectcount;
+                ata->count = 0;
+                ata->status = IDE_STATUS_DRIVE_READY|IDE_STATUS_DRIVE_SEEK_COMPLETE;
+                ata->state = IDE_DEV_READY;
+                ata->allow_writing = true;
+                dev->raise_irq();
+                break; }
+
             case 0x40:/* READ SECTOR VERIFY WITH RETRY */
             case 0x41: /* READ SECTOR VERIFY WITHOUT RETRY */
                 disk = ata->getBIOSdisk();
@@ -4036,9 +4445,15 @@ static void IDE_DelayedCommand(Bitu pk/*which IDE device*/) {
                 if ((512*ata->multiple_sector_count) > sizeof(ata->sector))
                     E_Exit("SECTOR OVERFLOW");
 
-                for (unsigned int cc=0;cc < MIN((Bitu)ata->multiple_sector_count,(Bitu)sectcount);cc++) {
-                    /* it would be great if the disk object had a "read multiple sectors" member function */
-                    if (disk->Read_AbsoluteSector(sectorn+cc, ata->sector+(cc*512)) != Int13Status::NoError) {
+                {
+                    const unsigned int count = (unsigned int)MIN((Bitu)ata->multiple_sector_count,(Bitu)sectcount);
+                    const uint8_t *src = disk->Map_AbsoluteSector(sectorn,count);
+
+                    if (src != NULL) {
+                        /* memory mapped image, the whole block is one copy */
+                        memcpy(ata->sector,src,512u*count);
+                    }
+                    else if (disk->Read_AbsoluteSectors(sectorn, count, ata->sector) != Int13Status::NoError) {
                         LOG_MSG("ATA read failed\n");
                         ata->abort_error();
                         dev->raise_irq();
@@ -4102,14 +4517,11 @@ static void IDE_DelayedCommand(Bitu pk/*which IDE device*/) {
                         ((unsigned int)ata->lba[0] - 1);
                 }
 
-                for (unsigned int cc=0;cc < MIN((Bitu)ata->multiple_sector_count,(Bitu)sectcount);cc++) {
-                    /* it would be great if the disk object had a "write multiple sectors" member function */
-                    if (disk->Write_AbsoluteSector(sectorn+cc, ata->sector+(cc*512)) != Int13Status::NoError) {
-                        LOG_MSG("Failed to write sector\n");
-                        ata->abort_error();
-                        dev->raise_irq();
-                        return;
-                    }
+                if (disk->Write_AbsoluteSectors(sectorn, (uint32_t)MIN((Bitu)ata->multiple_sector_count,(Bitu)sectcount), ata->sector) != Int13Status::NoError) {
+                    LOG_MSG("Failed to write sector\n");
+                    ata->abort_error();
+                    dev->raise_irq();
+                    return;
                 }
 
                 for (unsigned int cc=0;cc < MIN((Bitu)ata->multiple_sector_count,(Bitu)sectcount);cc++) {
@@ -4222,6 +4634,7 @@ void IDEController::check_device_irq() {
 
 void IDEController::raise_irq() {
     irq_pending = true;
+    if (busmaster) ide_busmaster[interface_index & 1u].status |= IDE_BM_STATUS_IRQ;
     if (IS_PC98_ARCH) {
         PC98_IDE_UpdateIRQ();
     }
@@ -4282,6 +4695,20 @@ void IDEDevice::data_write(Bitu v,Bitu iolen) {
     (void)v;//UNUSED
 }
 
+Bitu IDEDevice::data_read_block(uint8_t *buf,Bitu iolen,Bitu count) {
+    (void)buf;//UNUSED
+    (void)iolen;//UNUSED
+    (void)count;//UNUSED
+    return 0;
+}
+
+Bitu IDEDevice::data_write_block(const uint8_t *buf,Bitu iolen,Bitu count) {
+    (void)buf;//UNUSED
+    (void)iolen;//UNUSED
+    (void)count;//UNUSED
+    return 0;
+}
+
 IDEDevice::IDEDevice(IDEController *c,bool _slave) {
     type = IDE_TYPE_NONE;
     slave = _slave;
@@ -4706,6 +5133,21 @@ void IDEATADevice::writecommand(uint8_t cmd) {
             allow_writing = true;
             raise_irq();
             break;
+        case 0xC8: /* READ DMA */
+        case 0xC9: /* READ DMA WITHOUT RETRY */
+        case 0xCA: /* WRITE DMA */
+        case 0xCB: /* WRITE DMA WITHOUT RETRY */
+            if (controller->busmaster) {
+                /* seek, then wait for the host to start the bus master (see IDE_DelayedCommand) */
+                progress_count = 0;
+                state = IDE_DEV_BUSY;
+                status = IDE_STATUS_BUSY;
+                PIC_RemoveSpecificEvents(IDE_DelayedCommand,pk);
+                PIC_AddEvent(IDE_DelayedCommand,(faked_command ? 0.000001 : 0.1)/*ms*/,pk);
+                break;
+            }
+            /* without a bus master there is nothing to move the data, reject it like any unknown command */
+            /* fall through */
         default:
             LOG_MSG("Unknown IDE/ATA command %02X\n",cmd);
             abort_error();
@@ -4743,6 +5185,14 @@ IDEController::IDEController(Section* configuration,unsigned char index):Module_
     spinup_time = section->Get_int("cd-rom spinup time");
     spindown_timeout = section->Get_int("cd-rom spindown timeout");
     cd_insertion_time = section->Get_int("cd-rom insertion delay");
+    busmaster = section->Get_bool("busmaster dma") && index < 2 && !IS_PC98_ARCH && has_pcibus_enable();
+
+    if (busmaster) {
+        /* as a BIOS would leave it: idle, both drives marked DMA capable */
+        ide_busmaster[index].command = 0;
+        ide_busmaster[index].status = IDE_BM_STATUS_CAPABLE;
+        ide_busmaster[index].prd = 0;
+    }
 
     host_reset = false;
     irq_pending = false;
@@ -4862,6 +5312,9 @@ void IDEController::install_io_port(){
             WriteHandler[i].Install(base_io+i,ide_baseio_w,IO_MA);
             ReadHandler[i].Install(base_io+i,ide_baseio_r,IO_MA);
         }
+
+        IO_RegisterWriteBlockHandler(base_io,ide_baseio_w,ide_baseio_block_w);
+        IO_RegisterReadBlockHandler(base_io,ide_baseio_r,ide_baseio_block_r);
     }
 
     if (alt_io != 0) {
@@ -5082,6 +5535,32 @@ static Bitu ide_baseio_r(Bitu port,Bitu iolen) {
     return ret;
 }
 
+/* REP INS/OUTS on the data port, see IO_ReadBlockHandler. 32-bit I/O without
+ * "enable pio32" is two 16-bit accesses and is left to the regular handler. */
+static Bitu ide_baseio_block_r(Bitu port,uint8_t *buf,Bitu iolen,Bitu count) {
+    IDEController *ide = match_ide_controller(port);
+    if (ide == NULL || (iolen == 4 && (!ide->enable_pio32 || ide->ignore_pio32)))
+        return 0;
+
+    IDEDevice *dev = ide->device[ide->select];
+    if (dev == NULL || (dev->status & IDE_STATUS_BUSY))
+        return 0;
+
+    return dev->data_read_block(buf,iolen,count);
+}
+
+static Bitu ide_baseio_block_w(Bitu port,const uint8_t *buf,Bitu iolen,Bitu count) {
+    IDEController *ide = match_ide_controller(port);
+    if (ide == NULL || (iolen == 4 && (!ide->enable_pio32 || ide->ignore_pio32)))
+        return 0;
+
+    IDEDevice *dev = ide->device[ide->select];
+    if (dev == NULL || (dev->status & IDE_STATUS_BUSY))
+        return 0;
+
+    return dev->data_write_block(buf,iolen,count);
+}
+
 static void ide_baseio_w(Bitu port,Bitu val,Bitu iolen) {
     IDEController *ide = match_ide_controller(port);
     IDEDevice *dev;
@@ -5293,6 +5772,10 @@ void IDE_OnReset(Section *sec) {
 
     for (size_t i=0;i < MAX_IDE_CONTROLLERS;i++) ide_inits[i](control->GetSection(ide_names[i]));
 
+    PCI_RemoveIDEBusMaster_Device();
+    if ((idecontroller[0] != NULL && idecontroller[0]->busmaster) || (idecontroller[1] != NULL && idecontroller[1]->busmaster))
+        PCI_AddIDEBusMaster_Device();
+
     if (IS_PC98_ARCH) {//TODO: Only if any IDE interfaces are enabled
         for (size_t i=0;i < 8;i++) {
             PC98_WriteHandler[i].Uninstall();
@@ -5301,6 +5784,9 @@ void IDE_OnReset(Section *sec) {
             PC98_ReadHandler[i].Install(0x640+(i*2),ide_baseio_r,IO_MA);
         }
 
+        IO_RegisterWriteBlockHandler(0x640,ide_baseio_w,ide_baseio_block_w);
+        IO_RegisterReadBlockHandler(0x640,ide_baseio_r,ide_baseio_block_r);
+
         for (size_t i=0;i < 2;i++) {
             PC98_WriteHandlerAlt[i].Uninstall();
             PC98_ReadHandlerAlt[i].Uninstall();
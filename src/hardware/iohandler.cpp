@@ -24,6 +24,7 @@
 #include "logging.h"
 #include "setup.h"
 #include "cpu.h"
+#include "paging.h"
 #include "../src/cpu/lazyflags.h"
 #include "callback.h"
 
@@ -51,6 +52,22 @@ IO_ReadHandler * io_readhandlers[3][IO_MAX];
 
 static IO_callout_vector IO_callouts[IO_callouts_max];
 
+/* block handlers, by port. entry 0 means none */
+struct IO_ReadBlockEntry {
+	IO_ReadHandler *handler;
+	IO_ReadBlockHandler *block;
+};
+
+struct IO_WriteBlockEntry {
+	IO_WriteHandler *handler;
+	IO_WriteBlockHandler *block;
+};
+
+static std::vector<IO_ReadBlockEntry> io_readblocks(1,IO_ReadBlockEntry{NULL,NULL});
+static std::vector<IO_WriteBlockEntry> io_writeblocks(1,IO_WriteBlockEntry{NULL,NULL});
+static uint8_t io_readblock_index[IO_MAX] = {0};
+static uint8_t io_writeblock_index[IO_MAX] = {0};
+
 #if C_DEBUG
 void DEBUG_EnableDebugger(void);
 #endif
@@ -326,6 +343,7 @@ void IO_RegisterWriteHandler(Bitu port,IO_WriteHandler * handler,Bitu mask,Bitu
 void IO_FreeReadHandler(Bitu port,Bitu mask,Bitu range) {
     assert((port+range) <= IO_MAX);
 	while (range--) {
+		io_readblock_index[port]=0;
 		if (mask&IO_MB) io_readhandlers[0][port]=IO_ReadSlowPath;
 		if (mask&IO_MW) io_readhandlers[1][port]=IO_ReadSlowPath;
 		if (mask&IO_MD) io_readhandlers[2][port]=IO_ReadSlowPath;
@@ -336,6 +354,7 @@ void IO_FreeReadHandler(Bitu port,Bitu mask,Bitu range) {
 void IO_FreeWriteHandler(Bitu port,Bitu mask,Bitu range) {
     assert((port+range) <= IO_MAX);
 	while (range--) {
+		io_writeblock_index[port]=0;
 		if (mask&IO_MB) io_writehandlers[0][port]=IO_WriteSlowPath;
 		if (mask&IO_MW) io_writehandlers[1][port]=IO_WriteSlowPath;
 		if (mask&IO_MD) io_writehandlers[2][port]=IO_WriteSlowPath;
@@ -343,6 +362,32 @@ void IO_FreeWriteHandler(Bitu port,Bitu mask,Bitu range) {
 	}
 }
 
+void IO_RegisterReadBlockHandler(Bitu port,IO_ReadHandler * handler,IO_ReadBlockHandler * block,Bitu range) {
+    assert((port+range) <= IO_MAX);
+    size_t i = 1;
+    while (i < io_readblocks.size() && !(io_readblocks[i].handler == handler && io_readblocks[i].block == block)) i++;
+    if (i == io_readblocks.size()) {
+        if (i > 0xFF) E_Exit("Too many I/O block handlers");
+        io_readblocks.push_back(IO_ReadBlockEntry{handler,block});
+    }
+    while (range--) io_readblock_index[port++] = (uint8_t)i;
+}
+
+void IO_RegisterWriteBlockHandler(Bitu port,IO_WriteHandler * handler,IO_WriteBlockHandler * block,Bitu range) {
+    assert((port+range) <= IO_MAX);
+    size_t i = 1;
+    while (i < io_writeblocks.size() && !(io_writeblocks[i].handler == handler && io_writeblocks[i].block == block)) i++;
+    if (i == io_writeblocks.size()) {
+        if (i > 0xFF) E_Exit("Too many I/O block handlers");
+        io_writeblocks.push_back(IO_WriteBlockEntry{handler,block});
+    }
+    while (range--) io_writeblock_index[port++] = (uint8_t)i;
+}
+
+bool IO_HasBlockHandler(Bitu port,bool write) {
+    return (write ? io_writeblock_index[port] : io_readblock_index[port]) != 0;
+}
+
 void IO_InvalidateCachedHandler(Bitu port,Bitu range) {
     assert((port+range) <= IO_MAX);
     for (Bitu mb=0;mb <= 2;mb++) {
@@ -408,20 +453,29 @@ int io_delay_ns[3] = {-1,-1,-1};
 /* nonzero if we're in a callback */
 extern unsigned int last_callback;
 
-inline void IO_USEC_read_delay(const unsigned int szidx) {
-	if (io_delay_ns[szidx] > 0 && last_callback == 0/*NOT running within a callback function*/) {
-		Bits delaycyc = (CPU_CycleMax * io_delay_ns[szidx]) / 1000000;
-		CPU_Cycles -= delaycyc;
-		CPU_IODelayRemoved += delaycyc;
-	}
+/* CPU cycles the delay of one I/O read or write takes */
+static inline Bits IO_USEC_read_cycles(const unsigned int szidx) {
+	if (io_delay_ns[szidx] > 0 && last_callback == 0/*NOT running within a callback function*/)
+		return (CPU_CycleMax * io_delay_ns[szidx]) / 1000000;
+	return 0;
 }
 
-inline void IO_USEC_write_delay(const unsigned int szidx) {
-	if (io_delay_ns[szidx] > 0 && last_callback == 0/*NOT running within a callback function*/) {
-		Bits delaycyc = (CPU_CycleMax * io_delay_ns[szidx] * 3) / (1000000 * 4);
-		CPU_Cycles -= delaycyc;
-		CPU_IODelayRemoved += delaycyc;
-	}
+static inline Bits IO_USEC_write_cycles(const unsigned int szidx) {
+	if (io_delay_ns[szidx] > 0 && last_callback == 0/*NOT running within a callback function*/)
+		return (CPU_CycleMax * io_delay_ns[szidx] * 3) / (1000000 * 4);
+	return 0;
+}
+
+inline void IO_USEC_read_delay(const unsigned int szidx,const Bitu count=1) {
+	const Bits delaycyc = IO_USEC_read_cycles(szidx) * (Bits)count;
+	CPU_Cycles -= delaycyc;
+	CPU_IODelayRemoved += delaycyc;
+}
+
+inline void IO_USEC_write_delay(const unsigned int szidx,const Bitu count=1) {
+	const Bits delaycyc = IO_USEC_write_cycles(szidx) * (Bits)count;
+	CPU_Cycles -= delaycyc;
+	CPU_IODelayRemoved += delaycyc;
 }
 
 #ifdef ENABLE_PORTLOG
@@ -562,6 +616,83 @@ uint32_t IO_ReadD(Bitu port) {
 	return retval;
 }
 
+/* Items of a REP INS/OUTS that can go through a block handler in one call: what is
+ * left of the page the previous item at index-iolen was moved through, without
+ * wrapping index around mask, and no more than the CPU cycles left allow for at
+ * one cycle plus the I/O delay each. The item crossing into the next page and the
+ * one after the wraparound go the regular way, which takes care of page faults. */
+static Bitu IO_StringItems(const uint32_t base,const uint32_t index,const uint32_t mask,const Bitu iolen,const Bitu count,const Bits delaycyc) {
+	const uint32_t lin = base + index;
+
+	if (index < iolen || (lin & 0xFFFu) == 0 || CPU_Cycles <= 0) return 0;
+
+	Bitu n = (0x1000u - (lin & 0xFFFu)) / iolen;
+	const uint64_t wrap = ((uint64_t)mask + 1u - index) / iolen;
+	if ((uint64_t)n > wrap) n = (Bitu)wrap;
+	if (n > count) n = count;
+	const Bitu cycles = (Bitu)(CPU_Cycles / (1 + delaycyc));
+	if (n > cycles) n = cycles;
+	return n;
+}
+
+static uint8_t io_string_buf[0x1000];
+
+Bitu IO_StringIn(Bitu port,uint32_t base,uint32_t &index,uint32_t mask,Bitu iolen,Bitu count) {
+	const unsigned int i = io_readblock_index[port];
+	if (i == 0 || GETFLAG(VM)) return 0;
+
+	const unsigned int szidx = (iolen >= 4) ? 2 : (unsigned int)(iolen - 1);
+	const IO_ReadBlockEntry &e = io_readblocks[i];
+	if (io_readhandlers[szidx][port] != e.handler) return 0;
+
+	Bitu n = IO_StringItems(base,index,mask,iolen,count,IO_USEC_read_cycles(szidx));
+	if (n == 0 || (n = e.block(port,io_string_buf,iolen,n)) == 0) return 0;
+	IO_USEC_read_delay(szidx,n);
+
+	const LinearPt lin = base + index;
+	const HostPt tlb_addr = get_tlb_write(lin);
+	if (tlb_addr) {
+		memcpy(tlb_addr + lin,io_string_buf,n * iolen);
+	}
+	else {
+		for (Bitu j=0;j < n;j++) {
+			const uint8_t *p = io_string_buf + (j * iolen);
+			switch (iolen) {
+				case 1: mem_writeb_inline(lin + (LinearPt)j,*p); break;
+				case 2: mem_writew_inline(lin + (LinearPt)(j * 2u),host_readw(p)); break;
+				default: mem_writed_inline(lin + (LinearPt)(j * 4u),host_readd(p)); break;
+			}
+		}
+	}
+
+	index = (uint32_t)((index + (n * iolen)) & mask);
+	return n;
+}
+
+Bitu IO_StringOut(Bitu port,uint32_t base,uint32_t &index,uint32_t mask,Bitu iolen,Bitu count) {
+	const unsigned int i = io_writeblock_index[port];
+	if (i == 0 || GETFLAG(VM)) return 0;
+
+	const unsigned int szidx = (iolen >= 4) ? 2 : (unsigned int)(iolen - 1);
+	const IO_WriteBlockEntry &e = io_writeblocks[i];
+	if (io_writehandlers[szidx][port] != e.handler) return 0;
+
+	Bitu n = IO_StringItems(base,index,mask,iolen,count,IO_USEC_write_cycles(szidx));
+	if (n == 0) return 0;
+
+	/* only from RAM, reading ahead from a memory mapped device might not be harmless */
+	const LinearPt lin = base + index;
+	const HostPt tlb_addr = get_tlb_read(lin);
+	if (!tlb_addr) return 0;
+	memcpy(io_string_buf,tlb_addr + lin,n * iolen);
+
+	if ((n = e.block(port,io_string_buf,iolen,n)) == 0) return 0;
+	IO_USEC_write_delay(szidx,n);
+
+	index = (uint32_t)((index + (n * iolen)) & mask);
+	return n;
+}
+
 void IO_Reset(Section * /*sec*/) { // Reset or power on
 	Section_prop * section=static_cast<Section_prop *>(control->GetSection("dosbox"));
 
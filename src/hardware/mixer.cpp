@@ -24,6 +24,9 @@
 
 #include <assert.h>
 #include <string.h>
+#include <atomic>
+#include <map>
+#include <vector>
 #include <sys/types.h>
 #define _USE_MATH_DEFINES // needed for M_PI in Visual Studio as documented [https://msdn.microsoft.com/en-us/library/4hwaceh6.aspx]
 #include <math.h>
@@ -60,6 +63,8 @@
 #include "hardware.h"
 #include "programs.h"
 #include "midi.h"
+#include "hostprof.h"
+#include "mixer_simd.h"
 
 #define MIXER_SSIZE 4
 #define MIXER_VOLSHIFT 13
@@ -71,28 +76,16 @@ SDL_AudioDeviceID SDL2_AudioDevice = 0; /* valid IDs are 2 or higher, 1 for comp
 #define DC_ADJBITS (24u)
 static int32_t DC_ADJUSTMENT_STEP = 0;
 
-static INLINE int16_t MIXER_CLIP(Bits SAMP) {
-    if (SAMP < MAX_AUDIO) {
-        if (SAMP > MIN_AUDIO)
-            return SAMP;
-        else
-            return MIN_AUDIO;
-    } else {
-        return MAX_AUDIO;
-    }
-}
-
 struct mixedFraction {
     unsigned int        w;
     unsigned int        fn,fd;
 };
 
 static struct {
-    int32_t          work[MIXER_BUFSIZE][2];
-    Bitu            work_in,work_out,work_wrap;
+    float           work[MIXER_BUFSIZE][2];     // the millisecond being rendered
     Bitu            pos,done;
     int32_t         last_dac[2];
-    int32_t         dc_adj[2];
+    float           dc_adj[2];
     float           mastervol[2];
     float           recordvol[2];
     MixerChannel*   channels;
@@ -110,6 +103,61 @@ static struct {
     bool            mute;
 } mixer;
 
+/* Rendered samples on their way to the SDL audio callback. The emulation thread
+ * is the only writer and the callback the only reader, so each side just
+ * publishes its own position and neither has to lock the audio device. The
+ * positions run freely and are masked to index the buffer. */
+static struct {
+    float               buf[MIXER_BUFSIZE][2];
+    std::atomic<Bitu>   wpos{0},rpos{0};
+
+    /* written by the callback, read by mixerinfo() */
+    std::atomic<Bitu>   target{0};          // how much the callback lets build up before dropping, adapts to underruns
+    std::atomic<unsigned long> underruns{0},overruns{0},dropped{0};
+    Bitu                stable;             // samples played since the last underrun or target change
+
+    Bitu Buffered(void) const {
+        return wpos.load(std::memory_order_acquire) - rpos.load(std::memory_order_acquire);
+    }
+} mixer_ring;
+
+/* emulation thread: queue rendered samples, dropping what does not fit */
+static void MIXER_RingWrite(const float *src,Bitu count) {
+    const Bitu w = mixer_ring.wpos.load(std::memory_order_relaxed);
+    const Bitu space = MIXER_BUFSIZE - (w - mixer_ring.rpos.load(std::memory_order_acquire));
+
+    if (count > space) {
+        mixer_ring.overruns.fetch_add(1,std::memory_order_relaxed);
+        count = space;
+    }
+
+    const Bitu i = w & MIXER_BUFMASK;
+    const Bitu first = std::min<Bitu>(count,MIXER_BUFSIZE - i);
+    memcpy(&mixer_ring.buf[i][0],src,first*sizeof(float)*2);
+    memcpy(&mixer_ring.buf[0][0],src+first*2,(count-first)*sizeof(float)*2);
+    mixer_ring.wpos.store(w + count,std::memory_order_release);
+}
+
+/* audio callback: convert up to count samples for SDL, returns how many there were */
+static Bitu MIXER_RingRead(int16_t *dst,Bitu count) {
+    const Bitu r = mixer_ring.rpos.load(std::memory_order_relaxed);
+    const Bitu avail = mixer_ring.wpos.load(std::memory_order_acquire) - r;
+
+    if (count > avail) count = avail;
+
+    const Bitu i = r & MIXER_BUFMASK;
+    const Bitu first = std::min<Bitu>(count,MIXER_BUFSIZE - i);
+    MIXER_ToInt16(dst,&mixer_ring.buf[i][0],first,mixer.mastervol);
+    MIXER_ToInt16(dst+first*2,&mixer_ring.buf[0][0],count-first,mixer.mastervol);
+    mixer_ring.rpos.store(r + count,std::memory_order_release);
+    return count;
+}
+
+/* audio callback: skip samples, at most what is buffered */
+static void MIXER_RingDrop(Bitu count) {
+    mixer_ring.rpos.store(mixer_ring.rpos.load(std::memory_order_relaxed) + count,std::memory_order_release);
+}
+
 uint32_t Mixer_MIXQ(void) {
 	return  ((uint32_t)mixer.freq) |
 		((uint32_t)2u/*channels*/ << (uint32_t)20u) |
@@ -133,6 +181,180 @@ inline void MixerChannel::updateSlew(void) {
         max_change = 0x7FFFFFFFUL;
 }
 
+/* Windowed-sinc resampling, an alternative to the linear interpolation in
+ * runSampleInterpolation() chosen per channel by the "resampler" option or
+ * MIXER /RESAMPLER. Each output sample is the dot product of the newest taps
+ * input samples with one phase of a polyphase filter bank: a Kaiser windowed
+ * sinc, cut off below the lower of the two Nyquist rates, so that downsampling
+ * doesn't alias and upsampling doesn't image. The output is delayed by
+ * taps/2-1 input samples so the filter only needs samples already loaded. */
+static const struct {
+    const char*     name;
+    unsigned int    taps;           // multiple of 4, at most MIXER_RESAMPLE_MAXTAPS
+    unsigned int    phases;
+    double          beta;           // Kaiser window shape, higher is more stopband attenuation
+    double          passband;       // cutoff, relative to the lower Nyquist rate
+} mixer_resample_profiles[] = {
+    { "linear",  0,    0, 0.0, 0.00 },
+    { "fast",    8,   64, 5.0, 0.80 },
+    { "medium", 16,  256, 7.0, 0.88 },
+    { "best",   32, 1024, 9.0, 0.94 }
+};
+
+struct MixerResampleBank {
+    unsigned int        taps,phases;
+    std::vector<float>  coef;       // phases rows of taps coefficients, oldest input first
+};
+
+/* banks only depend on the profile and on the rate ratio when downsampling,
+ * so channels share them and a Sound Blaster switching rates reuses them */
+#define MIXER_RESAMPLE_RATIO_STEPS 4096u
+static std::map< std::pair<unsigned int,unsigned int>,MixerResampleBank > mixer_resample_banks;
+
+/* profiles set by the "resampler" option and MIXER /RESAMPLER */
+static unsigned int mixer_resample_default = 0;
+static std::map<std::string,unsigned int> mixer_resample_channels;
+
+static double MIXER_BesselI0(double x) {
+    double sum = 1.0,term = 1.0;
+    for (unsigned int k=1;k < 64;k++) {
+        const double f = x / (2.0 * k);
+        term *= f * f;
+        sum += term;
+        if (term < sum * 1e-12) break;
+    }
+    return sum;
+}
+
+static const MixerResampleBank *MIXER_GetResampleBank(unsigned int profile,double ratio/*output rate / input rate*/) {
+    const unsigned int rq = (unsigned int)std::max(1.0,floor(std::min(1.0,ratio) * MIXER_RESAMPLE_RATIO_STEPS + 0.5));
+    const auto key = std::make_pair(profile,rq);
+    auto i = mixer_resample_banks.find(key);
+    if (i != mixer_resample_banks.end()) return &i->second;
+
+    MixerResampleBank &b = mixer_resample_banks[key];
+    const unsigned int taps = mixer_resample_profiles[profile].taps;
+    const double fc = mixer_resample_profiles[profile].passband * rq / MIXER_RESAMPLE_RATIO_STEPS;
+    const double half = taps / 2.0;
+    const double beta = mixer_resample_profiles[profile].beta;
+    const double i0beta = MIXER_BesselI0(beta);
+
+    b.taps = taps;
+    b.phases = mixer_resample_profiles[profile].phases;
+    b.coef.resize((size_t)b.taps * b.phases);
+    for (unsigned int ph=0;ph < b.phases;ph++) {
+        float *c = &b.coef[(size_t)ph * taps];
+        double h[MIXER_RESAMPLE_MAXTAPS],sum = 0;
+
+        for (unsigned int k=0;k < taps;k++) {
+            /* tap k is the input sample taps-1-k before the current one, the
+             * output lies ph/phases past the last one, minus the delay */
+            const double d = (double)k + 1.0 - half - (double)ph / b.phases;
+            const double x = d / half;
+            const double w = (x > -1.0 && x < 1.0) ? MIXER_BesselI0(beta * sqrt(1.0 - x * x)) / i0beta : 0.0;
+            const double sinc = (d == 0.0) ? fc : sin(M_PI * fc * d) / (M_PI * d);
+            h[k] = sinc * w;
+            sum += h[k];
+        }
+        /* unity gain at DC for every phase */
+        for (unsigned int k=0;k < taps;k++)
+            c[k] = (float)(h[k] / sum);
+    }
+
+    LOG(LOG_MISC,LOG_DEBUG)("Mixer: resampler bank %s, cutoff %.3f of Nyquist, %u taps x %u phases",
+        mixer_resample_profiles[profile].name,fc,b.taps,b.phases);
+    return &b;
+}
+
+static int MIXER_FindResampleProfile(const std::string &name) {
+    for (unsigned int i=0;i < sizeof(mixer_resample_profiles)/sizeof(mixer_resample_profiles[0]);i++) {
+        if (!strcasecmp(name.c_str(),mixer_resample_profiles[i].name)) return (int)i;
+    }
+    return -1;
+}
+
+void MixerChannel::resamplerUpdate(void) {
+    if (resample_profile == 0 || freq_n == 0) {
+        resample = nullptr;
+        return;
+    }
+
+    resample = MIXER_GetResampleBank(resample_profile,(double)freq_d / freq_n);
+}
+
+bool MixerChannel::SetResampler(const char *profile) {
+    const int p = MIXER_FindResampleProfile(profile);
+    if (p < 0) return false;
+    if ((unsigned int)p == resample_profile) return true;
+
+    /* start from the current sample so switching over doesn't click */
+    resample_profile = (unsigned int)p;
+    resample_pos = 0;
+    for (unsigned int c=0;c < 2;c++) {
+        for (unsigned int k=0;k < MIXER_RESAMPLE_MAXTAPS*2;k++)
+            resample_hist[c][k] = (float)current[c];
+    }
+    resamplerUpdate();
+    return true;
+}
+
+const char *MixerChannel::GetResampler(void) const {
+    return mixer_resample_profiles[resample_profile].name;
+}
+
+const float *MixerChannel::GetResamplerCoef(unsigned int &taps,unsigned int &phases) const {
+    if (resample == nullptr) return NULL;
+    taps = resample->taps;
+    phases = resample->phases;
+    return resample->coef.data();
+}
+
+inline void MixerChannel::resamplerPush(void) {
+    const unsigned int taps = resample->taps;
+    for (unsigned int c=0;c < 2;c++)
+        resample_hist[c][resample_pos] = resample_hist[c][resample_pos+taps] = (float)(last[c] + delta[c]);
+    if (++resample_pos >= taps) resample_pos = 0;
+}
+
+static const char *MIXER_ResampleProfileOf(const char *channel) {
+    std::string name = channel;
+    for (auto &ch : name) ch = (char)toupper((unsigned char)ch);
+    const auto i = mixer_resample_channels.find(name);
+    return mixer_resample_profiles[i != mixer_resample_channels.end() ? i->second : mixer_resample_default].name;
+}
+
+/* "profile" or a list of "channel=profile" entries, an entry without a channel
+ * name sets the profile of every channel that isn't named. Applies to the
+ * channels that exist now and those added later. */
+static bool MIXER_SetResampler(const std::string &spec) {
+    std::vector< std::pair<std::string,unsigned int> > list;
+    std::string item;
+
+    for (size_t i=0;i <= spec.size();i++) {
+        if (i < spec.size() && spec[i] != ' ' && spec[i] != ',' && spec[i] != '\t') {
+            item += spec[i];
+            continue;
+        }
+        if (item.empty()) continue;
+
+        const size_t eq = item.find('=');
+        const int p = MIXER_FindResampleProfile(eq == std::string::npos ? item : item.substr(eq+1));
+        if (p < 0) return false;
+        std::string name = eq == std::string::npos ? std::string() : item.substr(0,eq);
+        for (auto &ch : name) ch = (char)toupper((unsigned char)ch);
+        list.push_back(std::make_pair(name,(unsigned int)p));
+        item.clear();
+    }
+
+    for (const auto &e : list) {
+        if (e.first.empty()) mixer_resample_default = e.second;
+        else mixer_resample_channels[e.first] = e.second;
+    }
+    for (MixerChannel *chan=mixer.channels;chan;chan=chan->next)
+        chan->SetResampler(MIXER_ResampleProfileOf(chan->name));
+    return true;
+}
+
 void MIXER_SetMaster(float vol0, float vol1) {
 	mixer.mastervol[0] = vol0;
 	mixer.mastervol[1] = vol1;
@@ -162,6 +384,8 @@ MixerChannel * MIXER_AddChannel(MIXER_Handler handler,Bitu freq,const char * nam
     chan->lowpass_on_out = false;
     chan->freq_d_orig = 1;
     chan->freq_f = 0;
+    chan->resample_profile = 0;
+    chan->resample = nullptr;
     chan->SetFreq(freq);
     chan->next=mixer.channels;
     chan->SetScale(1.0);
@@ -170,6 +394,7 @@ MixerChannel * MIXER_AddChannel(MIXER_Handler handler,Bitu freq,const char * nam
     chan->last[0] = chan->last[1] = 0;
     chan->delta[0] = chan->delta[1] = 0;
     chan->current[0] = chan->current[1] = 0;
+    chan->SetResampler(MIXER_ResampleProfileOf(name));
 
     mixer.channels=chan;
     return chan;
@@ -203,8 +428,8 @@ void MIXER_DelChannel(MixerChannel* delchan) {
 }
 
 void MixerChannel::UpdateVolume(void) {
-    volmul[0]=(Bits)((1 << MIXER_VOLSHIFT)*scale[0]*volmain[0]);
-    volmul[1]=(Bits)((1 << MIXER_VOLSHIFT)*scale[1]*volmain[1]);
+    volmul[0]=scale[0]*volmain[0];
+    volmul[1]=scale[1]*volmain[1];
 }
 
 void MixerChannel::SetVolume(float _left,float _right) {
@@ -256,7 +481,7 @@ void MixerChannel::lowpassUpdate() {
 
         tau = 1.0 / (lowpass_freq * 2 * M_PI);
         talpha = timeInterval / (tau + timeInterval);
-        lowpass_alpha = (int32_t)(talpha * 0x10000); // double -> 16.16 fixed point
+        lowpass_alpha = (float)talpha;
 
 //      LOG_MSG("Lowpass freq_n=%u freq_d=%u timeInterval=%.12f tau=%.12f alpha=%.6f onload=%u onout=%u",
 //          freq_n,freq_d_orig,timeInterval,tau,talpha,lowpass_on_load,lowpass_on_out);
@@ -267,15 +492,13 @@ void MixerChannel::lowpassUpdate() {
     }
 }
 
-inline int32_t MixerChannel::lowpassStep(int32_t in,const unsigned int iteration,const unsigned int channel) {
-    const int64_t m1 = (int64_t)in * (int64_t)lowpass_alpha;
-    const int64_t m2 = ((int64_t)lowpass[iteration][channel] << ((int64_t)16)) - ((int64_t)lowpass[iteration][channel] * (int64_t)lowpass_alpha);
-    const int32_t ns = (int32_t)((m1 + m2) >> (int64_t)16);
+inline float MixerChannel::lowpassStep(float in,const unsigned int iteration,const unsigned int channel) {
+    const float ns = (in * lowpass_alpha) + (lowpass[iteration][channel] * (1.0f - lowpass_alpha));
     lowpass[iteration][channel] = ns;
     return ns;
 }
 
-inline void MixerChannel::lowpassProc(int32_t ch[2]) {
+inline void MixerChannel::lowpassProc(float ch[2]) {
     for (unsigned int i=0;i < lowpass_order;i++) {
         for (unsigned int c=0;c < 2;c++)
             ch[c] = lowpassStep(ch[c],i,c);
@@ -309,6 +532,7 @@ void MixerChannel::SetFreq(Bitu _freq,Bitu _den) {
     freq_d_orig = _den;
     updateSlew();
     lowpassUpdate();
+    resamplerUpdate();
 }
 
 void CAPTURE_MultiTrackAddWave(uint32_t freq, uint32_t len, int16_t * data,const char *name);
@@ -325,14 +549,8 @@ void MixerChannel::EndFrame(Bitu samples) {
             padding = samples - cnv;
 
         if (cnv > 0) {
-            int32_t volscale1 = (int32_t)(mixer.recordvol[0] * (1 << MIXER_VOLSHIFT));
-            int32_t volscale2 = (int32_t)(mixer.recordvol[1] * (1 << MIXER_VOLSHIFT));
-
             if (cnv > 1024) cnv = 1024;
-            for (Bitu i=0;i<cnv;i++) {
-                convert[i][0]=MIXER_CLIP(((int64_t)msbuffer[i][0] * (int64_t)volscale1) >> (MIXER_VOLSHIFT + MIXER_VOLSHIFT));
-                convert[i][1]=MIXER_CLIP(((int64_t)msbuffer[i][1] * (int64_t)volscale2) >> (MIXER_VOLSHIFT + MIXER_VOLSHIFT));
-            }
+            MIXER_ToInt16(&convert[0][0],&msbuffer[0][0],cnv,mixer.recordvol);
             CAPTURE_MultiTrackAddWave(mixer.freq,cnv,(int16_t*)convert,name);
         }
 
@@ -352,7 +570,7 @@ void MixerChannel::EndFrame(Bitu samples) {
         msbuffer_o -= samples;
         if (msbuffer_i >= samples) msbuffer_i -= samples;
         else msbuffer_i = 0;
-        memmove(&msbuffer[0][0],&msbuffer[samples][0],msbuffer_o*sizeof(int32_t)*2/*stereo*/);
+        memmove(&msbuffer[0][0],&msbuffer[samples][0],msbuffer_o*sizeof(float)*2/*stereo*/);
     }
 
     last_sample_write -= (int)samples;
@@ -365,7 +583,7 @@ void MixerChannel::Mix(Bitu whole,Bitu frac) {
     if (whole <= rend_n) return;
     assert(whole <= mixer.samples_this_ms.w);
     assert(rend_n < mixer.samples_this_ms.w);
-    int32_t *outptr = &mixer.work[mixer.work_in+rend_n][0];
+    float *outptr = &mixer.work[rend_n][0];
 
     if (!enabled) {
         rend_n = whole;
@@ -404,21 +622,10 @@ void MixerChannel::Mix(Bitu whole,Bitu frac) {
         }
     }
 
-    if (mixer.swapstereo) {
-        while (rend_n < whole && msbuffer_i < upto) {
-            *outptr++ += msbuffer[msbuffer_i][1];
-            *outptr++ += msbuffer[msbuffer_i][0];
-            msbuffer_i++;
-            rend_n++;
-        }
-    }
-    else {
-        while (rend_n < whole && msbuffer_i < upto) {
-            *outptr++ += msbuffer[msbuffer_i][0];
-            *outptr++ += msbuffer[msbuffer_i][1];
-            msbuffer_i++;
-            rend_n++;
-        }
+    if (rend_n < whole && msbuffer_i < upto) {
+        const Bitu todo = std::min<Bitu>(whole - rend_n,upto - msbuffer_i);
+        MIXER_Accumulate(outptr,&msbuffer[msbuffer_i][0],todo,mixer.swapstereo);
+        msbuffer_i += todo;
     }
 
     rend_n = whole;
@@ -482,8 +689,12 @@ inline void MixerChannel::loadCurrentSample(Bitu &len, const Type* &data) {
         len = 0;
     }
 
-    if (T_lowpass && lowpass_on_load)
-        lowpassProc(current);
+    if (T_lowpass && lowpass_on_load) {
+        float ch[2] = { (float)current[0], (float)current[1] };
+        lowpassProc(ch);
+        current[0] = (int32_t)ch[0];
+        current[1] = (int32_t)ch[1];
+    }
 
     if (stereo) {
         delta[0] = current[0] - last[0];
@@ -506,6 +717,9 @@ inline void MixerChannel::loadCurrentSample(Bitu &len, const Type* &data) {
         }
     }
 
+    if (resample != nullptr)
+        resamplerPush();
+
     current_loaded = true;
 }
 
@@ -514,11 +728,13 @@ inline void MixerChannel::padFillSampleInterpolation(const Bitu upto) {
     if (msbuffer_o < upto) {
         if (freq_f > freq_d) freq_f = freq_d; // this is an abrupt stop, so interpolation must not carry over, to help avoid popping artifacts
 
-        while (msbuffer_o < upto) {
-            msbuffer[msbuffer_o][0] = current[0];
-            msbuffer[msbuffer_o][1] = current[1];
-            msbuffer_o++;
-        }
+        // the held sample is not multiplied by volmul, which on the old 13-bit fixed point bus left it at 1/8192 of its level. keep it that way.
+        const float hold[2] = {
+            (float)current[0] / (1 << MIXER_VOLSHIFT),
+            (float)current[1] / (1 << MIXER_VOLSHIFT)
+        };
+        MIXER_Fill(&msbuffer[msbuffer_o][0],upto - msbuffer_o,hold);
+        msbuffer_o = upto;
     }
 }
 
@@ -535,26 +751,63 @@ double MixerChannel::timeSinceLastSample(void) {
 inline bool MixerChannel::runSampleInterpolation(const Bitu upto) {
     if (msbuffer_o >= upto)
         return false;
+    if (resample != nullptr)
+        return runSampleResample(upto);
+
+    /* ramp from the last sample toward the current one, while freq_fslew < freq_d */
+    if (freq_fslew < freq_d) {
+        Bitu todo = upto - msbuffer_o;
+        if (freq_nslew != 0)
+            todo = (Bitu)std::min<uint64_t>(todo,((uint64_t)freq_d - freq_fslew + freq_nslew - 1u) / freq_nslew);
+
+        float start[2],step[2];
+        for (unsigned int c=0;c < 2;c++) {
+            start[c] = (float)(((double)last[c] + ((double)delta[c] * freq_fslew) / freq_d) * volmul[c]);
+            step[c] = (float)((((double)delta[c] * freq_nslew) / freq_d) * volmul[c]);
+        }
+        MIXER_Ramp(&msbuffer[msbuffer_o][0],todo,start,step);
 
-    while (freq_fslew < freq_d) {
-        int sample = last[0] + (int)(((int64_t)delta[0] * (int64_t)freq_fslew) / (int64_t)freq_d);
-        msbuffer[msbuffer_o][0] = sample * volmul[0];
-        sample = last[1] + (int)(((int64_t)delta[1] * (int64_t)freq_fslew) / (int64_t)freq_d);
-        msbuffer[msbuffer_o][1] = sample * volmul[1];
-
-        freq_f += freq_n;
-        freq_fslew += freq_nslew;
-        if ((++msbuffer_o) >= upto)
+        freq_f += (unsigned int)(todo * freq_n);
+        freq_fslew += (unsigned int)(todo * freq_nslew);
+        if ((msbuffer_o += todo) >= upto)
             return false;
     }
 
+    /* then hold it, while freq_f < freq_d */
     current[0] = last[0] + delta[0];
     current[1] = last[1] + delta[1];
+    if (freq_f < freq_d) {
+        Bitu todo = upto - msbuffer_o;
+        if (freq_n != 0)
+            todo = (Bitu)std::min<uint64_t>(todo,((uint64_t)freq_d - freq_f + freq_n - 1u) / freq_n);
+
+        const float hold[2] = { (float)current[0] * volmul[0], (float)current[1] * volmul[1] };
+        MIXER_Fill(&msbuffer[msbuffer_o][0],todo,hold);
+
+        freq_f += (unsigned int)(todo * freq_n);
+        if ((msbuffer_o += todo) >= upto)
+            return false;
+    }
+
+    return true;
+}
+
+/* windowed-sinc counterpart of the above, one convolution per output sample while freq_f < freq_d */
+inline bool MixerChannel::runSampleResample(const Bitu upto) {
+    const MixerResampleBank &b = *resample;
+    const float *l = &resample_hist[0][resample_pos];
+    const float *r = &resample_hist[1][resample_pos];
+
     while (freq_f < freq_d) {
-        msbuffer[msbuffer_o][0] = current[0] * volmul[0];
-        msbuffer[msbuffer_o][1] = current[1] * volmul[1];
+        const unsigned int phase = (unsigned int)(((uint64_t)freq_f * b.phases) / freq_d);
+        float out[2];
+
+        MIXER_Convolve(out,l,r,&b.coef[(size_t)phase * b.taps],b.taps);
+        msbuffer[msbuffer_o][0] = out[0] * volmul[0];
+        msbuffer[msbuffer_o][1] = out[1] * volmul[1];
 
         freq_f += freq_n;
+        freq_fslew = freq_f;
         if ((++msbuffer_o) >= upto)
             return false;
     }
@@ -674,6 +927,7 @@ double mixer_start_pic_time = 0;
 
 /* once a millisecond, render 1ms of audio, up to whole samples */
 static void MIXER_MixData(Bitu fracs/*render up to*/) {
+    HOSTPROF_SCOPE(HOSTPROF_MIXER);
     unsigned int prev_rendered = mixer.samples_rendered_ms.w;
     MixerChannel *chan = mixer.channels;
     unsigned int whole,frac;
@@ -700,16 +954,17 @@ static void MIXER_MixData(Bitu fracs/*render up to*/) {
      * while a game like In Extremis is running without this adjustment. */
     if (mixer.dc_bias_adj) {
         Bitu added = whole - prev_rendered;
-        Bitu readpos = mixer.work_in + prev_rendered;
-        int32_t ns;
+        Bitu readpos = prev_rendered;
+        const float step = (float)DC_ADJUSTMENT_STEP / (float)(1ul << DC_ADJBITS);
+        float ns;
 
         for (Bitu i=0;i<added;i++) {
             for (unsigned int ch=0;ch < 2;ch++) {
                 ns = mixer.work[readpos][ch] + mixer.dc_adj[ch];
-                if (ns > -((int32_t)(30000u << MIXER_VOLSHIFT)) && ns < ((int32_t)(30000u << MIXER_VOLSHIFT)))
-                    mixer.dc_adj[ch] -= (int32_t)(((int64_t)ns * (int64_t)DC_ADJUSTMENT_STEP) >> (int64_t)DC_ADJBITS);
+                if (ns > -30000.0f && ns < 30000.0f)
+                    mixer.dc_adj[ch] -= ns * step;
                 else//if the sample is out of range or nearly out of range then DC adjust FASTER to minimize distortion
-                    mixer.dc_adj[ch] -= (int32_t)(((int64_t)ns * (int64_t)DC_ADJUSTMENT_STEP * 64ll) >> (int64_t)DC_ADJBITS);
+                    mixer.dc_adj[ch] -= ns * step * 64.0f;
                 mixer.work[readpos][ch] = ns;
             }
 
@@ -718,40 +973,30 @@ static void MIXER_MixData(Bitu fracs/*render up to*/) {
     }
 
     if (CaptureState & (CAPTURE_WAVE|CAPTURE_VIDEO)) {
-        int32_t volscale1 = (int32_t)(mixer.recordvol[0] * (1 << MIXER_VOLSHIFT));
-        int32_t volscale2 = (int32_t)(mixer.recordvol[1] * (1 << MIXER_VOLSHIFT));
         int16_t convert[1024][2];
         Bitu added = whole - prev_rendered;
         if (added>1024) added=1024;
-        Bitu readpos = mixer.work_in + prev_rendered;
-        for (Bitu i=0;i<added;i++) {
-            convert[i][0]=MIXER_CLIP(((int64_t)mixer.work[readpos][0] * (int64_t)volscale1) >> (MIXER_VOLSHIFT + MIXER_VOLSHIFT));
-            convert[i][1]=MIXER_CLIP(((int64_t)mixer.work[readpos][1] * (int64_t)volscale2) >> (MIXER_VOLSHIFT + MIXER_VOLSHIFT));
-            readpos++;
-        }
+        Bitu readpos = prev_rendered;
+        MIXER_ToInt16(&convert[0][0],&mixer.work[readpos][0],added,mixer.recordvol);
+        readpos += added;
         assert(readpos <= MIXER_BUFSIZE);
         CAPTURE_AddWave( mixer.freq, added, (int16_t*)convert );
     }
 
+    if (!mixer.nosound)
+        MIXER_RingWrite(&mixer.work[prev_rendered][0],whole - prev_rendered);
+
     mixer.samples_rendered_ms.w = whole;
     mixer.samples_rendered_ms.fd = frac;
     mixer_sample_counter += mixer.samples_rendered_ms.w - prev_rendered;
 }
 
+/* No need to lock the audio device here, the callback only ever sees the
+ * rendered samples once they are queued in mixer_ring. */
 static void MIXER_FillUp(void) {
-#ifdef C_SDL2
-    SDL_LockAudioDevice(SDL2_AudioDevice);
-#else
-    SDL_LockAudio();
-#endif
     float index = PIC_TickIndex();
     if (index < 0) index = 0;
     MIXER_MixData((Bitu)((double)index * ((Bitu)mixer.samples_this_ms.w * mixer.samples_this_ms.fd)));
-#ifdef C_SDL2
-    SDL_UnlockAudioDevice(SDL2_AudioDevice);
-#else
-    SDL_UnlockAudio();
-#endif
 }
 
 void MixerChannel::FillUp(void) {
@@ -764,18 +1009,8 @@ void MIXER_MixSingle(Bitu /*val*/) {
 }
 
 static void MIXER_Mix(void) {
-    Bitu thr;
-
-#ifdef C_SDL2
-    SDL_LockAudioDevice(SDL2_AudioDevice);
-#else
-    SDL_LockAudio();
-#endif
-
     /* render */
-    assert((mixer.work_in+mixer.samples_per_ms.w) <= MIXER_BUFSIZE);
     MIXER_MixData((Bitu)mixer.samples_this_ms.w * (Bitu)mixer.samples_this_ms.fd);
-    mixer.work_in += mixer.samples_this_ms.w;
 
     /* how many samples for the next ms? */
     mixer.samples_this_ms.w = mixer.samples_per_ms.w;
@@ -785,64 +1020,35 @@ static void MIXER_Mix(void) {
         mixer.samples_this_ms.w++;
     }
 
-    /* advance. we use in/out & wrap pointers to make sure the rendering code
-     * doesn't have to worry about circular buffer wraparound. */
-    thr = mixer.blocksize;
-    if (thr < mixer.samples_this_ms.w) thr = mixer.samples_this_ms.w;
-    if ((mixer.work_in+thr) > MIXER_BUFSIZE) {
-        mixer.work_wrap = mixer.work_in;
-        mixer.work_in = 0;
-    }
-    assert((mixer.work_in+thr) <= MIXER_BUFSIZE);
-    assert((mixer.work_in+mixer.samples_this_ms.w) <= MIXER_BUFSIZE);
-    memset(&mixer.work[mixer.work_in][0],0,sizeof(int32_t)*2*mixer.samples_this_ms.w);
+    /* the finished millisecond is in mixer_ring, start the next one */
+    assert(mixer.samples_this_ms.w <= MIXER_BUFSIZE);
+    memset(&mixer.work[0][0],0,sizeof(float)*2*mixer.samples_this_ms.w);
     mixer.samples_rendered_ms.fn = 0;
     mixer.samples_rendered_ms.w = 0;
-#ifdef C_SDL2
-    SDL_UnlockAudioDevice(SDL2_AudioDevice);
-#else
-    SDL_UnlockAudio();
-#endif
     MIXER_FillUp();
 }
 
 static void SDLCALL MIXER_CallBack(void * userdata, Uint8 *stream, int len) {
     (void)userdata;//UNUSED
-    int32_t volscale1 = (int32_t)(mixer.mastervol[0] * (1 << MIXER_VOLSHIFT));
-    int32_t volscale2 = (int32_t)(mixer.mastervol[1] * (1 << MIXER_VOLSHIFT));
     Bitu need = (Bitu)len/MIXER_SSIZE;
     int16_t *output = (int16_t*)stream;
-    int remains;
+    Bitu target = mixer_ring.target.load(std::memory_order_relaxed);
+    bool playing = false;
+    Bitu remains;
 
-    if (mixer.mute) {
-        if ((CaptureState & (CAPTURE_WAVE|CAPTURE_VIDEO|CAPTURE_MULTITRACK_WAVE)) != 0)
-            mixer.work_out = mixer.work_in;
-        else
-            mixer.work_out = mixer.work_in = 0;
-    }
+    if (mixer.mute)
+        MIXER_RingDrop(mixer_ring.Buffered());
 
     if (mixer.prebuffer_wait) {
-        remains = (int)mixer.work_in - (int)mixer.work_out;
-        if (remains < 0) remains += (int)mixer.work_wrap;
-        if (remains < 0) remains = 0;
-
-        if ((unsigned int)remains >= mixer.prebuffer_samples)
+        if (mixer_ring.Buffered() >= mixer.prebuffer_samples)
             mixer.prebuffer_wait = false;
     }
 
     if (!mixer.prebuffer_wait && !mixer.mute && need > 0) {
-        int32_t *in = &mixer.work[mixer.work_out][0];
-        while (need > 0) {
-            if (mixer.work_out == mixer.work_in) break;
-            *output++ = MIXER_CLIP((((int64_t)(*in++)) * (int64_t)volscale1) >> (MIXER_VOLSHIFT + MIXER_VOLSHIFT));
-            *output++ = MIXER_CLIP((((int64_t)(*in++)) * (int64_t)volscale2) >> (MIXER_VOLSHIFT + MIXER_VOLSHIFT));
-            mixer.work_out++;
-            if (mixer.work_out >= mixer.work_wrap) {
-                mixer.work_out = 0;
-                in = &mixer.work[mixer.work_out][0];
-            }
-            need--;
-        }
+        const Bitu got = MIXER_RingRead(output,need);
+        output += got * 2u;
+        need -= got;
+        playing = true;
         if (output != (int16_t*)stream) {
             /* assume output != stream */
             mixer.last_dac[0] = (output-2)[0];
@@ -850,8 +1056,27 @@ static void SDLCALL MIXER_CallBack(void * userdata, Uint8 *stream, int len) {
         }
     }
 
-    if (need > 0)
+    if (need > 0) {
+        /* ran dry while playing, so allow more to build up from now on */
+        if (playing) {
+            mixer_ring.underruns.fetch_add(1,std::memory_order_relaxed);
+            target = std::min<Bitu>(target + mixer.samples_per_ms.w,MIXER_BUFSIZE / 4u);
+            mixer_ring.stable = 0;
+        }
         mixer.prebuffer_wait = true;
+    }
+    else if (playing) {
+        /* and after 10 seconds without, try 1ms less again */
+        mixer_ring.stable += (Bitu)len/MIXER_SSIZE;
+        if (mixer_ring.stable >= (mixer.freq * 10u)) {
+            mixer_ring.stable = 0;
+            if (target > (mixer.blocksize + mixer.samples_per_ms.w))
+                target -= mixer.samples_per_ms.w;
+            else
+                target = mixer.blocksize;
+        }
+    }
+    mixer_ring.target.store(target,std::memory_order_relaxed);
 
     while (need > 0) {
         *output++ = mixer.last_dac[0];
@@ -859,23 +1084,19 @@ static void SDLCALL MIXER_CallBack(void * userdata, Uint8 *stream, int len) {
         need--;
     }
 
-    remains = (int)mixer.work_in - (int)mixer.work_out;
-    if (remains < 0) remains += (int)mixer.work_wrap;
+    remains = mixer_ring.Buffered();
 
-    if ((unsigned long)remains >= (mixer.blocksize*2UL)) {
+    if (remains >= (target*2UL)) {
         /* drop some samples to keep time */
-        unsigned int drop;
+        Bitu drop;
 
-        if ((unsigned long)remains >= (mixer.blocksize*3UL)) // hard drop
-            drop = ((unsigned int)remains - (unsigned int)(mixer.blocksize));
+        if (remains >= (target*3UL)) // hard drop
+            drop = remains - target;
         else // subtle drop
-            drop = (((unsigned int)remains - (unsigned int)(mixer.blocksize*2)) / 50U) + 1;
+            drop = ((remains - (target*2)) / 50U) + 1;
 
-        while (drop > 0) {
-            mixer.work_out++;
-            if (mixer.work_out >= mixer.work_wrap) mixer.work_out = 0;
-            drop--;
-        }
+        mixer_ring.dropped.fetch_add((unsigned long)drop,std::memory_order_relaxed);
+        MIXER_RingDrop(drop);
     }
 }
 
@@ -894,11 +1115,25 @@ std::string mixerinfo() {
     info+=std::string(str);
     MixerChannel * chan=mixer.channels;
     for (chan=mixer.channels;chan;chan=chan->next) {
-        sprintf(str, "%-8s %3.0f:%-3.0f  %+3.2f:%-+3.2f\n",chan->name,
+        sprintf(str, "%-8s %3.0f:%-3.0f  %+3.2f:%-+3.2f",chan->name,
             (double)chan->volmain[0]*100,(double)chan->volmain[1]*100,
             20*log(chan->volmain[0])/log(10.0f),20*log(chan->volmain[1])/log(10.0f)
         );
         info+=std::string(str);
+        if (chan->resample_profile != 0) {
+            info+="  ";
+            info+=chan->GetResampler();
+        }
+        info+="\n";
+    }
+    if (!mixer.nosound) {
+        const double ms = 1000.0 / mixer.freq;
+        sprintf(str, "\nBuffered %.1fms, target %.1fms\n",
+            (double)mixer_ring.Buffered()*ms,(double)mixer_ring.target.load()*ms);
+        info+=std::string(str);
+        sprintf(str, "Underruns %lu, overruns %lu\nDropped %lu samples\n",
+            mixer_ring.underruns.load(),mixer_ring.overruns.load(),mixer_ring.dropped.load());
+        info+=std::string(str);
     }
     return info;
 }
@@ -937,15 +1172,23 @@ public:
     void Run(void) override {
         if (cmd->FindExist("-?", false) || cmd->FindExist("/?", false)) {
 			WriteOut("Displays or changes the current sound mixer volumes.\n\n"
-                    "MIXER [/GUI|/NOSHOW] [/LISTMIDI [handler]] [channel volume]\n\n"
+                    "MIXER [/GUI|/NOSHOW] [/LISTMIDI [handler]] [/RESAMPLER resampler] [channel volume]\n\n"
                     "  /GUI      Displays a dialog box showing the sound volumes.\n"
                     "  /NOSHOW   Does not show volumes when making changes to channel volumes.\n"
                     "  /LISTMIDI Lists and shows options for the current MIDI device handler.\n"
                     "            You can also add a handler name to show the specified handler.\n"
+                    "  /RESAMPLER Sets how channels are converted to the mixer rate, like the\n"
+                    "            resampler option (e.g. linear, best, or fm=best,sb=medium).\n"
                     "  channel   A sound channel name (such as MASTER, RECORD, and SPKR).\n"
                     "  volume    An integer between 0 and 100 representing the sound volume.\n");
             return;
 		}
+        if (cmd->FindString("/RESAMPLER",temp_line,true)) {
+            if (!MIXER_SetResampler(temp_line)) {
+                WriteOut("Invalid resampler \"%s\", use linear, fast, medium or best.\n",temp_line.c_str());
+                return;
+            }
+        }
         if(cmd->FindString("/LISTMIDI",temp_line,true)) {
             void MIDI_ListHandler(Program *caller, const char *name);
             MIDI_ListHandler(this, temp_line.c_str());
@@ -1113,6 +1356,13 @@ void MIXER_Init() {
     mixer.prebuffer_samples=0;
     mixer.prebuffer_wait=true;
     mixer.channels = nullptr;
+    mixer_resample_default=0;
+    mixer_resample_channels.clear();
+    {
+        const std::string resampler = section->Get_string("resampler");
+        if (!MIXER_SetResampler(resampler))
+            LOG_MSG("MIXER: Invalid resampler \"%s\", using linear interpolation",resampler.c_str());
+    }
     mixer.pos=0;
     mixer.done=0;
     memset(mixer.work,0,sizeof(mixer.work));
@@ -1180,9 +1430,8 @@ void MIXER_Init() {
     }
     mixer_start_pic_time = PIC_FullIndex();
     mixer_sample_counter = 0;
-    mixer.work_in = mixer.work_out = 0;
-    mixer.work_wrap = MIXER_BUFSIZE;
-    if (mixer.work_wrap <= mixer.blocksize) E_Exit("blocksize too large");
+    if (MIXER_BUFSIZE <= mixer.blocksize) E_Exit("blocksize too large");
+    mixer_ring.target = mixer.blocksize;
 
     {
         int ms = section->Get_int("prebuffer");
@@ -1190,8 +1439,8 @@ void MIXER_Init() {
         if (ms < 0) ms = 20;
 
         mixer.prebuffer_samples = ((unsigned int)ms * (unsigned int)mixer.freq) / 1000u;
-        if (mixer.prebuffer_samples > (mixer.work_wrap / 2))
-            mixer.prebuffer_samples = (mixer.work_wrap / 2);
+        if (mixer.prebuffer_samples > (MIXER_BUFSIZE / 2))
+            mixer.prebuffer_samples = (MIXER_BUFSIZE / 2);
     }
 
     // how many samples per millisecond? compute as improper fraction (sample rate / 1000)
@@ -1255,6 +1504,9 @@ void MixerChannel::LoadState( std::istream& stream )
 	//READ_POD( &freq_add, freq_add );
 	READ_POD( &enabled, enabled );
 
+	// volmul was fixed point in older save states
+	UpdateVolume();
+
 	//********************************************
 	//********************************************
 	//********************************************
@@ -0,0 +1,248 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Kernels of the mixer's float32 bus, included by mixer.cpp.
+ *
+ * All buffers are interleaved stereo and counts are in sample frames. The bus
+ * is in 16-bit sample units, +/-32767 is full scale, so there is plenty of
+ * headroom before the final conversion clips. The SSE2 versions are used on
+ * any x86 build that has SSE2 as a baseline (x86_64 always does) and NEON on
+ * ARM, the lowpass filters and the DC bias correction depend on the previous
+ * sample and stay in mixer.cpp. MIXER_Convolve is the inner loop of the
+ * windowed-sinc resampler, it sums in a different order than the C version so
+ * the results differ by float rounding. */
+
+#ifndef DOSBOX_MIXER_SIMD_H
+#define DOSBOX_MIXER_SIMD_H
+
+#include "dosbox.h"
+#include "mixer.h"
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_AMD64) || defined(_M_X64)
+# define MIXER_SSE2 1
+# include <emmintrin.h>
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__))
+# define MIXER_NEON 1
+# include <arm_neon.h>
+#endif
+
+/* a linear ramp: frame k is start + k*step */
+static inline void MIXER_Ramp_C(float *dst,Bitu count,const float start[2],const float step[2]) {
+    for (Bitu k=0;k < count;k++) {
+        dst[k*2u+0u] = start[0] + (float)k * step[0];
+        dst[k*2u+1u] = start[1] + (float)k * step[1];
+    }
+}
+
+static inline void MIXER_Fill_C(float *dst,Bitu count,const float val[2]) {
+    for (Bitu k=0;k < count;k++) {
+        dst[k*2u+0u] = val[0];
+        dst[k*2u+1u] = val[1];
+    }
+}
+
+static inline void MIXER_Accumulate_C(float *dst,const float *src,Bitu count,bool swapstereo) {
+    const unsigned int l = swapstereo ? 1u : 0u;
+    for (Bitu k=0;k < count;k++) {
+        dst[k*2u+0u] += src[k*2u+l];
+        dst[k*2u+1u] += src[k*2u+(l^1u)];
+    }
+}
+
+/* scale by vol, round to nearest and clip to 16 bits */
+static inline void MIXER_ToInt16_C(int16_t *dst,const float *src,Bitu count,const float vol[2]) {
+    for (Bitu k=0;k < count*2u;k++) {
+        float s = src[k] * vol[k&1u];
+        if (s > (float)MAX_AUDIO) s = (float)MAX_AUDIO;
+        else if (s < (float)MIN_AUDIO) s = (float)MIN_AUDIO;
+        dst[k] = (int16_t)lrintf(s);
+    }
+}
+
+/* one output frame of the windowed-sinc resampler: taps input samples of each
+ * channel, oldest first, times one phase of the filter bank. taps is a multiple of 4 */
+static inline void MIXER_Convolve_C(float out[2],const float *l,const float *r,const float *coef,unsigned int taps) {
+    float sl = 0.0f,sr = 0.0f;
+    for (unsigned int k=0;k < taps;k++) {
+        sl += l[k] * coef[k];
+        sr += r[k] * coef[k];
+    }
+    out[0] = sl;
+    out[1] = sr;
+}
+
+#if defined(MIXER_SSE2)
+static inline void MIXER_Ramp(float *dst,Bitu count,const float start[2],const float step[2]) {
+    const __m128 s = _mm_setr_ps(start[0],start[1],start[0],start[1]);
+    const __m128 st = _mm_setr_ps(step[0],step[1],step[0],step[1]);
+    const __m128 two = _mm_set1_ps(2.0f);
+    __m128 kv = _mm_setr_ps(0.0f,0.0f,1.0f,1.0f);
+    Bitu k = 0;
+    for (;k + 2u <= count;k += 2u) {
+        _mm_storeu_ps(dst + k*2u,_mm_add_ps(s,_mm_mul_ps(kv,st)));
+        kv = _mm_add_ps(kv,two);
+    }
+    if (k < count) {
+        dst[k*2u+0u] = start[0] + (float)k * step[0];
+        dst[k*2u+1u] = start[1] + (float)k * step[1];
+    }
+}
+
+static inline void MIXER_Fill(float *dst,Bitu count,const float val[2]) {
+    const __m128 v = _mm_setr_ps(val[0],val[1],val[0],val[1]);
+    Bitu k = 0;
+    for (;k + 2u <= count;k += 2u)
+        _mm_storeu_ps(dst + k*2u,v);
+    if (k < count) {
+        dst[k*2u+0u] = val[0];
+        dst[k*2u+1u] = val[1];
+    }
+}
+
+static inline void MIXER_Accumulate(float *dst,const float *src,Bitu count,bool swapstereo) {
+    Bitu k = 0;
+    if (swapstereo) {
+        for (;k + 2u <= count;k += 2u) {
+            const __m128 v = _mm_loadu_ps(src + k*2u);
+            _mm_storeu_ps(dst + k*2u,_mm_add_ps(_mm_loadu_ps(dst + k*2u),_mm_shuffle_ps(v,v,_MM_SHUFFLE(2,3,0,1))));
+        }
+    }
+    else {
+        for (;k + 2u <= count;k += 2u)
+            _mm_storeu_ps(dst + k*2u,_mm_add_ps(_mm_loadu_ps(dst + k*2u),_mm_loadu_ps(src + k*2u)));
+    }
+    MIXER_Accumulate_C(dst + k*2u,src + k*2u,count - k,swapstereo);
+}
+
+static inline void MIXER_ToInt16(int16_t *dst,const float *src,Bitu count,const float vol[2]) {
+    const __m128 v = _mm_setr_ps(vol[0],vol[1],vol[0],vol[1]);
+    const __m128 hi = _mm_set1_ps((float)MAX_AUDIO), lo = _mm_set1_ps((float)MIN_AUDIO);
+    Bitu k = 0;
+    for (;k + 4u <= count;k += 4u) {
+        const __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + k*2u),v),lo),hi);
+        const __m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + k*2u + 4u),v),lo),hi);
+        _mm_storeu_si128((__m128i*)(dst + k*2u),_mm_packs_epi32(_mm_cvtps_epi32(a),_mm_cvtps_epi32(b)));
+    }
+    MIXER_ToInt16_C(dst + k*2u,src + k*2u,count - k,vol);
+}
+
+static inline void MIXER_Convolve(float out[2],const float *l,const float *r,const float *coef,unsigned int taps) {
+    __m128 sl = _mm_setzero_ps(),sr = _mm_setzero_ps();
+    for (unsigned int k=0;k < taps;k += 4u) {
+        const __m128 c = _mm_loadu_ps(coef + k);
+        sl = _mm_add_ps(sl,_mm_mul_ps(_mm_loadu_ps(l + k),c));
+        sr = _mm_add_ps(sr,_mm_mul_ps(_mm_loadu_ps(r + k),c));
+    }
+    /* l0+l2 r0+r2 l1+l3 r1+r3, then fold the upper half onto the lower */
+    const __m128 t = _mm_add_ps(_mm_unpacklo_ps(sl,sr),_mm_unpackhi_ps(sl,sr));
+    const __m128 s = _mm_add_ps(t,_mm_movehl_ps(t,t));
+    _mm_storel_pi((__m64*)out,s);
+}
+#elif defined(MIXER_NEON)
+static inline void MIXER_Ramp(float *dst,Bitu count,const float start[2],const float step[2]) {
+    const float s4[4] = { start[0],start[1],start[0],start[1] };
+    const float st4[4] = { step[0],step[1],step[0],step[1] };
+    const float k4[4] = { 0.0f,0.0f,1.0f,1.0f };
+    const float32x4_t s = vld1q_f32(s4), st = vld1q_f32(st4), two = vdupq_n_f32(2.0f);
+    float32x4_t kv = vld1q_f32(k4);
+    Bitu k = 0;
+    for (;k + 2u <= count;k += 2u) {
+        vst1q_f32(dst + k*2u,vaddq_f32(s,vmulq_f32(kv,st)));
+        kv = vaddq_f32(kv,two);
+    }
+    if (k < count) {
+        dst[k*2u+0u] = start[0] + (float)k * step[0];
+        dst[k*2u+1u] = start[1] + (float)k * step[1];
+    }
+}
+
+static inline void MIXER_Fill(float *dst,Bitu count,const float val[2]) {
+    const float v4[4] = { val[0],val[1],val[0],val[1] };
+    const float32x4_t v = vld1q_f32(v4);
+    Bitu k = 0;
+    for (;k + 2u <= count;k += 2u)
+        vst1q_f32(dst + k*2u,v);
+    if (k < count) {
+        dst[k*2u+0u] = val[0];
+        dst[k*2u+1u] = val[1];
+    }
+}
+
+static inline void MIXER_Accumulate(float *dst,const float *src,Bitu count,bool swapstereo) {
+    Bitu k = 0;
+    if (swapstereo) {
+        for (;k + 2u <= count;k += 2u)
+            vst1q_f32(dst + k*2u,vaddq_f32(vld1q_f32(dst + k*2u),vrev64q_f32(vld1q_f32(src + k*2u))));
+    }
+    else {
+        for (;k + 2u <= count;k += 2u)
+            vst1q_f32(dst + k*2u,vaddq_f32(vld1q_f32(dst + k*2u),vld1q_f32(src + k*2u)));
+    }
+    MIXER_Accumulate_C(dst + k*2u,src + k*2u,count - k,swapstereo);
+}
+
+static inline void MIXER_ToInt16(int16_t *dst,const float *src,Bitu count,const float vol[2]) {
+#if defined(__aarch64__)
+    const float v4[4] = { vol[0],vol[1],vol[0],vol[1] };
+    const float32x4_t v = vld1q_f32(v4);
+    Bitu k = 0;
+    for (;k + 4u <= count;k += 4u) {
+        const int32x4_t a = vcvtnq_s32_f32(vmulq_f32(vld1q_f32(src + k*2u),v));
+        const int32x4_t b = vcvtnq_s32_f32(vmulq_f32(vld1q_f32(src + k*2u + 4u),v));
+        vst1q_s16(dst + k*2u,vcombine_s16(vqmovn_s32(a),vqmovn_s32(b)));
+    }
+    MIXER_ToInt16_C(dst + k*2u,src + k*2u,count - k,vol);
+#else
+    /* no round to nearest conversion before ARMv8 */
+    MIXER_ToInt16_C(dst,src,count,vol);
+#endif
+}
+
+static inline void MIXER_Convolve(float out[2],const float *l,const float *r,const float *coef,unsigned int taps) {
+    float32x4_t sl = vdupq_n_f32(0.0f),sr = vdupq_n_f32(0.0f);
+    for (unsigned int k=0;k < taps;k += 4u) {
+        const float32x4_t c = vld1q_f32(coef + k);
+        sl = vmlaq_f32(sl,vld1q_f32(l + k),c);
+        sr = vmlaq_f32(sr,vld1q_f32(r + k),c);
+    }
+    const float32x2_t s = vpadd_f32(vadd_f32(vget_low_f32(sl),vget_high_f32(sl)),vadd_f32(vget_low_f32(sr),vget_high_f32(sr)));
+    vst1_f32(out,s);
+}
+#else
+static inline void MIXER_Ramp(float *dst,Bitu count,const float start[2],const float step[2]) {
+    MIXER_Ramp_C(dst,count,start,step);
+}
+
+static inline void MIXER_Fill(float *dst,Bitu count,const float val[2]) {
+    MIXER_Fill_C(dst,count,val);
+}
+
+static inline void MIXER_Accumulate(float *dst,const float *src,Bitu count,bool swapstereo) {
+    MIXER_Accumulate_C(dst,src,count,swapstereo);
+}
+
+static inline void MIXER_ToInt16(int16_t *dst,const float *src,Bitu count,const float vol[2]) {
+    MIXER_ToInt16_C(dst,src,count,vol);
+}
+
+static inline void MIXER_Convolve(float out[2],const float *l,const float *r,const float *coef,unsigned int taps) {
+    MIXER_Convolve_C(out,l,r,coef,taps);
+}
+#endif
+
+#endif
@@ -1496,6 +1496,26 @@ void dosbox_write(Bitu port, Bitu val, Bitu len) {
 	theNE2kDevice->write((uint32_t)port, (uint32_t)val, (unsigned int)len);
 }
 
+// REP INSW/OUTSW on the data port: the remote DMA one word after the other,
+// minus the port dispatch of every access
+Bitu dosbox_read_block(Bitu port, uint8_t *buf, Bitu len, Bitu count) {
+	(void)port;
+	for (Bitu i = 0; i < count; i++) {
+		const uint32_t val = theNE2kDevice->asic_read(0, (unsigned int)len);
+		if (len == 2) host_writew(buf + (i * 2), (uint16_t)val);
+		else buf[i] = (uint8_t)val;
+	}
+	return count;
+}
+Bitu dosbox_write_block(Bitu port, const uint8_t *buf, Bitu len, Bitu count) {
+	(void)port;
+	for (Bitu i = 0; i < count; i++) {
+		const uint32_t val = (len == 2) ? host_readw(buf + (i * 2)) : buf[i];
+		theNE2kDevice->asic_write(0, val, (unsigned int)len);
+	}
+	return count;
+}
+
 void bx_ne2k_c::init()
 {
   //BX_DEBUG(("Init $Id: ne2k.cc,v 1.56.2.1 2004/02/02 22:37:22 cbothamy Exp $"));
@@ -1681,6 +1701,8 @@ public:
 			WriteHandler8[i].Install((i+theNE2kDevice->s.base_address),
 				dosbox_write,IO_MB|IO_MW);
 		}
+		IO_RegisterReadBlockHandler(theNE2kDevice->s.base_address+0x10,dosbox_read,dosbox_read_block);
+		IO_RegisterWriteBlockHandler(theNE2kDevice->s.base_address+0x10,dosbox_write,dosbox_write_block);
 		TIMER_AddTickHandler(NE2000_Poller);
 		addne2k = true;
 	}
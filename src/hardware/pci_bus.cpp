@@ -31,6 +31,7 @@
 #include "../ints/int10.h"
 #include "voodoo.h"
 #include "control.h"
+#include "ide.h"
 
 bool pcibus_enable = false;
 bool log_pci = false;
@@ -352,6 +353,72 @@ public:
 	}
 };
 
+class PCI_IDEBusMasterDevice:public PCI_Device {
+private:
+	static const uint16_t vendor=0x8086;	// Intel
+	static const uint16_t device=0x7010;	// 82371SB PIIX3 IDE
+	static const uint16_t default_base=0xFFA0;
+
+	/* the bus master registers themselves are emulated in ide.cpp */
+	void UpdateBase() {
+		IDE_BusMaster_SetBase((config[0x04] & 0x01) ? (host_readd(config+0x20) & 0xFFF0u) : 0u);
+	}
+public:
+	PCI_IDEBusMasterDevice():PCI_Device(vendor,device) {
+		config[0x08] = 0x00;	// revision
+		config[0x09] = 0x80;	// interface (bus master, both channels in compatibility mode)
+		config[0x0a] = 0x01;	// subclass code (IDE controller)
+		config[0x0b] = 0x01;	// class code (mass storage controller)
+		config[0x0d] = 0x40;	// latency timer
+		config[0x0e] = 0x00;	// header type (other)
+
+		// reset, as the BIOS would leave it
+		config[0x04] = 0x05;	// command register (I/O space and bus master enabled)
+		config[0x05] = 0x00;
+		config[0x06] = 0x80;	// status register (fast back-to-back)
+		config[0x07] = 0x02;	// DEVSEL timing medium
+
+		host_writew(config_writemask+0x04,0x0005);	/* allow changing I/O enable and bus master enable */
+
+		host_writed(config_writemask+0x20,0x0000FFF0);	/* BAR4: bus master I/O, 16 ports */
+		host_writed(config+0x20,(uint32_t)default_base | 0x1);
+
+		/* IDETIM (primary, secondary) and SIDETIM. Nothing to time here, but PIIX drivers
+		 * program them, and bit 15 of IDETIM enables the channel */
+		host_writed(config_writemask+0x40,0xFFFFFFFF);
+		config_writemask[0x44] = 0xFF;
+		host_writew(config+0x40,0x8000);
+		host_writew(config+0x42,0x8000);
+
+		UpdateBase();
+	}
+	~PCI_IDEBusMasterDevice() {
+		IDE_BusMaster_SetBase(0);
+	}
+
+	void config_write(uint8_t regnum,Bitu iolen,uint32_t value) override {
+		if (iolen == 1) {
+			const unsigned char mask = config_writemask[regnum];
+			const unsigned char nmask = ~mask;
+
+			config[regnum] = ((unsigned char)value & mask) + (config[regnum] & nmask);
+
+			switch (regnum) {
+				case 0x04:
+				case 0x20:
+				case 0x21:
+					UpdateBase();
+					break;
+				default:
+					break;
+			}
+		}
+		else {
+			PCI_Device::config_write(regnum,iolen,value); /* which will break down I/O into 8-bit */
+		}
+	}
+};
+
 static bool initialized = false;
 
 static IO_WriteHandleObject PCI_WriteHandler[5];
@@ -470,6 +537,7 @@ static void Deinitialize(void) {
 static PCI_Device *S3_PCI=NULL;
 static PCI_Device *SST_PCI=NULL;
 static PCI_Device *DOSBoxIG_PCI=NULL;
+static PCI_Device *IDEBM_PCI=NULL;
 
 extern bool enable_pci_vga;
 
@@ -541,6 +609,27 @@ void PCI_RemoveSST_Device(void) {
 	}
 }
 
+void PCI_AddIDEBusMaster_Device(void) {
+	if (!pcibus_enable) return;
+
+	if (IDEBM_PCI == NULL) {
+		LOG(LOG_MISC,LOG_DEBUG)("Initializing PCI bus master IDE device");
+		if ((IDEBM_PCI=new PCI_IDEBusMasterDevice()) == NULL)
+			return;
+
+		RegisterPCIDevice(IDEBM_PCI);
+	}
+}
+
+void PCI_RemoveIDEBusMaster_Device(void) {
+	if (IDEBM_PCI != NULL) {
+		/* not registered anymore if the PCI bus was reinitialized (and deleted it) since */
+		if (UnregisterPCIDevice(IDEBM_PCI))
+			delete IDEBM_PCI;
+		IDEBM_PCI = NULL;
+	}
+}
+
 PhysPt PCI_GetPModeInterface(void) {
 	if (!pcibus_enable) return 0;
 	return GetPModeCallbackPointer();
@@ -18,6 +18,10 @@
 
 #include <assert.h>
 
+#include <algorithm>
+#include <map>
+#include <vector>
+
 #include "dosbox.h"
 #include "inout.h"
 #include "cpu.h"
@@ -27,12 +31,17 @@
 #include "timer.h"
 #include "setup.h"
 #include "control.h"
+#include "benchmark.h"
+#include "hostprof.h"
 
 #if defined(_MSC_VER)
 # pragma warning(disable:4244) /* const fmath::local::uint64_t to double possible loss of data */
 #endif
 
+/* Number of event slots written to / read from save states. The live queue
+ * itself is not limited to this and grows on demand. */
 #define PIC_QUEUESIZE 8192
+#define PIC_NOENTRY (~0u)
 
 unsigned long PIC_irq_delay_ns = 0;
 
@@ -225,18 +234,30 @@ void PIC_Controller::start_irq(uint8_t val){
     }
 }
 
+/* Scheduled events live in a growable pool and are ordered by a binary
+ * min-heap on (index, seq). seq is a monotonic insertion counter, so events
+ * scheduled for the same index fire in the order they were added, exactly
+ * like the old sorted linked list did. Every pending entry is also on a
+ * doubly linked chain of entries sharing the same handler, so that
+ * PIC_RemoveEvents() and PIC_RemoveSpecificEvents() only visit the entries
+ * they can actually remove. */
 struct PICEntry {
     pic_tickindex_t index;
     Bitu value;
     PIC_EventHandler pic_event;
-    PICEntry * next;
+    uint64_t seq;
+    uint32_t heap_pos;      // position in pic_queue.heap, PIC_NOENTRY if free
+    uint32_t next;          // next entry with the same handler, or next free entry
+    uint32_t prev;          // previous entry with the same handler
 };
 
 static struct {
-    PICEntry entries[PIC_QUEUESIZE];
-    PICEntry * free_entry;
-    PICEntry * next_entry;
-} pic_queue;
+    std::vector<PICEntry> entries;
+    std::vector<uint32_t> heap;
+    std::map<PIC_EventHandler,uint32_t> handler_head;
+    uint32_t free_entry;
+    uint64_t seq;
+} pic_queue = { {}, {}, {}, PIC_NOENTRY, 0 };
 
 static void write_command(Bitu port,Bitu val,Bitu iolen) {
     (void)iolen;//UNUSED
@@ -620,31 +641,128 @@ void DEBUG_PICMask(int irq,bool mask) {
         PIC_SetIRQMask((unsigned int)irq,mask);
 }
 
-static void AddEntry(PICEntry * entry) {
-    PICEntry * find_entry=pic_queue.next_entry;
-    if (GCC_UNLIKELY(!find_entry)) {
-        entry->next = nullptr;
-        pic_queue.next_entry=entry;
-    } else if (find_entry->index>entry->index) {
-        pic_queue.next_entry=entry;
-        entry->next=find_entry;
-    } else while (find_entry) {
-        if (find_entry->next) {
-            /* See if the next index comes later than this one */
-            if (find_entry->next->index > entry->index) {
-                entry->next=find_entry->next;
-                find_entry->next=entry;
-                break;
-            } else {
-                find_entry=find_entry->next;
-            }
-        } else {
-            entry->next=find_entry->next;
-            find_entry->next=entry;
-            break;
-        }
+static inline bool PIC_EntryBefore(const PICEntry &a,const PICEntry &b) {
+    if (a.index != b.index) return a.index < b.index;
+    return a.seq < b.seq;
+}
+
+static inline void PIC_HeapPlace(uint32_t pos,uint32_t id) {
+    pic_queue.heap[pos] = id;
+    pic_queue.entries[id].heap_pos = pos;
+}
+
+static void PIC_HeapSiftUp(uint32_t pos) {
+    const uint32_t id = pic_queue.heap[pos];
+    while (pos > 0) {
+        const uint32_t parent = (pos - 1u) >> 1u;
+        if (!PIC_EntryBefore(pic_queue.entries[id],pic_queue.entries[pic_queue.heap[parent]])) break;
+        PIC_HeapPlace(pos,pic_queue.heap[parent]);
+        pos = parent;
     }
-    Bits cycles=PIC_MakeCycles(pic_queue.next_entry->index-PIC_TickIndex());
+    PIC_HeapPlace(pos,id);
+}
+
+static void PIC_HeapSiftDown(uint32_t pos) {
+    const uint32_t count = (uint32_t)pic_queue.heap.size();
+    const uint32_t id = pic_queue.heap[pos];
+    for (;;) {
+        uint32_t child = (pos << 1u) + 1u;
+        if (child >= count) break;
+        if ((child + 1u) < count && PIC_EntryBefore(pic_queue.entries[pic_queue.heap[child+1u]],pic_queue.entries[pic_queue.heap[child]])) child++;
+        if (!PIC_EntryBefore(pic_queue.entries[pic_queue.heap[child]],pic_queue.entries[id])) break;
+        PIC_HeapPlace(pos,pic_queue.heap[child]);
+        pos = child;
+    }
+    PIC_HeapPlace(pos,id);
+}
+
+static void PIC_HeapRemove(uint32_t pos) {
+    const uint32_t last = pic_queue.heap.back();
+    pic_queue.heap.pop_back();
+    if (pos < pic_queue.heap.size()) {
+        PIC_HeapPlace(pos,last);
+        if (pos > 0 && PIC_EntryBefore(pic_queue.entries[last],pic_queue.entries[pic_queue.heap[(pos - 1u) >> 1u]]))
+            PIC_HeapSiftUp(pos);
+        else
+            PIC_HeapSiftDown(pos);
+    }
+}
+
+static inline PICEntry *PIC_NextEntry(void) {
+    if (pic_queue.heap.empty()) return nullptr;
+    return &pic_queue.entries[pic_queue.heap[0]];
+}
+
+/* unlink from the heap and the handler chain, and return the slot to the free list */
+static void PIC_FreeEntry(uint32_t id) {
+    PICEntry &entry = pic_queue.entries[id];
+
+    if (entry.heap_pos != PIC_NOENTRY) PIC_HeapRemove(entry.heap_pos);
+    entry.heap_pos = PIC_NOENTRY;
+
+    if (entry.prev != PIC_NOENTRY) {
+        pic_queue.entries[entry.prev].next = entry.next;
+    }
+    else {
+        auto i = pic_queue.handler_head.find(entry.pic_event);
+        assert(i != pic_queue.handler_head.end() && i->second == id);
+        if (entry.next != PIC_NOENTRY) i->second = entry.next;
+        else pic_queue.handler_head.erase(i);
+    }
+    if (entry.next != PIC_NOENTRY)
+        pic_queue.entries[entry.next].prev = entry.prev;
+
+    entry.pic_event = nullptr;
+    entry.prev = PIC_NOENTRY;
+    entry.next = pic_queue.free_entry;
+    pic_queue.free_entry = id;
+}
+
+static void PIC_ClearQueue(void) {
+    pic_queue.entries.clear();
+    pic_queue.heap.clear();
+    pic_queue.handler_head.clear();
+    pic_queue.free_entry = PIC_NOENTRY;
+    pic_queue.seq = 0;
+}
+
+/* queue an event at a tick index relative to PIC_Ticks */
+static void PIC_QueueInsert(PIC_EventHandler handler,pic_tickindex_t index,Bitu val) {
+    uint32_t id = pic_queue.free_entry;
+    if (id != PIC_NOENTRY) {
+        pic_queue.free_entry = pic_queue.entries[id].next;
+    }
+    else {
+        id = (uint32_t)pic_queue.entries.size();
+        pic_queue.entries.emplace_back();
+    }
+
+    PICEntry &entry = pic_queue.entries[id];
+    entry.index = index;
+    entry.value = val;
+    entry.pic_event = handler;
+    entry.seq = pic_queue.seq++;
+
+    /* link at the head of the per-handler chain */
+    auto ins = pic_queue.handler_head.insert(std::pair<PIC_EventHandler,uint32_t>(handler,id));
+    entry.prev = PIC_NOENTRY;
+    if (!ins.second) {
+        entry.next = ins.first->second;
+        pic_queue.entries[entry.next].prev = id;
+        ins.first->second = id;
+    }
+    else {
+        entry.next = PIC_NOENTRY;
+    }
+
+    pic_queue.heap.push_back(id);
+    PIC_HeapSiftUp((uint32_t)pic_queue.heap.size() - 1u);
+}
+
+static void AddEntry(PIC_EventHandler handler,pic_tickindex_t index,Bitu val) {
+    PIC_QueueInsert(handler,index,val);
+
+    Bits cycles=PIC_MakeCycles(PIC_NextEntry()->index-PIC_TickIndex());
     if (cycles<CPU_Cycles) {
         CPU_CycleLeft+=CPU_Cycles;
         CPU_Cycles=0;
@@ -662,66 +780,33 @@ pic_tickindex_t PIC_GetCurrentEventTime(void) {
 }
 
 void PIC_AddEvent(PIC_EventHandler handler,pic_tickindex_t delay,Bitu val) {
-    if (GCC_UNLIKELY(!pic_queue.free_entry)) {
-        LOG(LOG_PIC,LOG_ERROR)("Event queue full");
-        return;
-    }
-    PICEntry * entry=pic_queue.free_entry;
-    if(InEventService) entry->index = delay + srv_lag;
-    else entry->index = delay + PIC_TickIndex();
-
-    entry->pic_event=handler;
-    entry->value=val;
-    pic_queue.free_entry=pic_queue.free_entry->next;
-    AddEntry(entry);
+    if(InEventService) AddEntry(handler, delay + srv_lag, val);
+    else AddEntry(handler, delay + PIC_TickIndex(), val);
 }
 
 void PIC_RemoveSpecificEvents(PIC_EventHandler handler, Bitu val) {
-    PICEntry * entry=pic_queue.next_entry;
-    PICEntry * prev_entry = nullptr;
-    while (entry) {
-        if (GCC_UNLIKELY((entry->pic_event == handler)) && (entry->value == val)) {
-            if (prev_entry) {
-                prev_entry->next=entry->next;
-                entry->next=pic_queue.free_entry;
-                pic_queue.free_entry=entry;
-                entry=prev_entry->next;
-                continue;
-            } else {
-                pic_queue.next_entry=entry->next;
-                entry->next=pic_queue.free_entry;
-                pic_queue.free_entry=entry;
-                entry=pic_queue.next_entry;
-                continue;
-            }
-        }
-        prev_entry=entry;
-        entry=entry->next;
-    }   
+    auto i = pic_queue.handler_head.find(handler);
+    if (i == pic_queue.handler_head.end()) return;
+
+    uint32_t id = i->second;
+    while (id != PIC_NOENTRY) {
+        const uint32_t next = pic_queue.entries[id].next;
+        if (GCC_UNLIKELY(pic_queue.entries[id].value == val))
+            PIC_FreeEntry(id); /* may invalidate i, which is not used again */
+        id = next;
+    }
 }
 
 void PIC_RemoveEvents(PIC_EventHandler handler) {
-    PICEntry * entry=pic_queue.next_entry;
-    PICEntry * prev_entry = nullptr;
-    while (entry) {
-        if (GCC_UNLIKELY(entry->pic_event==handler)) {
-            if (prev_entry) {
-                prev_entry->next=entry->next;
-                entry->next=pic_queue.free_entry;
-                pic_queue.free_entry=entry;
-                entry=prev_entry->next;
-                continue;
-            } else {
-                pic_queue.next_entry=entry->next;
-                entry->next=pic_queue.free_entry;
-                pic_queue.free_entry=entry;
-                entry=pic_queue.next_entry;
-                continue;
-            }
-        }
-        prev_entry=entry;
-        entry=entry->next;
-    }   
+    auto i = pic_queue.handler_head.find(handler);
+    if (i == pic_queue.handler_head.end()) return;
+
+    uint32_t id = i->second;
+    while (id != PIC_NOENTRY) {
+        const uint32_t next = pic_queue.entries[id].next;
+        PIC_FreeEntry(id);
+        id = next;
+    }
 }
 
 extern ClockDomain clockdom_DOSBox_cycles;
@@ -761,25 +846,28 @@ bool PIC_RunQueue(void) {
         /* Check the queue for an entry */
         Bits index_nd=PIC_TickIndexND();
         InEventService = true;
-        while (pic_queue.next_entry && (pic_queue.next_entry->index*CPU_CycleMax<=index_nd)) {
-            PICEntry * entry=pic_queue.next_entry;
-            pic_queue.next_entry=entry->next;
+        PICEntry * entry;
+        while ((entry=PIC_NextEntry()) != nullptr && (entry->index*CPU_CycleMax<=index_nd)) {
+            const PIC_EventHandler handler = entry->pic_event;
+            const Bitu value = entry->value;
             srv_lag = entry->index;
 
-            if (entry->pic_event != NULL)
-                (entry->pic_event)(entry->value); // call the event handler
+            /* Put the entry in the free list before calling the handler, which may schedule new events */
+            PIC_FreeEntry(pic_queue.heap[0]);
+
+            if (handler != NULL) {
+                HOSTPROF_SCOPE_ID(HOSTPROF_PIC,handler);
+                benchmark.pic_events++;
+                handler(value); // call the event handler
+            }
             else
                 LOG(LOG_MISC,LOG_WARN)("PIC: Event in queue with NULL handler"); // This can happen after save state / load state
-
-            /* Put the entry in the free list */
-            entry->next=pic_queue.free_entry;
-            pic_queue.free_entry=entry;
         }
         InEventService = false;
 
         /* Check when to set the new cycle end */
-        if (pic_queue.next_entry) {
-            Bits cycles=(Bits)(pic_queue.next_entry->index*CPU_CycleMax-index_nd);
+        if ((entry=PIC_NextEntry()) != nullptr) {
+            Bits cycles=(Bits)(entry->index*CPU_CycleMax-index_nd);
             if (GCC_UNLIKELY(!cycles)) cycles=1;
             if (cycles<CPU_CycleLeft) {
                 CPU_Cycles=cycles;
@@ -849,6 +937,8 @@ extern Bitu time_limit_ms;
 
 static unsigned long PIC_benchstart = 0;
 static unsigned long PIC_tickstart = 0;
+static cpu_cycles_count_t PIC_benchgiven = 0;		// cycles the core had at the start of the tick
+static cpu_cycles_count_t PIC_benchremoved = 0;		// CPU_IODelayRemoved at the start of the tick
 
 extern void GFX_SetTitle(int32_t cycles, int frameskip, Bits timing, bool paused);
 void TIMER_AddTick(void) {
@@ -861,20 +951,30 @@ void TIMER_AddTick(void) {
         PIC_benchstart = ticks;
         PIC_tickstart = PIC_Ticks;
     }
+    /* cycles the core executed in the tick that ends: not the ones left
+     * over for the next tick, nor the ones given up to HLT and I/O delays */
+    if (benchmark.active) {
+        const cpu_cycles_count_t removed = (CPU_IODelayRemoved >= PIC_benchremoved) ?
+            (CPU_IODelayRemoved - PIC_benchremoved) : CPU_IODelayRemoved;
+        const cpu_cycles_count_t used = PIC_benchgiven - (CPU_CycleLeft + CPU_Cycles) - removed;
+        if (used > 0) benchmark.cycles += (uint64_t)used;
+    }
     CPU_CycleLeft += CPU_CycleMax + CPU_Cycles;
     CPU_Cycles = 0;
+    PIC_benchgiven = CPU_CycleLeft;
+    PIC_benchremoved = CPU_IODelayRemoved;
 
     /* timeout */
-    if (time_limit_ms != 0 && PIC_Ticks >= time_limit_ms)
+    if (time_limit_ms != 0 && PIC_Ticks >= time_limit_ms) {
+        if (benchmark.active) BENCHMARK_Report();
         throw int(1);
-
-    /* Go through the list of scheduled events and lower their index with 1000 */
-    PICEntry * entry=pic_queue.next_entry;
-    while (entry) {
-        entry->index -= 1.0;
-        entry=entry->next;
     }
 
+    /* Go through the list of scheduled events and lower their index with 1000.
+     * Subtracting the same amount from every entry keeps the heap ordered. */
+    for (auto id : pic_queue.heap)
+        pic_queue.entries[id].index -= 1.0;
+
     /* Call our list of ticker handlers */
     TickerBlock * ticker=firstticker;
     while (ticker) {
@@ -1044,20 +1144,12 @@ void PIC_Destroy(Section* sec) {
 }
 
 void Init_PIC() {
-    Bitu i;
-
     LOG(LOG_MISC,LOG_DEBUG)("Init_PIC()");
 
     /* Initialize the pic queue */
-    for (i=0;i<PIC_QUEUESIZE-1;i++) {
-        pic_queue.entries[i].next=&pic_queue.entries[i+1];
-
-        // savestate compatibility
-        pic_queue.entries[i].pic_event = nullptr;
-    }
-    pic_queue.entries[PIC_QUEUESIZE-1].next = nullptr;
-    pic_queue.free_entry=&pic_queue.entries[0];
-    pic_queue.next_entry = nullptr;
+    PIC_ClearQueue();
+    pic_queue.entries.reserve(PIC_QUEUESIZE);
+    pic_queue.heap.reserve(PIC_QUEUESIZE);
 
     AddExitFunction(AddExitFunctionFuncPair(PIC_Destroy));
     AddVMEventFunction(VM_EVENT_RESET,AddVMEventFunctionFuncPair(PIC_Reset));
@@ -1258,26 +1350,25 @@ private:
     void getBytes(std::ostream& stream) override
     {
 				uint16_t pic_free_idx, pic_next_idx;
-				uint16_t pic_next_ptr[PIC_QUEUESIZE];
 
 				TickerBlock *ticker_ptr;
 				uint16_t ticker_size;
 				uint16_t ticker_handler_idx;
 
 
-				for( int lcv=0; lcv<PIC_QUEUESIZE; lcv++ ) {
-					Bitu pic_addr;
-
-					pic_addr = (Bitu) pic_queue.entries[lcv].next;
-					pic_next_ptr[lcv] = 0xffff;
-
-					for( int lcv2=0; lcv2<PIC_QUEUESIZE; lcv2++ ) {
-						if( pic_addr == (Bitu) &pic_queue.entries[lcv2] ) {
-							pic_next_ptr[lcv] = lcv2;
-							break;
-						}
-					}
+				/* The save state keeps the layout of the old fixed size event
+				 * list: PIC_QUEUESIZE slots, each with a relocated next pointer.
+				 * Pending events are written in firing order to the first slots,
+				 * the remaining slots form the free list. */
+				std::vector<uint32_t> pending( pic_queue.heap );
+				std::sort( pending.begin(), pending.end(), [](uint32_t a, uint32_t b) {
+					return PIC_EntryBefore( pic_queue.entries[a], pic_queue.entries[b] );
+				} );
+				if( pending.size() > PIC_QUEUESIZE ) {
+					LOG(LOG_PIC,LOG_ERROR)("PIC: %u events pending, only %u saved", (unsigned int)pending.size(), (unsigned int)PIC_QUEUESIZE);
+					pending.resize( PIC_QUEUESIZE );
 				}
+				const int pending_count = (int)pending.size();
 
 
 				ticker_size = 0;
@@ -1303,31 +1394,40 @@ private:
         stream.write(reinterpret_cast<const char*>(&pics), sizeof(pics) );
 
 
-				pic_free_idx = 0xffff;
-				pic_next_idx = 0xffff;
+				pic_free_idx = ( pending_count < PIC_QUEUESIZE ) ? (uint16_t)pending_count : 0xffff;
+				pic_next_idx = ( pending_count > 0 ) ? 0 : 0xffff;
 				for( int lcv=0; lcv<PIC_QUEUESIZE; lcv++ ) {
-					uint16_t event_idx;
+					uint16_t event_idx, next_idx;
+					Bitu value = 0;
+					PIC_EventHandler handler = NULL;
+					double index_d = 0.0;
+
+					if( lcv < pending_count ) {
+						const PICEntry &entry = pic_queue.entries[pending[lcv]];
+						/* Serialize .index as a fixed 8-byte double, not the raw
+						 * pic_tickindex_t (long double) bytes — MSVC has
+						 * sizeof(long double)==8 while MinGW has 16, so writing the
+						 * raw bytes makes the savestate file incompatible across
+						 * toolchains. Runtime keeps long double. */
+						index_d = (double)entry.index;
+						value = entry.value;
+						handler = entry.pic_event;
+						next_idx = ( lcv+1 < pending_count ) ? (uint16_t)(lcv+1) : 0xffff;
+					}
+					else {
+						next_idx = ( lcv+1 < PIC_QUEUESIZE ) ? (uint16_t)(lcv+1) : 0xffff;
+					}
 
 					// - data
-					/* Serialize .index as a fixed 8-byte double, not the raw
-					 * pic_tickindex_t (long double) bytes — MSVC has
-					 * sizeof(long double)==8 while MinGW has 16, so writing the
-					 * raw bytes makes the savestate file incompatible across
-					 * toolchains. Runtime keeps long double. */
-					double index_d = (double)pic_queue.entries[lcv].index;
 					stream.write(reinterpret_cast<const char*>(&index_d), sizeof(index_d) );
-					stream.write(reinterpret_cast<const char*>(&pic_queue.entries[lcv].value), sizeof(pic_queue.entries[lcv].value) );
+					stream.write(reinterpret_cast<const char*>(&value), sizeof(value) );
 
 					// - function ptr
-					event_idx = PIC_State_FindEvent( (Bitu) (pic_queue.entries[lcv].pic_event) );
+					event_idx = PIC_State_FindEvent( (Bitu) handler );
 					stream.write(reinterpret_cast<const char*>(&event_idx), sizeof(event_idx) );
 
 					// - reloc ptr
-					stream.write(reinterpret_cast<const char*>(&pic_next_ptr[lcv]), sizeof(pic_next_ptr[lcv]) );
-
-
-					if( &pic_queue.entries[lcv] == pic_queue.free_entry ) pic_free_idx = lcv;
-					if( &pic_queue.entries[lcv] == pic_queue.next_entry ) pic_next_idx = lcv;
+					stream.write(reinterpret_cast<const char*>(&next_idx), sizeof(next_idx) );
 				}
 
 				// - reloc ptrs
@@ -1385,6 +1485,7 @@ private:
         stream.read(reinterpret_cast<char*>(&pics), sizeof(pics) );
 
 
+				std::vector<PICEntry> saved( PIC_QUEUESIZE );
 				for( int lcv=0; lcv<PIC_QUEUESIZE; lcv++ ) {
 					uint16_t event_idx, next_idx;
 
@@ -1392,34 +1493,32 @@ private:
 					/* Read .index as fixed 8-byte double (see save side). */
 					double index_d = 0.0;
 					stream.read(reinterpret_cast<char*>(&index_d), sizeof(index_d) );
-					pic_queue.entries[lcv].index = (pic_tickindex_t)index_d;
-					stream.read(reinterpret_cast<char*>(&pic_queue.entries[lcv].value), sizeof(pic_queue.entries[lcv].value) );
+					saved[lcv].index = (pic_tickindex_t)index_d;
+					stream.read(reinterpret_cast<char*>(&saved[lcv].value), sizeof(saved[lcv].value) );
 
 
 					// - function ptr
 					stream.read(reinterpret_cast<char*>(&event_idx), sizeof(event_idx) );
-					pic_queue.entries[lcv].pic_event = (PIC_EventHandler) PIC_State_IndexEvent( event_idx );
+					saved[lcv].pic_event = (PIC_EventHandler) PIC_State_IndexEvent( event_idx );
 
 
 					// - reloc ptr
 					stream.read(reinterpret_cast<char*>(&next_idx), sizeof(next_idx) );
-
-					pic_queue.entries[lcv].next = NULL;
-					if( next_idx != 0xffff )
-						pic_queue.entries[lcv].next = &pic_queue.entries[next_idx];
+					saved[lcv].next = ( next_idx < PIC_QUEUESIZE ) ? next_idx : PIC_NOENTRY;
 				}
 
 				// - reloc ptrs
         stream.read(reinterpret_cast<char*>(&free_idx), sizeof(free_idx) );
         stream.read(reinterpret_cast<char*>(&next_idx), sizeof(next_idx) );
 
-				pic_queue.free_entry = NULL;
-				if( free_idx != 0xffff )
-					pic_queue.free_entry = &pic_queue.entries[free_idx];
-
-				pic_queue.next_entry = NULL;
-				if( next_idx != 0xffff )
-					pic_queue.next_entry = &pic_queue.entries[next_idx];
+				/* walk the saved list in firing order and schedule it again. The
+				 * step limit guards against a damaged state with a looped list. */
+				PIC_ClearQueue();
+				uint32_t saved_idx = ( next_idx < PIC_QUEUESIZE ) ? next_idx : PIC_NOENTRY;
+				for( int lcv=0; saved_idx != PIC_NOENTRY && lcv<PIC_QUEUESIZE; lcv++ ) {
+					PIC_QueueInsert( saved[saved_idx].pic_event, saved[saved_idx].index, saved[saved_idx].value );
+					saved_idx = saved[saved_idx].next;
+				}
 
 
 				// - data
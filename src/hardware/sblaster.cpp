@@ -3884,6 +3884,17 @@ template <const size_t ci> static void write_sb(Bitu port,Bitu val,Bitu iolen) {
 	sb[ci].write_sb(port,val,iolen);
 }
 
+/* REP INSB/OUTSB on the DSP data ports, a byte at a time but without going through the port dispatch */
+template <const size_t ci> static Bitu read_sb_block(Bitu port,uint8_t *buf,Bitu iolen,Bitu count) {
+	for (Bitu i=0;i < count;i++) buf[i] = (uint8_t)sb[ci].read_sb(port,iolen);
+	return count;
+}
+
+template <const size_t ci> static Bitu write_sb_block(Bitu port,const uint8_t *buf,Bitu iolen,Bitu count) {
+	for (Bitu i=0;i < count;i++) sb[ci].write_sb(port,buf[i],iolen);
+	return count;
+}
+
 static const MIXER_Handler SBLASTER_CallBacks[MAX_CARDS] = {
 	SBLASTER_CallBack<0>,
 	SBLASTER_CallBack<1>
@@ -3899,6 +3910,16 @@ static const IO_WriteHandler * const write_sbs[MAX_CARDS] = {
 	write_sb<1>
 };
 
+static IO_ReadBlockHandler * const read_sb_blocks[MAX_CARDS] = {
+	read_sb_block<0>,
+	read_sb_block<1>
+};
+
+static IO_WriteBlockHandler * const write_sb_blocks[MAX_CARDS] = {
+	write_sb_block<0>,
+	write_sb_block<1>
+};
+
 class SBLASTER: public Module_base {
 	private:
 		/* Data */
@@ -4283,6 +4304,8 @@ class SBLASTER: public Module_base {
 				ReadHandler[i].Install(sb[ci].hw.base+(IS_PC98_ARCH ? ((i+0x20u) << 8u) : i),read_sbs[ci],IO_MB);
 				WriteHandler[i].Install(sb[ci].hw.base+(IS_PC98_ARCH ? ((i+0x20u) << 8u) : i),write_sbs[ci],IO_MB);
 			}
+			IO_RegisterReadBlockHandler(sb[ci].hw.base+(IS_PC98_ARCH ? ((DSP_READ_DATA+0x20u) << 8u) : DSP_READ_DATA),read_sbs[ci],read_sb_blocks[ci]);
+			IO_RegisterWriteBlockHandler(sb[ci].hw.base+(IS_PC98_ARCH ? ((DSP_WRITE_DATA+0x20u) << 8u) : DSP_WRITE_DATA),write_sbs[ci],write_sb_blocks[ci]);
 
 			// TODO: read/write handler for ESS AudioDrive ES1688 (and later) MPU-401 ports (3x0h/3x1h; prevents Windows drivers from working with default settings if missing)
 
@@ -192,6 +192,7 @@ bool                                ignore_sequencer_blanking = false;
 bool                                memio_complexity_optimization = true;
 bool                                vga_render_on_demand = false; // Render at vsync or specific changes to hardware instead of every scanline
 signed char                         vga_render_on_demand_user = -1;
+bool                                vga_skip_unchanged_lines = true; // Do not draw scanlines again if their video memory was not written
 bool                                vga_render_wait_for_changes = false; // Skip rendering entirely, even at vsync, unless anything changes
 signed char                         vga_render_wait_for_changes_user = -1;
 
@@ -897,6 +898,7 @@ void VGA_Reset(Section*) {
 	enable_vbe_pmode_if = section->Get_bool("vbe protected mode interface");
 	ignore_sequencer_blanking = section->Get_bool("ignore sequencer blanking");
 	memio_complexity_optimization = section->Get_bool("memory io optimization 1");
+	vga_skip_unchanged_lines = section->Get_bool("skip unchanged scanlines");
 
 	vga_render_on_demand = false;
 	vga_render_wait_for_changes = false;
@@ -1357,6 +1359,7 @@ void VGA_OnEnterPC98(Section *sec) {
 	VGA_SetMode(M_PC98);
 	assert(vga.mem.memsize >= 0x80000);
 	memset(vga.mem.linear,0,0x80000);
+	vga.dirty.invalidate();
 
 	VGA_StartResize();
 }
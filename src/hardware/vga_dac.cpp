@@ -114,6 +114,8 @@ static void VGA_DAC_SendColor( Bitu index, Bitu src ) {
     if (vga.mode == M_CGA16)
         return;
 
+    const uint32_t old_xlat32 = vga.dac.xlat32[index];
+
     /* FIXME: Can someone behind the GCC project explain how (unsigned int) OR (unsigned int) somehow becomes (signed int)?? */
 
     if (GFX_bpp >= 24) /* FIXME: Assumes 8:8:8. What happens when desktops start using the 10:10:10 format? */
@@ -137,6 +139,10 @@ static void VGA_DAC_SendColor( Bitu index, Bitu src ) {
             vga.dac.xlat32[index] = (uint32_t)(blue << 16U) | (uint32_t)(green << 8U) | (uint32_t)(red << 0U);
     }
 
+    /* scanlines drawn with the old color must be drawn again */
+    if (vga.dac.xlat32[index] != old_xlat32)
+        vga.dirty.invalidate();
+
     RENDER_SetPal( (uint8_t)index, red, green, blue );
 }
 
@@ -21,6 +21,7 @@
 #include <assert.h>
 #include <math.h>
 #include <stdio.h>
+#include <vector>
 #include "dosbox.h"
 #if defined (WIN32)
 #include <d3d9.h>
@@ -47,6 +48,8 @@
 #include "pc98_cg.h"
 #include "pc98_gdc.h"
 #include "pc98_gdc_const.h"
+#include "hostprof.h"
+#include "vga_draw_simd.h"
 
 #if (C_SSHOT) || (C_AVCODEC)
 #include <zlib.h>
@@ -84,6 +87,7 @@ bool enable_supermegazeux_256colortext = false;
 static bool is_vga_rendering_on_demand = false;
 
 extern bool vga_render_on_demand;
+extern bool vga_skip_unchanged_lines;
 extern signed char vga_render_on_demand_user;
 extern bool vga_render_wait_for_changes;
 extern signed char vga_render_wait_for_changes_user;
@@ -907,8 +911,8 @@ static uint8_t * VGA_Draw_Linear_Line_24_to_32(Bitu vidstart, Bitu /*line*/) {
     for (i=0;i < vga.draw.width;i++)
         ((uint32_t*)TempLine)[i] = guest_bgr_to_macosx_rgba(*((uint32_t*)(vga.draw.linear_base+offset+(i*3)))) | 0x000000FF;
 #else
-    for (i=0;i < vga.draw.width;i++)
-        ((uint32_t*)TempLine)[i] = *((uint32_t*)(vga.draw.linear_base+offset+(i*3))) | 0xFF000000;
+    (void)i;
+    VGA_RGB24To32((uint32_t*)TempLine,vga.draw.linear_base+offset,vga.draw.width);
 #endif
 
     return TempLine;
@@ -1085,16 +1089,18 @@ static uint8_t * VGA_Draw_Xlat32_VGA_CRTC_bmode_Line(Bitu vidstart, Bitu line) {
 
     const Bitu count = ((vga.draw.line_length>>(2/*32bpp*/+2/*4 pixels*/))+((poff+3)>>2));
 
-    for(Bitu i = 0; i < count; i++) {
-        const uint8_t *ret = &vram[ vidstart & vidmask ];
-
-        /* one group of 4 */
-        *temps++ = vga.dac.xlat32[*ret++];
-        *temps++ = vga.dac.xlat32[*ret++];
-        *temps++ = vga.dac.xlat32[*ret++];
-        *temps++ = vga.dac.xlat32[*ret++];
-        /* and skip */
-        vidstart += skip;
+    /* gather the groups of 4, then translate them all at once (see vga_draw_simd.h) */
+    uint32_t groups[64];
+    for(Bitu i = 0; i < count;) {
+        const Bitu n = std::min<Bitu>(count - i,64u);
+        for (Bitu j = 0; j < n; j++) {
+            groups[j] = *((const uint32_t*)(&vram[ vidstart & vidmask ]));
+            /* and skip */
+            vidstart += skip;
+        }
+        VGA_Xlat8To32(temps,(const uint8_t*)groups,n * 4u,vga.dac.xlat32);
+        temps += n * 4u;
+        i += n;
     }
 
     return TempLine + (poff * 4);
@@ -1134,8 +1140,14 @@ static uint8_t * VGA_Draw_Xlat32_Linear_Line(Bitu vidstart, Bitu /*line*/) {
         vidstart += (Bitu)x;
     }
 
-    for(Bitu i = 0; i < (vga.draw.line_length>>2); i++)
-        temps[i]=vga.dac.xlat32[vga.draw.linear_base[(vidstart+i)&vga.draw.linear_mask]];
+    const Bitu count = vga.draw.line_length>>2;
+    if (((vidstart&vga.draw.linear_mask)+count) <= (vga.draw.linear_mask+1u)) {
+        VGA_Xlat8To32(temps,&vga.draw.linear_base[vidstart&vga.draw.linear_mask],count,vga.dac.xlat32);
+    }
+    else {
+        for(Bitu i = 0; i < count; i++)
+            temps[i]=vga.dac.xlat32[vga.draw.linear_base[(vidstart+i)&vga.draw.linear_mask]];
+    }
 
     return TempLine;
 }
@@ -1224,6 +1236,23 @@ template <const unsigned int card,typename templine_type_t> static uint8_t * EGA
      * Also, even though it is rarely used, EGA/VGA do have another bit that enables a
      * 4-way interleave that was obviously added with Hercules graphics mode in mind. */
 
+#if !defined(WORDS_BIGENDIAN)
+    if (card == MCH_VGA) {
+        /* gather the planes, then convert them all at once (see vga_draw_simd.h) */
+        uint32_t planes[64];
+        while (count > 0u) {
+            const Bitu n = std::min<Bitu>(count,64u);
+            for (Bitu j=0;j < n;j++) {
+                planes[j] = *((const uint32_t*)(&vram[ vidstart & vidmask ]));
+                vidstart += (uintptr_t)4 << (uintptr_t)vga.config.addr_shift;
+            }
+            VGA_Planar4ToXlat32((uint32_t*)(temps+i),planes,n,vga.dac.xlat32);
+            count -= n;
+            i += n * 8u;
+        }
+    }
+#endif
+
     while (count > 0u) {
         t1 = t2 = *((const uint32_t*)(&vram[ vidstart & vidmask ]));
         t1 = (t1 >> 4) & 0x0f0f0f0f;
@@ -2614,6 +2643,32 @@ struct first_equal {
     }
 };
 
+/* The font pattern and colors of a character cell in (SBCS) text mode. Bit 7 of
+ * the pattern is the leftmost pixel, bit 8 if characters are 9 pixels wide. */
+static inline uint16_t EGAVGA_TEXT_Cell(const VGA_Latch pixels,const Bitu line,Bitu &foreground,Bitu &background) {
+    const Bitu chr = pixels.b[0];
+    const Bitu attr = pixels.b[1];
+    // the font pattern (directly from video RAM)
+    uint16_t font = vga.draw.font_tables[(attr >> 3)&1][((chr<<5)+line)*4];
+    background = attr >> 4u;
+    // if blinking is enabled bit7 is not mapped to attributes
+    if (vga.draw.blinking) background &= ~0x8u;
+    // choose foreground color if blinking not set for this cell or blink on
+    foreground = (vga.draw.blink || (!(attr&0x80)))?
+        (attr&0xf):background;
+    // underline: all foreground [freevga: 0x77, previous 0x7]
+    if (GCC_UNLIKELY(((attr&0x77) == 0x01) &&
+        (vga.crtc.underline_location&0x1f)==line))
+            background = foreground;
+    if (vga.draw.char9dot) {
+        font <<=1; // 9 pixels
+        // extend to the 9th pixel if needed
+        if ((font&0x2) && (vga.attr.mode_control&0x04) &&
+            (chr>=0xc0) && (chr<=0xdf)) font |= 1;
+    }
+    return font;
+}
+
 template <const unsigned int card,typename templine_type_t> static inline uint8_t* EGAVGA_TEXT_Combined_Draw_Line(uint8_t *dst,Bitu vidstart,Bitu line) {
     if (vga.crtc.maximum_scan_line & 0x80) line >>= 1u; /* CGA modes (and 200-line EGA) have the VGA doublescan bit set. We need to compensate to properly map lines. */
     const uint8_t *vram = vga.draw.linear_base + (((line & vga.tandy.line_mask) << (2+vga.tandy.line_shift)) & vga.draw.linear_mask);
@@ -2650,6 +2705,27 @@ template <const unsigned int card,typename templine_type_t> static inline uint8_
 #define VMA(addr) ( *((const uint32_t*)(&vram[ (Bitu)(addr) & vidmask ])) )
 #define VMR(rel) VMA(lvida + ((Bitu)((Bits)rel * (Bits)skip)))
 
+    if (card == MCH_VGA && !usedbcs) {
+        /* work out the cells, then draw them all at once (see vga_draw_simd.h) */
+        const unsigned int width = vga.draw.char9dot ? 9u : 8u;
+        uint16_t fonts[64];
+        uint32_t fgs[64], bgs[64];
+        while (blocks > 0u) {
+            const Bitu n = std::min<Bitu>(blocks,64u);
+            for (Bitu j=0;j < n;j++) {
+                VGA_Latch pixels;
+                pixels.d = VMR(0);
+                fonts[j] = EGAVGA_TEXT_Cell(pixels,line,foreground,background);
+                fgs[j] = vga.dac.xlat32[foreground];
+                bgs[j] = vga.dac.xlat32[background];
+                lvida += skip;
+            }
+            VGA_TextExpand32((uint32_t*)draw,fonts,fgs,bgs,n,width);
+            draw += n * width;
+            blocks -= n;
+        }
+    }
+
     VGA_Latch pixeln1, pixeln2, pixeln3, pixelp1, pixelp2, pixelp3;
     while (blocks--) {
         if (!col) p3 = 0;
@@ -2813,25 +2889,9 @@ template <const unsigned int card,typename templine_type_t> static inline uint8_
         } else { // SBCS case
             VGA_Latch pixels;
             pixels.d = VMR(0);
-            Bitu chr = pixels.b[0];
-            Bitu attr = pixels.b[1];
-            // the font pattern (directly from video RAM)
-            uint16_t font = vga.draw.font_tables[(attr >> 3)&1][((chr<<5)+line)*4];
-            Bitu background = attr >> 4u;
-            // if blinking is enabled bit7 is not mapped to attributes
-            if (vga.draw.blinking) background &= ~0x8u;
-            // choose foreground color if blinking not set for this cell or blink on
-            Bitu foreground = (vga.draw.blink || (!(attr&0x80)))?
-                (attr&0xf):background;
-            // underline: all foreground [freevga: 0x77, previous 0x7]
-            if (GCC_UNLIKELY(((attr&0x77) == 0x01) &&
-                (vga.crtc.underline_location&0x1f)==line))
-                    background = foreground;
+            Bitu background, foreground;
+            uint16_t font = EGAVGA_TEXT_Cell(pixels,line,foreground,background);
             if (vga.draw.char9dot) {
-                font <<=1; // 9 pixels
-                // extend to the 9th pixel if needed
-                if ((font&0x2) && (vga.attr.mode_control&0x04) &&
-                    (chr>=0xc0) && (chr<=0xdf)) font |= 1;
                 for (Bitu n = 0; n < 9; n++) {
                     *draw++ = EGA_Planar_Common_Block_xlat<card,templine_type_t>((font&0x100)? foreground:background);
                     font <<= 1;
@@ -3784,13 +3844,118 @@ void VGA_FreeBiosLogo(void) {
 	BIOSlogo.free();
 }
 
+/* hands a finished scanline to the scaler */
+static inline void VGA_RenderScanline(const void *line) {
+    HOSTPROF_SCOPE(HOSTPROF_RENDER_LINE);
+    RENDER_DrawLine(line);
+}
+
+/* Scanlines that need not be drawn again. Each record says when the scanline was last
+ * handed to the renderer and from where, and the scanline is passed as NULL (unchanged)
+ * if none of the video memory it shows was written since then. This only works for the
+ * line drawing functions that read nothing but video memory and xlat32[]. */
+struct VGA_DirtyLine {
+    uint32_t            serial;             // vga.dirty.serial when drawn, 0 if not in the render cache
+    Bitu                address;
+    Bitu                address_line;
+    Bitu                panning;
+};
+
+static std::vector<VGA_DirtyLine> vga_dirty_lines;
+static VGA_Line_Handler vga_dirty_drawline = NULL;
+static uint8_t* vga_dirty_base = NULL;
+static Bitu vga_dirty_mask = 0;
+static Bitu vga_dirty_span = 0;             // bytes of video memory a scanline reads, 0 if not tracked
+static bool vga_dirty_active = false;
+
+static void VGA_DirtyStartFrame(void) {
+    const VGA_Line_Handler old_drawline = vga_dirty_drawline;
+    const uint8_t* old_base = vga_dirty_base;
+    const Bitu old_mask = vga_dirty_mask, old_span = vga_dirty_span;
+    Bitu span = 0;
+
+    if (vga_skip_unchanged_lines && vga.tandy.line_mask == 0 && !video_debug_overlay &&
+        vga.draw.linear_base >= vga.mem.linear && vga.draw.linear_base < (vga.mem.linear + vga.mem.memsize)) {
+        const Bitu step = (Bitu)4u << (Bitu)vga.config.addr_shift;
+
+        if (VGA_DrawLine == VGA_Draw_Xlat32_VGA_CRTC_bmode_Line && !vga_enable_hretrace_effects)
+            span = ((vga.draw.line_length >> 4u) + 2u) * step;
+        else if (VGA_DrawLine == VGA_Draw_VGA_Planar_Xlat32_Line)
+            span = (vga.draw.blocks + 2u) * step;
+
+        if (span > vga.draw.linear_mask + 1u) span = 0;
+    }
+
+    vga_dirty_drawline = VGA_DrawLine;
+    vga_dirty_base = vga.draw.linear_base;
+    vga_dirty_mask = vga.draw.linear_mask;
+    vga_dirty_span = span;
+    if (old_drawline != vga_dirty_drawline || old_base != vga_dirty_base || old_mask != vga_dirty_mask || old_span != vga_dirty_span)
+        vga.dirty.invalidate();
+
+    if (vga_dirty_lines.size() != vga.draw.lines_total)
+        vga_dirty_lines.assign(vga.draw.lines_total,VGA_DirtyLine());
+
+    /* start over well before the serial wraps around */
+    if (vga.dirty.serial >= 0xFFFFFF00u) {
+        if (vga.dirty.stamp != NULL)
+            memset(vga.dirty.stamp,0,((vga.mem.memsize >> VGA_DIRTY_SHIFT) + 1u) * sizeof(uint32_t));
+        vga.dirty.serial = 2;
+        vga.dirty.invalid = 1;
+        for (auto &l : vga_dirty_lines) l.serial = 0;
+    }
+
+    vga_dirty_active = (span != 0) && vga.dirty.tracking;
+}
+
+/* true if the scanline about to be drawn is the same as the last time */
+static bool VGA_DirtyLineUnchanged(void) {
+    if (!vga_dirty_active || vga_page_flip_occurred || vga_3da_polled || VGA_DrawLine != vga_dirty_drawline ||
+        (CaptureState & CAPTURE_RAWIMAGE))
+        return false;
+    if (vga.draw.lines_done >= vga_dirty_lines.size())
+        return false;
+
+    const VGA_DirtyLine &l = vga_dirty_lines[vga.draw.lines_done];
+    if (l.serial <= vga.dirty.invalid || l.address != vga.draw.address || l.address_line != vga.draw.address_line ||
+        l.panning != vga.draw.panning)
+        return false;
+    if (!RENDER_CanSkipLine())
+        return false;
+
+    /* the video memory the scanline reads, which may wrap around */
+    const Bitu base = (Bitu)(vga_dirty_base - vga.mem.linear);
+    return !vga.dirty.written_since(base,vga.draw.address & vga_dirty_mask & ~((Bitu)3u),vga_dirty_span,vga_dirty_mask,l.serial);
+}
+
+/* called after the scanline was drawn and handed to the renderer */
+static void VGA_DirtyLineDrawn(const bool unmodified) {
+    if (vga.draw.lines_done >= vga_dirty_lines.size())
+        return;
+
+    VGA_DirtyLine &l = vga_dirty_lines[vga.draw.lines_done];
+    if (unmodified && vga_dirty_active && VGA_DrawLine == vga_dirty_drawline && RENDER_LineCached()) {
+        l.serial = vga.dirty.serial;
+        l.address = vga.draw.address;
+        l.address_line = vga.draw.address_line;
+        l.panning = vga.draw.panning;
+    }
+    else if (render.updating) {
+        /* the render cache no longer holds what the record describes */
+        l.serial = 0;
+    }
+}
+
 static void VGA_DrawSingleLine(Bitu /*blah*/) {
+    HOSTPROF_SCOPE(HOSTPROF_VGA_LINE);
     unsigned int lines = 0;
     bool skiprender;
 
     vga.draw.hsync_events++;
-    if (vga.draw.lines_done == 0)
+    if (vga.draw.lines_done == 0) {
         vga.draw.must_complete_frame = true; /* frame started, vsync must complete it */
+        VGA_DirtyStartFrame();
+    }
 
 again:
     if (vga.draw.render_step == 0)
@@ -3889,8 +4054,14 @@ again:
                     memxor_greendotted_16bpp((uint16_t*)TempLine,(vga.draw.width>>1)*(vga.draw.bpp>>3),vga.draw.lines_done);
                 vga_3da_polled = false;
             }
-            RENDER_DrawLine(TempLine);
+            VGA_RenderScanline(TempLine);
+            VGA_DirtyLineDrawn(false);
+        } else if (VGA_DirtyLineUnchanged()) {
+            VGA_RenderScanline(NULL);
         } else {
+            /* video memory written from here on is newer than this scanline */
+            vga.dirty.serial++;
+
             if ((CaptureState & CAPTURE_RAWIMAGE) && VGA_DrawRawLine && rawshot.capturing) {
                 if (rawshot.render_y < rawshot.image_height && rawshot.image != NULL) {
                     VGA_DrawRawLine(
@@ -3917,6 +4088,7 @@ again:
             /* NTS: SVGA modes M_LIN15/16/24/32 DrawLine(), if not rendering the hardware cursor, often point directly at video RAM!
              *      Rendering past it will just corrupt video RAM! Make a copy if any such overlays will occur! */
             bool renderOK = true;
+            const bool unmodified = !video_debug_overlay && !vga_page_flip_occurred && !vga_3da_polled;
 
             if (!(data >= TempLine && data < (TempLine+(64*4)))) {
                 renderOK = false;
@@ -3947,7 +4119,8 @@ again:
                 }
             }
 
-            RENDER_DrawLine(data);
+            VGA_RenderScanline(data);
+            VGA_DirtyLineDrawn(unmodified);
         }
     }
 
@@ -4005,6 +4178,7 @@ again:
 }
 
 static void VGA_DrawEGASingleLine(Bitu /*blah*/) {
+    HOSTPROF_SCOPE(HOSTPROF_VGA_LINE);
     bool skiprender;
 
     if (vga.draw.render_step == 0)
@@ -4021,7 +4195,7 @@ static void VGA_DrawEGASingleLine(Bitu /*blah*/) {
     if (!skiprender) {
         if (GCC_UNLIKELY(vga.attr.disabled && !vga.dosboxig.svga)) {
             memset(TempLine, 0, TempLineSize);
-            RENDER_DrawLine(TempLine);
+            VGA_RenderScanline(TempLine);
         } else {
             Bitu address = vga.draw.address;
             if (machine != MCH_EGA) {
@@ -4049,7 +4223,7 @@ static void VGA_DrawEGASingleLine(Bitu /*blah*/) {
             uint8_t * data=VGA_DrawLine(address, vga.draw.address_line ); 
             if (video_debug_overlay && vga.draw.width < render.src.width) VGA_DrawDebugLine(data+(vga.draw.width*((vga.draw.bpp+7u)>>3u)),render.src.width-vga.draw.width);
 
-            RENDER_DrawLine(data);
+            VGA_RenderScanline(data);
         }
     }
 
@@ -5637,6 +5811,12 @@ void VGA_sof_debug_video_info(void) {
 		}
 	}
 
+#if C_HOST_PROFILER
+	/* bottom line: where the host time went, see hostprof.h */
+	HOSTPROF_OverlayText(tmp,sizeof(tmp));
+	VGA_debug_screen_puts8(4,(int)VGA_debug_screen_h - 4 - 8,tmp,white);
+#endif
+
 	if ((++single_digit_frame_count) >= 10)
 		single_digit_frame_count = 0;
 }
@@ -0,0 +1,200 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Pixel conversion kernels of the VGA line renderers, included by vga_draw.cpp.
+ *
+ * The line renderers work out the video memory addresses and gather what they
+ * read into a small buffer, these convert the buffer to 32bpp pixels. Each one
+ * has a plain C version and AVX2 and/or NEON versions, and a dispatcher that
+ * picks one at runtime like cacheHit_AVX2() in render.cpp. NEON has no gather,
+ * so the palette lookups stay in C there. */
+
+#ifndef DOSBOX_VGA_DRAW_SIMD_H
+#define DOSBOX_VGA_DRAW_SIMD_H
+
+#include "dosbox.h"
+
+/* avx2_available is only set where dosbox.cpp checks for it */
+#if defined(__SSE__) && defined(__GNUC__) && !(defined(_M_AMD64) || defined(__e2k__)) && !defined(EMSCRIPTEN)
+# define VGA_DRAW_AVX2 1
+# include <immintrin.h>
+#endif
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(WORDS_BIGENDIAN)
+# define VGA_DRAW_NEON 1
+# include <arm_neon.h>
+#endif
+
+/* 8 pixels per dword of the four planes: plane n is byte n (as read on a little
+ * endian host), the leftmost pixel is bit 7 */
+static inline void VGA_Planar4ToXlat32_C(uint32_t *dst,const uint32_t *src,Bitu count,const uint32_t *xlat) {
+    for (Bitu i=0;i < count;i++) {
+        const uint32_t p = src[i];
+        for (unsigned int x=0;x < 8;x++) {
+            const uint32_t t = p >> (7u - x);
+            dst[x] = xlat[(t & 1u) | ((t >> 7u) & 2u) | ((t >> 14u) & 4u) | ((t >> 21u) & 8u)];
+        }
+        dst += 8;
+    }
+}
+
+static inline void VGA_Xlat8To32_C(uint32_t *dst,const uint8_t *src,Bitu count,const uint32_t *xlat) {
+    for (Bitu i=0;i < count;i++)
+        dst[i] = xlat[src[i]];
+}
+
+/* Reads a byte past the last pixel, like the original 24bpp renderer */
+static inline void VGA_RGB24To32_C(uint32_t *dst,const uint8_t *src,Bitu count) {
+    for (Bitu i=0;i < count;i++)
+        dst[i] = *((const uint32_t*)(src + i*3u)) | 0xFF000000u;
+}
+
+/* One text mode character per entry: the font pattern and the translated colors,
+ * bit 7 is the leftmost pixel, bit 8 for 9 pixel wide characters */
+static inline void VGA_TextExpand32_C(uint32_t *dst,const uint16_t *font,const uint32_t *fg,const uint32_t *bg,Bitu count,unsigned int width) {
+    for (Bitu i=0;i < count;i++) {
+        for (unsigned int x=0;x < width;x++)
+            dst[x] = (font[i] & (1u << (width - 1u - x))) ? fg[i] : bg[i];
+        dst += width;
+    }
+}
+
+#if defined(VGA_DRAW_AVX2)
+__attribute__((__target__("avx2")))
+static inline void VGA_Planar4ToXlat32_AVX2(uint32_t *dst,const uint32_t *src,Bitu count,const uint32_t *xlat) {
+    const __m256i shift = _mm256_setr_epi32(7,6,5,4,3,2,1,0);
+    const __m256i one = _mm256_set1_epi32(1);
+    for (Bitu i=0;i < count;i++) {
+        const __m256i t = _mm256_srlv_epi32(_mm256_set1_epi32((int)src[i]),shift);
+        __m256i idx = _mm256_and_si256(t,one);
+        idx = _mm256_or_si256(idx,_mm256_and_si256(_mm256_srli_epi32(t, 7),_mm256_set1_epi32(2)));
+        idx = _mm256_or_si256(idx,_mm256_and_si256(_mm256_srli_epi32(t,14),_mm256_set1_epi32(4)));
+        idx = _mm256_or_si256(idx,_mm256_and_si256(_mm256_srli_epi32(t,21),_mm256_set1_epi32(8)));
+        _mm256_storeu_si256((__m256i*)dst,_mm256_i32gather_epi32((const int*)xlat,idx,4));
+        dst += 8;
+    }
+}
+
+__attribute__((__target__("avx2")))
+static inline void VGA_Xlat8To32_AVX2(uint32_t *dst,const uint8_t *src,Bitu count,const uint32_t *xlat) {
+    Bitu i = 0;
+    for (;i + 8u <= count;i += 8u) {
+        const __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+        _mm256_storeu_si256((__m256i*)(dst + i),_mm256_i32gather_epi32((const int*)xlat,idx,4));
+    }
+    for (;i < count;i++)
+        dst[i] = xlat[src[i]];
+}
+
+/* 8 pixels from two 16-byte loads, 12 bytes apart. Needs 9 pixels to go so the
+ * second load stays within what the C version reads. */
+__attribute__((__target__("avx2")))
+static inline void VGA_RGB24To32_AVX2(uint32_t *dst,const uint8_t *src,Bitu count) {
+    const __m256i shuf = _mm256_setr_epi8(0,1,2,-1,3,4,5,-1,6,7,8,-1,9,10,11,-1,
+                                          0,1,2,-1,3,4,5,-1,6,7,8,-1,9,10,11,-1);
+    const __m256i alpha = _mm256_set1_epi32((int)0xFF000000u);
+    Bitu i = 0;
+    for (;i + 9u <= count;i += 8u) {
+        const __m128i lo = _mm_loadu_si128((const __m128i*)(src + i*3u));
+        const __m128i hi = _mm_loadu_si128((const __m128i*)(src + i*3u + 12u));
+        const __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo),hi,1);
+        _mm256_storeu_si256((__m256i*)(dst + i),_mm256_or_si256(_mm256_shuffle_epi8(v,shuf),alpha));
+    }
+    VGA_RGB24To32_C(dst + i,src + i*3u,count - i);
+}
+
+__attribute__((__target__("avx2")))
+static inline void VGA_TextExpand32_AVX2(uint32_t *dst,const uint16_t *font,const uint32_t *fg,const uint32_t *bg,Bitu count,unsigned int width) {
+    /* the first 8 pixels, the 9th of wide characters is bit 0 */
+    const unsigned int s = width - 8u;
+    const __m256i bits = _mm256_setr_epi32(0x80<<s,0x40<<s,0x20<<s,0x10<<s,0x08<<s,0x04<<s,0x02<<s,0x01<<s);
+    for (Bitu i=0;i < count;i++) {
+        const __m256i set = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(font[i]),bits),bits);
+        const __m256i px = _mm256_blendv_epi8(_mm256_set1_epi32((int)bg[i]),_mm256_set1_epi32((int)fg[i]),set);
+        _mm256_storeu_si256((__m256i*)dst,px);
+        if (s) dst[8] = (font[i] & 1u) ? fg[i] : bg[i];
+        dst += width;
+    }
+}
+#endif
+
+#if defined(VGA_DRAW_NEON)
+static inline void VGA_RGB24To32_NEON(uint32_t *dst,const uint8_t *src,Bitu count) {
+    Bitu i = 0;
+    for (;i + 16u <= count;i += 16u) {
+        const uint8x16x3_t rgb = vld3q_u8(src + i*3u);
+        uint8x16x4_t rgba;
+        rgba.val[0] = rgb.val[0];
+        rgba.val[1] = rgb.val[1];
+        rgba.val[2] = rgb.val[2];
+        rgba.val[3] = vdupq_n_u8(0xFF);
+        vst4q_u8((uint8_t*)(dst + i),rgba);
+    }
+    VGA_RGB24To32_C(dst + i,src + i*3u,count - i);
+}
+
+static inline void VGA_TextExpand32_NEON(uint32_t *dst,const uint16_t *font,const uint32_t *fg,const uint32_t *bg,Bitu count,unsigned int width) {
+    const unsigned int s = width - 8u;
+    const uint32_t lobits[4] = { 0x80u<<s,0x40u<<s,0x20u<<s,0x10u<<s };
+    const uint32_t hibits[4] = { 0x08u<<s,0x04u<<s,0x02u<<s,0x01u<<s };
+    const uint32x4_t lo = vld1q_u32(lobits), hi = vld1q_u32(hibits);
+    for (Bitu i=0;i < count;i++) {
+        const uint32x4_t f = vdupq_n_u32(font[i]);
+        const uint32x4_t fc = vdupq_n_u32(fg[i]), bc = vdupq_n_u32(bg[i]);
+        vst1q_u32(dst,    vbslq_u32(vtstq_u32(f,lo),fc,bc));
+        vst1q_u32(dst + 4,vbslq_u32(vtstq_u32(f,hi),fc,bc));
+        if (s) dst[8] = (font[i] & 1u) ? fg[i] : bg[i];
+        dst += width;
+    }
+}
+#endif
+
+static inline void VGA_Planar4ToXlat32(uint32_t *dst,const uint32_t *src,Bitu count,const uint32_t *xlat) {
+#if defined(VGA_DRAW_AVX2)
+    if (avx2_available) { VGA_Planar4ToXlat32_AVX2(dst,src,count,xlat); return; }
+#endif
+    VGA_Planar4ToXlat32_C(dst,src,count,xlat);
+}
+
+static inline void VGA_Xlat8To32(uint32_t *dst,const uint8_t *src,Bitu count,const uint32_t *xlat) {
+#if defined(VGA_DRAW_AVX2)
+    if (avx2_available) { VGA_Xlat8To32_AVX2(dst,src,count,xlat); return; }
+#endif
+    VGA_Xlat8To32_C(dst,src,count,xlat);
+}
+
+static inline void VGA_RGB24To32(uint32_t *dst,const uint8_t *src,Bitu count) {
+#if defined(VGA_DRAW_AVX2)
+    if (avx2_available) { VGA_RGB24To32_AVX2(dst,src,count); return; }
+#endif
+#if defined(VGA_DRAW_NEON)
+    VGA_RGB24To32_NEON(dst,src,count);
+#else
+    VGA_RGB24To32_C(dst,src,count);
+#endif
+}
+
+static inline void VGA_TextExpand32(uint32_t *dst,const uint16_t *font,const uint32_t *fg,const uint32_t *bg,Bitu count,unsigned int width) {
+#if defined(VGA_DRAW_AVX2)
+    if (avx2_available) { VGA_TextExpand32_AVX2(dst,font,fg,bg,count,width); return; }
+#endif
+#if defined(VGA_DRAW_NEON)
+    VGA_TextExpand32_NEON(dst,font,fg,bg,count,width);
+#else
+    VGA_TextExpand32_C(dst,font,fg,bg,count,width);
+#endif
+}
+
+#endif
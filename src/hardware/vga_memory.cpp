@@ -379,6 +379,7 @@ template <const bool chained> static inline void VGA_Generic_Write_Handler(PhysP
 	pixels.d&=~mask;
 	pixels.d|=(data & mask);
 
+	vga.dirty.mark(planeaddr << 2u);
 	((uint32_t*)vga.mem.linear)[planeaddr]=pixels.d;
 }
 
@@ -421,6 +422,7 @@ public:
 	}
 	template <typename T=uint8_t> static INLINE void do_write_aligned(const PhysPt a,const T v) {
 		vga_vram_write_trigger_update();
+		vga.dirty.mark(a);
 		*((T*)(&vga.mem.linear[a])) = v;
 	}
 	template <typename T=uint8_t> static INLINE void do_write(const PhysPt a,const T v) {
@@ -643,6 +645,7 @@ public:
 
 	static INLINE void writeHandler8(PhysPt addr, uint8_t val) {
 		vga_vram_write_trigger_update_planar_mem(addr);
+		vga.dirty.mark(addr << 2u);
 		((uint32_t*)vga.mem.linear)[addr] =
 			(((uint32_t*)vga.mem.linear)[addr] & vga.config.full_not_map_mask) + (ExpandTable[val] & vga.config.full_map_mask);
 	}
@@ -2530,6 +2533,17 @@ void VGA_ChangedBank(void) {
 void MEM_ResetPageHandler_Unmapped(Bitu phys_page, Bitu pages);
 void MEM_ResetPageHandler_RAM(Bitu phys_page, Bitu pages);
 
+/* Dirty tracking is only trusted while every CPU write to video memory goes through a handler
+ * that stamps it, see VGA_Dirty in vga.h. The direct mapped handlers and the linear framebuffer
+ * give the CPU a host pointer, so scanlines drawn while they are mapped are drawn again. */
+static bool vga_dirty_handler_ok = false;
+
+static void VGA_DirtyUpdateTracking(void) {
+	const bool tracking = vga_dirty_handler_ok && vga.lfb.handler == NULL && vga.dirty.stamp != NULL;
+	if (!tracking || !vga.dirty.tracking) vga.dirty.invalidate();
+	vga.dirty.tracking = tracking;
+}
+
 extern void DISP2_SetPageHandler(void);
 void VGA_SetupHandlers(void) {
 	/* This code inherited from DOSBox SVN confuses bank size with bank granularity.
@@ -2546,6 +2560,7 @@ void VGA_SetupHandlers(void) {
 		vga.svga.bank_write_full = vga.svga.bank_write*vga.svga.bank_size;
 	}
 	bool runeten = false;
+	bool dirty_ok = false;
 	PageHandler *newHandler;
 	switch (machine) {
 	case MCH_OLIVETTI: // Olivetti M24 / AT&T 6300: CGA-class B8000 window (32KB)
@@ -2768,6 +2783,9 @@ void VGA_SetupHandlers(void) {
 		newHandler = vga_memio_lfb_delay ? &vgaph.map_slow : &vgaph.map;
 	}
 
+	dirty_ok = (newHandler == &vgaph.cvga || newHandler == &vgaph.cvga_slow || newHandler == &vgaph.cvga_et4000_slow ||
+		newHandler == &vgaph.uvga || newHandler == &vgaph.uvga_fast);
+
 	// Workaround for ETen Chinese DOS system (e.g. ET24VA)
 	if ((dos.loaded_codepage == 936 || dos.loaded_codepage == 950 || dos.loaded_codepage == 951) && RunningProgram.size() > 3 && !strncmp(RunningProgram.c_str(), "ET", 2)) enveten = true;
 	runeten = !vga_fill_inactive_ram && enveten && (dos.loaded_codepage == 936 || dos.loaded_codepage == 950 || dos.loaded_codepage == 951) && ((RunningProgram.size() > 3 && !strncmp(RunningProgram.c_str(), "ET", 2)) || !TTF_using());
@@ -2861,6 +2879,8 @@ range_done:
 #if C_DEBUG
 	if (control->opt_display2) DISP2_SetPageHandler();
 #endif
+	vga_dirty_handler_ok = dirty_ok;
+	VGA_DirtyUpdateTracking();
 	PAGING_ClearTLB();
 }
 
@@ -2929,6 +2949,8 @@ void VGA_StartUpdateLFB(void) {
 			MEM_SetLFB((unsigned int)(vga.s3.la_window & la_winmsk) << 4u,(unsigned int)vga.mem.memsize/4096u, vga.lfb.handler, &vgaph.mmio);
 		}
 	}
+
+	VGA_DirtyUpdateTracking();
 }
 
 static bool VGA_Memory_ShutDown_init = false;
@@ -2953,6 +2975,10 @@ static void VGA_Memory_ShutDown(Section * /*sec*/) {
 		vga.mem.linear_orgptr = NULL;
 		vga.mem.linear = NULL;
 	}
+	if (vga.dirty.stamp != NULL) {
+		delete[] vga.dirty.stamp;
+		vga.dirty.stamp = NULL;
+	}
 }
 
 void VGA_SetupMemory() {
@@ -2965,6 +2991,8 @@ void VGA_SetupMemory() {
         vga.mem.linear_orgptr = new uint8_t[vga.mem.memsize+32u];
         memset(vga.mem.linear_orgptr,0,vga.mem.memsize+32u);
         vga.mem.linear=(uint8_t*)(((uintptr_t)vga.mem.linear_orgptr + 16ull-1ull) & ~(16ull-1ull));
+        vga.dirty.stamp = new uint32_t[(vga.mem.memsize >> VGA_DIRTY_SHIFT) + 1u]();
+        vga.dirty.invalidate();
 
         /* HACK. try to avoid stale pointers */
 	    vga.draw.linear_base = vga.mem.linear;
@@ -3047,6 +3075,7 @@ void POD_Load_VGA_Memory( std::istream& stream )
 
 	// - pure data
 	READ_POD_SIZE( vga.mem.linear, sizeof(uint8_t) * vga.mem.memsize);
+	vga.dirty.invalidate();
 
 	//***************************************************
 	//***************************************************
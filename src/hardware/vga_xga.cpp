@@ -2336,6 +2336,9 @@ void XGA_ViRGE_Poly2D_Execute_deferred(void) {
 void XGA_Write(Bitu port, Bitu val, Bitu len) {
 //	LOG_MSG("XGA: Write to port %x, val %8x, len %x", (unsigned int)port, (unsigned int)val, (unsigned int)len);
 
+	/* the accelerator draws into video memory directly */
+	vga.dirty.invalidate();
+
 #if 0
 	// streams processing debug
 	if (port >= 0x8180 && port <= 0x81FF)
@@ -116,12 +116,20 @@ class VOODOO:public Module_base{
 			else
 				max_voodoomem = false;
 
+			/* rasterizer threads for the software renderer, -1 picks a count from the host CPU */
+			int threads = -1;
+			std::string threads_str(section->Get_string("voodoo_threads"));
+			if (threads_str != "auto") {
+				threads = atoi(threads_str.c_str());
+				if (threads < 0) threads = 0;
+			}
+
 			bool needs_pci_device = false;
 
 			switch (emulation_type) {
 				case 1:
 				case 2:
-					Voodoo_Initialize(emulation_type, card_type, max_voodoomem);
+					Voodoo_Initialize(emulation_type, card_type, max_voodoomem, threads);
 					needs_pci_device = true;
 					break;
 				default:
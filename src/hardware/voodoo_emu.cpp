@@ -75,6 +75,13 @@ iterated W    = 18.32 [48 bits]
 #include <string.h>
 #include <math.h>
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "dosbox.h"
 #include "cross.h"
 #include "logging.h"
@@ -124,21 +131,26 @@ static void triangle_create_work_item(voodoo_state *v, UINT16 *drawbuf, int texc
 /* rasterizer management */
 static raster_info *add_rasterizer(voodoo_state *v, const raster_info *cinfo);
 static raster_info *find_rasterizer(voodoo_state *v, int texcount);
+static void dump_rasterizer_stats(voodoo_state *v);
 
 /* generic rasterizers */
-static void raster_fastfill(void *dest, INT32 scanline, const poly_extent *extent, const void *extradata);
+static void raster_fastfill(void *dest, INT32 scanline, const poly_extent *extent, const void *extradata, int threadid);
 
 
 /***************************************************************************
     RASTERIZER MANAGEMENT
 ***************************************************************************/
 
-void raster_generic(UINT32 TMUS, UINT32 TEXMODE0, UINT32 TEXMODE1, void *destbase,
-					INT32 y, const poly_extent *extent,	const void *extradata)
+/* The modes are parameters, not register reads, so that the rasterizers in
+   voodoo_rast.h get this inlined with constants and the compiler drops every
+   branch that does not apply to them. */
+static INLINE void raster_generic(UINT32 TMUS, UINT32 FBZCOLORPATH, UINT32 ALPHAMODE, UINT32 FOGMODE, UINT32 FBZMODE,
+					UINT32 TEXMODE0, UINT32 TEXMODE1, void *destbase,
+					INT32 y, const poly_extent *extent,	const void *extradata, int threadid)
 {
 	const poly_extra_data *extra = (const poly_extra_data *)extradata;
 	voodoo_state *v = extra->state;
-	stats_block *stats = &v->thread_stats[0];
+	stats_block *stats = &v->thread_stats[threadid];
 	DECLARE_DITHER_POINTERS;
 	INT32 startx = extent->startx;
 	INT32 stopx = extent->stopx;
@@ -155,14 +167,14 @@ void raster_generic(UINT32 TMUS, UINT32 TEXMODE0, UINT32 TEXMODE1, void *destbas
 
 	/* determine the screen Y */
 	scry = y;
-	if (FBZMODE_Y_ORIGIN(v->reg[fbzMode].u))
+	if (FBZMODE_Y_ORIGIN(FBZMODE))
 		scry = (v->fbi.yorigin - y) & 0x3ff;
 
 	/* compute the dithering pointers */
-	if (FBZMODE_ENABLE_DITHERING(v->reg[fbzMode].u))
+	if (FBZMODE_ENABLE_DITHERING(FBZMODE))
 	{
 		dither4 = &dither_matrix_4x4[(y & 3) * 4];
-		if (FBZMODE_DITHER_TYPE(v->reg[fbzMode].u) == 0)
+		if (FBZMODE_DITHER_TYPE(FBZMODE) == 0)
 		{
 			dither = dither4;
 			dither_lookup = &dither4_lookup[(y & 3) << 11];
@@ -175,7 +187,7 @@ void raster_generic(UINT32 TMUS, UINT32 TEXMODE0, UINT32 TEXMODE1, void *destbas
 	}
 
 	/* apply clipping */
-	if (FBZMODE_ENABLE_CLIPPING(v->reg[fbzMode].u))
+	if (FBZMODE_ENABLE_CLIPPING(FBZMODE))
 	{
 		INT32 tempclip;
 
@@ -236,7 +248,7 @@ void raster_generic(UINT32 TMUS, UINT32 TEXMODE0, UINT32 TEXMODE1, void *destbas
 		rgb_union texel = { 0 };
 
 		/* pixel pipeline part 1 handles depth testing and stippling */
-		PIXEL_PIPELINE_BEGIN(v, x, y, v->reg[fbzColorPath].u, v->reg[fbzMode].u, iterz, iterw);
+		PIXEL_PIPELINE_BEGIN(v, x, y, FBZCOLORPATH, FBZMODE, iterz, iterw);
 
 		/* run the texture pipeline on TMU1 to produce a value in texel */
 		/* note that they set LOD min to 8 to "disable" a TMU */
@@ -260,7 +272,7 @@ void raster_generic(UINT32 TMUS, UINT32 TEXMODE0, UINT32 TEXMODE1, void *destbas
 		}
 
 		/* colorpath pipeline selects source colors and does blending */
-		CLAMPED_ARGB(iterr, iterg, iterb, itera, v->reg[fbzColorPath].u, iterargb);
+		CLAMPED_ARGB(iterr, iterg, iterb, itera, FBZCOLORPATH, iterargb);
 
 
 		INT32 blendr, blendg, blendb, blenda;
@@ -268,7 +280,7 @@ void raster_generic(UINT32 TMUS, UINT32 TEXMODE0, UINT32 TEXMODE1, void *destbas
 		rgb_union c_local;
 
 		/* compute c_other */
-		switch (FBZCP_CC_RGBSELECT(v->reg[fbzColorPath].u))
+		switch (FBZCP_CC_RGBSELECT(FBZCOLORPATH))
 		{
 			case 0:		/* iterated RGB */
 				c_other.u = iterargb.u;
@@ -285,10 +297,10 @@ void raster_generic(UINT32 TMUS, UINT32 TEXMODE0, UINT32 TEXMODE1, void *destbas
 		}
 
 		/* handle chroma key */
-		APPLY_CHROMAKEY(v, stats, v->reg[fbzMode].u, c_other);
+		APPLY_CHROMAKEY(v, stats, FBZMODE, c_other);
 
 		/* compute a_other */
-		switch (FBZCP_CC_ASELECT(v->reg[fbzColorPath].u))
+		switch (FBZCP_CC_ASELECT(FBZCOLORPATH))
 		{
 			case 0:		/* iterated alpha */
 				c_other.rgb.a = iterargb.rgb.a;
@@ -305,15 +317,15 @@ void raster_generic(UINT32 TMUS, UINT32 TEXMODE0, UINT32 TEXMODE1, void *destbas
 		}
 
 		/* handle alpha mask */
-		APPLY_ALPHAMASK(v, stats, v->reg[fbzMode].u, c_other.rgb.a);
+		APPLY_ALPHAMASK(v, stats, FBZMODE, c_other.rgb.a);
 
 		/* handle alpha test */
-		APPLY_ALPHATEST(v, stats, v->reg[alphaMode].u, c_other.rgb.a);
+		APPLY_ALPHATEST(v, stats, ALPHAMODE, c_other.rgb.a);
 
 		/* compute c_local */
-		if (FBZCP_CC_LOCALSELECT_OVERRIDE(v->reg[fbzColorPath].u) == 0)
+		if (FBZCP_CC_LOCALSELECT_OVERRIDE(FBZCOLORPATH) == 0)
 		{
-			if (FBZCP_CC_LOCALSELECT(v->reg[fbzColorPath].u) == 0)	/* iterated RGB */
+			if (FBZCP_CC_LOCALSELECT(FBZCOLORPATH) == 0)	/* iterated RGB */
 				c_local.u = iterargb.u;
 			else											/* color0 RGB */
 				c_local.u = v->reg[color0].u;
@@ -327,7 +339,7 @@ void raster_generic(UINT32 TMUS, UINT32 TEXMODE0, UINT32 TEXMODE1, void *destbas
 		}
 
 		/* compute a_local */
-		switch (FBZCP_CCA_LOCALSELECT(v->reg[fbzColorPath].u))
+		switch (FBZCP_CCA_LOCALSELECT(FBZCOLORPATH))
 		{
 			default:
 			case 0:		/* iterated alpha */
@@ -339,21 +351,21 @@ void raster_generic(UINT32 TMUS, UINT32 TEXMODE0, UINT32 TEXMODE1, void *destbas
 			case 2:		/* clamped iterated Z[27:20] */
 			{
 				int temp;
-				CLAMPED_Z(iterz, v->reg[fbzColorPath].u, temp);
+				CLAMPED_Z(iterz, FBZCOLORPATH, temp);
 				c_local.rgb.a = (UINT8)temp;
 				break;
 			}
 			case 3:		/* clamped iterated W[39:32] */
 			{
 				int temp;
-				CLAMPED_W(iterw, v->reg[fbzColorPath].u, temp);			/* Voodoo 2 only */
+				CLAMPED_W(iterw, FBZCOLORPATH, temp);			/* Voodoo 2 only */
 				c_local.rgb.a = (UINT8)temp;
 				break;
 			}
 		}
 
 		/* select zero or c_other */
-		if (FBZCP_CC_ZERO_OTHER(v->reg[fbzColorPath].u) == 0)
+		if (FBZCP_CC_ZERO_OTHER(FBZCOLORPATH) == 0)
 		{
 			r = c_other.rgb.r;
 			g = c_other.rgb.g;
@@ -363,13 +375,13 @@ void raster_generic(UINT32 TMUS, UINT32 TEXMODE0, UINT32 TEXMODE1, void *destbas
 			r = g = b = 0;
 
 		/* select zero or a_other */
-		if (FBZCP_CCA_ZERO_OTHER(v->reg[fbzColorPath].u) == 0)
+		if (FBZCP_CCA_ZERO_OTHER(FBZCOLORPATH) == 0)
 			a = c_other.rgb.a;
 		else
 			a = 0;
 
 		/* subtract c_local */
-		if (FBZCP_CC_SUB_CLOCAL(v->reg[fbzColorPath].u))
+		if (FBZCP_CC_SUB_CLOCAL(FBZCOLORPATH))
 		{
 			r -= c_local.rgb.r;
 			g -= c_local.rgb.g;
@@ -377,11 +389,11 @@ void raster_generic(UINT32 TMUS, UINT32 TEXMODE0, UINT32 TEXMODE1, void *destbas
 		}
 
 		/* subtract a_local */
-		if (FBZCP_CCA_SUB_CLOCAL(v->reg[fbzColorPath].u))
+		if (FBZCP_CCA_SUB_CLOCAL(FBZCOLORPATH))
 			a -= c_local.rgb.a;
 
 		/* blend RGB */
-		switch (FBZCP_CC_MSELECT(v->reg[fbzColorPath].u))
+		switch (FBZCP_CC_MSELECT(FBZCOLORPATH))
 		{
 			default:	/* reserved */
 			case 0:		/* 0 */
@@ -409,7 +421,7 @@ void raster_generic(UINT32 TMUS, UINT32 TEXMODE0, UINT32 TEXMODE1, void *destbas
 		}
 
 		/* blend alpha */
-		switch (FBZCP_CCA_MSELECT(v->reg[fbzColorPath].u))
+		switch (FBZCP_CCA_MSELECT(FBZCOLORPATH))
 		{
 			default:	/* reserved */
 			case 0:		/* 0 */
@@ -430,7 +442,7 @@ void raster_generic(UINT32 TMUS, UINT32 TEXMODE0, UINT32 TEXMODE1, void *destbas
 		}
 
 		/* reverse the RGB blend */
-		if (!FBZCP_CC_REVERSE_BLEND(v->reg[fbzColorPath].u))
+		if (!FBZCP_CC_REVERSE_BLEND(FBZCOLORPATH))
 		{
 			blendr ^= 0xff;
 			blendg ^= 0xff;
@@ -438,7 +450,7 @@ void raster_generic(UINT32 TMUS, UINT32 TEXMODE0, UINT32 TEXMODE1, void *destbas
 		}
 
 		/* reverse the alpha blend */
-		if (!FBZCP_CCA_REVERSE_BLEND(v->reg[fbzColorPath].u))
+		if (!FBZCP_CCA_REVERSE_BLEND(FBZCOLORPATH))
 			blenda ^= 0xff;
 
 		/* do the blend */
@@ -448,7 +460,7 @@ void raster_generic(UINT32 TMUS, UINT32 TEXMODE0, UINT32 TEXMODE1, void *destbas
 		a = (a * (blenda + 1)) >> 8;
 
 		/* add clocal or alocal to RGB */
-		switch (FBZCP_CC_ADD_ACLOCAL(v->reg[fbzColorPath].u))
+		switch (FBZCP_CC_ADD_ACLOCAL(FBZCOLORPATH))
 		{
 			case 3:		/* reserved */
 			case 0:		/* nothing */
@@ -466,7 +478,7 @@ void raster_generic(UINT32 TMUS, UINT32 TEXMODE0, UINT32 TEXMODE1, void *destbas
 		}
 
 		/* add clocal or alocal to alpha */
-		if (FBZCP_CCA_ADD_ACLOCAL(v->reg[fbzColorPath].u))
+		if (FBZCP_CCA_ADD_ACLOCAL(FBZCOLORPATH))
 			a += c_local.rgb.a;
 
 		/* clamp */
@@ -476,21 +488,21 @@ void raster_generic(UINT32 TMUS, UINT32 TEXMODE0, UINT32 TEXMODE1, void *destbas
 		CLAMP(a, 0x00, 0xff);
 
 		/* invert */
-		if (FBZCP_CC_INVERT_OUTPUT(v->reg[fbzColorPath].u))
+		if (FBZCP_CC_INVERT_OUTPUT(FBZCOLORPATH))
 		{
 			r ^= 0xff;
 			g ^= 0xff;
 			b ^= 0xff;
 		}
-		if (FBZCP_CCA_INVERT_OUTPUT(v->reg[fbzColorPath].u))
+		if (FBZCP_CCA_INVERT_OUTPUT(FBZCOLORPATH))
 			a ^= 0xff;
 
 
 		/* pixel pipeline part 2 handles fog, alpha, and final output */
 		PIXEL_PIPELINE_MODIFY(v, dither, dither4, x,
-							v->reg[fbzMode].u, v->reg[fbzColorPath].u, v->reg[alphaMode].u, v->reg[fogMode].u,
+							FBZMODE, FBZCOLORPATH, ALPHAMODE, FOGMODE,
 							iterz, iterw, iterargb);
-		PIXEL_PIPELINE_FINISH(v, dither_lookup, x, dest, depth, v->reg[fbzMode].u);
+		PIXEL_PIPELINE_FINISH(v, dither_lookup, x, dest, depth, FBZMODE);
 		PIXEL_PIPELINE_END(stats);
 
 		/* update the iterated parameters */
@@ -520,18 +532,40 @@ void raster_generic(UINT32 TMUS, UINT32 TEXMODE0, UINT32 TEXMODE1, void *destbas
     RASTERIZER MANAGEMENT
 ***************************************************************************/
 
-void raster_generic_0tmu(void *destbase, INT32 y, const poly_extent *extent, const void *extradata) {
-	raster_generic(0, 0, 0, destbase, y, extent, extradata);
+void raster_generic_0tmu(void *destbase, INT32 y, const poly_extent *extent, const void *extradata, int threadid) {
+	const poly_extra_data *extra = (const poly_extra_data *)extradata;
+	raster_generic(0, extra->r_fbzColorPath, extra->r_alphaMode, extra->r_fogMode, extra->r_fbzMode,
+					0, 0, destbase, y, extent, extradata, threadid);
 }
 
-void raster_generic_1tmu(void *destbase, INT32 y, const poly_extent *extent, const void *extradata) {
-	raster_generic(1, v->tmu[0].reg[textureMode].u, 0, destbase, y, extent, extradata);
+void raster_generic_1tmu(void *destbase, INT32 y, const poly_extent *extent, const void *extradata, int threadid) {
+	const poly_extra_data *extra = (const poly_extra_data *)extradata;
+	raster_generic(1, extra->r_fbzColorPath, extra->r_alphaMode, extra->r_fogMode, extra->r_fbzMode,
+					extra->r_textureMode0, 0, destbase, y, extent, extradata, threadid);
 }
 
-void raster_generic_2tmu(void *destbase, INT32 y, const poly_extent *extent, const void *extradata) {
-	raster_generic(2, v->tmu[0].reg[textureMode].u, v->tmu[1].reg[textureMode].u, destbase, y, extent, extradata);
+void raster_generic_2tmu(void *destbase, INT32 y, const poly_extent *extent, const void *extradata, int threadid) {
+	const poly_extra_data *extra = (const poly_extra_data *)extradata;
+	raster_generic(2, extra->r_fbzColorPath, extra->r_alphaMode, extra->r_fogMode, extra->r_fbzMode,
+					extra->r_textureMode0, extra->r_textureMode1, destbase, y, extent, extradata, threadid);
 }
 
+/* the rasterizers in voodoo_rast.h, raster_generic() with constant modes */
+template <UINT32 FBZCOLORPATH, UINT32 ALPHAMODE, UINT32 FOGMODE, UINT32 FBZMODE, UINT32 TEXMODE0, UINT32 TEXMODE1>
+static void raster_specialized(void *destbase, INT32 y, const poly_extent *extent, const void *extradata, int threadid) {
+	raster_generic((TEXMODE1 != 0xffffffff) ? 2 : (TEXMODE0 != 0xffffffff) ? 1 : 0,
+					FBZCOLORPATH, ALPHAMODE, FOGMODE, FBZMODE, TEXMODE0, TEXMODE1,
+					destbase, y, extent, extradata, threadid);
+}
+
+static const raster_info predef_raster_table[] =
+{
+#define RASTERIZER_ENTRY(fbzcp, alpha, fog, fbz, tex0, tex1) \
+	{ NULL, raster_specialized<fbzcp, alpha, fog, fbz, tex0, tex1>, false, 0, 0, 0, fbzcp, alpha, fog, fbz, tex0, tex1 },
+#include "voodoo_rast.h"
+#undef RASTERIZER_ENTRY
+};
+
 
 
 /*************************************
@@ -691,6 +725,8 @@ void voodoo_swap_buffers(voodoo_state *v)
 		return;
 	}
 
+	voodoo_work_wait();
+
 	/* keep a history of swap intervals */
 	v->reg[fbiSwapHistory].u = (v->reg[fbiSwapHistory].u << 4);
 
@@ -1127,15 +1163,249 @@ INLINE INT32 round_coordinate(float value)
 	return result + (value - (float)result > 0.5f);
 }
 
-void poly_render_triangle(void *dest, poly_draw_scanline_func callback, const poly_vertex *v1, const poly_vertex *v2, const poly_vertex *v3, poly_extra_data *extra)
+/* a triangle sorted by Y, with the slopes of its edges */
+struct poly_triangle
 {
+	float x1, y1, x2, y2, x3, y3;
 	float dxdy_v1v2, dxdy_v1v3, dxdy_v2v3;
-	const poly_vertex *tv;
-	INT32 curscan, scaninc=1;
+	INT32 starty, stopy;
+};
 
-	INT32 v1yclip, v3yclip;
-    INT32 v1y, v3y;
-    //INT32 v1x; UNUSED
+INLINE void poly_triangle_extent(const poly_triangle *tri, INT32 curscan, poly_extent *extent)
+{
+	float fully = (float)curscan + 0.5f;
+	float startx = tri->x1 + (fully - tri->y1) * tri->dxdy_v1v3;
+	float stopx;
+	INT32 istartx, istopx;
+
+	/* compute the ending X based on which part of the triangle we're in */
+	if (fully < tri->y2)
+		stopx = tri->x1 + (fully - tri->y1) * tri->dxdy_v1v2;
+	else
+		stopx = tri->x2 + (fully - tri->y2) * tri->dxdy_v2v3;
+
+	/* clamp to full pixels */
+	istartx = round_coordinate(startx);
+	istopx = round_coordinate(stopx);
+
+	/* force start < stop */
+	if (istartx > istopx)
+	{
+		INT32 temp = istartx;
+		istartx = istopx;
+		istopx = temp;
+	}
+
+	/* set the extent and update the total pixel count */
+	if (istartx >= istopx)
+		istartx = istopx = 0;
+
+	extent->startx = istartx;
+	extent->stopx = istopx;
+}
+
+
+
+/*************************************
+ *
+ *  Rasterizer threads
+ *
+ *  Triangles are queued to worker threads in order. Worker n draws the
+ *  scanlines of every triangle that fall into its bands of four lines
+ *  (((y >> 2) % count) == n), so each pixel is only ever written by one
+ *  thread and the triangles that touch it are still drawn in the order
+ *  they were submitted. The rasterizers read the live register, TMU and
+ *  FBI state, so everything that changes or reads that state waits for
+ *  the queue to drain first (voodoo_work_wait): all register writes but
+ *  the triangle parameters, LFB and texture writes, all reads, buffer
+ *  swaps and the screen update.
+ *
+ *************************************/
+
+#define VOODOO_WORK_ITEMS		256
+#define VOODOO_MAX_THREADS		16
+
+struct voodoo_work_item
+{
+	void *					dest;
+	poly_draw_scanline_func	callback;
+	poly_triangle			tri;
+	poly_extra_data			extra;
+};
+
+struct voodoo_work_counter
+{
+	std::atomic<UINT32>		done;					/* items this thread has finished */
+	UINT8					filler[64 - sizeof(std::atomic<UINT32>)];	/* one cache line each */
+};
+
+struct voodoo_work_queue
+{
+	voodoo_work_item		items[VOODOO_WORK_ITEMS];
+	std::atomic<UINT32>		head;					/* items queued so far */
+	voodoo_work_counter		counter[VOODOO_MAX_THREADS];
+	std::mutex				lock;
+	std::condition_variable	work_cv;				/* workers wait here for items */
+	std::condition_variable	idle_cv;				/* the emulation thread waits here for workers */
+	std::atomic<int>		sleepers;
+	std::atomic<bool>		waiting;
+	bool					quit;
+	std::vector<std::thread> threads;
+};
+
+/* number of worker threads, 0 draws on the emulation thread */
+static unsigned int voodoo_work_threads = 0;
+
+/* the configured number of threads, for starting them when OpenGL fails */
+static int voodoo_work_config = 0;
+
+/* allocated while the workers run, so that nothing is destroyed under them
+   if the emulator exits without shutting the Voodoo down */
+static voodoo_work_queue *voodoo_work = NULL;
+
+static void voodoo_work_render(const voodoo_work_item *item, unsigned int band, int threadid)
+{
+	const INT32 count = (INT32)voodoo_work_threads;
+	poly_extent extent;
+
+	for (INT32 y = item->tri.starty; y < item->tri.stopy; y++)
+	{
+		/* skip the rest of a band that belongs to another thread */
+		if ((unsigned int)((((y >> 2) % count) + count) % count) != band)
+		{
+			y |= 3;
+			continue;
+		}
+		poly_triangle_extent(&item->tri, y, &extent);
+		(item->callback)(item->dest, y, &extent, &item->extra, threadid);
+	}
+}
+
+static void voodoo_work_thread(voodoo_work_queue *q, unsigned int band)
+{
+	/* the queue is empty when the threads are started */
+	UINT32 next = 0;
+
+	for (;;)
+	{
+		if (next == q->head.load(std::memory_order_acquire))
+		{
+			std::unique_lock<std::mutex> lock(q->lock);
+			q->sleepers++;
+			while (next == q->head.load() && !q->quit)
+				q->work_cv.wait(lock);
+			q->sleepers--;
+			if (next == q->head.load()) return;
+		}
+
+		voodoo_work_render(&q->items[next % VOODOO_WORK_ITEMS], band, (int)band + 1);
+		q->counter[band].done.store(++next);
+
+		if (q->waiting.load())
+		{
+			std::lock_guard<std::mutex> lock(q->lock);
+			q->idle_cv.notify_one();
+		}
+	}
+}
+
+static bool voodoo_work_reached(UINT32 target)
+{
+	for (unsigned int t = 0; t < voodoo_work_threads; t++)
+		if ((INT32)(target - voodoo_work->counter[t].done.load()) > 0)
+			return false;
+	return true;
+}
+
+/* wait until every worker has finished the items queued before target */
+static void voodoo_work_wait_for(UINT32 target)
+{
+	if (voodoo_work_reached(target)) return;
+
+	std::unique_lock<std::mutex> lock(voodoo_work->lock);
+	voodoo_work->waiting.store(true);
+	while (!voodoo_work_reached(target))
+		voodoo_work->idle_cv.wait(lock);
+	voodoo_work->waiting.store(false);
+}
+
+void voodoo_work_wait(void)
+{
+	if (voodoo_work != NULL)
+		voodoo_work_wait_for(voodoo_work->head.load(std::memory_order_relaxed));
+}
+
+static void voodoo_work_start(int threads)
+{
+	if (threads < 0)
+	{
+		/* leave one core to the emulation thread */
+		threads = (int)std::thread::hardware_concurrency() - 1;
+		if (threads > 4) threads = 4;
+		if (threads < 0) threads = 0;
+	}
+	if (threads > VOODOO_MAX_THREADS) threads = VOODOO_MAX_THREADS;
+
+	voodoo_work_threads = (unsigned int)threads;
+	if (voodoo_work_threads == 0) return;
+
+	voodoo_work = new voodoo_work_queue;
+	voodoo_work->head.store(0);
+	for (unsigned int t = 0; t < VOODOO_MAX_THREADS; t++)
+		voodoo_work->counter[t].done.store(0);
+	voodoo_work->sleepers.store(0);
+	voodoo_work->waiting.store(false);
+	voodoo_work->quit = false;
+	for (unsigned int t = 0; t < voodoo_work_threads; t++)
+		voodoo_work->threads.emplace_back(voodoo_work_thread, voodoo_work, t);
+	LOG(LOG_VOODOO,LOG_NORMAL)("Voodoo: rasterizing on %u threads", voodoo_work_threads);
+}
+
+static void voodoo_work_stop(void)
+{
+	if (voodoo_work == NULL) return;
+
+	{
+		std::lock_guard<std::mutex> lock(voodoo_work->lock);
+		voodoo_work->quit = true;
+		voodoo_work->work_cv.notify_all();
+	}
+	for (auto &thread : voodoo_work->threads)
+		thread.join();
+
+	delete voodoo_work;
+	voodoo_work = NULL;
+	voodoo_work_threads = 0;
+}
+
+static void voodoo_work_queue_triangle(void *dest, poly_draw_scanline_func callback, const poly_triangle *tri, const poly_extra_data *extra)
+{
+	const UINT32 head = voodoo_work->head.load(std::memory_order_relaxed);
+
+	/* wait for a free slot if the workers are a whole queue behind */
+	voodoo_work_wait_for(head - VOODOO_WORK_ITEMS + 1);
+
+	voodoo_work_item *item = &voodoo_work->items[head % VOODOO_WORK_ITEMS];
+	item->dest = dest;
+	item->callback = callback;
+	item->tri = *tri;
+	item->extra = *extra;
+
+	voodoo_work->head.store(head + 1);
+	if (voodoo_work->sleepers.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(voodoo_work->lock);
+		voodoo_work->work_cv.notify_all();
+	}
+}
+
+
+void poly_render_triangle(void *dest, poly_draw_scanline_func callback, const poly_vertex *v1, const poly_vertex *v2, const poly_vertex *v3, poly_extra_data *extra)
+{
+	const poly_vertex *tv;
+	poly_triangle tri;
+	poly_extent extent;
+	INT32 curscan;
 
 	/* first sort by Y */
 	if (v2->y < v1->y)
@@ -1157,61 +1427,34 @@ void poly_render_triangle(void *dest, poly_draw_scanline_func callback, const po
 		}
 	}
 
-	/* compute some integral X/Y vertex values */
-	//v1x = round_coordinate(v1->x); UNUSED
-	v1y = round_coordinate(v1->y);
-	v3y = round_coordinate(v3->y);
-
-	/* clip coordinates */
-	v1yclip = v1y;
-	v3yclip = v3y;// + ((poly->flags & POLYFLAG_INCLUDE_BOTTOM_EDGE) ? 1 : 0);
-	if (v3yclip - v1yclip <= 0)
+	/* compute some integral X/Y vertex values and clip */
+	tri.starty = round_coordinate(v1->y);
+	tri.stopy = round_coordinate(v3->y);
+	if (tri.stopy - tri.starty <= 0)
 		return;
 
+	tri.x1 = v1->x; tri.y1 = v1->y;
+	tri.x2 = v2->x; tri.y2 = v2->y;
+	tri.x3 = v3->x; tri.y3 = v3->y;
+
 	/* compute the slopes for each portion of the triangle */
-	dxdy_v1v2 = (v2->y == v1->y) ? 0.0f : (v2->x - v1->x) / (v2->y - v1->y);
-	dxdy_v1v3 = (v3->y == v1->y) ? 0.0f : (v3->x - v1->x) / (v3->y - v1->y);
-	dxdy_v2v3 = (v3->y == v2->y) ? 0.0f : (v3->x - v2->x) / (v3->y - v2->y);
+	tri.dxdy_v1v2 = (v2->y == v1->y) ? 0.0f : (v2->x - v1->x) / (v2->y - v1->y);
+	tri.dxdy_v1v3 = (v3->y == v1->y) ? 0.0f : (v3->x - v1->x) / (v3->y - v1->y);
+	tri.dxdy_v2v3 = (v3->y == v2->y) ? 0.0f : (v3->x - v2->x) / (v3->y - v2->y);
 
-	poly_extent *extent = new poly_extent;
-	int extnum=0;
-	for (curscan = v1yclip; curscan < v3yclip; curscan += scaninc)
+	/* the rotating stipple pattern changes from pixel to pixel in drawing order */
+	if (voodoo_work != NULL && !(FBZMODE_ENABLE_STIPPLE(extra->r_fbzMode) && FBZMODE_STIPPLE_PATTERN(extra->r_fbzMode) == 0))
 	{
-		{
-			float fully = (float)(curscan + extnum) + 0.5f;
-			float startx = v1->x + (fully - v1->y) * dxdy_v1v3;
-			float stopx;
-			INT32 istartx, istopx;
-
-			/* compute the ending X based on which part of the triangle we're in */
-			if (fully < v2->y)
-				stopx = v1->x + (fully - v1->y) * dxdy_v1v2;
-			else
-				stopx = v2->x + (fully - v2->y) * dxdy_v2v3;
-
-			/* clamp to full pixels */
-			istartx = round_coordinate(startx);
-			istopx = round_coordinate(stopx);
-
-			/* force start < stop */
-			if (istartx > istopx)
-			{
-				INT32 temp = istartx;
-				istartx = istopx;
-				istopx = temp;
-			}
-
-			/* set the extent and update the total pixel count */
-			if (istartx >= istopx)
-				istartx = istopx = 0;
-
-			extent->startx = istartx;
-			extent->stopx = istopx;
-			(callback)(dest,curscan,extent,extra);
-		}
+		voodoo_work_queue_triangle(dest, callback, &tri, extra);
+		return;
 	}
 
-	delete extent;
+	voodoo_work_wait();
+	for (curscan = tri.starty; curscan < tri.stopy; curscan++)
+	{
+		poly_triangle_extent(&tri, curscan, &extent);
+		(callback)(dest,curscan,&extent,extra,0);
+	}
 }
 
 
@@ -1250,7 +1493,7 @@ void poly_render_triangle_custom(void *dest, int startscanline, int numscanlines
 			/* set the extent and update the total pixel count */
 			unit->extent[extnum].startx = (INT16)istartx;
 			unit->extent[extnum].stopx = (INT16)istopx;
-			raster_fastfill(dest,curscan,extent,extra);
+			raster_fastfill(dest,curscan,extent,extra,0);
 		}
 		delete unit;
 	}
@@ -1277,9 +1520,12 @@ static void accumulate_statistics(voodoo_state *v, const stats_block *stats)
 static void update_statistics(voodoo_state *v, bool accumulate)
 {
 	/* accumulate/reset statistics from all units */
-	if (accumulate)
-		accumulate_statistics(v, &v->thread_stats[0]);
-	memset(&v->thread_stats[0], 0, sizeof(v->thread_stats[0]));
+	for (unsigned int t = 0; t <= voodoo_work_threads; t++)
+	{
+		if (accumulate)
+			accumulate_statistics(v, &v->thread_stats[t]);
+		memset(&v->thread_stats[t], 0, sizeof(v->thread_stats[t]));
+	}
 
 	/* accumulate/reset statistics from the LFB */
 	if (accumulate)
@@ -1323,6 +1569,10 @@ void register_w(UINT32 offset, UINT32 data) {
 		return;
 	}
 
+	/* only the triangle parameters can change while triangles are drawn */
+	if (!((regnum >= vertexAx && regnum <= ftriangleCMD) || (regnum >= sSetupMode && regnum <= sBeginTriCMD)))
+		voodoo_work_wait();
+
 	/* switch off the register */
 	switch (regnum)
 	{
@@ -2878,15 +3128,20 @@ UINT32 lfb_r(UINT32 offset)
 
 
 void voodoo_w(UINT32 offset, UINT32 data, UINT32 mask) {
-	if ((offset & (0xc00000/4)) == 0)
+	if ((offset & (0xc00000/4)) == 0) {
 		register_w(offset, data);
-	else if ((offset & (0x800000/4)) == 0)
+		return;
+	}
+
+	voodoo_work_wait();
+	if ((offset & (0x800000/4)) == 0)
 		lfb_w(offset, data, mask);
 	else
 		texture_w(offset, data);
 }
 
 UINT32 voodoo_r(UINT32 offset) {
+	voodoo_work_wait();
 	if ((offset & (0xc00000/4)) == 0)
 		return register_r(offset);
 	else if ((offset & (0x800000/4)) == 0)
@@ -2905,7 +3160,7 @@ UINT32 voodoo_r(UINT32 offset) {
     device start callback
 -------------------------------------------------*/
 
-void voodoo_init(int type) {
+void voodoo_init(int type, int threads) {
 	v->active = false;
 
 	v->type = VOODOO_1;
@@ -2941,14 +3196,14 @@ void voodoo_init(int type) {
 	for (UINT32 rct=0; rct<MAX_RASTERIZERS; rct++)
 		v->rasterizer[rct] = raster_info();
 
-	v->thread_stats = new stats_block[1];
-	v->thread_stats[0].pixels_in = 0;
-	v->thread_stats[0].pixels_out = 0;
-	v->thread_stats[0].chroma_fail = 0;
-	v->thread_stats[0].zfunc_fail = 0;
-	v->thread_stats[0].afunc_fail = 0;
-	v->thread_stats[0].clip_fail = 0;
-	v->thread_stats[0].stipple_count = 0;
+	/* the OpenGL renderer does not use the software rasterizers, the
+	   workers are started by voodoo_activate() if it falls back to them */
+	voodoo_work_config = threads;
+	voodoo_work_start(v->ogl ? 0 : threads);
+
+	/* one for the emulation thread and one for each worker that may run */
+	v->thread_stats = new stats_block[1 + VOODOO_MAX_THREADS];
+	memset(v->thread_stats, 0, sizeof(stats_block) * (1 + VOODOO_MAX_THREADS));
 
 	v->alt_regmap = false;
 	v->regnames = voodoo_reg_name;
@@ -2965,6 +3220,11 @@ void voodoo_init(int type) {
 	for (UINT32 val = 0; val < RASTER_HASH_SIZE; val++)
 		v->raster_hash[val] = NULL;
 
+	/* find_rasterizer() picks the specialized rasterizers over the generic ones.
+	   Registered with OpenGL too, which falls back to them if it cannot start. */
+	for (size_t rct = 0; rct < sizeof(predef_raster_table) / sizeof(predef_raster_table[0]); rct++)
+		add_rasterizer(v, &predef_raster_table[rct]);
+
 	/* create dithering tables */
 	for (UINT32 val = 0; val < 256*16*2; val++)
 	{
@@ -3075,6 +3335,11 @@ void voodoo_init(int type) {
 }
 
 void voodoo_shutdown() {
+	voodoo_work_stop();
+
+	if (LOG_RASTERIZERS && v != NULL)
+		dump_rasterizer_stats(v);
+
 	if (v->ogl)
 		voodoo_ogl_shutdown(v);
 
@@ -3475,7 +3740,8 @@ static void setup_and_draw_triangle(voodoo_state *v)
 
 void triangle_create_work_item(voodoo_state *v, UINT16 *drawbuf, int texcount)
 {
-	poly_extra_data *extra = new poly_extra_data;
+	poly_extra_data extra_data;
+	poly_extra_data *extra = &extra_data;
 	raster_info *info  = find_rasterizer(v, texcount);
 	poly_vertex vert[3];
 
@@ -3559,16 +3825,12 @@ void triangle_create_work_item(voodoo_state *v, UINT16 *drawbuf, int texcount)
 	}
 
 	if (v->ogl && v->active) {
-		if (extra->info==NULL)  {
-			delete extra;
+		if (extra->info==NULL)
 			return;
-		}
 		voodoo_ogl_draw_triangle(extra);
 	} else {
 		poly_render_triangle(drawbuf, info->callback, &vert[0], &vert[1], &vert[2], extra);
 	}
-
-	delete extra;
 }
 
 /***************************************************************************
@@ -3609,6 +3871,28 @@ static raster_info *add_rasterizer(voodoo_state *v, const raster_info *cinfo)
 }
 
 
+/*-------------------------------------------------
+    dump_rasterizer_stats - log the generic
+    rasterizers that drew the most triangles as
+    voodoo_rast.h entries
+-------------------------------------------------*/
+
+static void dump_rasterizer_stats(voodoo_state *v)
+{
+	std::vector<const raster_info *> used;
+
+	for (int rct = 0; rct < v->next_rasterizer; rct++)
+		if (v->rasterizer[rct].is_generic && v->rasterizer[rct].polys > 0)
+			used.push_back(&v->rasterizer[rct]);
+	std::sort(used.begin(), used.end(), [](const raster_info *a, const raster_info *b) { return a->polys > b->polys; });
+
+	for (size_t rct = 0; rct < used.size() && rct < 20; rct++)
+		LOG_MSG("RASTERIZER_ENTRY( 0x%08X, 0x%08X, 0x%08X, 0x%08X, 0x%08X, 0x%08X )\t/* %u polys */",
+				used[rct]->eff_color_path, used[rct]->eff_alpha_mode, used[rct]->eff_fog_mode, used[rct]->eff_fbz_mode,
+				used[rct]->eff_tex_mode_0, used[rct]->eff_tex_mode_1, used[rct]->polys);
+}
+
+
 /*-------------------------------------------------
     find_rasterizer - find a rasterizer that
     matches  our current parameters and return
@@ -3675,11 +3959,11 @@ static raster_info *find_rasterizer(voodoo_state *v, int texcount)
     implementation of the 'fastfill' command
 -------------------------------------------------*/
 
-static void raster_fastfill(void *destbase, INT32 y, const poly_extent *extent, const void *extradata)
+static void raster_fastfill(void *destbase, INT32 y, const poly_extent *extent, const void *extradata, int threadid)
 {
 	const poly_extra_data *extra = (const poly_extra_data *)extradata;
 	voodoo_state *v = extra->state;
-	stats_block *stats = &v->thread_stats[0];
+	stats_block *stats = &v->thread_stats[threadid];
 	INT32 startx = extent->startx;
 	INT32 stopx = extent->stopx;
 	int scry, x;
@@ -3757,6 +4041,9 @@ void voodoo_activate(void) {
 		} else {
 			v->ogl = false;
 			LOG_MSG("VOODOO: acceleration disabled");
+			/* from now on the software rasterizers draw */
+			if (voodoo_work_threads == 0)
+				voodoo_work_start(voodoo_work_config);
 		}
 	}
 }
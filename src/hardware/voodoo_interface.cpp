@@ -139,6 +139,7 @@ static void Voodoo_VerticalTimer(Bitu /*val*/) {
 		r.max_y = (int)v->fbi.height;
 
 		// draw all lines at once
+		voodoo_work_wait();
 		uint16_t *viewbuf = (uint16_t *)(v->fbi.ram + v->fbi.rgboffs[v->fbi.frontbuf]);
 		for(Bitu i = 0; i < v->fbi.height; i++) {
 			RENDER_DrawLine((uint8_t*) viewbuf);
@@ -262,7 +263,7 @@ void Voodoo_Output_Enable(bool enabled) {
 	}
 }
 
-void Voodoo_Initialize(Bits emulation_type, Bits card_type, bool max_voodoomem) {
+void Voodoo_Initialize(Bits emulation_type, Bits card_type, bool max_voodoomem, int threads) {
 	if ((emulation_type <= 0) || (emulation_type > 2)) return;
 
 	int board = VOODOO_1;
@@ -290,7 +291,7 @@ void Voodoo_Initialize(Bits emulation_type, Bits card_type, bool max_voodoomem)
 
 	vdraw.vfreq = 1000.0f/60.0f;
 
-	voodoo_init(board);
+	voodoo_init(board, threads);
 }
 
 void Voodoo_Shut_Down() {
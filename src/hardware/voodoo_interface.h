@@ -54,7 +54,7 @@ public:
 };
 
 
-void Voodoo_Initialize(Bits emulation_type, Bits card_type, bool max_voodoomem);
+void Voodoo_Initialize(Bits emulation_type, Bits card_type, bool max_voodoomem, int threads);
 void Voodoo_Shut_Down();
 
 void Voodoo_PCI_InitEnable(Bitu val);
@@ -0,0 +1,58 @@
+/*
+ *  Copyright (C) 2002-2021  The DOSBox Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/*************************************************************************
+
+    Specialized software rasterizers, included by voodoo_emu.cpp
+
+    Each entry is compiled into its own copy of raster_generic() with the
+    modes as constants, which is several times faster than the generic
+    rasterizers. The values are the normalized registers (see the
+    normalize_*() functions in voodoo_data.h), 0xFFFFFFFF for an unused TMU:
+
+    RASTERIZER_ENTRY( fbzColorPath, alphaMode, fogMode, fbzMode, textureMode0, textureMode1 )
+
+    Building with LOG_RASTERIZERS set in voodoo_emu.cpp logs the most used
+    generic rasterizers in this format when the Voodoo shuts down, to add
+    the configurations a game spends its time in.
+
+**************************************************************************/
+
+/* Gouraud shaded, no texture */
+RASTERIZER_ENTRY( 0x00C26100, 0x00000000, 0x00000000, 0x00000301, 0xFFFFFFFF, 0xFFFFFFFF )	/* no depth buffer */
+RASTERIZER_ENTRY( 0x00C26100, 0x00000000, 0x00000000, 0x00000731, 0xFFFFFFFF, 0xFFFFFFFF )	/* Z buffer */
+RASTERIZER_ENTRY( 0x00C26100, 0x00000000, 0x00000000, 0x00000739, 0xFFFFFFFF, 0xFFFFFFFF )	/* W buffer */
+RASTERIZER_ENTRY( 0x00C26100, 0x00005110, 0x00000000, 0x00000739, 0xFFFFFFFF, 0xFFFFFFFF )	/* W buffer, alpha blended */
+
+/* RGB565 texture modulated by the iterated color, one TMU */
+RASTERIZER_ENTRY( 0x00482405, 0x00000000, 0x00000000, 0x00000301, 0x0C261A07, 0xFFFFFFFF )	/* no depth buffer */
+RASTERIZER_ENTRY( 0x00482405, 0x00000000, 0x00000000, 0x00000731, 0x0C261A07, 0xFFFFFFFF )	/* Z buffer */
+RASTERIZER_ENTRY( 0x00482405, 0x00000000, 0x00000000, 0x00000739, 0x0C261A07, 0xFFFFFFFF )	/* W buffer */
+RASTERIZER_ENTRY( 0x00482405, 0x00005110, 0x00000000, 0x00000739, 0x0C261A07, 0xFFFFFFFF )	/* W buffer, alpha blended */
+RASTERIZER_ENTRY( 0x00482405, 0x00000009, 0x00000000, 0x00000739, 0x0C261A07, 0xFFFFFFFF )	/* W buffer, alpha tested */
+
+/* RGB565 texture modulated by the iterated color, two TMUs */
+RASTERIZER_ENTRY( 0x00482405, 0x00000000, 0x00000000, 0x00000301, 0x0C261A07, 0x0C261A07 )	/* no depth buffer */
+RASTERIZER_ENTRY( 0x00482405, 0x00000000, 0x00000000, 0x00000731, 0x0C261A07, 0x0C261A07 )	/* Z buffer */
+RASTERIZER_ENTRY( 0x00482405, 0x00000000, 0x00000000, 0x00000739, 0x0C261A07, 0x0C261A07 )	/* W buffer */
+RASTERIZER_ENTRY( 0x00482405, 0x00005110, 0x00000000, 0x00000739, 0x0C261A07, 0x0C261A07 )	/* W buffer, alpha blended */
+RASTERIZER_ENTRY( 0x00482405, 0x00000009, 0x00000000, 0x00000739, 0x0C261A07, 0x0C261A07 )	/* W buffer, alpha tested */
+
+/* 8-bit texture (palettized, intensity, alpha) decal, no depth buffer: 2D games and menus */
+RASTERIZER_ENTRY( 0x00000005, 0x00000000, 0x00000000, 0x00000301, 0x0C261001, 0xFFFFFFFF )
+RASTERIZER_ENTRY( 0x00000005, 0x00000000, 0x00000000, 0x00000301, 0x0C261001, 0x0C261001 )
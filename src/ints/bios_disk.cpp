@@ -1123,6 +1123,9 @@ imageDisk *GetINT13HardDrive(unsigned char drv) {
 }
 
 void FreeBIOSDiskList() {
+    /* something else may still hold a reference, write back what is cached now */
+    imageDiskCache::FlushAll();
+
     for (int i=0;i < MAX_DISK_IMAGES;i++) {
         if (imageDiskList[i] != NULL) {
             if (i >= 2) IDE_Hard_Disk_Detach(i);
@@ -1405,8 +1408,7 @@ Int13Status imageDisk::Read_Sector(uint32_t head,uint32_t cylinder,uint32_t sect
 Int13Status imageDisk::Read_AbsoluteSector(uint32_t sectnum, void * data) {
 	if (ffdd) return ffdd->ReadSector(sectnum, data);
 
-    uint64_t bytenum,res;
-    int got;
+    uint64_t bytenum;
 
     bytenum = (uint64_t)sectnum * (uint64_t)sector_size;
     if ((bytenum + sector_size) > this->image_length) {
@@ -1417,18 +1419,12 @@ Int13Status imageDisk::Read_AbsoluteSector(uint32_t sectnum, void * data) {
 
     //LOG_MSG("Reading sectors %ld at bytenum %I64d", sectnum, bytenum);
 
-    fseeko64(diskimg,(fseek_ofs_t)bytenum,SEEK_SET);
-    res = (uint64_t)ftello64(diskimg);
-    if (res != bytenum) {
-        LOG_MSG("fseek() failed in Read_AbsoluteSector for sector %lu. Want=%llu Got=%llu\n",
-            (unsigned long)sectnum,(unsigned long long)bytenum,(unsigned long long)res);
-        return Int13Status::SeekFailed;
-    }
+    if (mapping_enabled && !mapping_tried) MapImage();
+    if (mapping != NULL && mapping->Read(bytenum,data,sector_size))
+        return Int13Status::NoError;
 
-    got = (int)fread(data, 1, sector_size, diskimg);
-    if ((unsigned int)got != sector_size) {
-        LOG_MSG("fread() failed in Read_AbsoluteSector for sector %lu. Want=%u got=%d\n",
-            (unsigned long)sectnum,sector_size,(unsigned int)got);
+    if (!ReadImage(bytenum,data,sector_size)) {
+        LOG_MSG("Failed to read image file in Read_AbsoluteSector for sector %lu\n",(unsigned long)sectnum);
         return Int13Status::ControllerFailure;
     }
 
@@ -1463,14 +1459,78 @@ Int13Status imageDisk::Write_AbsoluteSector(uint32_t sectnum, const void *data)
 
     //LOG_MSG("Writing sectors to %ld at bytenum %d", sectnum, bytenum);
 
-    fseeko64(diskimg,(fseek_ofs_t)bytenum,SEEK_SET);
-    if ((uint64_t)ftello64(diskimg) != bytenum)
-        LOG_MSG("WARNING: fseek() failed in Write_AbsoluteSector for sector %lu\n",(unsigned long)sectnum);
+    if (mapping_enabled && !mapping_tried) MapImage();
+    if (mapping != NULL && mapping->Write(bytenum,data,sector_size))
+        return Int13Status::NoError;
+
+    /* past the end of the mapping, or it is read-only and this fails too */
+    return WriteImage(bytenum,data,sector_size) ? Int13Status::NoError : Int13Status::ControllerFailure;
+}
+
+Int13Status imageDisk::Read_AbsoluteSectors(uint32_t sectnum, uint32_t count, void *data) {
+    for (uint32_t i = 0;i < count;i++) {
+        const Int13Status r = Read_AbsoluteSector(sectnum + i, (uint8_t*)data + ((size_t)i * sector_size));
+        if (r != Int13Status::NoError) return r;
+    }
+
+    return Int13Status::NoError;
+}
+
+Int13Status imageDisk::Write_AbsoluteSectors(uint32_t sectnum, uint32_t count, const void *data) {
+    for (uint32_t i = 0;i < count;i++) {
+        const Int13Status r = Write_AbsoluteSector(sectnum + i, (const uint8_t*)data + ((size_t)i * sector_size));
+        if (r != Int13Status::NoError) return r;
+    }
+
+    return Int13Status::NoError;
+}
+
+const uint8_t *imageDisk::Map_AbsoluteSector(uint32_t sectnum, uint32_t count) {
+    if (ffdd || !mapping_enabled) return NULL;
+    if (!mapping_tried) MapImage();
+    if (mapping == NULL) return NULL;
+
+    const uint64_t bytenum = (uint64_t)sectnum * sector_size;
+    const uint64_t len = (uint64_t)count * sector_size;
+    if ((bytenum + len) > this->image_length) return NULL;
 
-    size_t ret=fwrite(data, sector_size, 1, diskimg);
+    return mapping->Pointer(image_base + bytenum,(size_t)len);
+}
+
+void imageDisk::MapImage(void) {
+    mapping_tried = true;
+    /* nothing written through the cache may be left behind the mapping */
+    if (cache != NULL && !cache->Flush()) return;
+    mapping = imageDiskMapping::Create(diskimg);
+}
 
-    return ((ret>0)?Int13Status::NoError:Int13Status::ControllerFailure);
+bool imageDisk::ReadImage(uint64_t offset,void *data,size_t len) {
+    if (cache == NULL) cache = imageDiskCache::Create(diskimg);
+    if (cache != NULL) return cache->Read(offset,data,len);
 
+    if (fseeko64(diskimg,(fseek_ofs_t)offset,SEEK_SET) != 0) return false;
+    if (fread(data,1,len,diskimg) != len) {
+        clearerr(diskimg);
+        return false;
+    }
+    return true;
+}
+
+bool imageDisk::WriteImage(uint64_t offset,const void *data,size_t len) {
+    if (cache == NULL) cache = imageDiskCache::Create(diskimg);
+    if (cache != NULL) return cache->Write(offset,data,len);
+
+    if (fseeko64(diskimg,(fseek_ofs_t)offset,SEEK_SET) != 0) return false;
+    if (fwrite(data,1,len,diskimg) != len) {
+        clearerr(diskimg);
+        return false;
+    }
+    return true;
+}
+
+bool imageDisk::FlushImage(void) {
+    if (cache != NULL) return cache->Flush();
+    return fflush(diskimg) == 0;
 }
 
 void imageDisk::Set_Reserved_Cylinders(Bitu resCyl) {
@@ -1749,6 +1809,15 @@ imageDisk::imageDisk(class DOS_Drive *useDrive, unsigned int letter, uint32_t fr
 
 imageDisk::~imageDisk()
 {
+    if(mapping != NULL) {
+        delete mapping;
+        mapping=NULL;
+    }
+    if(cache != NULL) {
+        cache->LogStats(diskname.c_str());
+        delete cache;
+        cache=NULL;
+    }
     if(diskimg != NULL) {
         fclose(diskimg);
         diskimg=NULL;
@@ -2444,7 +2513,15 @@ static Bitu INT13_DiskHandler(void) {
         segat = dap.seg;
         bufptr = dap.off;
         for(i=0;i<dap.num;i++) {
-            last_status = imageDiskList[drivenum]->Read_AbsoluteSector(dap.sector+i, sectbuf);
+            /* memory mapped images are copied to the guest straight from the mapping */
+            const uint8_t *src = imageDiskList[drivenum]->Map_AbsoluteSector(dap.sector+i);
+            if (src != NULL) {
+                last_status = Int13Status::NoError;
+            }
+            else {
+                last_status = imageDiskList[drivenum]->Read_AbsoluteSector(dap.sector+i, sectbuf);
+                src = sectbuf;
+            }
 
             if(drivenum < 2)
                 diskio_delay(512, 0); // Floppy
@@ -2462,7 +2539,7 @@ static Bitu INT13_DiskHandler(void) {
                 return CBRET_NONE;
             }
             for(t=0;t<512;t++) {
-                real_writeb(segat,bufptr,sectbuf[t]);
+                real_writeb(segat,bufptr,src[t]);
                 bufptr++;
             }
         }
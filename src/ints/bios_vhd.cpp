@@ -201,6 +201,7 @@ imageDiskVHD::ErrorCodes imageDiskVHD::Open(const char* fileName, const bool rea
         vhd->heads = sizes[2];
         vhd->sectors = sizes[1];
         vhd->fixedDisk = new imageDisk(file, fileName, vhd->cylinders, vhd->heads, vhd->sectors, 512, true);
+        vhd->fixedDisk->EnableMapping();
         *disk = vhd;
         return !readOnly && roflag ? UNSUPPORTED_WRITE : OPEN_SUCCESS;
 	}
@@ -407,8 +408,7 @@ Int13Status imageDiskVHD::Read_AbsoluteSector(uint32_t sectnum, void * data) {
 		uint32_t bitNum = sectorOffset % 8;
 		bool hasData = currentBlockDirtyMap[byteNum] & (1 << (7 - bitNum));
 		if (hasData) {
-			if (fseeko64(diskimg, (((uint64_t)currentBlockSectorOffset + blockMapSectors + sectorOffset) * 512ull), SEEK_SET)) return Int13Status::SeekFailed; //can't seek
-			if (fread(data, sizeof(uint8_t), 512, diskimg) != 512) return Int13Status::ControllerFailure; //can't read
+			if (!ReadImage((((uint64_t)currentBlockSectorOffset + blockMapSectors + sectorOffset) * 512ull), data, 512)) return Int13Status::ControllerFailure; //can't read
 			return Int13Status::NoError;
 		}
 	}
@@ -449,29 +449,19 @@ Int13Status imageDiskVHD::Write_AbsoluteSector(uint32_t sectnum, const void * da
 
         if(!copiedFooter) {
             //write backup of footer at start of file (should already exist, but we never checked to be sure it is readable or matches the footer we used)
-            if(fseeko64(diskimg, 0, SEEK_SET)) {
-                return Int13Status::SeekFailed;
-            }
-            if(fwrite(&originalFooter, sizeof(uint8_t), 512, diskimg) != 512) {
+            if(!WriteImage(0, &originalFooter, 512)) {
                 return Int13Status::ControllerFailure;
             }
 			copiedFooter = true;
 			//flush the data to disk after writing the backup footer
-            if(fflush(diskimg)) {
+            if(!FlushImage()) {
                 return Int13Status::ControllerFailure;
             }
 		}
 		//calculate new location of footer, and round up to nearest 512 byte increment "just in case"
         uint64_t newFooterPosition = (((footerPosition + blockMapSize + dynamicHeader.blockSize) + 511ull) / 512ull) * 512ull;
-		//attempt to extend the length appropriately first (on some operating systems this will extend the file)
-        if(fseeko64(diskimg, newFooterPosition + 512, SEEK_SET)) {
-                return Int13Status::SeekFailed;
-        }
-		//now write the footer
-        if(fseeko64(diskimg, newFooterPosition, SEEK_SET)) {
-            return Int13Status::SeekFailed;
-        }
-        if(fwrite(&originalFooter, sizeof(uint8_t), 512, diskimg) != 512) {
+		//now write the footer, which extends the file
+        if(!WriteImage(newFooterPosition, &originalFooter, 512)) {
             return Int13Status::ControllerFailure;
         }
 		//save the new block location and new footer position
@@ -480,28 +470,22 @@ Int13Status imageDiskVHD::Write_AbsoluteSector(uint32_t sectnum, const void * da
 		//clear the dirty flags for the new footer position
 		for (uint32_t i = 0; i < blockMapSize; i++) currentBlockDirtyMap[i] = 0;
 		//write the dirty map
-        if(fseeko64(diskimg, (newBlockSectorNumber * 512ull), SEEK_SET)) {
-            return Int13Status::SeekFailed;
-        }
-        if(fwrite(currentBlockDirtyMap, sizeof(uint8_t), blockMapSize, diskimg) != blockMapSize) {
+        if(!WriteImage((newBlockSectorNumber * 512ull), currentBlockDirtyMap, blockMapSize)) {
             return Int13Status::ControllerFailure;
         }
 		//flush the data to disk after expanding the file, before allocating the block in the BAT
-        if(fflush(diskimg)) {
+        if(!FlushImage()) {
             return Int13Status::ControllerFailure;
         }
 		//update the BAT
-        if(fseeko64(diskimg, (dynamicHeader.tableOffset + (blockNumber * 4ull)), SEEK_SET)) {
-            return Int13Status::SeekFailed;
-        }
 		uint32_t newBlockSectorNumberBE = SDL_SwapBE32(newBlockSectorNumber);
-        if(fwrite(&newBlockSectorNumberBE, sizeof(uint8_t), 4, diskimg) != 4) {
+        if(!WriteImage((dynamicHeader.tableOffset + (blockNumber * 4ull)), &newBlockSectorNumberBE, 4)) {
             return Int13Status::ControllerFailure;
         }
 		currentBlockAllocated = true;
 		currentBlockSectorOffset = newBlockSectorNumber;
 		//flush the data to disk after allocating a block
-        if(fflush(diskimg)) {
+        if(!FlushImage()) {
             return Int13Status::ControllerFailure;
         }
 	}
@@ -512,19 +496,13 @@ Int13Status imageDiskVHD::Write_AbsoluteSector(uint32_t sectnum, const void * da
 	//if the sector hasn't been marked as dirty, mark it as dirty
 	if (!hasData) {
 		currentBlockDirtyMap[byteNum] |= 1 << (7 - bitNum);
-        if(fseeko64(diskimg, (currentBlockSectorOffset * 512ull), SEEK_SET)) {
-            return Int13Status::SeekFailed; //can't seek
-        }
-        if(fwrite(currentBlockDirtyMap, sizeof(uint8_t), blockMapSize, diskimg) != blockMapSize) {
+        if(!WriteImage((currentBlockSectorOffset * 512ull), currentBlockDirtyMap, blockMapSize)) {
             return Int13Status::ControllerFailure;
         }
 	}
 	//current sector has now been marked as dirty
 	//write the sector
-    if(fseeko64(diskimg, (((uint64_t)currentBlockSectorOffset + (uint64_t)blockMapSectors + (uint64_t)sectorOffset) * 512ull), SEEK_SET)) {
-        return Int13Status::SeekFailed; //can't seek
-    }
-    if(fwrite(data, sizeof(uint8_t), 512, diskimg) != 512) {
+    if(!WriteImage((((uint64_t)currentBlockSectorOffset + (uint64_t)blockMapSectors + (uint64_t)sectorOffset) * 512ull), data, 512)) {
         return Int13Status::ControllerFailure; //can't write
     }
 	return Int13Status::NoError;
@@ -547,20 +525,18 @@ imageDiskVHD::VHDTypes imageDiskVHD::GetVHDType(const char* fileName) {
 bool imageDiskVHD::loadBlock(const uint32_t blockNumber) {
 	if (currentBlock == blockNumber) return true;
 	if (blockNumber >= dynamicHeader.maxTableEntries) return false;
-	if (fseeko64(diskimg, (dynamicHeader.tableOffset + (blockNumber * 4ull)), SEEK_SET)) return false;
 	uint32_t blockSectorOffset;
-	if (fread(&blockSectorOffset, sizeof(uint8_t), 4, diskimg) != 4) return false;
+	if (!ReadImage((dynamicHeader.tableOffset + (blockNumber * 4ull)), &blockSectorOffset, 4)) return false;
 	blockSectorOffset = SDL_SwapBE32(blockSectorOffset);
 	if (blockSectorOffset == 0xFFFFFFFFul) {
 		currentBlock = blockNumber;
 		currentBlockAllocated = false;
 	}
 	else {
-		if (fseeko64(diskimg, (blockSectorOffset * (uint64_t)512), SEEK_SET)) return false;
 		currentBlock = 0xFFFFFFFFul;
 		currentBlockAllocated = true;
 		currentBlockSectorOffset = blockSectorOffset;
-		if (fread(currentBlockDirtyMap, sizeof(uint8_t), blockMapSize, diskimg) != blockMapSize) return false;
+		if (!ReadImage((blockSectorOffset * (uint64_t)512), currentBlockDirtyMap, blockMapSize)) return false;
 		currentBlock = blockNumber;
 	}
 	return true;
@@ -705,13 +681,11 @@ bool imageDiskVHD::UpdateUUID() {
     footer.SwapByteOrder();
     memcpy(&originalFooter, &footer, 512);
     footer.SwapByteOrder();
-    if (fseeko64(diskimg, footerPosition, SEEK_SET)) return false;
-    if (fwrite(&originalFooter, 1, 512, diskimg) != 512) return false;
+    if (!WriteImage(footerPosition, &originalFooter, 512)) return false;
     if(vhdType != VHD_TYPE_FIXED) {
-        if(fseeko64(diskimg, 0, SEEK_SET)) return false;
-        if(fwrite(&originalFooter, 1, 512, diskimg) != 512) return false;
+        if(!WriteImage(0, &originalFooter, 512)) return false;
     }
-    return true;
+    return FlushImage();
 }
 
 //computates pseudo CHS geometry according to MS VHD specification
@@ -956,10 +930,9 @@ uint32_t imageDiskVHD::GetInfo(VHDInfo* info) {
     if(vhdType != VHD_TYPE_FIXED) {
         info->blockSize = dynamicHeader.blockSize;
         info->totalBlocks = dynamicHeader.maxTableEntries;
-        fseeko64(diskimg, dynamicHeader.tableOffset, SEEK_SET);
         for(int i = 0; i < info->totalBlocks; i++) {
             uint32_t n;
-            if(fread(&n, 1, 4, diskimg) != 4) return ERROR_OPENING;
+            if(!ReadImage(dynamicHeader.tableOffset + i * 4ull, &n, 4)) return ERROR_OPENING;
             if(n != 0xFFFFFFFF) info->allocatedBlocks++;
         }
     }
@@ -1007,8 +980,7 @@ bool imageDiskVHD::MergeSnapshot(uint32_t* totalSectorsMerged, uint32_t* totalBl
     *totalBlocksUpdated = 0;
     for(uint32_t block = 0; block < dynamicHeader.maxTableEntries; block++) {
         uint32_t n;
-        fseeko64(diskimg, dynamicHeader.tableOffset+block*4, SEEK_SET);
-        if(fread(&n, 1, 4, diskimg) != 4) { return false; }
+        if(!ReadImage(dynamicHeader.tableOffset + block * 4ull, &n, 4)) { return false; }
         if(n == 0xFFFFFFFF) continue;
         loadBlock(block);
         bool blockUpdated = false;
@@ -1019,8 +991,7 @@ bool imageDiskVHD::MergeSnapshot(uint32_t* totalSectorsMerged, uint32_t* totalBl
             bool hasData = currentBlockDirtyMap[byteNum] & (1 << (7 - bitNum));
             if(hasData) {
                 uint8_t data[512];
-                if(fseeko64(diskimg, (((uint64_t)currentBlockSectorOffset + blockMapSectors + sector) * 512ull), SEEK_SET)) return false;
-                if(fread(data, sizeof(uint8_t), 512, diskimg) != 512) return false;
+                if(!ReadImage((((uint64_t)currentBlockSectorOffset + blockMapSectors + sector) * 512ull), data, 512)) return false;
                 uint32_t absoluteSector = block * sectorsPerBlock + sector;
                 //LOG_MSG("Merging sector %d", absoluteSector);
                 (*totalSectorsMerged)++;
@@ -0,0 +1,292 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <tuple>
+
+#include "dosbox.h"
+#include "logging.h"
+#include "timer.h"
+#include "bios_disk.h"
+
+#if defined(__linux__) && !defined(__GLIBC__)
+// musl libc does not need 64 suffix to work with files > 2 GiB
+#define fopen64 fopen
+#define fseeko64 fseeko
+#define ftello64 ftello
+#endif
+
+// Sector cache for disk images that read and write their image file directly
+
+extern int disk_image_cache_kb;
+
+static std::vector<imageDiskCache*> image_caches;
+static unsigned int image_cache_ticks = 0;
+
+/* dirty data is written back about once a second */
+static void imageDiskCache_Tick(void) {
+    if (++image_cache_ticks < 1000) return;
+    image_cache_ticks = 0;
+    imageDiskCache::FlushAll();
+}
+
+/* the sectors of a chunk that [within,within+len) touches */
+static inline uint64_t imageDiskCache_UnitMask(unsigned int within,size_t len) {
+    const unsigned int first = within >> 9u;
+    const unsigned int last = (unsigned int)((within + len - 1u) >> 9u);
+    const uint64_t upto = (last >= 63u) ? ~0ull : ((1ull << (last + 1u)) - 1ull);
+    return upto & (~0ull << first);
+}
+
+imageDiskCache *imageDiskCache::Create(FILE *file) {
+    if (file == NULL || disk_image_cache_kb <= 0) return NULL;
+    return new imageDiskCache(file,(uint64_t)disk_image_cache_kb * 1024u);
+}
+
+void imageDiskCache::FlushAll(void) {
+    for (auto &c : image_caches) {
+        if (c->sync && !c->sync())
+            LOG(LOG_IO,LOG_ERROR)("Disk image cache: failed to write back image metadata");
+        if (!c->Flush())
+            LOG(LOG_IO,LOG_ERROR)("Disk image cache: failed to write back to the image file");
+    }
+}
+
+imageDiskCache::imageDiskCache(FILE *file,uint64_t max_bytes) : file(file) {
+    max_chunks = (size_t)std::max<uint64_t>(max_bytes >> chunk_shift,2u);
+    if (fseeko64(file,0,SEEK_END) == 0) {
+        const auto end = ftello64(file);
+        if (end > 0) file_length = (uint64_t)end;
+    }
+    length = file_length;
+    iobuf.reserve(chunk_size);
+
+    if (image_caches.empty()) TIMER_AddTickHandler(imageDiskCache_Tick);
+    image_caches.push_back(this);
+}
+
+imageDiskCache::~imageDiskCache() {
+    if (!Flush())
+        LOG(LOG_IO,LOG_ERROR)("Disk image cache: failed to write back to the image file");
+
+    image_caches.erase(std::remove(image_caches.begin(),image_caches.end(),this),image_caches.end());
+    if (image_caches.empty()) TIMER_DelTickHandler(imageDiskCache_Tick);
+}
+
+void imageDiskCache::LogStats(const char *name) const {
+    LOG(LOG_IO,LOG_NORMAL)("Disk image cache %s: %llu hits, %llu misses, %llu read ahead, %llu sectors written back in %llu runs",
+        name,(unsigned long long)hits,(unsigned long long)misses,(unsigned long long)readahead,
+        (unsigned long long)writeback_sectors,(unsigned long long)writeback_runs);
+}
+
+imageDiskCache::Chunk &imageDiskCache::GetChunk(uint64_t index) {
+    auto i = chunks.find(index);
+    if (i != chunks.end()) {
+        lru.splice(lru.begin(),lru,i->second.lru);
+        return i->second;
+    }
+
+    while (chunks.size() >= max_chunks && !lru.empty()) {
+        auto victim = chunks.find(lru.back());
+        /* if it can't be written back, keep it and go over the limit */
+        if (victim->second.dirty != 0 && !WriteBack(victim,std::next(victim))) break;
+        lru.pop_back();
+        chunks.erase(victim);
+    }
+
+    i = chunks.emplace(std::piecewise_construct,std::forward_as_tuple(index),std::forward_as_tuple()).first;
+    lru.push_front(index);
+    i->second.lru = lru.begin();
+    return i->second;
+}
+
+/* Read the sectors in 'need' from the file with one fread() covering all of
+ * them, also taking any other sector in that span that isn't cached yet.
+ * Sectors past the end of the file read as zero. */
+bool imageDiskCache::Fill(uint64_t index,Chunk &c,uint64_t need) {
+    unsigned int lo = 0,hi = 63;
+    while (!(need & (1ull << lo))) lo++;
+    while (!(need & (1ull << hi))) hi--;
+
+    const uint64_t start = (index << chunk_shift) + ((uint64_t)lo << unit_shift);
+    const uint64_t end = (index << chunk_shift) + ((uint64_t)(hi + 1u) << unit_shift);
+    size_t got = 0;
+
+    iobuf.resize((size_t)(end - start));
+    if (start < file_length) {
+        const size_t want = (size_t)(std::min(end,file_length) - start);
+        if (fseeko64(file,(fseek_ofs_t)start,SEEK_SET) != 0) return false;
+        got = fread(iobuf.data(),1,want,file);
+        if (got != want) {
+            clearerr(file);
+            return false;
+        }
+    }
+
+    for (unsigned int u = lo;u <= hi;u++) {
+        if (c.valid & (1ull << u)) continue;
+
+        const size_t o = (size_t)(u - lo) << unit_shift;
+        const size_t have = (got > o) ? std::min<size_t>(got - o,unit_size) : 0;
+        uint8_t *d = c.data + ((size_t)u << unit_shift);
+        memcpy(d,iobuf.data() + o,have);
+        memset(d + have,0,unit_size - have);
+        c.valid |= 1ull << u;
+    }
+
+    return true;
+}
+
+/* Write back the dirty sectors of the chunks in [first,last), one fwrite() per
+ * run of adjacent sectors even where the run crosses into the next chunk */
+bool imageDiskCache::WriteBack(std::map<uint64_t,Chunk>::iterator first,std::map<uint64_t,Chunk>::iterator last) {
+    uint64_t run_start = 0;
+
+    iobuf.clear();
+    auto emit = [&]() -> bool {
+        if (iobuf.empty()) return true;
+
+        /* the last sector may reach past the end of the file */
+        const size_t n = (size_t)std::min<uint64_t>(iobuf.size(),length - run_start);
+        if (fseeko64(file,(fseek_ofs_t)run_start,SEEK_SET) != 0 || fwrite(iobuf.data(),1,n,file) != n) {
+            clearerr(file);
+            return false;
+        }
+        file_length = std::max(file_length,run_start + n);
+        writeback_runs++;
+        writeback_sectors += iobuf.size() >> unit_shift;
+        iobuf.clear();
+        return true;
+    };
+
+    for (auto i = first;i != last;++i) {
+        const Chunk &c = i->second;
+        if (c.dirty == 0) continue;
+
+        for (unsigned int u = 0;u < 64u;u++) {
+            if (!(c.dirty & (1ull << u))) continue;
+
+            const uint64_t at = (i->first << chunk_shift) + ((uint64_t)u << unit_shift);
+            if (!iobuf.empty() && (run_start + iobuf.size()) != at && !emit()) return false;
+            if (iobuf.empty()) run_start = at;
+
+            const uint8_t *s = c.data + ((size_t)u << unit_shift);
+            iobuf.insert(iobuf.end(),s,s + unit_size);
+        }
+    }
+    if (!emit()) return false;
+
+    for (auto i = first;i != last;++i) {
+        if (i->second.dirty != 0) {
+            i->second.dirty = 0;
+            dirty_chunks--;
+        }
+    }
+
+    return true;
+}
+
+bool imageDiskCache::Read(uint64_t offset,void *data,size_t len) {
+    if (offset > length || len > (length - offset)) return false;
+
+    /* a read that picks up where the last one ended reads ahead to the end of the chunk */
+    const bool sequential = (offset == next_read);
+    uint8_t *dst = (uint8_t*)data;
+
+    next_read = offset + len;
+    while (len != 0) {
+        const uint64_t index = offset >> chunk_shift;
+        const unsigned int within = (unsigned int)(offset & (chunk_size - 1u));
+        const size_t n = (size_t)std::min<uint64_t>(len,chunk_size - within);
+        Chunk &c = GetChunk(index);
+        const uint64_t want = imageDiskCache_UnitMask(within,n);
+
+        if ((c.valid & want) != want) {
+            uint64_t need = want & ~c.valid;
+            if (sequential) {
+                need = (~0ull << (within >> unit_shift)) & ~c.valid;
+                readahead++;
+            }
+            misses++;
+            if (!Fill(index,c,need)) return false;
+        }
+        else {
+            hits++;
+        }
+
+        memcpy(dst,c.data + within,n);
+        dst += n;
+        offset += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+bool imageDiskCache::Write(uint64_t offset,const void *data,size_t len) {
+    if (writable == 0) return false;
+    if (writable < 0) {
+        /* the first write goes straight to the file to find out if it was opened
+         * read-only, or the guest would only learn of it when the write back fails */
+        if (fseeko64(file,(fseek_ofs_t)offset,SEEK_SET) != 0 || fwrite(data,1,len,file) != len) {
+            clearerr(file);
+            writable = 0;
+            return false;
+        }
+        file_length = std::max(file_length,offset + len);
+        writable = 1;
+    }
+
+    const uint8_t *src = (const uint8_t*)data;
+    const uint64_t end = offset + len;
+
+    while (len != 0) {
+        const uint64_t index = offset >> chunk_shift;
+        const unsigned int within = (unsigned int)(offset & (chunk_size - 1u));
+        const size_t n = (size_t)std::min<uint64_t>(len,chunk_size - within);
+        Chunk &c = GetChunk(index);
+        const uint64_t m = imageDiskCache_UnitMask(within,n);
+
+        /* sectors only partly written need the rest of their contents first */
+        uint64_t partial = 0;
+        if (within & (unit_size - 1u)) partial |= 1ull << (within >> unit_shift);
+        if ((within + n) & (unit_size - 1u)) partial |= 1ull << ((within + n - 1u) >> unit_shift);
+        partial &= ~c.valid;
+        if (partial != 0 && !Fill(index,c,partial)) return false;
+
+        memcpy(c.data + within,src,n);
+        if (c.dirty == 0) dirty_chunks++;
+        c.valid |= m;
+        c.dirty |= m;
+        src += n;
+        offset += n;
+        len -= n;
+    }
+    length = std::max(length,end);
+
+    /* don't let the cache fill up with data that has to be written back */
+    if (dirty_chunks >= (max_chunks / 2u)) return Flush();
+    return true;
+}
+
+bool imageDiskCache::Flush(void) {
+    if (dirty_chunks == 0) return true;
+
+    bool ok = WriteBack(chunks.begin(),chunks.end());
+    if (fflush(file) != 0) ok = false;
+    return ok;
+}
@@ -0,0 +1,325 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "dosbox.h"
+#include "logging.h"
+#include "mem.h"
+#include "bios_disk.h"
+#include "src/libs/libchdr/chd.h"
+
+#if defined(__linux__) && !defined(__GLIBC__)
+#define fopen64 fopen
+#define fseeko64 fseeko
+#define ftello64 ftello
+#endif
+
+// CHD hard disk images, with a delta file for the sectors written to them
+
+extern int disk_image_cache_kb;
+extern bool int13_enable_48bitLBA;
+
+FILE * fopen_lock(const char * fname, const char * mode, bool &readonly);
+
+/* delta file header, little endian:
+ *   0 "CHDDELTA"   8 version   12 hunk size   16 hunks   20 sector size
+ *  24 disk size   32 SHA1 of the CHD          56 offset of the first hunk slot
+ * then the index from offset 512, then the slots */
+static const char chd_delta_cookie[8] = { 'C','H','D','D','E','L','T','A' };
+static constexpr uint32_t chd_delta_version = 1;
+static constexpr uint64_t chd_delta_index_offset = 512;
+
+imageDiskCHD::ErrorCodes imageDiskCHD::Open(const char* fileName, const bool readOnly, imageDisk** disk) {
+    if (fileName == NULL || disk == NULL) return ERROR_OPENING;
+
+    chd_file *chd = NULL;
+    const chd_error err = chd_open(fileName, CHD_OPEN_READ, NULL, &chd);
+    if (err == CHDERR_FILE_NOT_FOUND) return ERROR_OPENING;
+    if (err == CHDERR_REQUIRES_PARENT) return UNSUPPORTED_TYPE;
+    if (err != CHDERR_NONE) {
+        LOG_MSG("CHD: %s: %s", fileName, chd_error_string(err));
+        return INVALID_DATA;
+    }
+
+    /* only hard disk CHDs carry a geometry, CD-ROM images are mounted with -t iso */
+    char meta[256];
+    uint32_t metalen = 0;
+    int cyls = 0, heads = 0, secs = 0, bps = 0;
+    if (chd_get_metadata(chd, HARD_DISK_METADATA_TAG, 0, meta, sizeof(meta) - 1, &metalen, NULL, NULL) != CHDERR_NONE) {
+        chd_close(chd);
+        return UNSUPPORTED_TYPE;
+    }
+    meta[std::min<uint32_t>(metalen, sizeof(meta) - 1)] = 0;
+
+    const chd_header *header = chd_get_header(chd);
+    if (sscanf(meta, HARD_DISK_METADATA_FORMAT, &cyls, &heads, &secs, &bps) != 4 ||
+        cyls <= 0 || heads <= 0 || secs <= 0 || bps < 128 || (bps & (bps - 1)) != 0 ||
+        header == NULL || header->hunkbytes == 0 || (header->hunkbytes % (uint32_t)bps) != 0 ||
+        (uint64_t)cyls * (uint64_t)heads * (uint64_t)secs * (uint64_t)bps > header->logicalbytes) {
+        chd_close(chd);
+        return INVALID_DATA;
+    }
+
+    imageDiskCHD* image = new imageDiskCHD();
+    image->chd = chd;
+    image->hunkbytes = header->hunkbytes;
+    image->totalhunks = header->totalhunks;
+    memcpy(image->sha1, header->sha1, sizeof(image->sha1));
+    image->cylinders = (uint32_t)cyls;
+    image->heads = (uint32_t)heads;
+    image->sectors = (uint32_t)secs;
+    image->sector_size = (uint32_t)bps;
+    image->image_length = (uint64_t)cyls * (uint64_t)heads * (uint64_t)secs * (uint64_t)bps;
+    image->diskSizeK = image->image_length / 1024;
+    image->diskname = fileName;
+    image->hardDrive = true;
+    image->active = true;
+    image->readOnly = readOnly;
+    image->deltaname = std::string(fileName) + ".delta";
+    image->maxHunks = (size_t)std::max<uint64_t>(((uint64_t)std::max(disk_image_cache_kb, 0) * 1024u) / image->hunkbytes, 4u);
+    //use delete image from now on to close the CHD upon failure
+
+    const ErrorCodes ret = image->OpenDelta();
+    if (ret != OPEN_SUCCESS) {
+        delete image;
+        return ret;
+    }
+
+    uint64_t LBA = image->getLBA();
+    if (!int13_enable_48bitLBA && (LBA > 0x0FFFFFFF))
+        LOG_MSG("Warning: Disk size (%lf GiB) exceeds 128GiB limit for 28-bit LBA. You may need to enable 48-bit LBA support.", (double)image->image_length / (1024.0 * 1024 * 1024));
+    LOG_MSG("CHD image %s: C/H/S/sz %u/%u/%u/%u, %u hunks of %u bytes%s", fileName,
+        (unsigned int)image->cylinders, (unsigned int)image->heads, (unsigned int)image->sectors, (unsigned int)image->sector_size,
+        (unsigned int)image->totalhunks, (unsigned int)image->hunkbytes, image->diskimg != NULL ? ", with delta" : "");
+
+    *disk = image;
+    return OPEN_SUCCESS;
+}
+
+imageDiskCHD::~imageDiskCHD() {
+    LOG(LOG_IO,LOG_NORMAL)("CHD hunk cache %s: %llu hits, %llu hunks decompressed or read from the delta",
+        diskname.c_str(), (unsigned long long)hits, (unsigned long long)misses);
+    if (chd != NULL) {
+        chd_close(chd);
+        chd = NULL;
+    }
+    /* imageDisk writes back and closes the delta */
+}
+
+/* Open the delta file if there is one. Without one the image reads straight
+ * from the CHD until the first write creates it. */
+imageDiskCHD::ErrorCodes imageDiskCHD::OpenDelta(void) {
+    FILE *probe = fopen64(deltaname.c_str(), "rb");
+    if (probe == NULL) return OPEN_SUCCESS;
+    fclose(probe);
+
+    bool roflag = readOnly;
+    FILE *file = fopen_lock(deltaname.c_str(), readOnly ? "rb" : "rb+", roflag);
+    if (file == NULL) return ERROR_OPENING_DELTA;
+    setbuf(file, NULL);
+    readOnly = roflag;
+
+    uint8_t header[chd_delta_index_offset];
+    if (fread(header, sizeof(header), 1, file) != 1 || memcmp(header, chd_delta_cookie, 8) != 0 ||
+        host_readd(header + 8) != chd_delta_version) {
+        fclose(file);
+        return ERROR_OPENING_DELTA;
+    }
+    if (host_readd(header + 12) != hunkbytes || host_readd(header + 16) != totalhunks ||
+        host_readd(header + 20) != sector_size || host_readq(header + 24) != image_length ||
+        memcmp(header + 32, sha1, sizeof(sha1)) != 0) {
+        fclose(file);
+        return DELTA_INVALID_MATCH;
+    }
+    deltaDataOffset = host_readq(header + 56);
+    if (deltaDataOffset < chd_delta_index_offset + (uint64_t)totalhunks * 4u) {
+        fclose(file);
+        return ERROR_OPENING_DELTA;
+    }
+
+    std::vector<uint8_t> index((size_t)totalhunks * 4u);
+    if (!index.empty() && fread(index.data(), index.size(), 1, file) != 1) {
+        fclose(file);
+        return ERROR_OPENING_DELTA;
+    }
+    deltaIndex.resize(totalhunks);
+    deltaSlots = 0;
+    for (uint32_t i = 0; i < totalhunks; i++) {
+        deltaIndex[i] = host_readd(&index[(size_t)i * 4u]);
+        deltaSlots = std::max(deltaSlots, deltaIndex[i]);
+    }
+
+    diskimg = file;
+    return OPEN_SUCCESS;
+}
+
+bool imageDiskCHD::CreateDelta(void) {
+    FILE *file = fopen64(deltaname.c_str(), "wb+");
+    if (file == NULL) {
+        LOG_MSG("CHD: cannot create delta file %s", deltaname.c_str());
+        return false;
+    }
+    setbuf(file, NULL);
+
+    /* the first slot is 4KB aligned, past the header and an index of zeros */
+    const uint64_t dataOffset = (chd_delta_index_offset + (uint64_t)totalhunks * 4u + 0xFFFu) & ~(uint64_t)0xFFFu;
+    std::vector<uint8_t> header((size_t)dataOffset, 0);
+    memcpy(&header[0], chd_delta_cookie, 8);
+    host_writed(&header[8], chd_delta_version);
+    host_writed(&header[12], hunkbytes);
+    host_writed(&header[16], totalhunks);
+    host_writed(&header[20], sector_size);
+    host_writeq(&header[24], image_length);
+    memcpy(&header[32], sha1, sizeof(sha1));
+    host_writeq(&header[56], dataOffset);
+    if (fwrite(header.data(), header.size(), 1, file) != 1 || fflush(file) != 0) {
+        LOG_MSG("CHD: cannot write delta file %s", deltaname.c_str());
+        fclose(file);
+        remove(deltaname.c_str());
+        return false;
+    }
+
+    diskimg = file;
+    deltaDataOffset = dataOffset;
+    deltaIndex.assign(totalhunks, 0);
+    deltaSlots = 0;
+    LOG_MSG("CHD: writes to %s go to %s", diskname.c_str(), deltaname.c_str());
+    return true;
+}
+
+/* The hunk as the guest sees it, from the delta if it was written to and
+ * decompressed from the CHD otherwise. NULL if it can't be read. */
+imageDiskCHD::Hunk* imageDiskCHD::GetHunk(uint32_t hunknum) {
+    auto i = hunks.find(hunknum);
+    if (i != hunks.end()) {
+        hits++;
+        lru.splice(lru.begin(), lru, i->second.lru);
+        return &i->second;
+    }
+
+    misses++;
+    /* hunks are never dirty, whatever is written goes to the delta as it happens */
+    while (hunks.size() >= maxHunks && !lru.empty()) {
+        hunks.erase(lru.back());
+        lru.pop_back();
+    }
+
+    i = hunks.emplace(std::piecewise_construct, std::forward_as_tuple(hunknum), std::forward_as_tuple()).first;
+    Hunk &h = i->second;
+    h.data.resize(hunkbytes);
+    bool ok;
+    if (!deltaIndex.empty() && deltaIndex[hunknum] != 0)
+        ok = ReadImage(deltaDataOffset + (uint64_t)(deltaIndex[hunknum] - 1u) * hunkbytes, h.data.data(), hunkbytes);
+    else
+        ok = chd_read(chd, hunknum, h.data.data()) == CHDERR_NONE;
+    if (!ok) {
+        LOG(LOG_IO,LOG_ERROR)("CHD: failed to read hunk %u of %s", (unsigned int)hunknum, diskname.c_str());
+        hunks.erase(i);
+        return NULL;
+    }
+
+    lru.push_front(hunknum);
+    h.lru = lru.begin();
+    return &h;
+}
+
+bool imageDiskCHD::InRange(uint32_t sectnum, uint32_t count) const {
+    const uint64_t offset = (uint64_t)sectnum * sector_size;
+    const uint64_t len = (uint64_t)count * sector_size;
+    return count != 0 && offset < image_length && len <= (image_length - offset);
+}
+
+Int13Status imageDiskCHD::ReadSectors(uint32_t sectnum, uint32_t count, uint8_t* data) {
+    if (!InRange(sectnum, count)) return Int13Status::SectorNotFound;
+
+    uint64_t offset = (uint64_t)sectnum * sector_size;
+    uint64_t len = (uint64_t)count * sector_size;
+    while (len != 0) {
+        const uint32_t hunknum = (uint32_t)(offset / hunkbytes);
+        const uint32_t within = (uint32_t)(offset % hunkbytes);
+        const size_t n = (size_t)std::min<uint64_t>(len, hunkbytes - within);
+        const Hunk *h = GetHunk(hunknum);
+        if (h == NULL) return Int13Status::ControllerFailure;
+
+        memcpy(data, h->data.data() + within, n);
+        offset += n;
+        data += n;
+        len -= n;
+    }
+    return Int13Status::NoError;
+}
+
+Int13Status imageDiskCHD::WriteSectors(uint32_t sectnum, uint32_t count, const uint8_t* data) {
+    if (!InRange(sectnum, count)) return Int13Status::SectorNotFound;
+    if (readOnly) return Int13Status::WriteProtected;
+    if (diskimg == NULL && !CreateDelta()) return Int13Status::ControllerFailure;
+
+    uint64_t offset = (uint64_t)sectnum * sector_size;
+    uint64_t len = (uint64_t)count * sector_size;
+    while (len != 0) {
+        const uint32_t hunknum = (uint32_t)(offset / hunkbytes);
+        const uint32_t within = (uint32_t)(offset % hunkbytes);
+        const size_t n = (size_t)std::min<uint64_t>(len, hunkbytes - within);
+        Hunk *h = GetHunk(hunknum);
+        if (h == NULL) return Int13Status::ControllerFailure;
+
+        memcpy(h->data.data() + within, data, n);
+        bool ok;
+        if (deltaIndex[hunknum] != 0) {
+            ok = WriteImage(deltaDataOffset + (uint64_t)(deltaIndex[hunknum] - 1u) * hunkbytes + within, data, n);
+        }
+        else {
+            /* first write to the hunk, all of it goes to a new slot at the end.
+             * the slot is in the file before the index entry that points to it,
+             * so a crash in between can't leave the entry pointing at garbage */
+            uint8_t entry[4];
+            host_writed(entry, deltaSlots + 1u);
+            ok = WriteImage(deltaDataOffset + (uint64_t)deltaSlots * hunkbytes, h->data.data(), hunkbytes) &&
+                FlushImage() &&
+                WriteImage(chd_delta_index_offset + (uint64_t)hunknum * 4u, entry, 4);
+            if (ok) deltaIndex[hunknum] = ++deltaSlots;
+        }
+        if (!ok) {
+            /* don't keep data that never made it to the delta */
+            lru.erase(h->lru);
+            hunks.erase(hunknum);
+            return Int13Status::ControllerFailure;
+        }
+
+        offset += n;
+        data += n;
+        len -= n;
+    }
+    return Int13Status::NoError;
+}
+
+Int13Status imageDiskCHD::Read_AbsoluteSector(uint32_t sectnum, void * data) {
+    return ReadSectors(sectnum, 1, (uint8_t*)data);
+}
+
+Int13Status imageDiskCHD::Write_AbsoluteSector(uint32_t sectnum, const void * data) {
+    return WriteSectors(sectnum, 1, (const uint8_t*)data);
+}
+
+Int13Status imageDiskCHD::Read_AbsoluteSectors(uint32_t sectnum, uint32_t count, void * data) {
+    return ReadSectors(sectnum, count, (uint8_t*)data);
+}
+
+Int13Status imageDiskCHD::Write_AbsoluteSectors(uint32_t sectnum, uint32_t count, const void * data) {
+    return WriteSectors(sectnum, count, (const uint8_t*)data);
+}
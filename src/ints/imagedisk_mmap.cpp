@@ -0,0 +1,171 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "dosbox.h"
+#include "logging.h"
+#include "bios_disk.h"
+
+#if C_HAVE_MMAP
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+# define IMAGEDISK_MMAP
+#elif defined(WIN32) && !defined(HX_DOS)
+# include <windows.h>
+# include <io.h>
+# define IMAGEDISK_MMAP
+#endif
+
+// Memory mapped raw disk images
+
+extern bool disk_image_mmap;
+
+imageDiskMapping *imageDiskMapping::Create(FILE *file) {
+#if defined(IMAGEDISK_MMAP)
+    if (file == NULL || !disk_image_mmap) return NULL;
+
+    /* anything still in the stdio buffer has to reach the file first */
+    fflush(file);
+
+    imageDiskMapping *m = new imageDiskMapping();
+# if C_HAVE_MMAP
+    const int fd = fileno(file);
+    struct stat st;
+
+    if (fstat(fd,&st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 || (uint64_t)st.st_size > (uint64_t)SIZE_MAX) {
+        delete m;
+        return NULL;
+    }
+    m->length = (uint64_t)st.st_size;
+
+    void *p = mmap(NULL,(size_t)m->length,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+    if (p != MAP_FAILED) {
+        m->writable = true;
+    }
+    else {
+        /* the image was opened read-only */
+        p = mmap(NULL,(size_t)m->length,PROT_READ,MAP_SHARED,fd,0);
+        if (p == MAP_FAILED) {
+            delete m;
+            return NULL;
+        }
+    }
+    m->base = (uint8_t*)p;
+# else
+    const HANDLE fh = (HANDLE)_get_osfhandle(_fileno(file));
+    LARGE_INTEGER sz;
+
+    if (fh == INVALID_HANDLE_VALUE || !GetFileSizeEx(fh,&sz) || sz.QuadPart <= 0 || (uint64_t)sz.QuadPart > (uint64_t)SIZE_MAX) {
+        delete m;
+        return NULL;
+    }
+    m->length = (uint64_t)sz.QuadPart;
+
+    HANDLE mh = CreateFileMapping(fh,NULL,PAGE_READWRITE,0,0,NULL);
+    if (mh != NULL)
+        m->writable = true;
+    else
+        mh = CreateFileMapping(fh,NULL,PAGE_READONLY,0,0,NULL);
+    if (mh == NULL) {
+        delete m;
+        return NULL;
+    }
+    m->map_handle = mh;
+
+    m->base = (uint8_t*)MapViewOfFile(mh,m->writable ? FILE_MAP_WRITE : FILE_MAP_READ,0,0,0);
+    if (m->base == NULL) {
+        delete m;
+        return NULL;
+    }
+# endif
+
+    LOG(LOG_IO,LOG_NORMAL)("Disk image memory mapped, %llu bytes%s",(unsigned long long)m->length,m->writable ? "" : ", read-only");
+    return m;
+#else
+    (void)file;
+    return NULL;
+#endif
+}
+
+imageDiskMapping::~imageDiskMapping() {
+#if defined(IMAGEDISK_MMAP)
+    if (base != NULL) {
+        if (!Flush())
+            LOG(LOG_IO,LOG_ERROR)("Disk image mapping: failed to write back to the image file");
+# if C_HAVE_MMAP
+        munmap(base,(size_t)length);
+# else
+        UnmapViewOfFile(base);
+# endif
+        base = NULL;
+    }
+# if !C_HAVE_MMAP
+    if (map_handle != NULL) {
+        CloseHandle((HANDLE)map_handle);
+        map_handle = NULL;
+    }
+# endif
+#endif
+}
+
+const uint8_t *imageDiskMapping::Pointer(uint64_t offset,size_t len) const {
+    if (base == NULL || offset > length || len > (length - offset)) return NULL;
+    return base + offset;
+}
+
+bool imageDiskMapping::Read(uint64_t offset,void *data,size_t len) const {
+    const uint8_t *p = Pointer(offset,len);
+    if (p == NULL) return false;
+
+    memcpy(data,p,len);
+    return true;
+}
+
+bool imageDiskMapping::Write(uint64_t offset,const void *data,size_t len) {
+    if (!writable || Pointer(offset,len) == NULL) return false;
+
+    memcpy(base + offset,data,len);
+    if (dirty_start == dirty_end) {
+        dirty_start = offset;
+        dirty_end = offset + len;
+    }
+    else {
+        if (dirty_start > offset) dirty_start = offset;
+        if (dirty_end < (offset + len)) dirty_end = offset + len;
+    }
+    return true;
+}
+
+bool imageDiskMapping::Flush(void) {
+#if defined(IMAGEDISK_MMAP)
+    if (dirty_start == dirty_end) return true;
+
+    /* msync() wants a page aligned start, 64KB covers any host page size */
+    const uint64_t start = dirty_start & ~(uint64_t)0xFFFFu;
+    const size_t len = (size_t)(dirty_end - start);
+    dirty_start = dirty_end = 0;
+# if C_HAVE_MMAP
+    return msync(base + start,len,MS_SYNC) == 0;
+# else
+    return FlushViewOfFile(base + start,len) != 0;
+# endif
+#else
+    return true;
+#endif
+}
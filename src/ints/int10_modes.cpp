@@ -945,6 +945,7 @@ static void FinishSetMode(bool clearmem) {
         case M_PACKED4:
 			/* Hack we just access the memory directly */
 			memset(vga.mem.linear,0,vga.mem.memsize);
+			vga.dirty.invalidate();
 			break;
 		default:
 			break;
@@ -33,6 +33,10 @@
 using namespace std;
 
 
+//How much memory to use for cached L2 tables, and as much again for refcount blocks.
+	static const uint64_t table_cache_size = 1024 * 1024;
+
+
 //Public constant.
 	const uint32_t QCow2Image::magic = 0x514649FB;
 
@@ -65,6 +69,7 @@ using namespace std;
 //Public Constructor.
 	QCow2Image::QCow2Image(QCow2Image::QCow2Header& qcow2Header, FILE *qcow2File, const char* imageName, uint32_t sectorSizeBytes) : file(qcow2File), header(qcow2Header), sector_size(sectorSizeBytes), backing_image(NULL)
 	{
+		cache = imageDiskCache::Create(file);
 		cluster_mask = mask64(header.cluster_bits);
 		cluster_size = cluster_mask + 1;
 		sectors_per_cluster = cluster_size / sector_size;
@@ -73,6 +78,17 @@ using namespace std;
 		l1_bits = header.cluster_bits + l2_bits;
 		refcount_bits = header.cluster_bits - 1;
 		refcount_mask = mask64(refcount_bits);
+		max_cached_tables = (size_t)std::max<uint64_t>(4, table_cache_size / cluster_size);
+		table_use_count = 0;
+		cluster_buffer.resize(cluster_size);
+		//The L1 and refcount tables stay in memory, L2 tables and refcount blocks are loaded as needed.
+		if (0 != read_whole_table(header.l1_table_offset, header.l1_size, l1_table) ||
+			0 != read_whole_table(header.refcount_table_offset, ((uint64_t)header.refcount_table_clusters * cluster_size) >> 3, refcount_table)){
+			LOG(LOG_IO, LOG_ERROR) ("Failed to read QCow2 L1 or refcount table\n");
+		}
+		if (cache != NULL){
+			cache->sync = [this]() { return 0 == sync(); };
+		}
 		if (header.backing_file_offset != 0 && header.backing_file_size != 0){
 			char* backing_file_name = new char[header.backing_file_size + 1];
 			backing_file_name[header.backing_file_size] = 0;
@@ -115,98 +131,142 @@ using namespace std;
 
 //Public Destructor.
 	QCow2Image::~QCow2Image(){
+		if (0 != sync()){
+			LOG(LOG_IO, LOG_ERROR) ("Failed to write QCow2 refcounts\n");
+		}
+		if (cache != NULL){
+			cache->LogStats("QCOW2");
+			delete cache;
+		}
 		if (backing_image != NULL){
-			fclose(backing_image->file);
+			FILE* backing_file = backing_image->file;
 			delete backing_image;
+			fclose(backing_file);
 		}
 	}
 
 
 //Public function to a read a sector.
 	uint8_t QCow2Image::read_sector(uint32_t sectnum, uint8_t* data){
-		const uint64_t address = (uint64_t)sectnum * sector_size;
-		if (address >= header.size){
-			return 0x05;
-		}
-		uint64_t l2_table_offset;
-		if (0 != read_l1_table(address, l2_table_offset)){
-			return 0x05;
-		}
-		if (0 == l2_table_offset){
-			return read_unallocated_sector(sectnum, data);
-		}
-		uint64_t data_cluster_offset;
-		if (0 != read_l2_table(l2_table_offset, address, data_cluster_offset)){
-			return 0x05;
-		}
-		if (0 == data_cluster_offset){
-			return read_unallocated_sector(sectnum, data);
-		}
-		return read_allocated_data(data_cluster_offset + (address & cluster_mask), data, sector_size);
+		return read_sectors(sectnum, 1, data);
 	}
 
 
 //Public function to a write a sector.
 	uint8_t QCow2Image::write_sector(uint32_t sectnum, const uint8_t* data){
-		const uint64_t address = (uint64_t)sectnum * sector_size;
-		if (address >= header.size){
-			return 0x05;
-		}
-		uint64_t l2_table_offset;
-		if (0 != read_l1_table(address, l2_table_offset)){
+		return write_sectors(sectnum, 1, data);
+	}
+
+
+//Public function to read a run of sectors. Clusters that follow each other in the image file are read together.
+	uint8_t QCow2Image::read_sectors(uint32_t sectnum, uint32_t count, uint8_t* data){
+		uint64_t address = (uint64_t)sectnum * sector_size;
+		uint64_t data_size = (uint64_t)count * sector_size;
+		if (address >= header.size || data_size > header.size - address){
 			return 0x05;
 		}
-		if (0 == l2_table_offset){
-			if (0 != pad_file(l2_table_offset)){
-				return 0x05;
-			}
-			if (0 != write_l1_table_entry(address, l2_table_offset)){
+		while (data_size != 0){
+			const uint64_t cluster_offset = address & cluster_mask;
+			uint64_t length = std::min(data_size, cluster_size - cluster_offset);
+			uint64_t data_cluster_offset;
+			if (0 != read_data_cluster_offset(address, data_cluster_offset)){
 				return 0x05;
 			}
-			uint8_t* cluster_buffer = new uint8_t[cluster_size];
-			std::fill(cluster_buffer, cluster_buffer + cluster_size, 0);
-			if (0 != write_data(l2_table_offset, cluster_buffer, cluster_size)){
-				delete[] cluster_buffer;
-				return 0x05;
-			}
-			if (0 != update_reference_count(l2_table_offset, cluster_buffer)){
-				delete[] cluster_buffer;
-				return 0x05;
+			if (0 == data_cluster_offset){
+				if (0 != read_unallocated_data(address, data, length)){
+					return 0x05;
+				}
+			} else {
+				uint64_t next_cluster_offset;
+				while (length < data_size && 0 == read_data_cluster_offset(address + length, next_cluster_offset) &&
+					next_cluster_offset == data_cluster_offset + cluster_offset + length){
+					length += std::min(data_size - length, cluster_size);
+				}
+				if (0 != read_allocated_data(data_cluster_offset + cluster_offset, data, length)){
+					return 0x05;
+				}
 			}
-			delete[] cluster_buffer;
+			address += length;
+			data += length;
+			data_size -= length;
 		}
-		uint64_t data_cluster_offset;
-		if (0 != read_l2_table(l2_table_offset, address, data_cluster_offset)){
+		return 0;
+	}
+
+
+//Public function to write a run of sectors. Refcounts of new clusters are written by sync().
+	uint8_t QCow2Image::write_sectors(uint32_t sectnum, uint32_t count, const uint8_t* data){
+		uint64_t address = (uint64_t)sectnum * sector_size;
+		uint64_t data_size = (uint64_t)count * sector_size;
+		if (address >= header.size || data_size > header.size - address){
 			return 0x05;
 		}
-		if (data_cluster_offset == 0){
-			if (0 != pad_file(data_cluster_offset)){
-				return 0x05;
+		uint8_t result = 0;
+		while (data_size != 0){
+			const uint64_t cluster_offset = address & cluster_mask;
+			uint64_t length = std::min(data_size, cluster_size - cluster_offset);
+			uint64_t l2_table_offset;
+			if (0 != read_l1_table(address, l2_table_offset)){
+				result = 0x05;
+				break;
 			}
-			if (0 != write_l2_table_entry(l2_table_offset, address, data_cluster_offset)){
-				return 0x05;
-			}
-			uint8_t* cluster_buffer = new uint8_t[cluster_size];
-			if ( 0 != read_unallocated_cluster(address/cluster_size, cluster_buffer)){
-				delete[] cluster_buffer;
-				return 0x05;
+			if (0 == l2_table_offset){
+				std::fill(cluster_buffer.begin(), cluster_buffer.end(), 0);
+				if (0 != allocate_cluster(cluster_buffer.data(), l2_table_offset) ||
+					0 != write_l1_table_entry(address, l2_table_offset)){
+					result = 0x05;
+					break;
+				}
 			}
-			const uint64_t cluster_buffer_sector_offset = address & cluster_mask;
-			for (uint64_t i = 0; i < sector_size; i++){
-				cluster_buffer[cluster_buffer_sector_offset + i] = data[i];
+			uint64_t data_cluster_offset;
+			if (0 != read_l2_table(l2_table_offset, address, data_cluster_offset)){
+				result = 0x05;
+				break;
 			}
-			if (0 != write_data(data_cluster_offset, cluster_buffer, cluster_size)){
-				delete[] cluster_buffer;
-				return 0x05;
+			if (0 == data_cluster_offset){
+				//Copy on write, unless all of the cluster is written.
+				if (length != cluster_size && 0 != read_unallocated_data(address - cluster_offset, cluster_buffer.data(), cluster_size)){
+					result = 0x05;
+					break;
+				}
+				std::copy(data, data + length, cluster_buffer.begin() + (ptrdiff_t)cluster_offset);
+				if (0 != allocate_cluster(cluster_buffer.data(), data_cluster_offset) ||
+					0 != write_l2_table_entry(l2_table_offset, address, data_cluster_offset)){
+					result = 0x05;
+					break;
+				}
+			} else {
+				uint64_t next_cluster_offset;
+				while (length < data_size && 0 == read_data_cluster_offset(address + length, next_cluster_offset) &&
+					next_cluster_offset == data_cluster_offset + cluster_offset + length){
+					length += std::min(data_size - length, cluster_size);
+				}
+				if (0 != write_data(data_cluster_offset + cluster_offset, data, length)){
+					result = 0x05;
+					break;
+				}
 			}
-			if (0 != update_reference_count(data_cluster_offset, cluster_buffer)){
-				delete[] cluster_buffer;
-				return 0x05;
+			address += length;
+			data += length;
+			data_size -= length;
+		}
+		//Without the cache there is no write back to go with, so every write is a sync point.
+		if (cache == NULL && 0 != sync()){
+			result = 0x05;
+		}
+		return result;
+	}
+
+
+//Public function to write the refcount blocks changed since the last sync.
+	uint8_t QCow2Image::sync(){
+		uint8_t result = 0;
+		for (auto& block : refcount_blocks){
+			if (block.second.dirty_first != block.second.dirty_last && 0 != write_refcount_block(block.first, block.second)){
+				result = 0x05;
 			}
-			delete[] cluster_buffer;
-			return 0;
 		}
-		return write_data(data_cluster_offset + (address & cluster_mask), data, sector_size);
+		return result;
 	}
 
 
@@ -257,10 +317,15 @@ using namespace std;
 
 //Pad a file with zeros if it doesn't end on a cluster boundary.
 	uint8_t QCow2Image::pad_file(uint64_t& new_file_length){
-		if (0 != fseeko64(file, 0, SEEK_END)){
-			return 0x05;
+		uint64_t old_file_length;
+		if (cache != NULL){
+			old_file_length = cache->Length();
+		} else {
+			if (0 != fseeko64(file, 0, SEEK_END)){
+				return 0x05;
+			}
+			old_file_length = (uint64_t)ftello64(file);
 		}
-		const uint64_t old_file_length = (uint64_t)ftello64(file);
 		const uint64_t padding_size = (cluster_size - (old_file_length % cluster_size)) % cluster_size;
 		new_file_length = old_file_length + padding_size;
 		if (0 == padding_size){
@@ -274,125 +339,214 @@ using namespace std;
 	}
 
 
-//Read data of arbitrary length that is present in the image file.
-	uint8_t QCow2Image::read_allocated_data(uint64_t file_offset, uint8_t* data, uint64_t data_size)
-	{
-		if (0 != fseeko64(file, file_offset, SEEK_SET)){
+//Allocate a cluster at the end of the file, write its contents and count it.
+	uint8_t QCow2Image::allocate_cluster(const uint8_t* data, uint64_t& cluster_offset){
+		if (0 != pad_file(cluster_offset)){
 			return 0x05;
 		}
-		if (1 != fread(data, data_size, 1, file)){
+		if (0 != write_data(cluster_offset, data, cluster_size)){
 			return 0x05;
 		}
-		return 0;
+		return update_reference_count(cluster_offset);
 	}
 
 
-//Read an entire cluster that may or may not be allocated in the image file.
-	uint8_t QCow2Image::read_cluster(uint64_t data_cluster_number, uint8_t* data)
+//Read data of arbitrary length that is present in the image file.
+	uint8_t QCow2Image::read_allocated_data(uint64_t file_offset, uint8_t* data, uint64_t data_size)
 	{
-		const uint64_t address = data_cluster_number * cluster_size;
-		if (address >= header.size){
-			return 0x05;
+		if (cache != NULL){
+			return cache->Read(file_offset, data, (size_t)data_size) ? 0 : 0x05;
 		}
-		uint64_t l2_table_offset;
-		if (0 != read_l1_table(address, l2_table_offset)){
+		if (0 != fseeko64(file, file_offset, SEEK_SET)){
 			return 0x05;
 		}
-		if (0 == l2_table_offset){
-			return read_unallocated_cluster(data_cluster_number, data);
-		}
-		uint64_t data_cluster_offset;
-		if (0 != read_l2_table(l2_table_offset, address, data_cluster_offset)){
+		if (1 != fread(data, data_size, 1, file)){
 			return 0x05;
 		}
-		if (0 == data_cluster_offset){
-			return read_unallocated_cluster(data_cluster_number, data);
-		}
-		return read_allocated_data(data_cluster_offset, data, cluster_size);
+		return 0;
 	}
 
 
 //Read the L1 table to get the offset of the L2 table for a given address.
 	inline uint8_t QCow2Image::read_l1_table(uint64_t address, uint64_t& l2_table_offset){
-		const uint64_t l1_entry_offset = header.l1_table_offset + ((address >> l1_bits) << 3);
-		return read_table(l1_entry_offset, table_entry_mask, l2_table_offset);
+		const uint64_t l1_index = address >> l1_bits;
+		if (l1_index >= l1_table.size()){
+			return 0x05;
+		}
+		l2_table_offset = l1_table[l1_index] & table_entry_mask;
+		return 0;
 	}
 
 
 //Read an L2 table to get the offset of the data cluster for a given address.
 	inline uint8_t QCow2Image::read_l2_table(uint64_t l2_table_offset, uint64_t address, uint64_t& data_cluster_offset){
-		const uint64_t l2_entry_offset = l2_table_offset + (((address >> header.cluster_bits) & l2_mask) << 3);
-		return read_table(l2_entry_offset, table_entry_mask, data_cluster_offset);
+		CachedTable<uint64_t>* l2_table = get_l2_table(l2_table_offset);
+		if (l2_table == NULL){
+			return 0x05;
+		}
+		data_cluster_offset = l2_table->entries[(address >> header.cluster_bits) & l2_mask] & table_entry_mask;
+		return 0;
+	}
+
+
+//Get the offset of the data cluster for a given address, 0 if it isn't allocated.
+	uint8_t QCow2Image::read_data_cluster_offset(uint64_t address, uint64_t& data_cluster_offset){
+		uint64_t l2_table_offset;
+		if (0 != read_l1_table(address, l2_table_offset)){
+			return 0x05;
+		}
+		if (0 == l2_table_offset){
+			data_cluster_offset = 0;
+			return 0;
+		}
+		return read_l2_table(l2_table_offset, address, data_cluster_offset);
 	}
 
 
-//Read the refcount table to get the offset of the refcount cluster for a given address.
-	inline uint8_t QCow2Image::read_refcount_table(uint64_t data_cluster_offset, uint64_t& refcount_cluster_offset){
-		const uint64_t refcount_entry_offset = header.refcount_table_offset + (((data_cluster_offset/cluster_size) >> refcount_bits) << 3);
-		return read_table(refcount_entry_offset, empty_mask, refcount_cluster_offset);
+//Read data not currently allocated in the image file, from the backing image or as zeros.
+	uint8_t QCow2Image::read_unallocated_data(uint64_t address, uint8_t* data, uint64_t data_size){
+		uint64_t backing_size = 0;
+		if (backing_image != NULL && address < backing_image->header.size){
+			backing_size = std::min(data_size, backing_image->header.size - address);
+			if (0 != backing_image->read_sectors((uint32_t)(address / sector_size), (uint32_t)(backing_size / sector_size), data)){
+				return 0x05;
+			}
+		}
+		std::fill(data + backing_size, data + data_size, 0);
+		return 0;
 	}
 
 
-//Read a table entry at the given offset.
-	inline uint8_t QCow2Image::read_table(uint64_t entry_offset, uint64_t entry_mask, uint64_t& entry_value){
-        (void)entry_mask;//UNUSED
-		uint64_t buffer;
-		if (0 != read_allocated_data(entry_offset, (uint8_t*)&buffer, sizeof buffer)){
+//Read a whole table of 64-bit entries into memory.
+	uint8_t QCow2Image::read_whole_table(uint64_t table_offset, uint64_t table_size, std::vector<uint64_t>& table){
+		table.clear();
+		if (table_size > 0x2000000){
+			return 0x05; /* 256MB of table, the header is broken */
+		}
+		table.resize((size_t)table_size);
+		if (0 != table_size && 0 != read_allocated_data(table_offset, (uint8_t*)table.data(), table_size << 3)){
+			table.clear();
 			return 0x05;
 		}
-		entry_value = host_read64(buffer) & table_entry_mask;
+		for (auto& entry : table){
+			entry = host_read64(entry);
+		}
 		return 0;
 	}
 
 
-//Read a cluster not currently allocated in the image file.
-	inline uint8_t QCow2Image::read_unallocated_cluster(uint64_t data_cluster_number, uint8_t* data)
-	{
-		if(backing_image == NULL){
-			std::fill(data, data + cluster_size, 0);
-			return 0;
+//Get an L2 table, from the cache or else from the image file.
+	QCow2Image::CachedTable<uint64_t>* QCow2Image::get_l2_table(uint64_t l2_table_offset){
+		auto cached = l2_tables.find(l2_table_offset);
+		if (cached != l2_tables.end()){
+			cached->second.last_use = ++table_use_count;
+			return &cached->second;
+		}
+		evict_tables(l2_tables);
+		CachedTable<uint64_t>& l2_table = l2_tables[l2_table_offset];
+		l2_table.entries.resize((size_t)(cluster_size >> 3));
+		if (0 != read_allocated_data(l2_table_offset, (uint8_t*)l2_table.entries.data(), cluster_size)){
+			l2_tables.erase(l2_table_offset);
+			return NULL;
 		}
-		return backing_image->read_cluster(data_cluster_number, data);
+		for (auto& entry : l2_table.entries){
+			entry = host_read64(entry);
+		}
+		l2_table.last_use = ++table_use_count;
+		return &l2_table;
 	}
 
 
-//Read a sector not currently allocated in the image file.
-	inline uint8_t QCow2Image::read_unallocated_sector(uint32_t sectnum, uint8_t* data){
-		if(backing_image == NULL){
-			std::fill(data, data+sector_size, 0);
-			return 0;
+//Get a refcount block, from the cache or else from the image file.
+	QCow2Image::CachedTable<uint16_t>* QCow2Image::get_refcount_block(uint64_t refcount_cluster_offset){
+		auto cached = refcount_blocks.find(refcount_cluster_offset);
+		if (cached != refcount_blocks.end()){
+			cached->second.last_use = ++table_use_count;
+			return &cached->second;
+		}
+		if (refcount_blocks.size() >= max_cached_tables){
+			//Only clean blocks can go.
+			if (0 != sync()){
+				return NULL;
+			}
+			evict_tables(refcount_blocks);
+		}
+		CachedTable<uint16_t>& block = refcount_blocks[refcount_cluster_offset];
+		block.entries.resize((size_t)(cluster_size >> 1));
+		if (0 != read_allocated_data(refcount_cluster_offset, (uint8_t*)block.entries.data(), cluster_size)){
+			refcount_blocks.erase(refcount_cluster_offset);
+			return NULL;
 		}
-		return backing_image->read_sector(sectnum, data);
+		for (auto& entry : block.entries){
+			entry = host_read16(entry);
+		}
+		block.last_use = ++table_use_count;
+		return &block;
 	}
 
-//Update the reference count for a cluster.
-	uint8_t QCow2Image::update_reference_count(uint64_t cluster_offset, uint8_t* cluster_buffer){
-		uint64_t refcount_cluster_offset;
-		if (0 != read_refcount_table(cluster_offset, refcount_cluster_offset)){
+
+//Drop the least recently used table once the cache is full. The tables must not be dirty.
+	template <typename T> void QCow2Image::evict_tables(std::map<uint64_t, CachedTable<T> >& tables){
+		if (tables.size() < max_cached_tables){
+			return;
+		}
+		auto victim = tables.begin();
+		for (auto i = tables.begin(); i != tables.end(); ++i){
+			if (i->second.last_use < victim->second.last_use){
+				victim = i;
+			}
+		}
+		tables.erase(victim);
+	}
+
+
+//Set the reference count of a new cluster. Only the cached refcount block changes until the next sync().
+	uint8_t QCow2Image::update_reference_count(uint64_t cluster_offset){
+		const uint64_t cluster_number = cluster_offset >> header.cluster_bits;
+		const uint64_t refcount_table_index = cluster_number >> refcount_bits;
+		if (refcount_table_index >= refcount_table.size()){
+			LOG(LOG_IO, LOG_ERROR) ("QCow2 refcount table is full\n");
 			return 0x05;
 		}
+		uint64_t refcount_cluster_offset = refcount_table[refcount_table_index];
 		if (0 == refcount_cluster_offset){
-			refcount_cluster_offset = cluster_offset + cluster_size;
-			std::fill(cluster_buffer, cluster_buffer + cluster_size, 0);
-			if (0 != write_refcount_table_entry(cluster_offset, refcount_cluster_offset)){
+			//A new refcount block, which has to be counted itself.
+			if (0 != pad_file(refcount_cluster_offset)){
 				return 0x05;
 			}
-			if (0 != write_data(refcount_cluster_offset, cluster_buffer, cluster_size)){
-			return 0x05;
+			std::vector<uint8_t> zeros((size_t)cluster_size, 0);
+			if (0 != write_data(refcount_cluster_offset, zeros.data(), cluster_size)){
+				return 0x05;
+			}
+			if (0 != write_refcount_table_entry(cluster_offset, refcount_cluster_offset)){
+				return 0x05;
 			}
-			if (0 != write_refcount(refcount_cluster_offset, refcount_cluster_offset, 0x1)){
+			if (0 != update_reference_count(refcount_cluster_offset)){
 				return 0x05;
 			}
 		}
-		if (0 != write_refcount(cluster_offset, refcount_cluster_offset, 0x1)){
+		CachedTable<uint16_t>* block = get_refcount_block(refcount_cluster_offset);
+		if (block == NULL){
 			return 0x05;
 		}
+		const size_t index = (size_t)(cluster_number & refcount_mask);
+		block->entries[index] = 1;
+		if (block->dirty_first == block->dirty_last){
+			block->dirty_first = index;
+			block->dirty_last = index + 1;
+		} else {
+			block->dirty_first = std::min(block->dirty_first, index);
+			block->dirty_last = std::max(block->dirty_last, index + 1);
+		}
 		return 0;
 	}
 
 
 //Write data of arbitrary length to the image file.
 	uint8_t QCow2Image::write_data(uint64_t file_offset, const uint8_t* data, uint64_t data_size){
+		if (cache != NULL){
+			return cache->Write(file_offset, data, (size_t)data_size) ? 0 : 0x05;
+		}
 		if (0 != fseeko64(file, file_offset, SEEK_SET)){
 			return 0x05;
 		}
@@ -405,30 +559,43 @@ using namespace std;
 
 //Write an L2 table offset into the L1 table.
 	inline uint8_t QCow2Image::write_l1_table_entry(uint64_t address, uint64_t l2_table_offset){
-		const uint64_t l1_entry_offset = header.l1_table_offset + ((address >> l1_bits) << 3);
-		return write_table_entry(l1_entry_offset, l2_table_offset | copy_flag);
+		const uint64_t l1_index = address >> l1_bits;
+		l1_table[l1_index] = l2_table_offset | copy_flag;
+		return write_table_entry(header.l1_table_offset + (l1_index << 3), l1_table[l1_index]);
 	}
 
 
 //Write a data cluster offset into an L2 table.
 	inline uint8_t QCow2Image::write_l2_table_entry(uint64_t l2_table_offset, uint64_t address, uint64_t data_cluster_offset){
-		const uint64_t l2_entry_offset = l2_table_offset + (((address >> header.cluster_bits) & l2_mask) << 3);
-		return write_table_entry(l2_entry_offset, data_cluster_offset | copy_flag);
+		CachedTable<uint64_t>* l2_table = get_l2_table(l2_table_offset);
+		if (l2_table == NULL){
+			return 0x05;
+		}
+		const uint64_t l2_index = (address >> header.cluster_bits) & l2_mask;
+		l2_table->entries[l2_index] = data_cluster_offset | copy_flag;
+		return write_table_entry(l2_table_offset + (l2_index << 3), l2_table->entries[l2_index]);
 	}
 
 
-//Write a refcount.
-	inline uint8_t QCow2Image::write_refcount(uint64_t cluster_offset, uint64_t refcount_cluster_offset, uint16_t refcount){
-		const uint64_t refcount_offset = refcount_cluster_offset + (((cluster_offset/cluster_size) & refcount_mask) << 1);
-		uint16_t buffer = host_read16(refcount);
-		return write_data(refcount_offset, (uint8_t*)&buffer, sizeof buffer);
+//Write the changed part of a refcount block.
+	uint8_t QCow2Image::write_refcount_block(uint64_t refcount_cluster_offset, CachedTable<uint16_t>& block){
+		std::vector<uint16_t> buffer(block.entries.begin() + (ptrdiff_t)block.dirty_first, block.entries.begin() + (ptrdiff_t)block.dirty_last);
+		for (auto& entry : buffer){
+			entry = host_read16(entry);
+		}
+		if (0 != write_data(refcount_cluster_offset + (block.dirty_first << 1), (uint8_t*)buffer.data(), buffer.size() << 1)){
+			return 0x05;
+		}
+		block.dirty_first = block.dirty_last = 0;
+		return 0;
 	}
 
 
 //Write a refcount table entry.
 	inline uint8_t QCow2Image::write_refcount_table_entry(uint64_t cluster_offset, uint64_t refcount_cluster_offset){
-		const uint64_t refcount_entry_offset = header.refcount_table_offset + (((cluster_offset/cluster_size) >> refcount_bits) << 3);
-		return write_table_entry(refcount_entry_offset, refcount_cluster_offset);
+		const uint64_t refcount_table_index = (cluster_offset >> header.cluster_bits) >> refcount_bits;
+		refcount_table[refcount_table_index] = refcount_cluster_offset;
+		return write_table_entry(header.refcount_table_offset + (refcount_table_index << 3), refcount_cluster_offset);
 	}
 
 
@@ -459,3 +626,16 @@ using namespace std;
 	Int13Status QCow2Disk::Write_AbsoluteSector(uint32_t sectnum,const void* data){
 		return qcowImage.write_sector(sectnum, (const uint8_t*)data) ? Int13Status::ControllerFailure : Int13Status::NoError;
 	}
+
+
+
+//Public function to read a run of sectors.
+	Int13Status QCow2Disk::Read_AbsoluteSectors(uint32_t sectnum, uint32_t count, void* data){
+		return qcowImage.read_sectors(sectnum, count, (uint8_t*)data) ? Int13Status::ControllerFailure : Int13Status::NoError;
+	}
+
+
+//Public function to write a run of sectors.
+	Int13Status QCow2Disk::Write_AbsoluteSectors(uint32_t sectnum, uint32_t count, const void* data){
+		return qcowImage.write_sectors(sectnum, count, (const uint8_t*)data) ? Int13Status::ControllerFailure : Int13Status::NoError;
+	}
@@ -28,7 +28,20 @@
 #include <math.h>
 #include <png.h>
 
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define ZMBV_SSE2 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+# include <arm_neon.h>
+# define ZMBV_NEON 1
+#endif
+
 #include "zmbv.h"
+#include "threadpool.h"
 
 #define DBZV_VERSION_HIGH 0
 #define DBZV_VERSION_LOW 1
@@ -41,6 +54,140 @@
 #define Mask_KeyFrame			0x01
 #define	Mask_DeltaPalette		0x02
 
+#define DEFLATE_WINDOW			32768
+/* each slice starts its matches over, smaller ones cost more ratio than the thread gains */
+#define SLICE_MIN			65536
+
+struct ZMBVThreads : public ThreadPool {
+	/* A raw deflate stream per slice, primed with the 32KB of uncompressed
+	   stream before the slice and ended with a sync flush. Written one after
+	   the other they are the same single zlib stream that the decoders
+	   inflate, the way pigz splits its input. */
+	std::vector<z_stream> slices;
+	std::vector< std::vector<unsigned char> > sliceout, slicedict;
+	std::vector<unsigned char> history;	// the last 32KB of the stream before this frame
+
+	ZMBVThreads(int threads);
+	~ZMBVThreads();
+};
+
+ZMBVThreads::ZMBVThreads(int threads) : ThreadPool(threads) {
+	slices.resize((size_t)threads + 1u);
+	sliceout.resize(slices.size());
+	slicedict.resize(slices.size());
+	for (auto &z : slices) {
+		memset(&z, 0, sizeof(z));
+		deflateInit2(&z, 4, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+	}
+}
+
+ZMBVThreads::~ZMBVThreads() {
+	for (auto &z : slices) deflateEnd(&z);
+}
+
+static INLINE int PopCount16(unsigned int m) {
+	m = m - ((m >> 1) & 0x5555u);
+	m = (m & 0x3333u) + ((m >> 2) & 0x3333u);
+	m = (m + (m >> 4)) & 0x0f0fu;
+	return (int)((m + (m >> 8)) & 0x1fu);
+}
+
+/* pixels that differ in a row of a block, the upper byte of 32bpp pixels does not count */
+template<class P>
+static INLINE int CountChanged(const P * pold,const P * pnew,int dx) {
+	int ret=0;
+	for (int x=0;x<dx;x++) {
+		int test=0-(int)((pold[x]-pnew[x])&0x00ffffffu);
+		ret-=(test>>31);
+	}
+	return ret;
+}
+
+#if defined(ZMBV_SSE2)
+template<>
+INLINE int CountChanged<uint8_t>(const uint8_t * pold,const uint8_t * pnew,int dx) {
+	if (dx != 16) {
+		int ret=0;
+		for (int x=0;x<dx;x++) ret+=(pold[x]!=pnew[x]);
+		return ret;
+	}
+	const __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)pold),_mm_loadu_si128((const __m128i*)pnew));
+	return 16 - PopCount16((unsigned int)_mm_movemask_epi8(eq));
+}
+
+template<>
+INLINE int CountChanged<uint16_t>(const uint16_t * pold,const uint16_t * pnew,int dx) {
+	if (dx != 16) {
+		int ret=0;
+		for (int x=0;x<dx;x++) ret+=(pold[x]!=pnew[x]);
+		return ret;
+	}
+	const __m128i eq0 = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)pold),_mm_loadu_si128((const __m128i*)pnew));
+	const __m128i eq1 = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(pold+8)),_mm_loadu_si128((const __m128i*)(pnew+8)));
+	return 16 - PopCount16((unsigned int)_mm_movemask_epi8(_mm_packs_epi16(eq0,eq1)));
+}
+
+template<>
+INLINE int CountChanged<uint32_t>(const uint32_t * pold,const uint32_t * pnew,int dx) {
+	if (dx != 16) {
+		int ret=0;
+		for (int x=0;x<dx;x++) ret+=(((pold[x]^pnew[x])&0x00ffffffu)!=0);
+		return ret;
+	}
+	const __m128i rgb = _mm_set1_epi32(0x00ffffff);
+	__m128i eq[4];
+	for (int i=0;i<4;i++) {
+		const __m128i o = _mm_and_si128(_mm_loadu_si128((const __m128i*)(pold+i*4)),rgb);
+		const __m128i n = _mm_and_si128(_mm_loadu_si128((const __m128i*)(pnew+i*4)),rgb);
+		eq[i] = _mm_cmpeq_epi32(o,n);
+	}
+	const __m128i eq16 = _mm_packs_epi16(_mm_packs_epi32(eq[0],eq[1]),_mm_packs_epi32(eq[2],eq[3]));
+	return 16 - PopCount16((unsigned int)_mm_movemask_epi8(eq16));
+}
+#elif defined(ZMBV_NEON)
+static INLINE int SumBytes(uint8x16_t v) {
+	const uint64x2_t s = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(v)));
+	return (int)(vgetq_lane_u64(s,0) + vgetq_lane_u64(s,1));
+}
+
+template<>
+INLINE int CountChanged<uint8_t>(const uint8_t * pold,const uint8_t * pnew,int dx) {
+	if (dx != 16) {
+		int ret=0;
+		for (int x=0;x<dx;x++) ret+=(pold[x]!=pnew[x]);
+		return ret;
+	}
+	return 16 - SumBytes(vshrq_n_u8(vceqq_u8(vld1q_u8(pold),vld1q_u8(pnew)),7));
+}
+
+template<>
+INLINE int CountChanged<uint16_t>(const uint16_t * pold,const uint16_t * pnew,int dx) {
+	if (dx != 16) {
+		int ret=0;
+		for (int x=0;x<dx;x++) ret+=(pold[x]!=pnew[x]);
+		return ret;
+	}
+	const uint16x8_t eq0 = vceqq_u16(vld1q_u16(pold),vld1q_u16(pnew));
+	const uint16x8_t eq1 = vceqq_u16(vld1q_u16(pold+8),vld1q_u16(pnew+8));
+	return 16 - SumBytes(vshrq_n_u8(vcombine_u8(vmovn_u16(eq0),vmovn_u16(eq1)),7));
+}
+
+template<>
+INLINE int CountChanged<uint32_t>(const uint32_t * pold,const uint32_t * pnew,int dx) {
+	if (dx != 16) {
+		int ret=0;
+		for (int x=0;x<dx;x++) ret+=(((pold[x]^pnew[x])&0x00ffffffu)!=0);
+		return ret;
+	}
+	const uint32x4_t rgb = vdupq_n_u32(0x00ffffffu);
+	uint16x4_t eq[4];
+	for (int i=0;i<4;i++)
+		eq[i] = vmovn_u32(vceqq_u32(vandq_u32(vld1q_u32(pold+i*4),rgb),vandq_u32(vld1q_u32(pnew+i*4),rgb)));
+	const uint8x16_t eq8 = vcombine_u8(vmovn_u16(vcombine_u16(eq[0],eq[1])),vmovn_u16(vcombine_u16(eq[2],eq[3])));
+	return 16 - SumBytes(vshrq_n_u8(eq8,7));
+}
+#endif
+
 zmbv_format_t BPPFormat( int bpp ) {
 	switch (bpp) {
 	case 8:
@@ -174,10 +321,7 @@ INLINE int VideoCodec::CompareBlock(int vx,int vy,FrameBlock * block) {
 	P * pold=((P*)oldframe)+block->start+(vy*pitch)+vx;
 	P * pnew=((P*)newframe)+block->start;;	
 	for (int y=0;y<block->dy;y++) {
-		for (int x=0;x<block->dx;x++) {
-			int test=0-(int)((pold[x]-pnew[x])&0x00ffffffu);
-			ret-=(test>>31);
-		}
+		ret+=CountChanged<P>(pold,pnew,block->dx);
 		pold+=pitch;
 		pnew+=pitch;
 	}
@@ -185,65 +329,183 @@ INLINE int VideoCodec::CompareBlock(int vx,int vy,FrameBlock * block) {
 }
 
 template<class P>
-INLINE void VideoCodec::AddXorBlock(int vx,int vy,FrameBlock * block) {
+INLINE void VideoCodec::XorBlock(int vx,int vy,FrameBlock * block,unsigned char * dest) {
 	P * pold=((P*)oldframe)+block->start+(vy*pitch)+vx;
 	P * pnew=((P*)newframe)+block->start;
 	for (int y=0;y<block->dy;y++) {
 		for (int x=0;x<block->dx;x++) {
-			*((P*)&work[workUsed])=pnew[x] ^ pold[x];
-			workUsed+=(int)sizeof(P);
+			*((P*)dest)=pnew[x] ^ pold[x];
+			dest+=sizeof(P);
 		}
 		pold+=pitch;
 		pnew+=pitch;
 	}
 }
 
+template<class P>
+INLINE void VideoCodec::AddXorBlock(int vx,int vy,FrameBlock * block) {
+	XorBlock<P>(vx,vy,block,&work[workUsed]);
+	workUsed+=block->dx*block->dy*(int)sizeof(P);
+}
+
+template<class P>
+INLINE void VideoCodec::FindBlockVector(FrameBlock * block) {
+	int bestvx = 0;
+	int bestvy = 0;
+	int bestchange=CompareBlock<P>(0,0, block);
+	int possibles=64;
+	for (int v=0;v<VectorCount && possibles;v++) {
+		if (bestchange<4) break;
+		int vx = VectorTable[v].x;
+		int vy = VectorTable[v].y;
+		if (PossibleBlock<P>(vx, vy, block) < 4) {
+			possibles--;
+//			if (!possibles) Msg("Ran out of possibles, at %d of %d best %d\n",v,VectorCount,bestchange);
+			int testchange=CompareBlock<P>(vx,vy, block);
+			if (testchange<bestchange) {
+				bestchange=testchange;
+				bestvx = vx;
+				bestvy = vy;
+			}
+		}
+	}
+	block->vx = bestvx;
+	block->vy = bestvy;
+	block->change = bestchange;
+}
+
 template<class P>
 void VideoCodec::AddXorFrame(void) {
-//	int written=0;
-//	int lastvector=0;
 	signed char * vectors=(signed char*)&work[workUsed];
 	/* Align the following xor data on 4 byte boundary*/
 	workUsed=(workUsed + blockcount*2 +3) & ~3;
-//	int totalx=0;
-//	int totaly=0;
 	for (int b=0;b<blockcount;b++) {
 		FrameBlock * block=&blocks[b];
-		int bestvx = 0;
-		int bestvy = 0;
-		int bestchange=CompareBlock<P>(0,0, block);
-		int possibles=64;
-		for (int v=0;v<VectorCount && possibles;v++) {
-			if (bestchange<4) break;
-			int vx = VectorTable[v].x;
-			int vy = VectorTable[v].y;
-			if (PossibleBlock<P>(vx, vy, block) < 4) {
-				possibles--;
-//				if (!possibles) Msg("Ran out of possibles, at %d of %d best %d\n",v,VectorCount,bestchange);
-				int testchange=CompareBlock<P>(vx,vy, block);
-				if (testchange<bestchange) {
-					bestchange=testchange;
-					bestvx = vx;
-					bestvy = vy;
-				}
-			}
+		FindBlockVector<P>(block);
+		vectors[b*2+0]=(block->vx << 1);
+		vectors[b*2+1]=(block->vy << 1);
+		if (block->change) {
+			vectors[b*2+0]|=1;
+			AddXorBlock<P>(block->vx, block->vy, block);
 		}
-		vectors[b*2+0]=(bestvx << 1);
-		vectors[b*2+1]=(bestvy << 1);
-		if (bestchange) {
+	}
+}
+
+/* The same frame as AddXorFrame(). The rows of blocks are searched on the
+   worker threads, then the xor data of each changed block is written at the
+   offset it gets in the sequential layout. */
+template<class P>
+void VideoCodec::AddXorFrameThreaded(void) {
+	signed char * vectors=(signed char*)&work[workUsed];
+	workUsed=(workUsed + blockcount*2 +3) & ~3;
+	const int xblocks = (width + 15) / 16;
+	const int rows = blockcount / xblocks;
+
+	threads->Run(rows, [this,xblocks](int row) {
+		for (int b=row*xblocks;b<(row+1)*xblocks;b++)
+			FindBlockVector<P>(&blocks[b]);
+	});
+
+	for (int b=0;b<blockcount;b++) {
+		FrameBlock * block=&blocks[b];
+		vectors[b*2+0]=(block->vx << 1);
+		vectors[b*2+1]=(block->vy << 1);
+		if (block->change) {
 			vectors[b*2+0]|=1;
-			AddXorBlock<P>(bestvx, bestvy, block);
+			block->workpos=workUsed;
+			workUsed+=block->dx*block->dy*(int)sizeof(P);
 		}
 	}
+
+	threads->Run(rows, [this,xblocks](int row) {
+		for (int b=row*xblocks;b<(row+1)*xblocks;b++) {
+			FrameBlock * block=&blocks[b];
+			if (block->change) XorBlock<P>(block->vx,block->vy,block,&work[block->workpos]);
+		}
+	});
 }
 
-bool VideoCodec::SetupCompress( int _width, int _height ) {
+/* Deflates the work buffer in slices on the worker threads, returns the bytes
+   written after compress.writeDone or -1 if they do not fit */
+int VideoCodec::DeflateSlices(void) {
+	ZMBVThreads &t = *threads;
+	unsigned char *out = compress.writeBuf + compress.writeDone;
+	int room = compress.writeSize - compress.writeDone;
+	int written = 0;
+
+	if (*compress.writeBuf & Mask_KeyFrame) {
+		/* the stream restarts with a zlib header, as after deflateReset() */
+		if (room < 2) return -1;
+		out[0] = 0x78;	/* deflate, 32KB window */
+		out[1] = 0x5E;	/* compression level 4, header check */
+		written = 2;
+		t.history.clear();
+	}
+
+	int count = workUsed / SLICE_MIN;
+	if (count < 1) count = 1;
+	if (count > (int)t.slices.size()) count = (int)t.slices.size();
+	const int slicelen = workUsed / count;
+
+	t.Run(count, [this,&t,count,slicelen](int i) {
+		const int start = i * slicelen;
+		const int end = (i == count - 1) ? workUsed : start + slicelen;
+		z_stream &z = t.slices[(size_t)i];
+		std::vector<unsigned char> &dict = t.slicedict[(size_t)i];
+		std::vector<unsigned char> &sout = t.sliceout[(size_t)i];
+
+		deflateReset(&z);
+		if (start >= DEFLATE_WINDOW) {
+			deflateSetDictionary(&z, &work[start - DEFLATE_WINDOW], DEFLATE_WINDOW);
+		} else {
+			const size_t old = std::min(t.history.size(), (size_t)(DEFLATE_WINDOW - start));
+			dict.assign(t.history.end() - (long)old, t.history.end());
+			dict.insert(dict.end(), work, work + start);
+			if (!dict.empty()) deflateSetDictionary(&z, dict.data(), (uInt)dict.size());
+		}
+
+		size_t used = 0;
+		sout.resize(deflateBound(&z, (uLong)(end - start)) + 64u);
+		z.next_in = &work[start];
+		z.avail_in = (uInt)(end - start);
+		for (;;) {
+			z.next_out = sout.data() + used;
+			z.avail_out = (uInt)(sout.size() - used);
+			deflate(&z, Z_SYNC_FLUSH);
+			used = sout.size() - z.avail_out;
+			if (z.avail_out != 0) break;
+			sout.resize(sout.size() * 2u);
+		}
+		sout.resize(used);
+	});
+
+	for (int i=0;i<count;i++) {
+		const std::vector<unsigned char> &sout = t.sliceout[(size_t)i];
+		if ((int)sout.size() > room - written) return -1;
+		memcpy(out + written, sout.data(), sout.size());
+		written += (int)sout.size();
+	}
+
+	/* the slices of the next frame look back into this one */
+	if (workUsed >= DEFLATE_WINDOW) {
+		t.history.assign(work + workUsed - DEFLATE_WINDOW, work + workUsed);
+	} else {
+		t.history.insert(t.history.end(), work, work + workUsed);
+		if (t.history.size() > DEFLATE_WINDOW)
+			t.history.erase(t.history.begin(), t.history.end() - DEFLATE_WINDOW);
+	}
+	return written;
+}
+
+bool VideoCodec::SetupCompress( int _width, int _height, int _threads ) {
 	width = _width;
 	height = _height;
 	pitch = _width + 2*MAX_VECTOR;
 	format = ZMBV_FORMAT_NONE;
 	if (deflateInit (&zstream, 4) != Z_OK)
 		return false;
+	delete threads;
+	threads = (_threads > 0) ? new ZMBVThreads(_threads) : nullptr;
 	return true;
 }
 
@@ -347,19 +609,27 @@ int VideoCodec::FinishCompressFrame( void ) {
 		/* Add the delta frame data */
 		switch (format) {
 		case ZMBV_FORMAT_8BPP:
-			AddXorFrame<uint8_t>();
+			if (threads) AddXorFrameThreaded<uint8_t>();
+			else AddXorFrame<uint8_t>();
 			break;
 		case ZMBV_FORMAT_15BPP:
 		case ZMBV_FORMAT_16BPP:
-			AddXorFrame<uint16_t>();
+			if (threads) AddXorFrameThreaded<uint16_t>();
+			else AddXorFrame<uint16_t>();
 			break;
 		case ZMBV_FORMAT_32BPP:
-			AddXorFrame<uint32_t>();
+			if (threads) AddXorFrameThreaded<uint32_t>();
+			else AddXorFrame<uint32_t>();
 			break;
 		default:
 			break;
 		}
 	}
+	if (threads) {
+		const int written = DeflateSlices();
+		if (written < 0) return -1;
+		return (int)compress.writeDone + written;
+	}
 	/* Create the actual frame with compression */
 	zstream.next_in = (Bytef *)work;
 	zstream.avail_in = (unsigned int)workUsed;
@@ -561,7 +831,13 @@ VideoCodec::VideoCodec() {
 	buf1 = nullptr;
 	buf2 = nullptr;
 	work = nullptr;
+	threads = nullptr;
 	memset( &zstream, 0, sizeof(zstream));
 }
 
+VideoCodec::~VideoCodec() {
+	delete threads;
+	FreeBuffers();
+}
+
 #endif //(C_SSHOT)
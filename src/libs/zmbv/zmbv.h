@@ -41,11 +41,14 @@ typedef enum {
 } zmbv_format_t;
 
 void Msg(const char fmt[], ...);
+struct ZMBVThreads;
 class VideoCodec {
 private:
 	struct FrameBlock {
 		int start;
 		int dx,dy;
+		int vx,vy,change;	// compressor: best vector, pixels that differ with it
+		int workpos;		// compressor: where the xor data goes in the work buffer
 	};
 	struct CodecVector {
 		int x,y;
@@ -86,6 +89,10 @@ private:
 
 	z_stream zstream;
 
+	/* SetupCompress() with threads: block rows are searched and the frame is
+	   deflated in slices on a pool of worker threads */
+	ZMBVThreads *threads;
+
 	// methods
 	void FreeBuffers(void);
 	void CreateVectorTable(void);
@@ -93,6 +100,11 @@ private:
 
 	template<class P>
 		void AddXorFrame(void);
+	template<class P>
+		void AddXorFrameThreaded(void);
+	template<class P>
+		INLINE void FindBlockVector(FrameBlock * block);
+	int DeflateSlices(void);
 	template<class P>
 		void UnXorFrame(void);
 	template<class P>
@@ -101,13 +113,16 @@ private:
 		INLINE int CompareBlock(int vx,int vy,FrameBlock * block);
 	template<class P>
 		INLINE void AddXorBlock(int vx,int vy,FrameBlock * block);
+	template<class P>
+		INLINE void XorBlock(int vx,int vy,FrameBlock * block,unsigned char * dest);
 	template<class P>
 		INLINE void UnXorBlock(int vx,int vy,FrameBlock * block);
 	template<class P>
 		INLINE void CopyBlock(int vx, int vy,FrameBlock * block);
 public:
 	VideoCodec();
-	bool SetupCompress( int _width, int _height);
+	~VideoCodec();
+	bool SetupCompress( int _width, int _height, int _threads = 0);
 	bool SetupDecompress( int _width, int _height);
 	zmbv_format_t BPPFormat( int bpp );
 	int NeededSize( int _width, int _height, zmbv_format_t _format);
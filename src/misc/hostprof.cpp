@@ -0,0 +1,222 @@
+/*
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "dosbox.h"
+#include "hostprof.h"
+
+#if C_HOST_PROFILER
+
+#include "control.h"
+#include "logging.h"
+#include "setup.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+# include <dlfcn.h>
+# define HOSTPROF_DLADDR 1
+#endif
+
+HostProfState hostprof;
+
+struct HostProfEvent {
+	const void *id;
+	hostprof_time_t start;
+	uint32_t dur;			// nanoseconds, a single scope never runs for seconds
+	uint8_t zone;
+};
+
+/* 2M events are about 48MB, several seconds worth of scanlines */
+static const size_t hostprof_trace_max = 2u*1024u*1024u;
+static std::vector<HostProfEvent> hostprof_trace;
+static std::string hostprof_trace_path;
+static bool hostprof_trace_full = false;
+
+/* inclusive time per PIC event handler, for the summary at exit */
+static std::unordered_map<const void*,hostprof_time_t> hostprof_handlers;
+
+/* what the overlay shows, updated twice per second */
+static hostprof_time_t hostprof_overlay_start = 0;
+static unsigned int hostprof_overlay_pct[HOSTPROF_ZONES] = {0};
+
+static const char *hostprof_zone_names[HOSTPROF_ZONES] = {
+	"other",
+	"cpu",
+	"pic event",
+	"mixer",
+	"vga line",
+	"render line",
+	"gfx output"
+};
+
+static const char *hostprof_zone_short[HOSTPROF_ZONES] = {
+	"OTH","CPU","PIC","MIX","VGA","RND","GFX"
+};
+
+void HOSTPROF_Record(HostProfZone zone,const void *id,hostprof_time_t start,hostprof_time_t end) {
+	if (id != NULL) hostprof_handlers[id] += end - start;
+
+	if (hostprof_trace_path.empty()) return;
+	/* The main loop enters the CPU core millions of times per second. Merge
+	 * back to back slices that nothing else was recorded between. */
+	if (!hostprof_trace.empty()) {
+		HostProfEvent &last = hostprof_trace.back();
+		const hostprof_time_t last_end = last.start + last.dur;
+		if (last.zone == (uint8_t)zone && last.id == id && start >= last_end && (start - last_end) < 1000u &&
+			(end - last.start) <= 0xFFFFFFFFu) {
+			last.dur = (uint32_t)(end - last.start);
+			return;
+		}
+	}
+
+	if (hostprof_trace.size() >= hostprof_trace_max) {
+		if (!hostprof_trace_full) {
+			LOG_MSG("Host profiler: trace buffer full after %.3f seconds, no longer recording",(double)start / 1e9);
+			hostprof_trace_full = true;
+		}
+		return;
+	}
+
+	HostProfEvent ev;
+	ev.id = id;
+	ev.start = start;
+	ev.dur = (uint32_t)std::min<hostprof_time_t>(end - start,0xFFFFFFFFu);
+	ev.zone = (uint8_t)zone;
+	hostprof_trace.push_back(ev);
+}
+
+void HOSTPROF_OverlayText(char *buf,size_t len) {
+	const hostprof_time_t now = HOSTPROF_Now();
+	const hostprof_time_t elapsed = now - hostprof_overlay_start;
+
+	if (elapsed >= 500000000u) {
+		HOSTPROF_Charge(now);
+		for (unsigned int z=0;z < HOSTPROF_ZONES;z++) {
+			hostprof_overlay_pct[z] = (unsigned int)((hostprof.self[z] * 100u + (elapsed / 2u)) / elapsed);
+			hostprof.total[z] += hostprof.self[z];
+			hostprof.self[z] = 0;
+		}
+		hostprof_overlay_start = now;
+	}
+
+	char *d = buf;
+	char * const f = buf + len;
+	for (unsigned int z=HOSTPROF_CPU;z < HOSTPROF_ZONES && d < f;z++) {
+		const int r = snprintf(d,(size_t)(f-d),"%s%s%u%%",z != HOSTPROF_CPU ? " " : "",hostprof_zone_short[z],hostprof_overlay_pct[z]);
+		if (r < 0) break;
+		d += r;
+	}
+}
+
+/* Names a PIC event handler. Exported functions resolve to their symbol, the
+ * rest to an offset in the executable for "addr2line -f -e dosbox-x". */
+static std::string HOSTPROF_HandlerName(const void *id) {
+	char tmp[128];
+
+#if defined(HOSTPROF_DLADDR)
+	Dl_info info;
+	if (dladdr(id,&info) != 0) {
+		if (info.dli_sname != NULL) return info.dli_sname;
+		snprintf(tmp,sizeof(tmp),"pic event +0x%lx",(unsigned long)((uintptr_t)id - (uintptr_t)info.dli_fbase));
+		return tmp;
+	}
+#endif
+
+	snprintf(tmp,sizeof(tmp),"pic event %p",id);
+	return tmp;
+}
+
+static void HOSTPROF_WriteTrace(void) {
+	FILE *fp = fopen(hostprof_trace_path.c_str(),"w");
+	if (fp == NULL) {
+		LOG_MSG("Host profiler: cannot write trace to %s",hostprof_trace_path.c_str());
+		return;
+	}
+
+	std::map<const void*,std::string> names;
+	for (const auto &h : hostprof_handlers) names[h.first] = HOSTPROF_HandlerName(h.first);
+
+	fprintf(fp,"{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(fp,"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"emulation\"}}");
+	for (const auto &ev : hostprof_trace) {
+		const char *name = hostprof_zone_names[ev.zone];
+		if (ev.id != NULL) name = names[ev.id].c_str();
+
+		/* timestamps are in microseconds */
+		fprintf(fp,",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}",
+			name,hostprof_zone_names[ev.zone],(double)ev.start / 1000.0,(double)ev.dur / 1000.0);
+	}
+	fprintf(fp,"\n]}\n");
+	fclose(fp);
+
+	LOG_MSG("Host profiler: wrote %u trace events to %s",(unsigned int)hostprof_trace.size(),hostprof_trace_path.c_str());
+}
+
+static void HOSTPROF_Shutdown(Section *sec) {
+	(void)sec;//UNUSED
+	if (!hostprof.active) return;
+
+	HOSTPROF_Charge(HOSTPROF_Now());
+	hostprof.active = false;
+
+	hostprof_time_t all = 0;
+	for (unsigned int z=0;z < HOSTPROF_ZONES;z++) {
+		hostprof.total[z] += hostprof.self[z];
+		hostprof.self[z] = 0;
+		all += hostprof.total[z];
+	}
+	if (all == 0) all = 1;
+
+	LOG_MSG("Host profiler: %.3f seconds of host time",(double)all / 1e9);
+	for (unsigned int z=0;z < HOSTPROF_ZONES;z++)
+		LOG_MSG("Host profiler: %-12s %10.3f seconds %5.1f%%",hostprof_zone_names[z],(double)hostprof.total[z] / 1e9,(double)hostprof.total[z] * 100.0 / (double)all);
+
+	/* the PIC event handlers that took the most time, including nested scopes */
+	std::vector< std::pair<hostprof_time_t,const void*> > handlers;
+	for (const auto &h : hostprof_handlers) handlers.push_back(std::make_pair(h.second,h.first));
+	std::sort(handlers.rbegin(),handlers.rend());
+	for (size_t i=0;i < handlers.size() && i < 10;i++)
+		LOG_MSG("Host profiler: %10.3f seconds in %s",(double)handlers[i].first / 1e9,HOSTPROF_HandlerName(handlers[i].second).c_str());
+
+	if (!hostprof_trace_path.empty()) HOSTPROF_WriteTrace();
+	hostprof_trace.clear();
+	hostprof_trace.shrink_to_fit();
+	hostprof_handlers.clear();
+}
+
+void HOSTPROF_Init(void) {
+	hostprof.epoch = std::chrono::steady_clock::now();
+	hostprof.zone = HOSTPROF_OTHER;
+	hostprof.last = 0;
+	for (unsigned int z=0;z < HOSTPROF_ZONES;z++) hostprof.self[z] = hostprof.total[z] = 0;
+	hostprof_overlay_start = 0;
+
+	hostprof_trace_path = control->opt_hostprof_trace;
+	if (!hostprof_trace_path.empty()) {
+		hostprof_trace.reserve(64u*1024u);
+		LOG_MSG("Host profiler: recording a trace to %s",hostprof_trace_path.c_str());
+	}
+
+	hostprof.active = true;
+	AddExitFunction(AddExitFunctionFuncPair(HOSTPROF_Shutdown),true);
+}
+
+#endif
@@ -0,0 +1,200 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/* Runs short real mode instruction sequences on the dynamic cores and
+ * compares the registers, flags and memory they leave behind with what
+ * the normal core does. The sequences exercise the flags liveness of the
+ * recompilers: flags that are overwritten, partially overwritten and read
+ * again by later instructions of the same block. */
+
+#include "callback.h"
+#include "cpu.h"
+#include "dos_inc.h"
+#include "mem.h"
+#include "regs.h"
+#include "../src/cpu/lazyflags.h"
+
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#if (C_DYNAMIC_X86)
+void CPU_Core_Dyn_X86_Cache_Init(bool enable_cache);
+void CPU_Core_Dyn_X86_Cache_Reset(void);
+#endif
+#if (C_DYNREC)
+void CPU_Core_Dynrec_Cache_Init(bool enable_cache);
+void CPU_Core_Dynrec_Cache_Reset(void);
+extern bool dynamic_core_superblocks;
+#endif
+
+namespace {
+
+constexpr uint16_t dyn_test_data = 0x3000;	/* scratch memory, DS:SI and DS:DI point into it */
+constexpr uint16_t dyn_test_data_size = 0x100;
+
+struct DynTestCase {
+	const char *name;
+	std::vector<uint8_t> code;			/* without the final RETF */
+};
+
+/* hand assembled 16-bit code, AX=1234 BX=00FF CX=0003 DX=8000 SI=3000 DI=3010 */
+const DynTestCase dyn_test_cases[] = {
+	{ "dead add killed by cmp",	{ 0x01,0xd8, 0x88,0x04, 0x46, 0x39,0xd8 } },
+	{ "inc keeps carry",		{ 0x01,0xd2, 0x41, 0x47, 0x83,0xd2,0x00 } },
+	{ "carry through inc/dec",	{ 0x01,0xd2, 0x46, 0x4f, 0x72,0x01, 0x40, 0x39,0xc8 } },
+	{ "pushf after sub",		{ 0x29,0xd8, 0x89,0x05, 0x9c, 0x5d, 0x39,0xd8 } },
+	{ "shl by one",				{ 0x01,0xd2, 0x88,0x04, 0xd1,0xe3, 0x83,0xd0,0x00 } },
+	{ "shift count masked to 0",{ 0x01,0xd2, 0xc1,0xe0,0x20, 0x83,0xd0,0x00 } },
+	{ "shl by cl",				{ 0x01,0xd2, 0xd3,0xe0, 0x83,0xd0,0x00 } },
+	{ "rol keeps zf",			{ 0x39,0xd8, 0xd1,0xc2, 0x74,0x01, 0x41, 0x39,0xc8 } },
+	{ "sahf keeps of",			{ 0x01,0xd2, 0xb4,0x00, 0x9e, 0x71,0x01, 0x41, 0x39,0xc8 } },
+	{ "clc keeps zf",			{ 0x01,0xd2, 0xf8, 0x74,0x01, 0x41, 0x83,0xd0,0x00 } },
+	{ "cmc and sbb",			{ 0x29,0xc8, 0xf5, 0x19,0xda } },
+	{ "setcc",					{ 0x01,0xd2, 0x88,0x04, 0x0f,0x92,0xc1, 0x0f,0x94,0xc5, 0x39,0xc8 } },
+	{ "adc chain from memory",	{ 0x8a,0x04, 0x02,0x44,0x01, 0x12,0x44,0x02, 0x88,0x45,0x00, 0x46, 0x47, 0x83,0xd0,0x00 } },
+	{ "loop with dec/jnz",		{ 0xb9,0x05,0x00, 0x01,0xd8, 0x88,0x04, 0x46, 0x49, 0x75,0xf8, 0x39,0xd8 } },
+	{ "32-bit inc and adc",		{ 0x66,0x01,0xd8, 0x66,0x41, 0x66,0x83,0xd2,0x00, 0x66,0x39,0xc8 } },
+	{ "shld then adc",			{ 0x0f,0xa4,0xc2,0x04, 0x83,0xd0,0x00 } },
+	{ "neg and test",			{ 0xf7,0xda, 0x88,0x04, 0x85,0xdb, 0x83,0xd0,0x00 } },
+	{ "rcl reads carry",		{ 0x01,0xd2, 0x41, 0xd1,0xd3, 0x83,0xd0,0x00 } },
+	{ "lahf",					{ 0x01,0xd8, 0x9f, 0x88,0x24, 0x39,0xd8 } },
+	{ "stores between flags",	{ 0x29,0xd8, 0x89,0x04, 0x88,0x65,0x01, 0x8b,0x1c, 0x47, 0x81,0xfb,0x00,0x10 } },
+};
+
+struct DynTestResult {
+	uint32_t regs[8];
+	uint32_t flags;
+	uint8_t data[dyn_test_data_size];
+};
+
+DynTestResult DynTestRun(CPU_Decoder *decoder,uint16_t seg,uint16_t off) {
+	for (uint16_t i=0;i<dyn_test_data_size;i++)
+		real_writeb(seg,dyn_test_data+i,(uint8_t)(i*7+1));
+
+	reg_eax=0x1234;
+	reg_ebx=0x00ff;
+	reg_ecx=0x0003;
+	reg_edx=0x8000;
+	reg_esi=dyn_test_data;
+	reg_edi=dyn_test_data+0x10;
+	reg_ebp=0;
+	reg_flags=(reg_flags&~FMASK_TEST)|FLAG_ZF|FLAG_PF;
+	lflags.type=t_UNKNOWN;
+	SegSet16(ds,seg);
+	SegSet16(es,seg);
+
+	cpudecoder=decoder;
+	CALLBACK_RunRealFar(seg,off);
+
+	DynTestResult result;
+	FillFlags();
+	for (unsigned int r=0;r<8;r++) result.regs[r]=cpu_regs.regs[r].dword[0];
+	result.flags=(uint32_t)(reg_flags&FMASK_TEST);
+	for (uint16_t i=0;i<dyn_test_data_size;i++)
+		result.data[i]=real_readb(seg,dyn_test_data+i);
+	return result;
+}
+
+void DynTestCompare(const char *core,CPU_Decoder *decoder,void (*cache_init)(bool),void (*cache_reset)(void)) {
+	uint16_t seg,blocks=0x400;
+	ASSERT_TRUE(DOS_AllocateMemory(&seg,&blocks));
+
+	const CPU_Regs saved_regs=cpu_regs;
+	const uint16_t saved_ds=(uint16_t)SegValue(ds),saved_es=(uint16_t)SegValue(es);
+	CPU_Decoder * const saved_decoder=cpudecoder;
+	cache_init(true);
+
+	uint16_t off=0;
+	for (const auto &test : dyn_test_cases) {
+		for (size_t i=0;i<test.code.size();i++) real_writeb(seg,(uint16_t)(off+i),test.code[i]);
+		real_writeb(seg,(uint16_t)(off+test.code.size()),0xcb);	// retf
+
+		const DynTestResult expected=DynTestRun(&CPU_Core_Normal_Run,seg,off);
+		// the second run executes the block that was translated by the first
+		for (int run=0;run<2;run++) {
+			const DynTestResult got=DynTestRun(decoder,seg,off);
+			for (unsigned int r=0;r<8;r++)
+				EXPECT_EQ(expected.regs[r],got.regs[r]) << core << ": " << test.name << ", register " << r;
+			EXPECT_EQ(expected.flags,got.flags) << core << ": " << test.name;
+			EXPECT_EQ(0,memcmp(expected.data,got.data,sizeof(expected.data))) << core << ": " << test.name << ", memory";
+		}
+		off+=0x100;
+	}
+
+	// give the code pages back, the other dynamic core may run next
+	cache_reset();
+	cpudecoder=saved_decoder;
+	cpu_regs=saved_regs;
+	SegSet16(ds,saved_ds);
+	SegSet16(es,saved_es);
+	DOS_FreeMemory(seg);
+}
+
+#if (C_DYNREC)
+TEST(DynamicCore, DynrecMatchesNormalCore)
+{
+	DynTestCompare("dynamic_rec",&CPU_Core_Dynrec_Run,CPU_Core_Dynrec_Cache_Init,CPU_Core_Dynrec_Cache_Reset);
+}
+
+/* the loop jump is hot after the first run, later runs execute the block
+ * again as a superblock that unrolls the loop through its back-edge */
+TEST(DynamicCore, DynrecSuperblockLoopMatchesNormalCore)
+{
+	/* mov cx,100h; l: add ax,bx; adc dx,ax; xor [si],al; inc si; and si,303fh; dec cx; jnz l */
+	const std::vector<uint8_t> code = { 0xb9,0x00,0x01, 0x01,0xd8, 0x11,0xc2, 0x30,0x04, 0x46,
+		0x81,0xe6,0x3f,0x30, 0x49, 0x75,0xf2, 0xcb };
+	uint16_t seg,blocks=0x400;
+	ASSERT_TRUE(DOS_AllocateMemory(&seg,&blocks));
+
+	const CPU_Regs saved_regs=cpu_regs;
+	const uint16_t saved_ds=(uint16_t)SegValue(ds),saved_es=(uint16_t)SegValue(es);
+	CPU_Decoder * const saved_decoder=cpudecoder;
+	const bool saved_superblocks=dynamic_core_superblocks;
+	dynamic_core_superblocks=true;
+	CPU_Core_Dynrec_Cache_Init(true);
+
+	for (size_t i=0;i<code.size();i++) real_writeb(seg,(uint16_t)i,code[i]);
+	const DynTestResult expected=DynTestRun(&CPU_Core_Normal_Run,seg,0);
+	for (int run=0;run<4;run++) {
+		const DynTestResult got=DynTestRun(&CPU_Core_Dynrec_Run,seg,0);
+		for (unsigned int r=0;r<8;r++)
+			EXPECT_EQ(expected.regs[r],got.regs[r]) << "run " << run << ", register " << r;
+		EXPECT_EQ(expected.flags,got.flags) << "run " << run;
+		EXPECT_EQ(0,memcmp(expected.data,got.data,sizeof(expected.data))) << "run " << run << ", memory";
+	}
+
+	CPU_Core_Dynrec_Cache_Reset();
+	dynamic_core_superblocks=saved_superblocks;
+	cpudecoder=saved_decoder;
+	cpu_regs=saved_regs;
+	SegSet16(ds,saved_ds);
+	SegSet16(es,saved_es);
+	DOS_FreeMemory(seg);
+}
+#endif
+
+#if (C_DYNAMIC_X86)
+TEST(DynamicCore, DynX86MatchesNormalCore)
+{
+	DynTestCompare("dynamic_x86",&CPU_Core_Dyn_X86_Run,CPU_Core_Dyn_X86_Cache_Init,CPU_Core_Dyn_X86_Cache_Reset);
+}
+#endif
+
+} // namespace
@@ -0,0 +1,134 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "bios_disk.h"
+#include "control.h"
+#include "cpu.h"
+#include "dos_inc.h"
+#include "ide.h"
+#include "inout.h"
+#include "mem.h"
+#include "pic.h"
+
+#include <cstdio>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+/* a hard disk on the primary master, disk 3 in the BIOS disk list */
+const unsigned char ide_test_disk = 3;
+
+uint8_t IDE_TestByte(uint32_t sector, uint32_t i) {
+	return (uint8_t)(sector * 29u + i * 3u + 5u);
+}
+
+/* READ SECTOR of one LBA sector, then REP INS of count items of iolen bytes to
+ * base the way the CPU core does it: the first item through IO_Read*, the rest
+ * through IO_StringIn where it takes them. Returns the number of items
+ * IO_StringIn took. */
+Bitu IDE_TestReadSector(PhysPt base, uint32_t sector, Bitu iolen, Bitu count) {
+	const cpu_cycles_count_t cycles = CPU_Cycles;
+	const cpu_cycles_count_t cycle_left = CPU_CycleLeft;
+	const Bitu irq_check = PIC_IRQCheck;
+
+	/* the command is carried out 0.1ms later by a PIC event, fire it */
+	PIC_IRQCheck = 0;
+	CPU_Cycles = 0;
+	CPU_CycleLeft = CPU_CycleMax;
+	IO_WriteB(0x1F6, 0xE0u);
+	IO_WriteB(0x1F2, 1);
+	IO_WriteB(0x1F3, (uint8_t)sector);
+	IO_WriteB(0x1F4, (uint8_t)(sector >> 8u));
+	IO_WriteB(0x1F5, (uint8_t)(sector >> 16u));
+	IO_WriteB(0x1F7, 0x20);
+	CPU_CycleLeft = 1;
+	PIC_RunQueue();
+	EXPECT_EQ(IO_ReadB(0x1F7) & 0x89u, 0x08u) << "DRQ, not busy or error";
+
+	Bitu taken = 0;
+	uint32_t index = 0;
+	CPU_Cycles = CPU_CycleMax;
+	while (index < count * iolen) {
+		if (index != 0) {
+			const Bitu n = IO_StringIn(0x1F0, base, index, 0xFFFFu, iolen, count - index / iolen);
+			taken += n;
+			if (n != 0) continue;
+		}
+		if (iolen == 4) mem_writed(base + index, IO_ReadD(0x1F0));
+		else mem_writew(base + index, IO_ReadW(0x1F0));
+		index += (uint32_t)iolen;
+	}
+
+	PIC_IRQCheck |= irq_check;
+	CPU_Cycles = cycles;
+	CPU_CycleLeft = cycle_left;
+	return taken;
+}
+
+/* without "enable pio32" a 32-bit read of the data port is a 16-bit read of it
+ * and one of the next port, the sector count, so REP INSD must not go through
+ * the block handler */
+TEST(IDE, RepInsdWithoutPio32)
+{
+	Section_prop *section = static_cast<Section_prop *>(control->GetSection("ide, primary"));
+	if (section == NULL || !section->Get_bool("enable") || section->Get_bool("enable pio32"))
+		GTEST_SKIP() << "needs the primary IDE controller without pio32";
+	if (imageDiskList[ide_test_disk] != NULL || IDE_controller_occupied(0, false))
+		GTEST_SKIP() << "disk " << (unsigned int)ide_test_disk << " or the primary master is in use";
+
+	/* 20 cylinders, 2 heads, 8 sectors */
+	FILE *f = tmpfile();
+	ASSERT_NE(f, nullptr);
+	for (uint32_t s = 0; s < 320; s++)
+		for (uint32_t i = 0; i < 512; i++) fputc(IDE_TestByte(s, i), f);
+	fflush(f);
+	imageDiskList[ide_test_disk] = new imageDisk(f, "idetest.img", 20, 2, 8, 512, true);
+	imageDiskList[ide_test_disk]->Addref();
+	IDE_Hard_Disk_Attach(0, false, ide_test_disk);
+
+	uint16_t segment = 0, blocks = 1024 / 16;
+	if (DOS_AllocateMemory(&segment, &blocks)) {
+		const PhysPt base = (PhysPt)segment << 4u;
+
+		EXPECT_GT(IDE_TestReadSector(base, 5, 2, 256), 0u);
+		for (uint32_t i = 0; i < 512; i++) ASSERT_EQ(mem_readb(base + i), IDE_TestByte(5, i)) << "INSW byte " << i;
+
+		EXPECT_EQ(IDE_TestReadSector(base, 17, 4, 128), 0u);
+		const uint16_t count = IO_ReadW(0x1F2);
+		for (uint32_t i = 0; i < 128; i++) {
+			ASSERT_EQ(mem_readb(base + i * 4u), IDE_TestByte(17, i * 2u)) << "INSD item " << i;
+			ASSERT_EQ(mem_readb(base + i * 4u + 1u), IDE_TestByte(17, i * 2u + 1u)) << "INSD item " << i;
+			ASSERT_EQ(mem_readw(base + i * 4u + 2u), count) << "INSD item " << i;
+		}
+		/* the other half of the sector is still there */
+		for (uint32_t i = 256; i < 512; i += 2) ASSERT_EQ(IO_ReadW(0x1F0), IDE_TestByte(17, i) | (IDE_TestByte(17, i + 1u) << 8u)) << "byte " << i;
+		EXPECT_EQ(IO_ReadB(0x1F7) & 0x89u, 0x00u) << "done";
+
+		DOS_FreeMemory(segment);
+	}
+	else {
+		ADD_FAILURE() << "no conventional memory";
+	}
+
+	IDE_Hard_Disk_Detach(ide_test_disk);
+	imageDiskList[ide_test_disk]->Release();
+	imageDiskList[ide_test_disk] = NULL;
+}
+
+} // namespace
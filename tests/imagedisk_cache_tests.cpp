@@ -0,0 +1,97 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "bios_disk.h"
+#include "imagedisk_test_helpers.h"
+
+#include <cstdio>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+FILE *ImageCache_TestFile(std::vector<uint8_t> &shadow, size_t size) {
+	uint32_t seed = 7u;
+	shadow.resize(size);
+	for (auto &v : shadow) v = (uint8_t)Test_Random(seed);
+
+	FILE *f = tmpfile();
+	if (f != NULL) fwrite(shadow.data(), 1, shadow.size(), f);
+	return f;
+}
+
+TEST(ImageDiskCache, SequentialReadAhead)
+{
+	std::vector<uint8_t> shadow;
+	FILE *f = ImageCache_TestFile(shadow, 256 * 1024);
+	ASSERT_NE(f, nullptr);
+	{
+		imageDiskCache cache(f, 1024 * 1024);
+		uint8_t sector[512];
+		for (size_t o = 0; o < shadow.size(); o += sizeof(sector)) {
+			ASSERT_TRUE(cache.Read(o, sector, sizeof(sector)));
+			ASSERT_TRUE(std::equal(sector, sector + sizeof(sector), shadow.begin() + (long)o)) << "offset " << o;
+		}
+		/* the first read has nothing to continue, after that one miss per 32KB chunk */
+		EXPECT_EQ(cache.misses, 9u);
+		EXPECT_EQ(cache.readahead, 8u);
+		EXPECT_FALSE(cache.Read(shadow.size() - 100, sector, sizeof(sector)));
+	}
+	fclose(f);
+}
+
+TEST(ImageDiskCache, MatchesFileAfterWriteBack)
+{
+	std::vector<uint8_t> shadow;
+	FILE *f = ImageCache_TestFile(shadow, 200 * 1024 + 300);
+	ASSERT_NE(f, nullptr);
+	{
+		/* small enough that chunks get evicted, dirty or not */
+		imageDiskCache cache(f, 96 * 1024);
+		uint32_t seed = 1234u;
+		std::vector<uint8_t> buf;
+		for (unsigned int i = 0; i < 4000; i++) {
+			const size_t o = Test_Random(seed) % shadow.size();
+			size_t n = 1 + Test_Random(seed) % 5000;
+			buf.resize(n);
+			if (Test_Random(seed) & 1u) {
+				/* writes may extend the file */
+				for (auto &v : buf) v = (uint8_t)Test_Random(seed);
+				ASSERT_TRUE(cache.Write(o, buf.data(), n));
+				if (o + n > shadow.size()) shadow.resize(o + n);
+				std::copy(buf.begin(), buf.end(), shadow.begin() + (long)o);
+			}
+			else {
+				n = std::min(n, shadow.size() - o);
+				ASSERT_TRUE(cache.Read(o, buf.data(), n));
+				ASSERT_TRUE(std::equal(buf.begin(), buf.begin() + (long)n, shadow.begin() + (long)o)) << "read " << i;
+			}
+			if ((i % 500) == 499) {
+				ASSERT_TRUE(cache.Flush());
+			}
+			ASSERT_EQ(cache.Length(), shadow.size());
+		}
+		EXPECT_GT(cache.hits, 0u);
+		EXPECT_GT(cache.writeback_runs, 0u);
+	}
+	EXPECT_TRUE(ImageDisk_TestContents(f) == shadow);
+	fclose(f);
+}
+
+} // namespace
@@ -0,0 +1,159 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "bios_disk.h"
+#include "imagedisk_test_helpers.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+/* 20 cylinders, 2 heads, 8 sectors: 320 sectors in 40 hunks of 4KB */
+const uint32_t CHD_TestSectors = 20 * 2 * 8;
+const uint32_t CHD_TestHunkBytes = 4096;
+const uint32_t CHD_TestHunks = CHD_TestSectors * 512 / CHD_TestHunkBytes;
+
+uint8_t CHD_TestByte(uint32_t sector, uint32_t i) {
+	return (uint8_t)(sector * 13u + i * 7u + 1u);
+}
+
+/* A CHD v4 hard disk image with uncompressed hunks and the geometry in the
+ * metadata. The SHA1 is what a delta file is matched against. */
+bool CHD_TestWrite(uint8_t sha1, const std::string &name) {
+	const char meta[] = "CYLS:20,HEADS:2,SECS:8,BPS:512";
+	const size_t mapoff = 108;
+	const size_t metaoff = mapoff + CHD_TestHunks * 16u + 16u;
+	const size_t dataoff = metaoff + 16u + sizeof(meta);
+	std::vector<uint8_t> f(dataoff + (size_t)CHD_TestHunks * CHD_TestHunkBytes, 0);
+
+	memcpy(&f[0], "MComprHD", 8);
+	ImageDisk_TestPutBE(f, 8, 108, 4);                                    /* header length */
+	ImageDisk_TestPutBE(f, 12, 4, 4);                                     /* version */
+	ImageDisk_TestPutBE(f, 24, CHD_TestHunks, 4);
+	ImageDisk_TestPutBE(f, 28, (uint64_t)CHD_TestSectors * 512u, 8);
+	ImageDisk_TestPutBE(f, 36, metaoff, 8);
+	ImageDisk_TestPutBE(f, 44, CHD_TestHunkBytes, 4);
+	memset(&f[48], sha1, 20);
+	for (uint32_t h = 0; h < CHD_TestHunks; h++) {
+		ImageDisk_TestPutBE(f, mapoff + h * 16u, dataoff + (uint64_t)h * CHD_TestHunkBytes, 8);
+		ImageDisk_TestPutBE(f, mapoff + h * 16u + 12u, CHD_TestHunkBytes, 2);  /* low 16 bits of the length */
+		ImageDisk_TestPutBE(f, mapoff + h * 16u + 14u, CHD_TestHunkBytes >> 16u, 1);
+		f[mapoff + h * 16u + 15u] = 0x12;                            /* uncompressed, no CRC */
+	}
+	memcpy(&f[mapoff + CHD_TestHunks * 16u], "EndOfListCookie", 16);
+	ImageDisk_TestPutBE(f, metaoff, 0x47444444, 4);                       /* 'GDDD' */
+	ImageDisk_TestPutBE(f, metaoff + 4u, 0x01000000u | sizeof(meta), 4);
+	memcpy(&f[metaoff + 16u], meta, sizeof(meta));
+	for (uint32_t s = 0; s < CHD_TestSectors; s++)
+		for (uint32_t i = 0; i < 512; i++) f[dataoff + s * 512u + i] = CHD_TestByte(s, i);
+
+	FILE *file = fopen(name.c_str(), "wb");
+	if (file == NULL) return false;
+	const bool ok = fwrite(f.data(), f.size(), 1, file) == 1;
+	return (fclose(file) == 0) && ok;
+}
+
+std::vector<uint8_t> CHD_TestFile(const std::string &name) {
+	std::vector<uint8_t> r;
+	FILE *file = fopen(name.c_str(), "rb");
+	if (file != NULL) {
+		r = ImageDisk_TestContents(file);
+		fclose(file);
+	}
+	return r;
+}
+
+TEST(ImageDiskCHD, WritesSurviveInDelta)
+{
+	ImageDisk_TestDir dir;
+	ASSERT_TRUE(dir.Valid());
+	const std::string name = dir.Path("imagedisk_chd_test.chd");
+	const std::string delta = dir.Path("imagedisk_chd_test.chd.delta");
+	ASSERT_TRUE(CHD_TestWrite(1, name));
+	const std::vector<uint8_t> chd = CHD_TestFile(name);
+
+	/* sectors 6 to 9 cross from hunk 0 into hunk 1 */
+	std::vector<uint8_t> written(4 * 512);
+	for (size_t i = 0; i < written.size(); i++) written[i] = (uint8_t)(0xA5u ^ i);
+	{
+		imageDisk *disk = NULL;
+		ASSERT_EQ(imageDiskCHD::Open(name.c_str(), false, &disk), imageDiskCHD::OPEN_SUCCESS);
+		disk->Addref();
+		EXPECT_EQ(disk->cylinders, 20u);
+		EXPECT_EQ(disk->heads, 2u);
+		EXPECT_EQ(disk->sectors, 8u);
+
+		uint8_t sector[512];
+		ASSERT_EQ(disk->Read_AbsoluteSector(100, sector), Int13Status::NoError);
+		for (uint32_t i = 0; i < 512; i++) ASSERT_EQ(sector[i], CHD_TestByte(100, i)) << "byte " << i;
+		EXPECT_TRUE(CHD_TestFile(delta).empty());	/* reads don't create it */
+
+		EXPECT_EQ(disk->Write_AbsoluteSectors(6, 4, written.data()), Int13Status::NoError);
+		disk->Release();
+	}
+	EXPECT_TRUE(CHD_TestFile(name) == chd);
+	EXPECT_FALSE(CHD_TestFile(delta).empty());
+
+	/* reopened, the written sectors come from the delta and the rest from the CHD */
+	{
+		imageDisk *disk = NULL;
+		ASSERT_EQ(imageDiskCHD::Open(name.c_str(), true, &disk), imageDiskCHD::OPEN_SUCCESS);
+		disk->Addref();
+		std::vector<uint8_t> got(16 * 512);
+		ASSERT_EQ(disk->Read_AbsoluteSectors(0, 16, got.data()), Int13Status::NoError);
+		for (uint32_t s = 0; s < 16; s++) {
+			for (uint32_t i = 0; i < 512; i++) {
+				const uint8_t want = (s >= 6 && s < 10) ? written[(s - 6) * 512u + i] : CHD_TestByte(s, i);
+				ASSERT_EQ(got[s * 512u + i], want) << "sector " << s << ", byte " << i;
+			}
+		}
+		uint8_t sector[512] = {};
+		EXPECT_EQ(disk->Write_AbsoluteSector(0, sector), Int13Status::WriteProtected);
+		disk->Release();
+	}
+}
+
+TEST(ImageDiskCHD, DeltaOfOtherImageRejected)
+{
+	ImageDisk_TestDir dir;
+	ASSERT_TRUE(dir.Valid());
+	const std::string name = dir.Path("imagedisk_chd_test.chd");
+	const std::string delta = dir.Path("imagedisk_chd_test.chd.delta");
+	ASSERT_TRUE(CHD_TestWrite(1, name));
+	{
+		imageDisk *disk = NULL;
+		ASSERT_EQ(imageDiskCHD::Open(name.c_str(), false, &disk), imageDiskCHD::OPEN_SUCCESS);
+		disk->Addref();
+		uint8_t sector[512] = {};
+		EXPECT_EQ(disk->Write_AbsoluteSector(3, sector), Int13Status::NoError);
+		disk->Release();
+	}
+
+	/* same geometry, but another image */
+	ASSERT_TRUE(CHD_TestWrite(2, name));
+	imageDisk *disk = NULL;
+	EXPECT_EQ(imageDiskCHD::Open(name.c_str(), false, &disk), imageDiskCHD::DELTA_INVALID_MATCH);
+	EXPECT_EQ(disk, nullptr);
+}
+
+} // namespace
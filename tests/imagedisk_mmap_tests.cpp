@@ -0,0 +1,112 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "bios_disk.h"
+#include "imagedisk_test_helpers.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+/* 64 sectors of 512 bytes */
+const uint32_t MMap_TestSectors = 64;
+
+uint8_t MMap_TestByte(uint32_t sector, uint32_t i) {
+	return (uint8_t)(sector * 11u + i * 5u + 3u);
+}
+
+FILE *MMap_TestFile(std::vector<uint8_t> &shadow) {
+	shadow.resize(MMap_TestSectors * 512u);
+	for (uint32_t s = 0; s < MMap_TestSectors; s++)
+		for (uint32_t i = 0; i < 512; i++) shadow[s * 512u + i] = MMap_TestByte(s, i);
+
+	FILE *f = tmpfile();
+	if (f != NULL && fwrite(shadow.data(), 1, shadow.size(), f) != shadow.size()) {
+		fclose(f);
+		f = NULL;
+	}
+	return f;
+}
+
+TEST(ImageDiskMapping, OnlyWhenEnabled)
+{
+	std::vector<uint8_t> shadow;
+	FILE *f = MMap_TestFile(shadow);
+	ASSERT_NE(f, nullptr);
+
+	imageDisk *disk = new imageDisk(f, "mmap_test.img", (uint64_t)shadow.size(), true);
+	disk->Addref();
+	uint8_t sector[512];
+	ASSERT_EQ(disk->Read_AbsoluteSector(7, sector), Int13Status::NoError);
+	EXPECT_EQ(memcmp(sector, &shadow[7 * 512], sizeof(sector)), 0);
+	EXPECT_EQ(disk->Map_AbsoluteSector(0, MMap_TestSectors), nullptr);
+	disk->Release();
+}
+
+/* reads, writes and the pointer into the mapping all agree with the file */
+TEST(ImageDiskMapping, ReadWriteFlushMatchFile)
+{
+	std::vector<uint8_t> shadow;
+	FILE *f = MMap_TestFile(shadow);
+	ASSERT_NE(f, nullptr);
+
+	imageDisk *disk = new imageDisk(f, "mmap_test.img", (uint64_t)shadow.size(), true);
+	disk->Addref();
+	disk->EnableMapping();
+	const uint8_t *map = disk->Map_AbsoluteSector(0, MMap_TestSectors);
+	if (map == NULL) {
+		disk->Release();
+		GTEST_SKIP() << "no memory mapped disk images on this host";
+	}
+	EXPECT_EQ(memcmp(map, shadow.data(), shadow.size()), 0);
+	EXPECT_EQ(disk->Map_AbsoluteSector(5, 2), map + 5 * 512);
+	EXPECT_EQ(disk->Map_AbsoluteSector(MMap_TestSectors - 1, 2), nullptr);
+
+	uint8_t sector[512];
+	ASSERT_EQ(disk->Read_AbsoluteSector(9, sector), Int13Status::NoError);
+	EXPECT_EQ(memcmp(sector, &shadow[9 * 512], sizeof(sector)), 0);
+
+	std::vector<uint8_t> written(3 * 512);
+	for (size_t i = 0; i < written.size(); i++) written[i] = (uint8_t)(0x5Au ^ (i * 7u));
+	ASSERT_EQ(disk->Write_AbsoluteSectors(20, 3, written.data()), Int13Status::NoError);
+	memcpy(&shadow[20 * 512], written.data(), written.size());
+	EXPECT_EQ(memcmp(map, shadow.data(), shadow.size()), 0);
+	ASSERT_EQ(disk->Read_AbsoluteSector(21, sector), Int13Status::NoError);
+	EXPECT_EQ(memcmp(sector, &written[512], sizeof(sector)), 0);
+	EXPECT_EQ(disk->Write_AbsoluteSector(MMap_TestSectors, sector), Int13Status::SectorNotFound);
+
+	/* a second mapping of the same file, written back with Flush() */
+	imageDiskMapping *m = imageDiskMapping::Create(f);
+	ASSERT_NE(m, nullptr);
+	const uint8_t last[4] = { 1, 2, 3, 4 };
+	EXPECT_TRUE(m->Write(shadow.size() - 4u, last, sizeof(last)));
+	EXPECT_FALSE(m->Write(shadow.size() - 3u, last, sizeof(last)));
+	EXPECT_TRUE(m->Flush());
+	memcpy(&shadow[shadow.size() - 4u], last, sizeof(last));
+	delete m;
+
+	EXPECT_TRUE(ImageDisk_TestContents(f) == shadow);
+	EXPECT_EQ(memcmp(map, shadow.data(), shadow.size()), 0);
+	disk->Release();
+}
+
+} // namespace
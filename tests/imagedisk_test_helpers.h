@@ -0,0 +1,108 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_IMAGEDISK_TEST_HELPERS_H
+#define DOSBOX_IMAGEDISK_TEST_HELPERS_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <direct.h>
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+/* the whole file, empty if it cannot be read */
+inline std::vector<uint8_t> ImageDisk_TestContents(FILE *f) {
+	std::vector<uint8_t> r;
+	fseek(f, 0, SEEK_END);
+	r.resize((size_t)ftell(f));
+	fseek(f, 0, SEEK_SET);
+	if (fread(r.data(), 1, r.size(), f) != r.size()) r.clear();
+	return r;
+}
+
+/* the LCG the tests make their data with, 24 bits of it */
+inline uint32_t Test_Random(uint32_t &seed) {
+	seed = seed * 1103515245u + 12345u;
+	return seed >> 8u;
+}
+
+/* big endian fields of a hand made image header, as QCOW2 and CHD have */
+inline uint64_t ImageDisk_TestGetBE(const std::vector<uint8_t> &f, uint64_t offset, unsigned int bytes) {
+	uint64_t r = 0;
+	for (unsigned int i = 0; i < bytes; i++) r = (r << 8u) | f[(size_t)(offset + i)];
+	return r;
+}
+
+inline void ImageDisk_TestPutBE(std::vector<uint8_t> &f, uint64_t offset, uint64_t v, unsigned int bytes) {
+	for (unsigned int i = bytes; i-- > 0;) {
+		f[(size_t)(offset + i)] = (uint8_t)v;
+		v >>= 8u;
+	}
+}
+
+/* A temporary directory for the image files of one test. The files named
+ * through Path() and the directory are removed when it goes out of scope. */
+class ImageDisk_TestDir {
+public:
+	ImageDisk_TestDir() {
+#if defined(_WIN32)
+		const char *tmp = getenv("TEMP");
+		const std::string base = std::string(tmp != NULL ? tmp : ".") + "\\dosbox-x-test-" + std::to_string(_getpid()) + "-";
+		for (unsigned int i = 0; i < 1000 && dir.empty(); i++) {
+			if (_mkdir((base + std::to_string(i)).c_str()) == 0) dir = base + std::to_string(i);
+		}
+#else
+		const char *tmp = getenv("TMPDIR");
+		std::string name = std::string(tmp != NULL ? tmp : "/tmp") + "/dosbox-x-test-XXXXXX";
+		if (mkdtemp(&name[0]) != NULL) dir = name;
+#endif
+	}
+
+	~ImageDisk_TestDir() {
+		for (const auto &f : files) remove(f.c_str());
+#if defined(_WIN32)
+		if (!dir.empty()) _rmdir(dir.c_str());
+#else
+		if (!dir.empty()) rmdir(dir.c_str());
+#endif
+	}
+
+	ImageDisk_TestDir(const ImageDisk_TestDir &) = delete;
+	ImageDisk_TestDir &operator=(const ImageDisk_TestDir &) = delete;
+
+	bool Valid() const { return !dir.empty(); }
+
+	/* name in the directory, removed with it */
+	std::string Path(const std::string &name) {
+		files.push_back(dir + "/" + name);
+		return files.back();
+	}
+
+private:
+	std::string dir;
+	std::vector<std::string> files;
+};
+
+#endif
@@ -0,0 +1,168 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "../src/hardware/mixer_simd.h"
+#include "mixer.h"
+#include "imagedisk_test_helpers.h"
+
+#include <cmath>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+/* odd on purpose, so the kernels have a tail to finish in C */
+constexpr Bitu mixer_test_frames = 1001;
+
+TEST(Mixer, KernelsMatchC)
+{
+	std::vector<float> src(mixer_test_frames * 2u), want(mixer_test_frames * 2u), got(mixer_test_frames * 2u);
+	uint32_t seed = 7u;
+	for (auto &v : src) {
+		v = (float)((int32_t)Test_Random(seed) - 0x800000) / 128.0f; /* about +/-65536, so it clips */
+	}
+
+	const float start[2] = { -1000.5f, 250.25f }, step[2] = { 3.75f, -0.5f };
+	MIXER_Ramp_C(want.data(), mixer_test_frames, start, step);
+	MIXER_Ramp(got.data(), mixer_test_frames, start, step);
+	for (Bitu i = 0; i < want.size(); i++)
+		ASSERT_NEAR(want[i], got[i], 0.01f) << "ramp " << i;
+
+	MIXER_Fill_C(want.data(), mixer_test_frames, start);
+	MIXER_Fill(got.data(), mixer_test_frames, start);
+	EXPECT_EQ(want, got);
+
+	for (int swap = 0; swap < 2; swap++) {
+		MIXER_Accumulate_C(want.data(), src.data(), mixer_test_frames, swap != 0);
+		MIXER_Accumulate(got.data(), src.data(), mixer_test_frames, swap != 0);
+		EXPECT_EQ(want, got) << "swap " << swap;
+	}
+
+	const float vol[2] = { 1.0f, 0.375f };
+	std::vector<int16_t> want16(mixer_test_frames * 2u), got16(mixer_test_frames * 2u);
+	MIXER_ToInt16_C(want16.data(), src.data(), mixer_test_frames, vol);
+	MIXER_ToInt16(got16.data(), src.data(), mixer_test_frames, vol);
+	EXPECT_EQ(want16, got16);
+
+	/* the resampler sums in a different order, so allow for rounding */
+	for (unsigned int taps = 8; taps <= MIXER_RESAMPLE_MAXTAPS; taps *= 2) {
+		std::vector<float> coef(taps);
+		for (unsigned int k = 0; k < taps; k++) coef[k] = src[k + 7u] / 65536.0f;
+		float cw[2], cg[2];
+		MIXER_Convolve_C(cw, src.data() + 1u, src.data() + 100u, coef.data(), taps);
+		MIXER_Convolve(cg, src.data() + 1u, src.data() + 100u, coef.data(), taps);
+		EXPECT_NEAR(cw[0], cg[0], 0.05f) << "taps " << taps;
+		EXPECT_NEAR(cw[1], cg[1], 0.05f) << "taps " << taps;
+	}
+}
+
+
+const char *const mixer_test_profiles[3] = { "fast", "medium", "best" };
+
+/* gain of one phase of a filter bank at f cycles per input sample */
+double MIXER_TestGain(const float *c, unsigned int taps, double f) {
+	double re = 0, im = 0;
+	for (unsigned int k = 0; k < taps; k++) {
+		re += c[k] * cos(2.0 * M_PI * f * k);
+		im -= c[k] * sin(2.0 * M_PI * f * k);
+	}
+	return sqrt(re * re + im * im);
+}
+
+/* halving the rate: unity gain at DC, the lower half of the new band kept, and
+ * what would alias from above 1.4 times the new Nyquist rate held down */
+TEST(Mixer, ResamplerFilterBank)
+{
+	MixerChannel *chan = MIXER_AddChannel(NULL, 22050, "RESAMPLETEST");
+	const unsigned int rate = chan->freq_d;
+	if (rate == 0) {
+		MIXER_DelChannel(chan);
+		GTEST_SKIP() << "no mixer rate";
+	}
+	chan->SetFreq(rate * 2u);
+
+	const double min_passband[3] = { 0.75, 0.95, 0.99 }, max_stopband_db[3] = { -25.0, -50.0, -80.0 };
+	for (unsigned int p = 0; p < 3; p++) {
+		ASSERT_TRUE(chan->SetResampler(mixer_test_profiles[p]));
+		unsigned int taps = 0, phases = 0;
+		const float *coef = chan->GetResamplerCoef(taps, phases);
+		ASSERT_NE(coef, nullptr);
+
+		for (unsigned int ph = 0; ph < phases; ph++) {
+			double sum = 0;
+			for (unsigned int k = 0; k < taps; k++) sum += coef[ph * taps + k];
+			ASSERT_NEAR(sum, 1.0, 1e-4) << mixer_test_profiles[p] << " phase " << ph;
+		}
+		for (unsigned int ph = 0; ph < phases; ph += phases / 16u) {
+			const float *c = coef + ph * taps;
+			EXPECT_GE(MIXER_TestGain(c, taps, 0.125), min_passband[p]) << mixer_test_profiles[p] << " phase " << ph;
+			for (double f = 0.35; f <= 0.5; f += 0.001) {
+				const double db = 20.0 * log10(MIXER_TestGain(c, taps, f) + 1e-12);
+				ASSERT_LE(db, max_stopband_db[p]) << mixer_test_profiles[p] << " phase " << ph << ", " << f << " cycles/sample";
+			}
+		}
+	}
+	MIXER_DelChannel(chan);
+}
+
+/* a 1kHz sine at 22050Hz comes out at the mixer rate with the same frequency
+ * and amplitude, after the filter has filled up */
+TEST(Mixer, ResamplerKeepsSine)
+{
+	MixerChannel *chan = MIXER_AddChannel(NULL, 22050, "RESAMPLETEST");
+	const unsigned int rate = chan->freq_d;
+	if (rate == 0) {
+		MIXER_DelChannel(chan);
+		GTEST_SKIP() << "no mixer rate";
+	}
+
+	std::vector<int16_t> in(22050u * 2048u / rate - 2u);
+	for (size_t i = 0; i < in.size(); i++) in[i] = (int16_t)lround(10000.0 * sin(2.0 * M_PI * 1000.0 * i / 22050.0));
+
+	for (unsigned int p = 0; p < 3; p++) {
+		chan->current_loaded = false;
+		chan->freq_f = chan->freq_fslew = 0;
+		chan->msbuffer_o = 0;
+		ASSERT_TRUE(chan->SetResampler(mixer_test_profiles[p]));
+		chan->AddSamples_m16(in.size(), in.data());
+		const Bitu skip = 64u * rate / 22050u, n = chan->msbuffer_o - skip;
+		ASSERT_GT(chan->msbuffer_o, skip + 1000u) << mixer_test_profiles[p];
+
+		/* least squares fit of a sin + b cos at 1kHz, then what is left over */
+		double ss = 0, sc = 0, cc = 0, ys = 0, yc = 0;
+		for (Bitu i = 0; i < n; i++) {
+			const double w = 2.0 * M_PI * 1000.0 * i / rate, si = sin(w), co = cos(w), y = chan->msbuffer[skip + i][0];
+			ss += si * si; sc += si * co; cc += co * co; ys += y * si; yc += y * co;
+		}
+		const double det = ss * cc - sc * sc;
+		const double a = (ys * cc - yc * sc) / det, b = (yc * ss - ys * sc) / det;
+		double residual = 0;
+		for (Bitu i = 0; i < n; i++) {
+			const double w = 2.0 * M_PI * 1000.0 * i / rate;
+			const double e = chan->msbuffer[skip + i][0] - a * sin(w) - b * cos(w);
+			residual += e * e;
+		}
+		EXPECT_NEAR(sqrt(a * a + b * b), 10000.0, 100.0) << mixer_test_profiles[p];
+		EXPECT_LT(sqrt(residual / n), 50.0) << mixer_test_profiles[p];
+		EXPECT_EQ(chan->msbuffer[skip][0], chan->msbuffer[skip][1]) << mixer_test_profiles[p];
+	}
+	MIXER_DelChannel(chan);
+}
+
+} // namespace
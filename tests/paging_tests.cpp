@@ -0,0 +1,157 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "mem.h"
+#include "paging.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+/* page directories, page tables and two data pages above the DOS memory,
+ * with address bit 20 clear so that they do not depend on the A20 gate */
+constexpr PhysPt paging_test_dir   = 0x400000;
+constexpr PhysPt paging_test_table = 0x401000;
+constexpr PhysPt paging_test_page0 = 0x402000;
+constexpr PhysPt paging_test_page1 = 0x403000;
+constexpr PhysPt paging_test_dir2   = 0x404000;	/* second address space */
+constexpr PhysPt paging_test_table2 = 0x405000;
+constexpr LinearPt paging_test_lin = 0x80000000;
+
+void PAGING_TestMap(PhysPt page) {
+	phys_writed(paging_test_table, page | 0x7);		// present, writable, user
+}
+
+/* page walks and software TLB hits since the last call */
+struct PAGING_TestCounts {
+	uint64_t walks = 0, hits = 0;
+
+	void Take() {
+		const PagingTLBStats &stats = PAGING_GetTLBStats();
+		walks = stats.walks;
+		hits = stats.stlb_hits;
+	}
+	void Expect(uint64_t new_walks, uint64_t new_hits) {
+		const PagingTLBStats &stats = PAGING_GetTLBStats();
+		EXPECT_EQ(new_walks, stats.walks - walks) << "page walks";
+		EXPECT_EQ(new_hits, stats.stlb_hits - hits) << "software TLB hits";
+		Take();
+	}
+};
+
+TEST(Paging, TranslationsFollowFlushes)
+{
+	if (MEM_TotalPages() < ((paging_test_page1 >> 12) + 1)) GTEST_SKIP() << "not enough memory";
+
+	const Bitu saved_cr3 = PAGING_GetDirBase();
+	const bool saved_enabled = PAGING_Enabled();
+	PAGING_TestCounts counts;
+
+	for (PhysPt i = 0; i < 4096; i += 4) {
+		phys_writed(paging_test_dir + i, 0);
+		phys_writed(paging_test_table + i, 0);
+	}
+	phys_writed(paging_test_dir + ((paging_test_lin >> 22) * 4), paging_test_table | 0x7);
+	PAGING_TestMap(paging_test_page0);
+	phys_writed(paging_test_page1, 0x22222222);
+
+	PAGING_SetDirBase(paging_test_dir);
+	PAGING_Enable(true);
+
+	counts.Take();
+	mem_writed(paging_test_lin, 0x11111111);
+	EXPECT_EQ(0x11111111u, phys_readd(paging_test_page0));
+	EXPECT_EQ(0x67u, phys_readd(paging_test_table) & 0x67u);	// accessed and dirty
+	counts.Expect(1, 0);
+
+	// not a flush, the translation is mapped again without a page walk
+	PAGING_SetWP(true);
+	EXPECT_EQ(0x11111111u, mem_readd(paging_test_lin));
+	counts.Expect(0, 1);
+	PAGING_SetWP(false);
+
+	// a flush drops the old translation
+	PAGING_TestMap(paging_test_page1);
+	PAGING_ClearTLB();
+	EXPECT_EQ(0x22222222u, mem_readd(paging_test_lin));
+	counts.Expect(1, 0);
+	PAGING_SetWP(true);
+	EXPECT_EQ(0x22222222u, mem_readd(paging_test_lin));
+	counts.Expect(0, 1);
+	PAGING_SetWP(false);
+	mem_writed(paging_test_lin + 4, 0x33333333);
+	EXPECT_EQ(0x33333333u, phys_readd(paging_test_page1 + 4));
+
+	PAGING_Enable(saved_enabled);
+	PAGING_SetDirBase(saved_cr3);
+	PAGING_ClearTLB();
+}
+
+TEST(Paging, TranslationsFollowAddressSpaces)
+{
+	if (MEM_TotalPages() < ((paging_test_table2 >> 12) + 1)) GTEST_SKIP() << "not enough memory";
+
+	const Bitu saved_cr3 = PAGING_GetDirBase();
+	const bool saved_enabled = PAGING_Enabled();
+	PAGING_TestCounts counts;
+
+	for (PhysPt i = 0; i < 4096; i += 4) {
+		phys_writed(paging_test_dir + i, 0);
+		phys_writed(paging_test_table + i, 0);
+		phys_writed(paging_test_dir2 + i, 0);
+		phys_writed(paging_test_table2 + i, 0);
+	}
+	phys_writed(paging_test_dir + ((paging_test_lin >> 22) * 4), paging_test_table | 0x7);
+	phys_writed(paging_test_dir2 + ((paging_test_lin >> 22) * 4), paging_test_table2 | 0x7);
+	PAGING_TestMap(paging_test_page0);
+	phys_writed(paging_test_table2, paging_test_page1 | 0x7);
+	phys_writed(paging_test_page0, 0x11111111);
+	phys_writed(paging_test_page1, 0x22222222);
+
+	// every CR3 write is a flush, each switch walks the tables again
+	PAGING_SetDirBase(paging_test_dir);
+	PAGING_Enable(true);
+	counts.Take();
+	EXPECT_EQ(0x11111111u, mem_readd(paging_test_lin));
+	EXPECT_EQ(0u, mem_readd(paging_test_lin + 4));		// mapped by the first read
+	counts.Expect(1, 0);
+	PAGING_SetDirBase(paging_test_dir2);
+	EXPECT_EQ(0x22222222u, mem_readd(paging_test_lin));
+	counts.Expect(1, 0);
+	PAGING_SetDirBase(paging_test_dir);
+	EXPECT_EQ(0x11111111u, mem_readd(paging_test_lin));
+	counts.Expect(1, 0);
+
+	// page tables changed while another address space is active are
+	// seen when switching back, and a reload of CR3 flushes too
+	PAGING_SetDirBase(paging_test_dir2);
+	PAGING_TestMap(paging_test_page1);
+	EXPECT_EQ(0x22222222u, mem_readd(paging_test_lin));
+	PAGING_SetDirBase(paging_test_dir);
+	EXPECT_EQ(0x22222222u, mem_readd(paging_test_lin));
+	PAGING_TestMap(paging_test_page0);
+	PAGING_SetDirBase(paging_test_dir);
+	EXPECT_EQ(0x11111111u, mem_readd(paging_test_lin));
+	counts.Expect(3, 0);
+
+	PAGING_Enable(saved_enabled);
+	PAGING_SetDirBase(saved_cr3);
+	PAGING_ClearTLB();
+}
+
+} // namespace
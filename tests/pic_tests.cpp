@@ -0,0 +1,191 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "pic.h"
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+constexpr Bitu pic_test_event_count = 100000;
+
+std::vector<Bitu> pic_test_fired;
+
+void PIC_TestEvent(Bitu val) {
+	pic_test_fired.push_back(val);
+}
+
+void PIC_TestOtherEvent(Bitu val) {
+	pic_test_fired.push_back(val | 0x80000000u);
+}
+
+/* scatter the values so that inserts do not arrive in firing order */
+Bitu PIC_TestScramble(Bitu i) {
+	return (i * 7919u) % pic_test_event_count;
+}
+
+/* Fire every event that is due now without letting the PIC start an
+ * interrupt on the CPU while the test runs. */
+void PIC_TestRunQueue() {
+	const cpu_cycles_count_t cycles = CPU_Cycles;
+	const cpu_cycles_count_t cycle_left = CPU_CycleLeft;
+	const Bitu irq_check = PIC_IRQCheck;
+
+	PIC_IRQCheck = 0;
+	CPU_Cycles = 0;
+	CPU_CycleLeft = CPU_CycleMax;
+	PIC_RunQueue();
+
+	PIC_IRQCheck |= irq_check;
+	CPU_Cycles = cycles;
+	CPU_CycleLeft = cycle_left;
+}
+
+TEST(PIC_EventQueue, FiringOrder)
+{
+	pic_test_fired.clear();
+
+	/* all in the past, so that the next PIC_RunQueue() fires them */
+	for (Bitu i = 0; i < pic_test_event_count; i++) {
+		const Bitu v = PIC_TestScramble(i);
+		PIC_AddEvent(PIC_TestEvent, -2.0 + (pic_tickindex_t)v / 1000000.0, v);
+	}
+
+	PIC_TestRunQueue();
+
+	ASSERT_EQ(pic_test_event_count, pic_test_fired.size());
+	for (Bitu i = 0; i < pic_test_event_count; i++)
+		EXPECT_EQ(i, pic_test_fired[i]);
+}
+
+TEST(PIC_EventQueue, SameIndexFiresInInsertionOrder)
+{
+	pic_test_fired.clear();
+
+	for (Bitu i = 0; i < 64; i++)
+		PIC_AddEvent((i & 1) ? PIC_TestOtherEvent : PIC_TestEvent, -2.0, i);
+
+	PIC_TestRunQueue();
+
+	ASSERT_EQ(64u, pic_test_fired.size());
+	for (Bitu i = 0; i < 64; i++)
+		EXPECT_EQ((i & 1) ? (i | 0x80000000u) : i, pic_test_fired[i]);
+}
+
+TEST(PIC_EventQueue, RemoveEvents)
+{
+	pic_test_fired.clear();
+
+	for (Bitu i = 0; i < 1000; i++) {
+		PIC_AddEvent(PIC_TestEvent, -2.0 + (pic_tickindex_t)i / 1000000.0, i % 10);
+		PIC_AddEvent(PIC_TestOtherEvent, -2.0 + (pic_tickindex_t)i / 1000000.0, i % 10);
+	}
+
+	for (Bitu v = 0; v < 10; v += 2)
+		PIC_RemoveSpecificEvents(PIC_TestEvent, v);
+	PIC_RemoveEvents(PIC_TestOtherEvent);
+
+	PIC_TestRunQueue();
+
+	ASSERT_EQ(500u, pic_test_fired.size());
+	for (auto v : pic_test_fired)
+		EXPECT_EQ(1u, v & 0x80000001u);
+}
+
+/* removing one handler's events from a full queue keeps the rest in order */
+TEST(PIC_EventQueue, RemoveFromLargeQueue)
+{
+	pic_test_fired.clear();
+
+	for (Bitu i = 0; i < pic_test_event_count; i++) {
+		const Bitu v = PIC_TestScramble(i);
+		PIC_AddEvent((v & 1) ? PIC_TestOtherEvent : PIC_TestEvent, -2.0 + (pic_tickindex_t)v / 1000000.0, v);
+	}
+	PIC_RemoveEvents(PIC_TestOtherEvent);
+
+	PIC_TestRunQueue();
+
+	ASSERT_EQ(pic_test_event_count / 2u, pic_test_fired.size());
+	for (Bitu i = 0; i < pic_test_fired.size(); i++)
+		EXPECT_EQ(i * 2u, pic_test_fired[i]);
+}
+
+/* The sorted singly linked list the event queue used before the heap, kept
+ * here only to time against: an insert walks from the head to its place. */
+struct PIC_TestListEntry {
+	pic_tickindex_t index;
+	Bitu value;
+	PIC_TestListEntry *next;
+};
+
+Bitu PIC_TestListRun(std::vector<PIC_TestListEntry> &entries) {
+	PIC_TestListEntry *head = nullptr;
+	for (auto &entry : entries) {
+		if (!head || head->index > entry.index) {
+			entry.next = head;
+			head = &entry;
+			continue;
+		}
+		PIC_TestListEntry *find = head;
+		while (find->next && find->next->index <= entry.index) find = find->next;
+		entry.next = find->next;
+		find->next = &entry;
+	}
+
+	Bitu sum = 0;
+	for (Bitu i = 0; head; i++, head = head->next) sum += head->value * i;
+	return sum;
+}
+
+/* Not run by default; use --gtest_also_run_disabled_tests to see the times */
+TEST(PIC_EventQueue, DISABLED_TimeAgainstSortedList)
+{
+	typedef std::chrono::steady_clock clock;
+
+	std::vector<PIC_TestListEntry> entries(pic_test_event_count);
+	for (Bitu i = 0; i < pic_test_event_count; i++) {
+		const Bitu v = PIC_TestScramble(i);
+		entries[i].index = -2.0 + (pic_tickindex_t)v / 1000000.0;
+		entries[i].value = v;
+	}
+	const clock::time_point list_start = clock::now();
+	const Bitu list_sum = PIC_TestListRun(entries);
+	const double list_ms = std::chrono::duration<double, std::milli>(clock::now() - list_start).count();
+
+	pic_test_fired.clear();
+	pic_test_fired.reserve(pic_test_event_count);
+	const clock::time_point heap_start = clock::now();
+	for (Bitu i = 0; i < pic_test_event_count; i++)
+		PIC_AddEvent(PIC_TestEvent, entries[i].index, entries[i].value);
+	PIC_TestRunQueue();
+	const double heap_ms = std::chrono::duration<double, std::milli>(clock::now() - heap_start).count();
+
+	Bitu heap_sum = 0;
+	for (Bitu i = 0; i < pic_test_fired.size(); i++) heap_sum += pic_test_fired[i] * i;
+	ASSERT_EQ(pic_test_event_count, pic_test_fired.size());
+	EXPECT_EQ(list_sum, heap_sum);
+
+	printf("%u events: sorted list %.1fms, heap %.1fms\n", (unsigned int)pic_test_event_count, list_ms, heap_ms);
+	EXPECT_LT(heap_ms, list_ms);
+}
+
+} // namespace
@@ -0,0 +1,134 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "qcow2_disk.h"
+#include "imagedisk_test_helpers.h"
+
+#include <cstdio>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+extern int disk_image_cache_kb;
+
+namespace {
+
+const uint64_t QCow2_TestClusterSize = 4096;
+const uint64_t QCow2_TestDiskSize = 16 * 1024 * 1024;
+
+/* header, L1 table, refcount table and one refcount block, one cluster each.
+ * 4KB clusters so that the writes need several L2 tables and a second
+ * refcount block (one covers 8MB of file). */
+FILE *QCow2_TestImage() {
+	std::vector<uint8_t> f((size_t)(4 * QCow2_TestClusterSize), 0);
+	ImageDisk_TestPutBE(f, 0, QCow2Image::magic, 4);
+	ImageDisk_TestPutBE(f, 4, 2, 4);
+	ImageDisk_TestPutBE(f, 20, 12, 4);                       /* cluster_bits */
+	ImageDisk_TestPutBE(f, 24, QCow2_TestDiskSize, 8);
+	ImageDisk_TestPutBE(f, 36, QCow2_TestDiskSize >> 21, 4); /* l1_size, 2MB per L2 table */
+	ImageDisk_TestPutBE(f, 40, 1 * QCow2_TestClusterSize, 8);
+	ImageDisk_TestPutBE(f, 48, 2 * QCow2_TestClusterSize, 8);
+	ImageDisk_TestPutBE(f, 56, 1, 4);
+	ImageDisk_TestPutBE(f, 2 * QCow2_TestClusterSize, 3 * QCow2_TestClusterSize, 8);
+	for (unsigned int i = 0; i < 4; i++) ImageDisk_TestPutBE(f, 3 * QCow2_TestClusterSize + i * 2, 1, 2);
+
+	FILE *file = tmpfile();
+	if (file != NULL) fwrite(f.data(), 1, f.size(), file);
+	return file;
+}
+
+/* every cluster the tables point to has a refcount of 1, and nothing else does */
+void QCow2_TestCheckRefcounts(const std::vector<uint8_t> &f) {
+	ASSERT_EQ(f.size() % QCow2_TestClusterSize, 0u);
+	const size_t clusters = f.size() / QCow2_TestClusterSize;
+	std::vector<unsigned int> used(clusters, 0);
+	auto use = [&](uint64_t offset) {
+		ASSERT_EQ(offset % QCow2_TestClusterSize, 0u);
+		ASSERT_LT(offset / QCow2_TestClusterSize, clusters);
+		used[(size_t)(offset / QCow2_TestClusterSize)]++;
+	};
+
+	for (uint64_t c = 0; c < 4; c++) use(c * QCow2_TestClusterSize);
+	for (uint64_t i = 0; i < (QCow2_TestDiskSize >> 21); i++) {
+		const uint64_t l2 = ImageDisk_TestGetBE(f, QCow2_TestClusterSize + i * 8, 8) & 0x00FFFFFFFFFFFFFFull;
+		if (l2 == 0) continue;
+		use(l2);
+		for (uint64_t j = 0; j < QCow2_TestClusterSize / 8; j++) {
+			const uint64_t data = ImageDisk_TestGetBE(f, l2 + j * 8, 8) & 0x00FFFFFFFFFFFFFFull;
+			if (data != 0) use(data);
+		}
+	}
+	for (uint64_t i = 1; i < QCow2_TestClusterSize / 8; i++) {
+		const uint64_t block = ImageDisk_TestGetBE(f, 2 * QCow2_TestClusterSize + i * 8, 8);
+		if (block != 0) use(block);
+	}
+
+	for (size_t c = 0; c < clusters; c++) {
+		const uint64_t block = ImageDisk_TestGetBE(f, 2 * QCow2_TestClusterSize + (c / (QCow2_TestClusterSize / 2)) * 8, 8);
+		ASSERT_NE(block, 0u) << "cluster " << c;
+		EXPECT_EQ(ImageDisk_TestGetBE(f, block + (c % (QCow2_TestClusterSize / 2)) * 2, 2), used[c]) << "cluster " << c;
+	}
+}
+
+TEST(QCow2Image, RangesMatchShadowAndRefcounts)
+{
+	const int cache_kb = disk_image_cache_kb;
+	for (const int kb : {8192, 0}) {
+		disk_image_cache_kb = kb;
+		FILE *file = QCow2_TestImage();
+		ASSERT_NE(file, nullptr);
+		std::vector<uint8_t> shadow((size_t)QCow2_TestDiskSize, 0);
+		{
+			QCow2Image::QCow2Header header = QCow2Image::read_header(file);
+			QCow2Image image(header, file, "test.qcow2", 512);
+			uint32_t seed = 99u;
+			std::vector<uint8_t> buf;
+			for (unsigned int i = 0; i < 2000; i++) {
+				const uint32_t sectnum = Test_Random(seed) % (uint32_t)(QCow2_TestDiskSize / 512u);
+				const uint32_t count = std::min(1u + Test_Random(seed) % 64u, (uint32_t)(QCow2_TestDiskSize / 512u) - sectnum);
+				buf.resize((size_t)count * 512u);
+				if (i & 1u) {
+					for (auto &v : buf) v = (uint8_t)Test_Random(seed);
+					ASSERT_EQ(image.write_sectors(sectnum, count, buf.data()), 0);
+					std::copy(buf.begin(), buf.end(), shadow.begin() + (long)sectnum * 512);
+				}
+				else {
+					ASSERT_EQ(image.read_sectors(sectnum, count, buf.data()), 0);
+					ASSERT_TRUE(std::equal(buf.begin(), buf.end(), shadow.begin() + (long)sectnum * 512)) << "read " << i;
+				}
+			}
+			uint8_t sector[512];
+			EXPECT_NE(image.read_sectors((uint32_t)(QCow2_TestDiskSize / 512u) - 1u, 2, sector), 0);
+		}
+		const std::vector<uint8_t> f = ImageDisk_TestContents(file);
+		EXPECT_GT(f.size(), (QCow2_TestClusterSize / 2) * QCow2_TestClusterSize);
+		QCow2_TestCheckRefcounts(f);
+		{
+			/* reopened, everything comes back from the file */
+			QCow2Image::QCow2Header header = QCow2Image::read_header(file);
+			QCow2Image image(header, file, "test.qcow2", 512);
+			std::vector<uint8_t> all(shadow.size());
+			ASSERT_EQ(image.read_sectors(0, (uint32_t)(QCow2_TestDiskSize / 512u), all.data()), 0);
+			EXPECT_TRUE(all == shadow) << "cache " << kb;
+		}
+		fclose(file);
+	}
+	disk_image_cache_kb = cache_kb;
+}
+
+} // namespace
@@ -23,8 +23,19 @@
 
 #include "dos_files_tests.cpp"
 #include "drives_tests.cpp"
+#include "dynamic_core_tests.cpp"
+#include "ide_tests.cpp"
+#include "imagedisk_cache_tests.cpp"
+#include "imagedisk_chd_tests.cpp"
+#include "imagedisk_mmap_tests.cpp"
+#include "mixer_tests.cpp"
+#include "paging_tests.cpp"
+#include "pic_tests.cpp"
+#include "qcow2_disk_tests.cpp"
 #include "shell_cmds_tests.cpp"
 #include "shell_redirection_tests.cpp"
+#include "vga_draw_tests.cpp"
+#include "zmbv_tests.cpp"
 
 #else
 //google test code causes problem on win9x, remove them and add empty implementations for linkage.
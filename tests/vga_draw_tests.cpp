@@ -0,0 +1,183 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "../src/hardware/vga_draw_simd.h"
+#include "vga.h"
+#include "imagedisk_test_helpers.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+/* odd on purpose, so the kernels have a tail to finish in C */
+constexpr Bitu vga_test_count = 1021;
+constexpr unsigned int vga_test_rounds = 200;
+
+struct VGA_TestData {
+	std::vector<uint32_t> xlat, planes, fg, bg;
+	std::vector<uint8_t> bytes;
+	std::vector<uint16_t> font;
+
+	VGA_TestData() : xlat(256), planes(vga_test_count), fg(vga_test_count), bg(vga_test_count),
+		bytes(vga_test_count * 4u), font(vga_test_count) {
+		uint32_t seed = 42u;
+		for (auto &v : xlat) v = Test_Random(seed) | 0xFF000000u;
+		for (auto &v : planes) v = Test_Random(seed) ^ (Test_Random(seed) << 16u);
+		for (auto &v : fg) v = Test_Random(seed);
+		for (auto &v : bg) v = Test_Random(seed);
+		for (auto &v : bytes) v = (uint8_t)Test_Random(seed);
+		for (auto &v : font) v = (uint16_t)(Test_Random(seed) & 0x1FFu);
+	}
+};
+
+TEST(VGA_Draw, KernelsMatchC)
+{
+	const VGA_TestData d;
+	std::vector<uint32_t> want(vga_test_count * 9u), got(vga_test_count * 9u);
+
+	VGA_Planar4ToXlat32_C(want.data(), d.planes.data(), vga_test_count, d.xlat.data());
+	VGA_Planar4ToXlat32(got.data(), d.planes.data(), vga_test_count, d.xlat.data());
+	EXPECT_TRUE(std::equal(want.begin(), want.begin() + vga_test_count * 8u, got.begin()));
+
+	VGA_Xlat8To32_C(want.data(), d.bytes.data(), vga_test_count, d.xlat.data());
+	VGA_Xlat8To32(got.data(), d.bytes.data(), vga_test_count, d.xlat.data());
+	EXPECT_TRUE(std::equal(want.begin(), want.begin() + vga_test_count, got.begin()));
+
+	/* the C version reads one byte past the last pixel */
+	VGA_RGB24To32_C(want.data(), d.bytes.data(), vga_test_count);
+	VGA_RGB24To32(got.data(), d.bytes.data(), vga_test_count);
+	EXPECT_TRUE(std::equal(want.begin(), want.begin() + vga_test_count, got.begin()));
+
+	for (unsigned int width = 8; width <= 9; width++) {
+		VGA_TextExpand32_C(want.data(), d.font.data(), d.fg.data(), d.bg.data(), vga_test_count, width);
+		VGA_TextExpand32(got.data(), d.font.data(), d.fg.data(), d.bg.data(), vga_test_count, width);
+		EXPECT_TRUE(std::equal(want.begin(), want.begin() + vga_test_count * width, got.begin())) << "width " << width;
+	}
+}
+
+template <typename F> double VGA_TestMpixels(Bitu pixels, F f) {
+	typedef std::chrono::steady_clock clock;
+	const auto t_start = clock::now();
+	for (unsigned int r = 0; r < vga_test_rounds; r++) f();
+	const double us = std::chrono::duration<double, std::micro>(clock::now() - t_start).count();
+	return us > 0.0 ? ((double)pixels * vga_test_rounds) / us : 0.0;
+}
+
+/* timing only, run with --gtest_also_run_disabled_tests */
+TEST(VGA_Draw, DISABLED_Throughput)
+{
+	const VGA_TestData d;
+	std::vector<uint32_t> out(vga_test_count * 9u);
+	uint32_t *o = out.data();
+
+	printf("VGA line kernels, Mpixels/s C vs dispatched (avx2 %s):\n", avx2_available ? "yes" : "no");
+	printf("  planar 16 color  %8.1f %8.1f\n",
+		VGA_TestMpixels(vga_test_count * 8u, [&] { VGA_Planar4ToXlat32_C(o, d.planes.data(), vga_test_count, d.xlat.data()); }),
+		VGA_TestMpixels(vga_test_count * 8u, [&] { VGA_Planar4ToXlat32(o, d.planes.data(), vga_test_count, d.xlat.data()); }));
+	printf("  8bpp             %8.1f %8.1f\n",
+		VGA_TestMpixels(vga_test_count, [&] { VGA_Xlat8To32_C(o, d.bytes.data(), vga_test_count, d.xlat.data()); }),
+		VGA_TestMpixels(vga_test_count, [&] { VGA_Xlat8To32(o, d.bytes.data(), vga_test_count, d.xlat.data()); }));
+	printf("  24bpp            %8.1f %8.1f\n",
+		VGA_TestMpixels(vga_test_count, [&] { VGA_RGB24To32_C(o, d.bytes.data(), vga_test_count); }),
+		VGA_TestMpixels(vga_test_count, [&] { VGA_RGB24To32(o, d.bytes.data(), vga_test_count); }));
+	for (unsigned int width = 8; width <= 9; width++) {
+		printf("  text %u dot       %8.1f %8.1f\n", width,
+			VGA_TestMpixels(vga_test_count * width, [&] { VGA_TextExpand32_C(o, d.font.data(), d.fg.data(), d.bg.data(), vga_test_count, width); }),
+			VGA_TestMpixels(vga_test_count * width, [&] { VGA_TextExpand32(o, d.font.data(), d.fg.data(), d.bg.data(), vga_test_count, width); }));
+	}
+}
+
+/* hand made input with the pixels worked out, odd counts for the tails again */
+TEST(VGA_Draw, KnownPixels)
+{
+	std::vector<uint32_t> xlat(256), out(19u * 9u);
+	for (unsigned int i = 0; i < 256; i++) xlat[i] = 0xFF000000u | (i * 0x010101u);
+
+	/* bit 7 of each plane is the leftmost pixel, plane 0 is bit 0 of the color */
+	const std::vector<uint32_t> planes(19, 0x11214181u);
+	const uint32_t planar_colors[8] = { 1, 2, 4, 8, 0, 0, 0, 15 };
+	VGA_Planar4ToXlat32(out.data(), planes.data(), planes.size(), xlat.data());
+	for (size_t i = 0; i < planes.size() * 8u; i++)
+		EXPECT_EQ(xlat[planar_colors[i % 8u]], out[i]) << "planar pixel " << i;
+
+	std::vector<uint8_t> bytes(19 * 3 + 1);
+	for (size_t i = 0; i < bytes.size(); i++) bytes[i] = (uint8_t)(i * 37u);
+	VGA_Xlat8To32(out.data(), bytes.data(), 19, xlat.data());
+	for (size_t i = 0; i < 19; i++)
+		EXPECT_EQ(0xFF000000u | (bytes[i] * 0x010101u), out[i]) << "8bpp pixel " << i;
+
+	/* blue, green, red in memory */
+	VGA_RGB24To32(out.data(), bytes.data(), 19);
+	for (size_t i = 0; i < 19; i++) {
+		const uint32_t rgb = bytes[i*3u] | ((uint32_t)bytes[i*3u+1u] << 8u) | ((uint32_t)bytes[i*3u+2u] << 16u);
+		EXPECT_EQ(0xFF000000u | rgb, out[i]) << "24bpp pixel " << i;
+	}
+
+	const std::vector<uint32_t> fg(19, 0xFFAAAAAAu), bg(19, 0xFF000000u);
+	const std::vector<uint16_t> font8(19, 0xF0u), font9(19, 0x155u);
+	VGA_TextExpand32(out.data(), font8.data(), fg.data(), bg.data(), 19, 8);
+	for (size_t i = 0; i < 19u * 8u; i++)
+		EXPECT_EQ((i % 8u) < 4u ? fg[0] : bg[0], out[i]) << "8 dot text pixel " << i;
+	VGA_TextExpand32(out.data(), font9.data(), fg.data(), bg.data(), 19, 9);
+	for (size_t i = 0; i < 19u * 9u; i++)
+		EXPECT_EQ((i % 9u) % 2u == 0u ? fg[0] : bg[0], out[i]) << "9 dot text pixel " << i;
+}
+
+
+/* A scanline recorded when it was drawn is passed as unchanged only while none of
+ * the video memory it reads is written, see VGA_DirtyLineUnchanged */
+TEST(VGA_Draw, WrittenLineIsRedrawn)
+{
+	std::vector<uint32_t> stamps((0x10000u >> VGA_DIRTY_SHIFT) + 1u, 0);
+	VGA_Dirty dirty;
+	dirty.stamp = stamps.data();
+	dirty.serial = 10;
+
+	/* 320 bytes from 1000h are blocks 10h and 11h, drawn at serial 10 */
+	const uint32_t drawn = dirty.serial++;
+	EXPECT_FALSE(dirty.written_since(0, 0x1000, 320, 0xFFFF, drawn));
+	dirty.mark(0x0FFF);
+	dirty.mark(0x1200);
+	EXPECT_FALSE(dirty.written_since(0, 0x1000, 320, 0xFFFF, drawn));
+	dirty.mark(0x1000 + 319);
+	EXPECT_TRUE(dirty.written_since(0, 0x1000, 320, 0xFFFF, drawn));
+
+	/* a 16KB window at 8000h that the scanline wraps around in */
+	const uint32_t wrapped = dirty.serial++;
+	EXPECT_FALSE(dirty.written_since(0x8000, 0x3F00, 0x200, 0x3FFF, wrapped));
+	dirty.mark(0xC000);
+	dirty.mark(0x8100);
+	EXPECT_FALSE(dirty.written_since(0x8000, 0x3F00, 0x200, 0x3FFF, wrapped));
+	dirty.mark(0x8080);
+	EXPECT_TRUE(dirty.written_since(0x8000, 0x3F00, 0x200, 0x3FFF, wrapped));
+	dirty.serial++;
+	EXPECT_FALSE(dirty.written_since(0x8000, 0x3F00, 0x200, 0x3FFF, dirty.serial));
+
+	/* after a mode set or palette change every line drawn so far is drawn again */
+	EXPECT_GT(dirty.serial, dirty.invalid);
+	dirty.invalidate();
+	EXPECT_LE(drawn, dirty.invalid);
+	EXPECT_LE(wrapped, dirty.invalid);
+}
+
+} // namespace
@@ -0,0 +1,124 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "config.h"
+
+#if (C_SSHOT)
+
+#include <stdint.h>
+#include <vector>
+#include <zlib.h>
+
+#include "../src/libs/zmbv/zmbv.h"
+#include "imagedisk_test_helpers.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+constexpr int zmbv_test_width = 320;
+constexpr int zmbv_test_height = 240;
+constexpr int zmbv_test_frames = 12;
+
+/* A background that scrolls, for the motion vectors, and a rectangle of noise
+ * large enough that a delta frame is deflated in more than one slice. */
+void ZMBV_TestFrame(std::vector<uint32_t> &frame,int n,bool rgb565) {
+	uint32_t seed = 1234u + (uint32_t)n;
+
+	for (int y=0;y < zmbv_test_height;y++) {
+		for (int x=0;x < zmbv_test_width;x++) {
+			uint32_t c = (uint32_t)(((x + n * 3) / 8) * 0x102030u + (y / 8) * 0x030201u);
+			if (x >= 40 && x < 280 && y >= 20 && y < 220 && ((n & 1) || y < 120)) {
+				c = Test_Random(seed);
+			}
+			frame[(size_t)y * zmbv_test_width + (size_t)x] = rgb565 ? (c & 0xffffu) : (c | 0xff000000u);
+		}
+	}
+}
+
+/* encodes the test frames and returns what a decoder makes of them */
+std::vector<uint8_t> ZMBV_TestRoundTrip(zmbv_format_t format,int threads,const std::vector< std::vector<uint32_t> > &frames) {
+	const bool rgb565 = (format == ZMBV_FORMAT_16BPP);
+	const size_t rowlen = (size_t)zmbv_test_width * 3u + (zmbv_test_width & 3u);
+	std::vector<uint8_t> decoded;
+
+	VideoCodec enc, dec;
+	EXPECT_TRUE(enc.SetupCompress(zmbv_test_width, zmbv_test_height, threads));
+	EXPECT_TRUE(dec.SetupDecompress(zmbv_test_width, zmbv_test_height));
+
+	std::vector<uint8_t> buf((size_t)enc.NeededSize(zmbv_test_width, zmbv_test_height, format));
+	std::vector<uint16_t> line16(zmbv_test_width);
+	std::vector<uint8_t> out(rowlen * zmbv_test_height);
+
+	for (size_t n=0;n < frames.size();n++) {
+		EXPECT_TRUE(enc.PrepareCompressFrame((n % 6) == 0 ? 1 : 0, format, NULL, buf.data(), (int)buf.size()));
+		for (int y=0;y < zmbv_test_height;y++) {
+			const uint32_t *src = &frames[n][(size_t)y * zmbv_test_width];
+			void *line = (void*)src;
+			if (rgb565) {
+				for (int x=0;x < zmbv_test_width;x++) line16[(size_t)x] = (uint16_t)src[x];
+				line = line16.data();
+			}
+			enc.CompressLines(1, &line);
+		}
+
+		const int size = enc.FinishCompressFrame();
+		EXPECT_GT(size, 0);
+		EXPECT_TRUE(dec.DecompressFrame(buf.data(), size));
+		dec.Output_UpsideDown_24(out.data());
+		decoded.insert(decoded.end(), out.begin(), out.end());
+	}
+	return decoded;
+}
+
+TEST(ZMBV, ThreadedEncoderDecodes)
+{
+	for (const zmbv_format_t format : { ZMBV_FORMAT_32BPP, ZMBV_FORMAT_16BPP }) {
+		std::vector< std::vector<uint32_t> > frames(zmbv_test_frames);
+		for (int n=0;n < zmbv_test_frames;n++) {
+			frames[(size_t)n].resize((size_t)zmbv_test_width * zmbv_test_height);
+			ZMBV_TestFrame(frames[(size_t)n], n, format == ZMBV_FORMAT_16BPP);
+		}
+
+		const std::vector<uint8_t> single = ZMBV_TestRoundTrip(format, 0, frames);
+		const std::vector<uint8_t> threaded = ZMBV_TestRoundTrip(format, 3, frames);
+		EXPECT_TRUE(single == threaded);
+
+		if (format != ZMBV_FORMAT_32BPP) continue;
+
+		/* the decoder outputs the frames bottom up as BGR */
+		const size_t rowlen = (size_t)zmbv_test_width * 3u + (zmbv_test_width & 3u);
+		size_t mismatches = 0;
+		for (size_t n=0;n < frames.size();n++) {
+			const uint8_t *out = &threaded[n * rowlen * zmbv_test_height];
+			for (int y=0;y < zmbv_test_height;y++) {
+				const uint8_t *row = out + (size_t)(zmbv_test_height - 1 - y) * rowlen;
+				for (int x=0;x < zmbv_test_width;x++) {
+					const uint32_t c = frames[n][(size_t)y * zmbv_test_width + (size_t)x];
+					if (row[x*3+0] != (uint8_t)c || row[x*3+1] != (uint8_t)(c >> 8) || row[x*3+2] != (uint8_t)(c >> 16))
+						mismatches++;
+				}
+			}
+		}
+		EXPECT_EQ(mismatches, 0u);
+	}
+}
+
+} // namespace
+
+#endif
@@ -89,6 +89,9 @@
 /* Force SDL drawn menus */
 #undef C_FORCE_MENU_SDLDRAW
 
+/* Define to 1 to compile in the host time profiler */
+#undef C_HOST_PROFILER
+
 /* Define to 1 to enable floating point emulation */
 #define C_FPU 1
 